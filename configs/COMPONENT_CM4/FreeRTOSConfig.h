@@ -127,10 +127,18 @@
 #define configUSE_DAEMON_TASK_STARTUP_HOOK      0
 
 /* Run time and task stats gathering related definitions. */
-#define configGENERATE_RUN_TIME_STATS           0
+#define configGENERATE_RUN_TIME_STATS           1
 #define configUSE_TRACE_FACILITY                1
 #define configUSE_STATS_FORMATTING_FUNCTIONS    0
 
+/* Run time counter and context switch counts, see runtime_stats.c */
+extern void runtime_stats_timer_init( void );
+extern uint32_t runtime_stats_counter( void );
+extern void runtime_stats_task_switched_in( uint32_t task_number );
+#define portCONFIGURE_TIMER_FOR_RUN_TIME_STATS()    runtime_stats_timer_init()
+#define portGET_RUN_TIME_COUNTER_VALUE()            runtime_stats_counter()
+#define traceTASK_SWITCHED_IN()                     runtime_stats_task_switched_in( pxCurrentTCB->uxTCBNumber )
+
 /* Co-routine related definitions. */
 #define configUSE_CO_ROUTINES                   0
 #define configMAX_CO_ROUTINE_PRIORITIES         2
@@ -73,6 +73,20 @@
 #define MQTT_SUB_TOPIC_TWO				  "EC_Reading"
 #define MQTT_SUB_TOPIC_THREE			  "PumpSecond"
 
+/* Per-device telemetry topic, '%s' is replaced by the device identifier
+ * (MQTT_CLIENT_IDENTIFIER followed by the silicon unique ID).
+ */
+#define MQTT_TELEMETRY_TOPIC_FORMAT       "hydro/%s/telemetry"
+
+/* Per-device command topic, payloads are CBOR maps (see subscriber_task.h) */
+#define MQTT_COMMAND_TOPIC_FORMAT         "hydro/%s/cmd"
+
+/* Per-device diagnostics topic, CBOR task statistics (see runtime_stats.h) */
+#define MQTT_DIAG_TOPIC_FORMAT            "hydro/%s/diag"
+
+/* Per-device log topic, binary frames for tools/log_decode (see dlog.h) */
+#define MQTT_LOG_TOPIC_FORMAT             "hydro/%s/log"
+
 /* Set the QoS that is associated with the MQTT publish, and subscribe messages.
  * Valid choices are 0, 1, and 2. Other values should not be used in this macro.
  */
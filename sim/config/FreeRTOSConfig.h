@@ -0,0 +1,107 @@
+/******************************************************************************
+* File Name:   FreeRTOSConfig.h
+*
+* Description: FreeRTOS configuration for the host simulation build (POSIX
+*              port). Scheduling options mirror configs/COMPONENT_CM4 so the
+*              task graph behaves like it does on the board.
+*
+* Related Document: See README.md
+*
+*******************************************************************************/
+
+#ifndef FREERTOS_CONFIG_H
+#define FREERTOS_CONFIG_H
+
+#include <stdint.h>
+
+#define configUSE_PREEMPTION                    1
+#define configUSE_PORT_OPTIMISED_TASK_SELECTION 0
+#define configTICK_RATE_HZ                      1000u
+#define configMAX_PRIORITIES                    7
+#define configMINIMAL_STACK_SIZE                ( ( configSTACK_DEPTH_TYPE ) 4096 )
+#define configMAX_TASK_NAME_LEN                 16
+#define configUSE_16_BIT_TICKS                  0
+#define configIDLE_SHOULD_YIELD                 1
+#define configUSE_TASK_NOTIFICATIONS            1
+#define configUSE_MUTEXES                       1
+#define configUSE_RECURSIVE_MUTEXES             1
+#define configUSE_COUNTING_SEMAPHORES           1
+#define configQUEUE_REGISTRY_SIZE               10
+#define configUSE_QUEUE_SETS                    0
+#define configUSE_TIME_SLICING                  1
+#define configENABLE_BACKWARD_COMPATIBILITY     0
+#define configNUM_THREAD_LOCAL_STORAGE_POINTERS 16
+#define configSTACK_DEPTH_TYPE                  uint32_t
+
+/* Memory allocation related definitions. */
+#define configSUPPORT_STATIC_ALLOCATION         1
+#define configSUPPORT_DYNAMIC_ALLOCATION        1
+#define configKERNEL_PROVIDED_STATIC_MEMORY     0
+#define configTOTAL_HEAP_SIZE                   ( 1024 * 1024 )
+#define configAPPLICATION_ALLOCATED_HEAP        0
+
+/* Hook function related definitions. */
+#define configUSE_IDLE_HOOK                     0
+#define configUSE_TICK_HOOK                     0
+#define configCHECK_FOR_STACK_OVERFLOW          0
+#define configUSE_MALLOC_FAILED_HOOK            1
+#define configUSE_DAEMON_TASK_STARTUP_HOOK      0
+
+/* Run time and task stats gathering related definitions. */
+#define configGENERATE_RUN_TIME_STATS           1
+#define configUSE_TRACE_FACILITY                1
+#define configUSE_STATS_FORMATTING_FUNCTIONS    0
+
+/* Run time counter and context switch counts, see runtime_stats.c */
+extern void runtime_stats_timer_init( void );
+extern uint32_t runtime_stats_counter( void );
+extern void runtime_stats_task_switched_in( uint32_t task_number );
+#define portCONFIGURE_TIMER_FOR_RUN_TIME_STATS()    runtime_stats_timer_init()
+#define portGET_RUN_TIME_COUNTER_VALUE()            runtime_stats_counter()
+#define traceTASK_SWITCHED_IN()                     runtime_stats_task_switched_in( pxCurrentTCB->uxTCBNumber )
+
+/* Co-routine related definitions. */
+#define configUSE_CO_ROUTINES                   0
+#define configMAX_CO_ROUTINE_PRIORITIES         2
+
+/* Software timer related definitions. */
+#define configUSE_TIMERS                        1
+#define configTIMER_TASK_PRIORITY               2
+#define configTIMER_QUEUE_LENGTH                10
+#define configTIMER_TASK_STACK_DEPTH            configMINIMAL_STACK_SIZE
+
+/* Set the following definitions to 1 to include the API function, or zero
+to exclude the API function. */
+#define INCLUDE_vTaskPrioritySet                1
+#define INCLUDE_uxTaskPriorityGet               1
+#define INCLUDE_vTaskDelete                     1
+#define INCLUDE_vTaskSuspend                    1
+#define INCLUDE_xResumeFromISR                  1
+#define INCLUDE_vTaskDelayUntil                 1
+#define INCLUDE_vTaskDelay                      1
+#define INCLUDE_xTaskGetSchedulerState          1
+#define INCLUDE_xTaskGetCurrentTaskHandle       1
+#define INCLUDE_uxTaskGetStackHighWaterMark     1
+#define INCLUDE_xTaskGetIdleTaskHandle          0
+#define INCLUDE_eTaskGetState                   0
+#define INCLUDE_xEventGroupSetBitFromISR        1
+#define INCLUDE_xTimerPendFunctionCall          1
+#define INCLUDE_xTaskAbortDelay                 0
+#define INCLUDE_xTaskGetHandle                  0
+#define INCLUDE_xTaskResumeFromISR              1
+
+/* The firmware sizes its task stacks for a Cortex-M4. Tasks created by the
+ * application are rescaled in sim_platform.c so they fit a host pthread.
+ */
+#define SIM_TASK_STACK_SCALE                    (8u)
+
+#if defined(NDEBUG)
+#define configASSERT( x ) ( ( void ) ( x ) )
+#else
+extern void vAssertCalled( const char * const pcFileName, unsigned long ulLine );
+#define configASSERT( x ) if( ( x ) == 0 ) vAssertCalled( __FILE__, __LINE__ )
+#endif
+
+#endif /* FREERTOS_CONFIG_H */
+
+/* [] END OF FILE */
@@ -0,0 +1,19 @@
+/******************************************************************************
+* File Name:   clock.h
+*
+* Description: Host simulation stand-in for the FreeRTOS-Plus clock helper.
+*
+* Related Document: See README.md
+*
+*******************************************************************************/
+
+#ifndef CLOCK_H_
+#define CLOCK_H_
+
+#include <stdint.h>
+
+uint32_t Clock_GetTimeMs(void);
+
+#endif /* CLOCK_H_ */
+
+/* [] END OF FILE */
@@ -0,0 +1,142 @@
+/******************************************************************************
+* File Name:   cy_mqtt_api.h
+*
+* Description: Host simulation stand-in for the Infineon MQTT library API.
+*              The implementation in sim/source/sim_mqtt.c talks to a local
+*              Mosquitto broker through libmosquitto.
+*
+* Related Document: See README.md
+*
+*******************************************************************************/
+
+#ifndef CY_MQTT_API_H_
+#define CY_MQTT_API_H_
+
+#include "cyhal.h"
+
+/*******************************************************************************
+* Macros
+********************************************************************************/
+#define CY_MQTT_MIN_NETWORK_BUFFER_SIZE (256u)
+
+/*******************************************************************************
+* Global Variables
+********************************************************************************/
+typedef void *cy_mqtt_t;
+
+typedef enum
+{
+    CY_MQTT_QOS0 = 0,
+    CY_MQTT_QOS1,
+    CY_MQTT_QOS2,
+    CY_MQTT_QOS_INVALID
+} cy_mqtt_qos_t;
+
+typedef struct
+{
+    cy_mqtt_qos_t qos;
+    bool retain;
+    bool dup;
+    const char *topic;
+    uint16_t topic_len;
+    const char *payload;
+    size_t payload_len;
+} cy_mqtt_publish_info_t;
+
+typedef cy_mqtt_publish_info_t cy_mqtt_message_t;
+
+typedef struct
+{
+    cy_mqtt_qos_t qos;
+    const char *topic;
+    uint16_t topic_len;
+    cy_mqtt_qos_t allocated_qos;
+} cy_mqtt_subscribe_info_t;
+
+typedef cy_mqtt_subscribe_info_t cy_mqtt_unsubscribe_info_t;
+
+typedef struct
+{
+    const char *hostname;
+    uint16_t hostname_len;
+    uint16_t port;
+} cy_mqtt_broker_info_t;
+
+typedef struct
+{
+    const char *client_cert;
+    size_t client_cert_size;
+    const char *private_key;
+    size_t private_key_size;
+    const char *root_ca;
+    size_t root_ca_size;
+    const char *alpnprotos;
+    size_t alpnprotoslen;
+    const char *sni_host_name;
+    size_t sni_host_name_size;
+} cy_awsport_ssl_credentials_t;
+
+typedef struct
+{
+    bool clean_session;
+    const char *client_id;
+    uint16_t client_id_len;
+    const char *username;
+    uint16_t username_len;
+    const char *password;
+    uint16_t password_len;
+    uint16_t keep_alive_sec;
+    cy_mqtt_publish_info_t *will_info;
+} cy_mqtt_connect_info_t;
+
+typedef enum
+{
+    CY_MQTT_EVENT_TYPE_DISCONNECT = 0,
+    CY_MQTT_EVENT_TYPE_SUBSCRIPTION_MESSAGE_RECEIVE
+} cy_mqtt_event_type_t;
+
+typedef enum
+{
+    CY_MQTT_DISCONN_TYPE_BROKER_DOWN = 0,
+    CY_MQTT_DISCONN_TYPE_NETWORK_DOWN,
+    CY_MQTT_DISCONN_TYPE_BAD_RESPONSE,
+    CY_MQTT_DISCONN_TYPE_SND_RCV_FAIL
+} cy_mqtt_disconn_type_t;
+
+typedef struct
+{
+    uint16_t packet_id;
+    cy_mqtt_publish_info_t received_message;
+} cy_mqtt_received_msg_info_t;
+
+typedef struct
+{
+    cy_mqtt_event_type_t type;
+    union
+    {
+        cy_mqtt_disconn_type_t reason;
+        cy_mqtt_received_msg_info_t pub_msg;
+    } data;
+} cy_mqtt_event_t;
+
+typedef void (*cy_mqtt_callback_t)(cy_mqtt_t mqtt_handle, cy_mqtt_event_t event, void *user_data);
+
+/*******************************************************************************
+* Function Prototypes
+********************************************************************************/
+cy_rslt_t cy_mqtt_init(void);
+cy_rslt_t cy_mqtt_deinit(void);
+cy_rslt_t cy_mqtt_create(uint8_t *buffer, uint32_t buff_len,
+                         cy_awsport_ssl_credentials_t *security,
+                         cy_mqtt_broker_info_t *broker_info,
+                         char *descriptor, cy_mqtt_t *mqtt_handle);
+cy_rslt_t cy_mqtt_register_event_callback(cy_mqtt_t mqtt_handle, cy_mqtt_callback_t event_callback, void *user_data);
+cy_rslt_t cy_mqtt_connect(cy_mqtt_t mqtt_handle, cy_mqtt_connect_info_t *connect_info);
+cy_rslt_t cy_mqtt_publish(cy_mqtt_t mqtt_handle, cy_mqtt_publish_info_t *pub_msg);
+cy_rslt_t cy_mqtt_subscribe(cy_mqtt_t mqtt_handle, cy_mqtt_subscribe_info_t *sub_info, uint8_t sub_count);
+cy_rslt_t cy_mqtt_disconnect(cy_mqtt_t mqtt_handle);
+cy_rslt_t cy_mqtt_delete(cy_mqtt_t mqtt_handle);
+
+#endif /* CY_MQTT_API_H_ */
+
+/* [] END OF FILE */
@@ -0,0 +1,28 @@
+/******************************************************************************
+* File Name:   cy_pdl.h
+*
+* Description: Host simulation stand-in for the Peripheral Driver Library.
+*
+* Related Document: See README.md
+*
+*******************************************************************************/
+
+#ifndef CY_PDL_H_
+#define CY_PDL_H_
+
+#include "cyhal.h"
+
+/* Die unique ID, see sim_platform.c */
+uint64_t Cy_SysLib_GetUniqueId(void);
+
+/* Moves the compare of a running timer, see sim_timer.c. 'base' is the
+ * cyhal_timer_t, as set by cyhal_timer_init(). */
+void Cy_TCPWM_Counter_SetCompare0(void *base, uint32_t cntNum, uint32_t compare0);
+
+/* Count latched by the last and the previous capture input edge */
+uint32_t Cy_TCPWM_Counter_GetCapture0Val(void *base, uint32_t cntNum);
+uint32_t Cy_TCPWM_Counter_GetCapture0BufVal(void *base, uint32_t cntNum);
+
+#endif /* CY_PDL_H_ */
+
+/* [] END OF FILE */
@@ -0,0 +1,24 @@
+/******************************************************************************
+* File Name:   cy_retarget_io.h
+*
+* Description: Host simulation stand-in for retarget-io. printf goes to stdout.
+*
+* Related Document: See README.md
+*
+*******************************************************************************/
+
+#ifndef CY_RETARGET_IO_H_
+#define CY_RETARGET_IO_H_
+
+#include "cyhal.h"
+
+#define CY_RETARGET_IO_BAUDRATE         (115200)
+
+/* Binary writes from the deferred logger go to stdout with printf */
+extern cyhal_uart_t cy_retarget_io_uart_obj;
+
+cy_rslt_t cy_retarget_io_init(cyhal_gpio_t tx, cyhal_gpio_t rx, uint32_t baudrate);
+
+#endif /* CY_RETARGET_IO_H_ */
+
+/* [] END OF FILE */
@@ -0,0 +1,26 @@
+/******************************************************************************
+* File Name:   cybsp.h
+*
+* Description: Host simulation stand-in for the board support package.
+*
+* Related Document: See README.md
+*
+*******************************************************************************/
+
+#ifndef CYBSP_H_
+#define CYBSP_H_
+
+#include "cyhal.h"
+
+/* CY8CPROTO-062-4343W pin assignments used by the firmware */
+#define CYBSP_USER_LED                  (P13_7)
+#define CYBSP_LED_STATE_ON              (0u)
+#define CYBSP_LED_STATE_OFF             (1u)
+#define CYBSP_DEBUG_UART_TX             (P5_1)
+#define CYBSP_DEBUG_UART_RX             (P5_0)
+
+cy_rslt_t cybsp_init(void);
+
+#endif /* CYBSP_H_ */
+
+/* [] END OF FILE */
@@ -0,0 +1,349 @@
+/******************************************************************************
+* File Name:   cyhal.h
+*
+* Description: Host simulation stand-in for the PSoC 6 Hardware Abstraction
+*              Layer. Only the GPIO, timer, ADC, flash and UART calls used by
+*              the firmware are provided; they are backed by the virtual
+*              peripherals in sim/source.
+*
+* Related Document: See README.md
+*
+*******************************************************************************/
+
+#ifndef CYHAL_H_
+#define CYHAL_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "sim_hw.h"
+
+/*******************************************************************************
+* Macros
+********************************************************************************/
+typedef uint32_t cy_rslt_t;
+
+#define CY_RSLT_SUCCESS                 ((cy_rslt_t)0x00000000U)
+#define CY_RSLT_SIM_ERROR               ((cy_rslt_t)0x04020001U)
+
+#define CY_ASSERT(x)                    do { if (!(x)) { fprintf(stderr, "CY_ASSERT %s:%d\n", __FILE__, __LINE__); abort(); } } while (0)
+#define CY_UNUSED_PARAMETER(x)          ((void)(x))
+#define CY_HALT()                       abort()
+
+#define __enable_irq()                  do { } while (0)
+#define __disable_irq()                 do { } while (0)
+
+#define CYHAL_ISR_PRIORITY_DEFAULT      (7u)
+#define CYHAL_DMA_PRIORITY_DEFAULT      (3u)
+
+/*******************************************************************************
+* GPIO
+********************************************************************************/
+typedef enum
+{
+    P0_0 = 0x00, P0_1 = 0x01, P0_2 = 0x02, P0_3 = 0x03, P0_4 = 0x04, P0_5 = 0x05, P0_6 = 0x06, P0_7 = 0x07,
+    P1_0 = 0x08, P1_1 = 0x09, P1_2 = 0x0A, P1_3 = 0x0B, P1_4 = 0x0C, P1_5 = 0x0D, P1_6 = 0x0E, P1_7 = 0x0F,
+    P2_0 = 0x10, P2_1 = 0x11, P2_2 = 0x12, P2_3 = 0x13, P2_4 = 0x14, P2_5 = 0x15, P2_6 = 0x16, P2_7 = 0x17,
+    P3_0 = 0x18, P3_1 = 0x19, P3_2 = 0x1A, P3_3 = 0x1B, P3_4 = 0x1C, P3_5 = 0x1D, P3_6 = 0x1E, P3_7 = 0x1F,
+    P4_0 = 0x20, P4_1 = 0x21, P4_2 = 0x22, P4_3 = 0x23, P4_4 = 0x24, P4_5 = 0x25, P4_6 = 0x26, P4_7 = 0x27,
+    P5_0 = 0x28, P5_1 = 0x29, P5_2 = 0x2A, P5_3 = 0x2B, P5_4 = 0x2C, P5_5 = 0x2D, P5_6 = 0x2E, P5_7 = 0x2F,
+    P6_0 = 0x30, P6_1 = 0x31, P6_2 = 0x32, P6_3 = 0x33, P6_4 = 0x34, P6_5 = 0x35, P6_6 = 0x36, P6_7 = 0x37,
+    P7_0 = 0x38, P7_1 = 0x39, P7_2 = 0x3A, P7_3 = 0x3B, P7_4 = 0x3C, P7_5 = 0x3D, P7_6 = 0x3E, P7_7 = 0x3F,
+    P8_0 = 0x40, P8_1 = 0x41, P8_2 = 0x42, P8_3 = 0x43, P8_4 = 0x44, P8_5 = 0x45, P8_6 = 0x46, P8_7 = 0x47,
+    P9_0 = 0x48, P9_1 = 0x49, P9_2 = 0x4A, P9_3 = 0x4B, P9_4 = 0x4C, P9_5 = 0x4D, P9_6 = 0x4E, P9_7 = 0x4F,
+    P10_0 = 0x50, P10_1 = 0x51, P10_2 = 0x52, P10_3 = 0x53, P10_4 = 0x54, P10_5 = 0x55, P10_6 = 0x56, P10_7 = 0x57,
+    P11_0 = 0x58, P11_1 = 0x59, P11_2 = 0x5A, P11_3 = 0x5B, P11_4 = 0x5C, P11_5 = 0x5D, P11_6 = 0x5E, P11_7 = 0x5F,
+    P12_0 = 0x60, P12_1 = 0x61, P12_2 = 0x62, P12_3 = 0x63, P12_4 = 0x64, P12_5 = 0x65, P12_6 = 0x66, P12_7 = 0x67,
+    P13_0 = 0x68, P13_1 = 0x69, P13_2 = 0x6A, P13_3 = 0x6B, P13_4 = 0x6C, P13_5 = 0x6D, P13_6 = 0x6E, P13_7 = 0x6F,
+    NC = 0xFF
+} cyhal_gpio_t;
+
+typedef enum
+{
+    CYHAL_GPIO_DIR_INPUT,
+    CYHAL_GPIO_DIR_OUTPUT,
+    CYHAL_GPIO_DIR_BIDIRECTIONAL
+} cyhal_gpio_direction_t;
+
+typedef enum
+{
+    CYHAL_GPIO_DRIVE_NONE,
+    CYHAL_GPIO_DRIVE_ANALOG,
+    CYHAL_GPIO_DRIVE_PULLUP,
+    CYHAL_GPIO_DRIVE_PULLDOWN,
+    CYHAL_GPIO_DRIVE_OPENDRAINDRIVESLOW,
+    CYHAL_GPIO_DRIVE_OPENDRAINDRIVESHIGH,
+    CYHAL_GPIO_DRIVE_STRONG,
+    CYHAL_GPIO_DRIVE_PULLUPDOWN
+} cyhal_gpio_drive_mode_t;
+
+typedef enum
+{
+    CYHAL_GPIO_IRQ_NONE = 0,
+    CYHAL_GPIO_IRQ_RISE = 1 << 0,
+    CYHAL_GPIO_IRQ_FALL = 1 << 1,
+    CYHAL_GPIO_IRQ_BOTH = (1 << 0) | (1 << 1)
+} cyhal_gpio_event_t;
+
+typedef void (*cyhal_gpio_event_callback_t)(void *callback_arg, cyhal_gpio_event_t event);
+
+typedef struct cyhal_gpio_callback_data_s
+{
+    cyhal_gpio_event_callback_t callback;
+    void *callback_arg;
+    struct cyhal_gpio_callback_data_s *next;
+    cyhal_gpio_t pin;
+} cyhal_gpio_callback_data_t;
+
+typedef enum
+{
+    CYHAL_SIGNAL_TYPE_LEVEL,
+    CYHAL_SIGNAL_TYPE_EDGE
+} cyhal_signal_type_t;
+
+typedef enum
+{
+    CYHAL_EDGE_TYPE_RISING_EDGE,
+    CYHAL_EDGE_TYPE_FALLING_EDGE,
+    CYHAL_EDGE_TYPE_BOTH_EDGES,
+    CYHAL_EDGE_TYPE_LEVEL
+} cyhal_edge_type_t;
+
+typedef uint32_t cyhal_source_t;
+
+cy_rslt_t cyhal_gpio_init(cyhal_gpio_t pin, cyhal_gpio_direction_t direction, cyhal_gpio_drive_mode_t drive_mode, bool init_val);
+void cyhal_gpio_free(cyhal_gpio_t pin);
+void cyhal_gpio_write(cyhal_gpio_t pin, bool value);
+bool cyhal_gpio_read(cyhal_gpio_t pin);
+void cyhal_gpio_toggle(cyhal_gpio_t pin);
+void cyhal_gpio_register_callback(cyhal_gpio_t pin, cyhal_gpio_callback_data_t *callback_data);
+void cyhal_gpio_enable_event(cyhal_gpio_t pin, cyhal_gpio_event_t event, uint8_t intr_priority, bool enable);
+cy_rslt_t cyhal_gpio_enable_output(cyhal_gpio_t pin, cyhal_signal_type_t type, cyhal_source_t *source);
+
+/*******************************************************************************
+* Timer
+********************************************************************************/
+typedef struct cyhal_clock_s cyhal_clock_t;
+
+typedef enum
+{
+    CYHAL_TIMER_DIR_UP,
+    CYHAL_TIMER_DIR_DOWN,
+    CYHAL_TIMER_DIR_UP_DOWN
+} cyhal_timer_direction_t;
+
+typedef enum
+{
+    CYHAL_TIMER_IRQ_NONE = 0,
+    CYHAL_TIMER_IRQ_TERMINAL_COUNT = 1 << 0,
+    CYHAL_TIMER_IRQ_CAPTURE_COMPARE = 1 << 1,
+    CYHAL_TIMER_IRQ_ALL = (1 << 2) - 1
+} cyhal_timer_event_t;
+
+typedef enum
+{
+    CYHAL_TIMER_INPUT_START,
+    CYHAL_TIMER_INPUT_STOP,
+    CYHAL_TIMER_INPUT_RELOAD,
+    CYHAL_TIMER_INPUT_COUNT,
+    CYHAL_TIMER_INPUT_CAPTURE
+} cyhal_timer_input_t;
+
+typedef struct
+{
+    bool is_continuous;
+    cyhal_timer_direction_t direction;
+    bool is_compare;
+    uint32_t period;
+    uint32_t compare_value;
+    uint32_t value;
+} cyhal_timer_cfg_t;
+
+typedef void (*cyhal_timer_event_callback_t)(void *callback_arg, cyhal_timer_event_t event);
+
+typedef struct
+{
+    uint8_t block_num;
+    uint8_t channel_num;
+} cyhal_resource_inst_t;
+
+typedef struct
+{
+    void *base;
+    cyhal_resource_inst_t resource;
+} cyhal_tcpwm_t;
+
+typedef struct
+{
+    cyhal_tcpwm_t tcpwm;
+    cyhal_timer_cfg_t cfg;
+    uint32_t frequency_hz;
+    cyhal_timer_event_callback_t callback;
+    void *callback_arg;
+    cyhal_timer_event_t events;
+    bool running;
+    uint64_t start_us;
+    uint32_t start_value;
+    uint32_t capture;
+    uint32_t capture_buf;
+    cyhal_source_t count_source;
+    cyhal_source_t capture_source;
+    bool count_external;
+    bool capture_external;
+    sim_event_t tc_event;
+    sim_event_t cc_event;
+} cyhal_timer_t;
+
+cy_rslt_t cyhal_timer_init(cyhal_timer_t *obj, cyhal_gpio_t pin, const cyhal_clock_t *clk);
+void cyhal_timer_free(cyhal_timer_t *obj);
+cy_rslt_t cyhal_timer_configure(cyhal_timer_t *obj, const cyhal_timer_cfg_t *cfg);
+cy_rslt_t cyhal_timer_set_frequency(cyhal_timer_t *obj, uint32_t hz);
+cy_rslt_t cyhal_timer_start(cyhal_timer_t *obj);
+cy_rslt_t cyhal_timer_stop(cyhal_timer_t *obj);
+cy_rslt_t cyhal_timer_reset(cyhal_timer_t *obj);
+uint32_t cyhal_timer_read(const cyhal_timer_t *obj);
+void cyhal_timer_register_callback(cyhal_timer_t *obj, cyhal_timer_event_callback_t callback, void *callback_arg);
+void cyhal_timer_enable_event(cyhal_timer_t *obj, cyhal_timer_event_t event, uint8_t intr_priority, bool enable);
+cy_rslt_t cyhal_timer_connect_digital2(cyhal_timer_t *obj, cyhal_source_t source, cyhal_timer_input_t signal, cyhal_edge_type_t edge_type);
+
+/*******************************************************************************
+* ADC
+********************************************************************************/
+typedef enum
+{
+    CYHAL_ADC_REF_INTERNAL,
+    CYHAL_ADC_REF_EXTERNAL,
+    CYHAL_ADC_REF_VDDA,
+    CYHAL_ADC_REF_VDDA_DIV_2
+} cyhal_adc_vref_t;
+
+typedef enum
+{
+    CYHAL_ADC_VNEG_VSSA,
+    CYHAL_ADC_VNEG_VREF
+} cyhal_adc_vneg_t;
+
+#define CYHAL_ADC_VNEG                  NC
+
+#define CYHAL_ADC_AVG_MODE_AVERAGE      (1u << 0)
+#define CYHAL_ADC_AVG_MODE_ACCUMULATE   (1u << 1)
+#define CYHAL_ADC_AVG_MODE_INTERLEAVED  (1u << 2)
+
+typedef enum
+{
+    CYHAL_ADC_EOS = 1u,
+    CYHAL_ADC_ASYNC_READ_COMPLETE = 2u
+} cyhal_adc_event_t;
+
+typedef enum
+{
+    CYHAL_ASYNC_SW,
+    CYHAL_ASYNC_DMA
+} cyhal_async_mode_t;
+
+typedef struct
+{
+    bool continuous_scanning;
+    uint32_t average_mode_flags;
+    uint32_t average_count;
+    cyhal_adc_vref_t vref;
+    cyhal_adc_vneg_t vneg;
+    uint8_t resolution;
+    uint32_t ext_vref_mv;
+    cyhal_gpio_t ext_vref;
+    bool is_bypassed;
+    cyhal_gpio_t bypass_pin;
+} cyhal_adc_config_t;
+
+typedef struct
+{
+    bool enabled;
+    bool enable_averaging;
+    uint32_t min_acquisition_ns;
+} cyhal_adc_channel_config_t;
+
+#define SIM_ADC_MAX_CHANNELS            (8u)
+
+typedef void (*cyhal_adc_event_callback_t)(void *callback_arg, cyhal_adc_event_t event);
+
+struct cyhal_adc_channel_s;
+
+typedef struct
+{
+    cyhal_adc_config_t config;
+    struct cyhal_adc_channel_s *channels[SIM_ADC_MAX_CHANNELS];
+    uint8_t num_channels;
+    cyhal_adc_event_callback_t callback;
+    void *callback_arg;
+    cyhal_adc_event_t events;
+    cyhal_async_mode_t async_mode;
+    int32_t *async_result;
+    size_t async_scans;
+    sim_event_t async_event;
+} cyhal_adc_t;
+
+typedef struct cyhal_adc_channel_s
+{
+    cyhal_adc_t *adc;
+    uint8_t channel_idx;
+    cyhal_gpio_t vplus;
+    cyhal_gpio_t vminus;
+    cyhal_adc_channel_config_t config;
+} cyhal_adc_channel_t;
+
+cy_rslt_t cyhal_adc_init(cyhal_adc_t *obj, cyhal_gpio_t pin, const cyhal_clock_t *clk);
+cy_rslt_t cyhal_adc_configure(cyhal_adc_t *obj, const cyhal_adc_config_t *config);
+cy_rslt_t cyhal_adc_channel_init_diff(cyhal_adc_channel_t *obj, cyhal_adc_t *adc, cyhal_gpio_t vplus, cyhal_gpio_t vminus, const cyhal_adc_channel_config_t *cfg);
+void cyhal_adc_register_callback(cyhal_adc_t *obj, cyhal_adc_event_callback_t callback, void *callback_arg);
+void cyhal_adc_enable_event(cyhal_adc_t *obj, cyhal_adc_event_t event, uint8_t intr_priority, bool enable);
+cy_rslt_t cyhal_adc_set_async_mode(cyhal_adc_t *obj, cyhal_async_mode_t mode, uint8_t dma_priority);
+cy_rslt_t cyhal_adc_read_async_uv(cyhal_adc_t *obj, size_t num_scan, int32_t *result_list);
+int32_t cyhal_adc_read_uv(const cyhal_adc_channel_t *obj);
+
+/*******************************************************************************
+* Flash
+********************************************************************************/
+typedef struct
+{
+    bool initialized;
+} cyhal_flash_t;
+
+typedef struct
+{
+    uint32_t start_address;
+    uint32_t size;
+    uint32_t sector_size;
+    uint32_t page_size;
+    uint8_t erase_value;
+} cyhal_flash_block_info_t;
+
+typedef struct
+{
+    uint8_t block_count;
+    const cyhal_flash_block_info_t *blocks;
+} cyhal_flash_info_t;
+
+cy_rslt_t cyhal_flash_init(cyhal_flash_t *obj);
+void cyhal_flash_free(cyhal_flash_t *obj);
+void cyhal_flash_get_info(const cyhal_flash_t *obj, cyhal_flash_info_t *info);
+cy_rslt_t cyhal_flash_read(cyhal_flash_t *obj, uint32_t address, uint8_t *data, size_t size);
+cy_rslt_t cyhal_flash_erase(cyhal_flash_t *obj, uint32_t address);
+cy_rslt_t cyhal_flash_write(cyhal_flash_t *obj, uint32_t address, const uint32_t *data);
+
+/*******************************************************************************
+* UART
+********************************************************************************/
+typedef struct
+{
+    FILE *stream;
+} cyhal_uart_t;
+
+cy_rslt_t cyhal_uart_write(cyhal_uart_t *obj, void *tx, size_t *tx_length);
+
+#endif /* CYHAL_H_ */
+
+/* [] END OF FILE */
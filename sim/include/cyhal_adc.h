@@ -0,0 +1,12 @@
+/******************************************************************************
+* File Name:   cyhal_adc.h
+*
+* Description: Host simulation stand-in for the HAL ADC header.
+*
+* Related Document: See README.md
+*
+*******************************************************************************/
+
+#include "cyhal.h"
+
+/* [] END OF FILE */
@@ -0,0 +1,30 @@
+/******************************************************************************
+* File Name:   netif.h
+*
+* Description: Host simulation stand-in for the lwIP address helpers.
+*
+* Related Document: See README.md
+*
+*******************************************************************************/
+
+#ifndef LWIP_NETIF_H_
+#define LWIP_NETIF_H_
+
+#include <stdint.h>
+
+typedef struct
+{
+    uint32_t addr;
+} ip4_addr_t;
+
+typedef struct
+{
+    uint32_t addr[4];
+} ip6_addr_t;
+
+char *ip4addr_ntoa(const ip4_addr_t *addr);
+char *ip6addr_ntoa(const ip6_addr_t *addr);
+
+#endif /* LWIP_NETIF_H_ */
+
+/* [] END OF FILE */
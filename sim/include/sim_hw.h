@@ -0,0 +1,59 @@
+/******************************************************************************
+* File Name:   sim_hw.h
+*
+* Description: Virtual hardware event engine used by the host simulation
+*              build. Simulated peripherals schedule their interrupts here and
+*              the engine runs the callbacks from a high priority FreeRTOS
+*              task, which stands in for the NVIC.
+*
+* Related Document: See README.md
+*
+*******************************************************************************/
+
+#ifndef SIM_HW_H_
+#define SIM_HW_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/*******************************************************************************
+* Global Variables
+********************************************************************************/
+/* Callback run by the engine when an event falls due ("interrupt context") */
+typedef void (*sim_event_fn_t)(void *arg);
+
+/* One pending hardware event. Owned by the peripheral that schedules it. */
+typedef struct sim_event_s
+{
+    uint64_t deadline_us;
+    sim_event_fn_t fn;
+    void *arg;
+    bool armed;
+    struct sim_event_s *next;
+} sim_event_t;
+
+/*******************************************************************************
+* Function Prototypes
+********************************************************************************/
+void sim_hw_start(void);
+uint64_t sim_time_us(void);
+void sim_event_schedule(sim_event_t *event, uint64_t delay_us, sim_event_fn_t fn, void *arg);
+void sim_event_cancel(sim_event_t *event);
+
+/* Bus models attached to GPIO pins (sim_gpio.c) */
+typedef void (*sim_pin_hook_t)(uint8_t pin, bool level);
+void sim_gpio_attach(uint8_t pin, sim_pin_hook_t on_master_write);
+void sim_gpio_set_device_pull(uint8_t pin, uint8_t device, bool pull_low);
+bool sim_gpio_master_level(uint8_t pin);
+
+/* Timer count and capture inputs routed from a GPIO (sim_timer.c) */
+void sim_timer_input_edge(uint32_t source);
+
+/* Simulated sensors */
+void sim_ds18b20_init(void);
+void sim_flow_init(void);
+int32_t sim_sensor_uv(uint8_t pin, uint64_t now_us);
+
+#endif /* SIM_HW_H_ */
+
+/* [] END OF FILE */
@@ -0,0 +1,285 @@
+/******************************************************************************
+* File Name:   sim_adc.c
+*
+* Description: Simulated SAR ADC and the pH / EC probe front ends. Probe
+*              readings follow slow waveforms with noise, and only settle
+*              after the probe's FET has been switched on, so the firmware's
+*              probe switching is exercised the same way as on the bench.
+*
+* Related Document: See README.md
+*
+*******************************************************************************/
+
+#include <math.h>
+
+#include "FreeRTOS.h"
+#include "task.h"
+
+#include "cyhal.h"
+#include "functions.h"
+#include "macros.h"
+
+/******************************************************************************
+* Macros
+******************************************************************************/
+/* Time for one channel conversion, acquisition included */
+#define SIM_ADC_CONVERSION_US           (2u)
+
+/* Probe front end after the FET switches on */
+#define SIM_PROBE_SETTLE_TAU_US         (250000.0)
+#define SIM_PROBE_NOISE_UV              (2000.0)
+
+/* pH 6.0 +/- 0.4 over 15 minutes, 59.16 mV per pH around a 1.5 V offset */
+#define SIM_PH_CENTER                   (6.0)
+#define SIM_PH_SWING                    (0.4)
+#define SIM_PH_PERIOD_S                 (900.0)
+#define SIM_PH_OFFSET_UV                (1500000.0)
+#define SIM_PH_SLOPE_UV                 (59160.0)
+
+/* EC 1.4 mS/cm +/- 0.2 over 20 minutes, 1 mV per uS/cm */
+#define SIM_EC_CENTER_US                (1400.0)
+#define SIM_EC_SWING_US                 (200.0)
+#define SIM_EC_PERIOD_S                 (1200.0)
+
+#ifndef M_PI
+#define M_PI                            (3.14159265358979323846)
+#endif
+
+/******************************************************************************
+* Global Variables
+*******************************************************************************/
+static uint64_t ph_fet_on_us;
+static uint64_t ec_fet_on_us;
+static uint32_t noise_state = 0x2545F491u;
+
+static void sim_adc_complete(void *arg);
+
+/******************************************************************************
+ * Function Name: sim_noise_uv
+ ******************************************************************************
+ * Summary:
+ *  Roughly gaussian noise (sum of uniforms), deterministic across runs.
+ *
+ ******************************************************************************/
+static double sim_noise_uv(void)
+{
+    double sum = 0.0;
+
+    for (int i = 0; i < 4; i++)
+    {
+        noise_state ^= noise_state << 13;
+        noise_state ^= noise_state >> 17;
+        noise_state ^= noise_state << 5;
+        sum += (double)(noise_state & 0xFFFFu) / 65535.0 - 0.5;
+    }
+    return sum * SIM_PROBE_NOISE_UV;
+}
+
+static void sim_fet_hook(uint8_t pin, bool level)
+{
+    if (level)
+    {
+        if (pin == PH_FET)
+        {
+            ph_fet_on_us = sim_time_us();
+        }
+        else
+        {
+            ec_fet_on_us = sim_time_us();
+        }
+    }
+}
+
+static double sim_settle(uint64_t on_us, uint64_t now_us)
+{
+    return 1.0 - exp(-(double)(now_us - on_us) / SIM_PROBE_SETTLE_TAU_US);
+}
+
+/******************************************************************************
+ * Function Name: sim_sensor_uv
+ ******************************************************************************
+ * Summary:
+ *  Voltage seen on an analog input pin at 'now_us', in microvolts.
+ *
+ ******************************************************************************/
+int32_t sim_sensor_uv(uint8_t pin, uint64_t now_us)
+{
+    double t = (double)now_us / 1e6;
+    double uv;
+
+    if (pin == PH_CHANNEL)
+    {
+        if (!sim_gpio_master_level(PH_FET))
+        {
+            return (int32_t)fabs(sim_noise_uv());
+        }
+        double ph = SIM_PH_CENTER + SIM_PH_SWING * sin(2.0 * M_PI * t / SIM_PH_PERIOD_S);
+        uv = (SIM_PH_OFFSET_UV + (7.0 - ph) * SIM_PH_SLOPE_UV) * sim_settle(ph_fet_on_us, now_us);
+    }
+    else if (pin == EC_CHANNEL)
+    {
+        if (!sim_gpio_master_level(EC_FET))
+        {
+            return (int32_t)fabs(sim_noise_uv());
+        }
+        double ec = SIM_EC_CENTER_US + SIM_EC_SWING_US * sin(2.0 * M_PI * t / SIM_EC_PERIOD_S);
+        uv = ec * 1000.0 * sim_settle(ec_fet_on_us, now_us);
+    }
+    else
+    {
+        uv = 0.0;
+    }
+
+    uv += sim_noise_uv();
+    return (uv < 0.0) ? 0 : (int32_t)uv;
+}
+
+/******************************************************************************
+ * Function Name: sim_adc_sample
+ ******************************************************************************
+ * Summary:
+ *  One channel result, averaged in "hardware" if the channel asks for it.
+ *
+ ******************************************************************************/
+static int32_t sim_adc_sample(const cyhal_adc_channel_t *chan, uint64_t now_us)
+{
+    const cyhal_adc_t *adc = chan->adc;
+    uint32_t count = 1u;
+    int64_t sum = 0;
+
+    if (chan->config.enable_averaging && (adc->config.average_count > 1u))
+    {
+        count = adc->config.average_count;
+    }
+    for (uint32_t i = 0; i < count; i++)
+    {
+        sum += sim_sensor_uv(chan->vplus, now_us + i * SIM_ADC_CONVERSION_US);
+    }
+    if ((adc->config.average_mode_flags & CYHAL_ADC_AVG_MODE_ACCUMULATE) != 0u)
+    {
+        return (int32_t)sum;
+    }
+    return (int32_t)(sum / (int64_t)count);
+}
+
+cy_rslt_t cyhal_adc_init(cyhal_adc_t *obj, cyhal_gpio_t pin, const cyhal_clock_t *clk)
+{
+    (void) pin;
+    (void) clk;
+
+    memset(obj, 0, sizeof(*obj));
+    obj->config.resolution = 12u;
+    obj->config.average_count = 1u;
+
+    sim_gpio_attach(PH_FET, sim_fet_hook);
+    sim_gpio_attach(EC_FET, sim_fet_hook);
+    return CY_RSLT_SUCCESS;
+}
+
+cy_rslt_t cyhal_adc_configure(cyhal_adc_t *obj, const cyhal_adc_config_t *config)
+{
+    obj->config = *config;
+    if (obj->config.average_count == 0u)
+    {
+        obj->config.average_count = 1u;
+    }
+    return CY_RSLT_SUCCESS;
+}
+
+cy_rslt_t cyhal_adc_channel_init_diff(cyhal_adc_channel_t *obj, cyhal_adc_t *adc, cyhal_gpio_t vplus, cyhal_gpio_t vminus, const cyhal_adc_channel_config_t *cfg)
+{
+    if (adc->num_channels >= SIM_ADC_MAX_CHANNELS)
+    {
+        return CY_RSLT_SIM_ERROR;
+    }
+
+    obj->adc = adc;
+    obj->channel_idx = adc->num_channels;
+    obj->vplus = vplus;
+    obj->vminus = vminus;
+    obj->config = *cfg;
+    adc->channels[adc->num_channels++] = obj;
+    return CY_RSLT_SUCCESS;
+}
+
+void cyhal_adc_register_callback(cyhal_adc_t *obj, cyhal_adc_event_callback_t callback, void *callback_arg)
+{
+    obj->callback = callback;
+    obj->callback_arg = callback_arg;
+}
+
+void cyhal_adc_enable_event(cyhal_adc_t *obj, cyhal_adc_event_t event, uint8_t intr_priority, bool enable)
+{
+    (void) intr_priority;
+
+    if (enable)
+    {
+        obj->events |= event;
+    }
+    else
+    {
+        obj->events &= ~event;
+    }
+}
+
+cy_rslt_t cyhal_adc_set_async_mode(cyhal_adc_t *obj, cyhal_async_mode_t mode, uint8_t dma_priority)
+{
+    (void) dma_priority;
+    obj->async_mode = mode;
+    return CY_RSLT_SUCCESS;
+}
+
+/******************************************************************************
+ * Function Name: sim_adc_complete
+ ******************************************************************************
+ * Summary:
+ *  Fills the result list once the scans are "done" and raises the async
+ *  read complete interrupt.
+ *
+ ******************************************************************************/
+static void sim_adc_complete(void *arg)
+{
+    cyhal_adc_t *obj = (cyhal_adc_t *)arg;
+    uint64_t now = sim_time_us();
+    int32_t *result = obj->async_result;
+
+    for (size_t scan = 0; scan < obj->async_scans; scan++)
+    {
+        for (uint8_t ch = 0; ch < obj->num_channels; ch++)
+        {
+            *result++ = sim_adc_sample(obj->channels[ch], now);
+        }
+    }
+    obj->async_result = NULL;
+
+    if ((obj->events & CYHAL_ADC_ASYNC_READ_COMPLETE) && (obj->callback != NULL))
+    {
+        obj->callback(obj->callback_arg, CYHAL_ADC_ASYNC_READ_COMPLETE);
+    }
+}
+
+cy_rslt_t cyhal_adc_read_async_uv(cyhal_adc_t *obj, size_t num_scan, int32_t *result_list)
+{
+    uint64_t duration_us;
+
+    taskENTER_CRITICAL();
+    if (obj->async_result != NULL)
+    {
+        taskEXIT_CRITICAL();
+        return CY_RSLT_SIM_ERROR;       /* Previous read still in flight */
+    }
+    obj->async_result = result_list;
+    obj->async_scans = num_scan;
+    taskEXIT_CRITICAL();
+
+    duration_us = (uint64_t)num_scan * obj->num_channels * obj->config.average_count * SIM_ADC_CONVERSION_US;
+    sim_event_schedule(&obj->async_event, duration_us, sim_adc_complete, obj);
+    return CY_RSLT_SUCCESS;
+}
+
+int32_t cyhal_adc_read_uv(const cyhal_adc_channel_t *obj)
+{
+    return sim_adc_sample(obj, sim_time_us());
+}
+
+/* [] END OF FILE */
@@ -0,0 +1,452 @@
+/******************************************************************************
+* File Name:   sim_ds18b20.c
+*
+* Description: Bit-level model of DS18B20 sensors on the 1-Wire bus.
+*
+*              The model watches the firmware's writes to TEMP_PIN and
+*              classifies each low pulse by its length, as the sensor does:
+*              480 us or more is a reset, 15 us or more is a written 0,
+*              anything shorter is a written 1 or a read slot. Devices answer
+*              resets with a presence pulse and transmit 0 bits by holding
+*              the line low for 30 us after the falling edge, so the
+*              firmware samples the bus exactly as it would on the board.
+*
+*              ROM commands: READ ROM (33h), MATCH ROM (55h), SKIP ROM (CCh),
+*              SEARCH ROM (F0h). Function commands: CONVERT T (44h), READ
+*              SCRATCHPAD (BEh), WRITE SCRATCHPAD (4Eh), READ POWER SUPPLY
+*              (B4h).
+*
+* Related Document: See README.md
+*
+*******************************************************************************/
+
+#include <math.h>
+
+#include "FreeRTOS.h"
+#include "task.h"
+
+#include "cyhal.h"
+#include "macros.h"
+
+/******************************************************************************
+* Macros
+******************************************************************************/
+#ifndef SIM_DS18B20_COUNT
+#define SIM_DS18B20_COUNT               (1u)
+#endif
+
+#define DS_RESET_MIN_US                 (480u)
+#define DS_WRITE0_MIN_US                (15u)
+#define DS_PRESENCE_DELAY_US            (15u)
+#define DS_PRESENCE_US                  (120u)
+#define DS_TX0_HOLD_US                  (30u)
+
+#define DS_FAMILY_CODE                  (0x28u)
+#define DS_SCRATCHPAD_SIZE              (9u)
+#define DS_POWER_ON_TEMP                (0x0550)    /* +85 C */
+
+/* Ambient 21.5 C +/- 1.5 C over 10 minutes, each probe offset by 0.25 C */
+#define SIM_TEMP_CENTER_C               (21.5)
+#define SIM_TEMP_SWING_C                (1.5)
+#define SIM_TEMP_PERIOD_S               (600.0)
+#define SIM_TEMP_DEVICE_OFFSET_C        (0.25)
+
+#ifndef M_PI
+#define M_PI                            (3.14159265358979323846)
+#endif
+
+/******************************************************************************
+* Global Variables
+*******************************************************************************/
+typedef enum
+{
+    DS_IDLE,            /* Not selected, waits for the next reset */
+    DS_ROM_CMD,
+    DS_MATCH_ROM,
+    DS_SEARCH_ROM,
+    DS_FUNC_CMD,
+    DS_TX,
+    DS_WRITE_SCRATCH,
+    DS_CONVERTING
+} ds_state_t;
+
+typedef struct
+{
+    uint8_t index;
+    uint8_t rom[8];
+    uint8_t scratchpad[DS_SCRATCHPAD_SIZE];
+    ds_state_t state;
+
+    /* Receive side, LSB first */
+    uint8_t rx_byte;
+    uint8_t rx_bits;
+    uint8_t rx_count;
+
+    /* Transmit side */
+    uint8_t tx_buf[DS_SCRATCHPAD_SIZE];
+    uint8_t tx_len;
+    uint16_t tx_pos;
+    ds_state_t tx_next;
+
+    /* SEARCH ROM: 0 = send bit, 1 = send complement, 2 = read direction */
+    uint8_t search_bit;
+    uint8_t search_phase;
+
+    uint64_t conversion_end_us;
+    bool conversion_pending;
+
+    sim_event_t pull_event;
+    sim_event_t presence_event;
+} ds_device_t;
+
+static ds_device_t devices[SIM_DS18B20_COUNT];
+
+/* Time the firmware last pulled the bus low */
+static uint64_t fall_us;
+
+/******************************************************************************
+ * Function Name: ds_crc8
+ ******************************************************************************
+ * Summary:
+ *  Maxim 1-Wire CRC8 (x^8 + x^5 + x^4 + 1, reflected).
+ *
+ ******************************************************************************/
+static uint8_t ds_crc8(const uint8_t *data, uint8_t len)
+{
+    uint8_t crc = 0;
+
+    while (len--)
+    {
+        uint8_t byte = *data++;
+        for (uint8_t i = 0; i < 8u; i++)
+        {
+            uint8_t mix = (crc ^ byte) & 0x01u;
+            crc >>= 1;
+            if (mix)
+            {
+                crc ^= 0x8Cu;
+            }
+            byte >>= 1;
+        }
+    }
+    return crc;
+}
+
+static uint8_t ds_resolution_bits(const ds_device_t *dev)
+{
+    return (uint8_t)(9u + ((dev->scratchpad[4] >> 5) & 0x03u));
+}
+
+/* Maximum conversion time from the datasheet: 93.75 ms per resolution step */
+static uint64_t ds_conversion_us(const ds_device_t *dev)
+{
+    return 93750u << (ds_resolution_bits(dev) - 9u);
+}
+
+static void ds_update_crc(ds_device_t *dev)
+{
+    dev->scratchpad[8] = ds_crc8(dev->scratchpad, DS_SCRATCHPAD_SIZE - 1u);
+}
+
+/******************************************************************************
+ * Function Name: ds_latch_temperature
+ ******************************************************************************
+ * Summary:
+ *  Stores the temperature at the end of the conversion in the scratchpad,
+ *  truncated to the configured resolution.
+ *
+ ******************************************************************************/
+static void ds_latch_temperature(ds_device_t *dev)
+{
+    double t = (double)dev->conversion_end_us / 1e6;
+    double celsius = SIM_TEMP_CENTER_C + SIM_TEMP_SWING_C * sin(2.0 * M_PI * t / SIM_TEMP_PERIOD_S)
+                     + SIM_TEMP_DEVICE_OFFSET_C * dev->index;
+    int16_t raw = (int16_t)lround(celsius * 16.0);
+
+    raw &= (int16_t)(0xFFFF << (12u - ds_resolution_bits(dev)));
+    dev->scratchpad[0] = (uint8_t)(raw & 0xFF);
+    dev->scratchpad[1] = (uint8_t)((uint16_t)raw >> 8);
+    ds_update_crc(dev);
+    dev->conversion_pending = false;
+}
+
+static void ds_start_tx(ds_device_t *dev, const uint8_t *data, uint8_t len, ds_state_t next)
+{
+    memcpy(dev->tx_buf, data, len);
+    dev->tx_len = len;
+    dev->tx_pos = 0;
+    dev->tx_next = next;
+    dev->state = DS_TX;
+}
+
+/******************************************************************************
+ * Function Name: ds_tx_bit
+ ******************************************************************************
+ * Summary:
+ *  Returns true if the device drives the current read slot, with the bit in
+ *  'bit'.
+ *
+ ******************************************************************************/
+static bool ds_tx_bit(const ds_device_t *dev, uint64_t now, bool *bit)
+{
+    switch (dev->state)
+    {
+        case DS_TX:
+            *bit = (dev->tx_buf[dev->tx_pos / 8u] >> (dev->tx_pos % 8u)) & 0x01u;
+            return true;
+        case DS_CONVERTING:
+            *bit = (now >= dev->conversion_end_us);
+            return true;
+        case DS_SEARCH_ROM:
+            if (dev->search_phase < 2u)
+            {
+                *bit = ((dev->rom[dev->search_bit / 8u] >> (dev->search_bit % 8u)) & 0x01u) ^ dev->search_phase;
+                return true;
+            }
+            return false;
+        default:
+            return false;
+    }
+}
+
+static void ds_function_command(ds_device_t *dev, uint8_t cmd)
+{
+    uint8_t power = 0xFF;   /* Externally powered */
+
+    switch (cmd)
+    {
+        case 0x44:
+            dev->conversion_end_us = sim_time_us() + ds_conversion_us(dev);
+            dev->conversion_pending = true;
+            dev->state = DS_CONVERTING;
+            break;
+        case 0xBE:
+            if (dev->conversion_pending && (sim_time_us() >= dev->conversion_end_us))
+            {
+                ds_latch_temperature(dev);
+            }
+            ds_start_tx(dev, dev->scratchpad, DS_SCRATCHPAD_SIZE, DS_IDLE);
+            break;
+        case 0x4E:
+            dev->rx_count = 0;
+            dev->state = DS_WRITE_SCRATCH;
+            break;
+        case 0xB4:
+            ds_start_tx(dev, &power, 1u, DS_IDLE);
+            break;
+        default:
+            dev->state = DS_IDLE;
+            break;
+    }
+}
+
+static void ds_rom_command(ds_device_t *dev, uint8_t cmd)
+{
+    switch (cmd)
+    {
+        case 0xCC:
+            dev->state = DS_FUNC_CMD;
+            break;
+        case 0x33:
+            ds_start_tx(dev, dev->rom, sizeof(dev->rom), DS_FUNC_CMD);
+            break;
+        case 0x55:
+            dev->rx_count = 0;
+            dev->state = DS_MATCH_ROM;
+            break;
+        case 0xF0:
+            dev->search_bit = 0;
+            dev->search_phase = 0;
+            dev->state = DS_SEARCH_ROM;
+            break;
+        default:
+            dev->state = DS_IDLE;
+            break;
+    }
+}
+
+/******************************************************************************
+ * Function Name: ds_rx_byte
+ ******************************************************************************
+ * Summary:
+ *  Handles a complete byte written by the firmware.
+ *
+ ******************************************************************************/
+static void ds_rx_byte(ds_device_t *dev, uint8_t byte)
+{
+    switch (dev->state)
+    {
+        case DS_ROM_CMD:
+            ds_rom_command(dev, byte);
+            break;
+        case DS_MATCH_ROM:
+            if (byte != dev->rom[dev->rx_count])
+            {
+                dev->state = DS_IDLE;
+                break;
+            }
+            if (++dev->rx_count == sizeof(dev->rom))
+            {
+                dev->state = DS_FUNC_CMD;
+            }
+            break;
+        case DS_FUNC_CMD:
+            ds_function_command(dev, byte);
+            break;
+        case DS_WRITE_SCRATCH:
+            dev->scratchpad[2u + dev->rx_count] = byte;
+            if (++dev->rx_count == 3u)
+            {
+                dev->scratchpad[4] = (uint8_t)((dev->scratchpad[4] & 0x60u) | 0x1Fu);
+                ds_update_crc(dev);
+                dev->state = DS_IDLE;
+            }
+            break;
+        default:
+            break;
+    }
+}
+
+static void ds_rx_bit(ds_device_t *dev, bool bit)
+{
+    if (dev->state == DS_SEARCH_ROM)
+    {
+        if (bit != ((dev->rom[dev->search_bit / 8u] >> (dev->search_bit % 8u)) & 0x01u))
+        {
+            dev->state = DS_IDLE;       /* Lost arbitration */
+            return;
+        }
+        dev->search_phase = 0;
+        if (++dev->search_bit == 64u)
+        {
+            dev->state = DS_FUNC_CMD;
+        }
+        return;
+    }
+
+    dev->rx_byte |= (uint8_t)(bit << dev->rx_bits);
+    if (++dev->rx_bits == 8u)
+    {
+        uint8_t byte = dev->rx_byte;
+        dev->rx_byte = 0;
+        dev->rx_bits = 0;
+        ds_rx_byte(dev, byte);
+    }
+}
+
+static void ds_release(void *arg)
+{
+    ds_device_t *dev = (ds_device_t *)arg;
+    sim_gpio_set_device_pull(TEMP_PIN, dev->index, false);
+}
+
+static void ds_presence(void *arg)
+{
+    ds_device_t *dev = (ds_device_t *)arg;
+
+    sim_gpio_set_device_pull(TEMP_PIN, dev->index, true);
+    sim_event_schedule(&dev->pull_event, DS_PRESENCE_US, ds_release, dev);
+}
+
+/******************************************************************************
+ * Function Name: ds_bus_hook
+ ******************************************************************************
+ * Summary:
+ *  Called on every change of the firmware's output on TEMP_PIN.
+ *
+ ******************************************************************************/
+static void ds_bus_hook(uint8_t pin, bool level)
+{
+    uint64_t now = sim_time_us();
+    bool bit;
+
+    (void) pin;
+
+    if (!level)
+    {
+        fall_us = now;
+        for (uint8_t i = 0; i < SIM_DS18B20_COUNT; i++)
+        {
+            if (ds_tx_bit(&devices[i], now, &bit) && !bit)
+            {
+                sim_gpio_set_device_pull(TEMP_PIN, i, true);
+                sim_event_schedule(&devices[i].pull_event, DS_TX0_HOLD_US, ds_release, &devices[i]);
+            }
+        }
+        return;
+    }
+
+    for (uint8_t i = 0; i < SIM_DS18B20_COUNT; i++)
+    {
+        ds_device_t *dev = &devices[i];
+
+        if ((now - fall_us) >= DS_RESET_MIN_US)
+        {
+            dev->rx_byte = 0;
+            dev->rx_bits = 0;
+            dev->state = DS_ROM_CMD;
+            sim_event_schedule(&dev->presence_event, DS_PRESENCE_DELAY_US, ds_presence, dev);
+            continue;
+        }
+
+        if (ds_tx_bit(dev, fall_us, &bit))
+        {
+            if (dev->state == DS_TX)
+            {
+                if (++dev->tx_pos == dev->tx_len * 8u)
+                {
+                    dev->state = dev->tx_next;
+                }
+            }
+            else if (dev->state == DS_SEARCH_ROM)
+            {
+                dev->search_phase++;
+            }
+            else if ((dev->state == DS_CONVERTING) && bit && dev->conversion_pending)
+            {
+                ds_latch_temperature(dev);
+            }
+            continue;
+        }
+
+        if (dev->state != DS_IDLE)
+        {
+            ds_rx_bit(dev, (now - fall_us) < DS_WRITE0_MIN_US);
+        }
+    }
+}
+
+/******************************************************************************
+ * Function Name: sim_ds18b20_init
+ ******************************************************************************
+ * Summary:
+ *  Gives each sensor a unique ROM code and power-on scratchpad and attaches
+ *  the model to TEMP_PIN.
+ *
+ ******************************************************************************/
+void sim_ds18b20_init(void)
+{
+    static const uint8_t power_on[DS_SCRATCHPAD_SIZE - 1u] =
+        { DS_POWER_ON_TEMP & 0xFF, DS_POWER_ON_TEMP >> 8, 0x4B, 0x46, 0x7F, 0xFF, 0x0C, 0x10 };
+
+    for (uint8_t i = 0; i < SIM_DS18B20_COUNT; i++)
+    {
+        ds_device_t *dev = &devices[i];
+
+        memset(dev, 0, sizeof(*dev));
+        dev->index = i;
+        dev->rom[0] = DS_FAMILY_CODE;
+        dev->rom[1] = (uint8_t)(0xA0u + i * 0x17u);
+        dev->rom[2] = (uint8_t)(0x3Cu ^ (i << 4));
+        dev->rom[3] = 0x5Eu;
+        dev->rom[4] = (uint8_t)i;
+        dev->rom[7] = ds_crc8(dev->rom, 7u);
+        memcpy(dev->scratchpad, power_on, sizeof(power_on));
+        ds_update_crc(dev);
+        dev->state = DS_IDLE;
+    }
+
+    sim_gpio_attach(TEMP_PIN, ds_bus_hook);
+}
+
+/* [] END OF FILE */
@@ -0,0 +1,94 @@
+/******************************************************************************
+* File Name:   sim_flash.c
+*
+* Description: Simulated cyhal_flash for the auxiliary (EEPROM) flash the
+*              firmware keeps its calibration in. Rows are erased to 0 and
+*              written whole like the PSoC 6 flash. The contents are held in
+*              RAM and do not survive a restart of the simulation.
+*
+* Related Document: See README.md
+*
+*******************************************************************************/
+
+#include "cyhal.h"
+
+/******************************************************************************
+* Macros
+******************************************************************************/
+#define SIM_FLASH_BASE                  (0x14000000u)
+#define SIM_FLASH_SIZE                  (32u * 1024u)
+#define SIM_FLASH_ROW_SIZE              (512u)
+#define SIM_FLASH_ERASE_VALUE           (0x00u)
+
+/******************************************************************************
+* Global Variables
+*******************************************************************************/
+static const cyhal_flash_block_info_t sim_flash_block =
+{
+    .start_address = SIM_FLASH_BASE,
+    .size = SIM_FLASH_SIZE,
+    .sector_size = SIM_FLASH_ROW_SIZE,
+    .page_size = SIM_FLASH_ROW_SIZE,
+    .erase_value = SIM_FLASH_ERASE_VALUE
+};
+
+static uint8_t sim_flash[SIM_FLASH_SIZE];
+
+/* True when the 'size' bytes at 'address' are inside the simulated block */
+static bool sim_flash_range(uint32_t address, size_t size)
+{
+    return (address >= SIM_FLASH_BASE) && (size <= SIM_FLASH_SIZE) &&
+           ((address - SIM_FLASH_BASE) <= (SIM_FLASH_SIZE - size));
+}
+
+cy_rslt_t cyhal_flash_init(cyhal_flash_t *obj)
+{
+    obj->initialized = true;
+    return CY_RSLT_SUCCESS;
+}
+
+void cyhal_flash_free(cyhal_flash_t *obj)
+{
+    obj->initialized = false;
+}
+
+void cyhal_flash_get_info(const cyhal_flash_t *obj, cyhal_flash_info_t *info)
+{
+    (void) obj;
+    info->block_count = 1;
+    info->blocks = &sim_flash_block;
+}
+
+cy_rslt_t cyhal_flash_read(cyhal_flash_t *obj, uint32_t address, uint8_t *data, size_t size)
+{
+    if (!obj->initialized || !sim_flash_range(address, size))
+    {
+        return CY_RSLT_SIM_ERROR;
+    }
+    memcpy(data, &sim_flash[address - SIM_FLASH_BASE], size);
+    return CY_RSLT_SUCCESS;
+}
+
+cy_rslt_t cyhal_flash_erase(cyhal_flash_t *obj, uint32_t address)
+{
+    if (!obj->initialized || ((address % SIM_FLASH_ROW_SIZE) != 0u) ||
+        !sim_flash_range(address, SIM_FLASH_ROW_SIZE))
+    {
+        return CY_RSLT_SIM_ERROR;
+    }
+    memset(&sim_flash[address - SIM_FLASH_BASE], SIM_FLASH_ERASE_VALUE, SIM_FLASH_ROW_SIZE);
+    return CY_RSLT_SUCCESS;
+}
+
+cy_rslt_t cyhal_flash_write(cyhal_flash_t *obj, uint32_t address, const uint32_t *data)
+{
+    cy_rslt_t result = cyhal_flash_erase(obj, address);
+
+    if (result == CY_RSLT_SUCCESS)
+    {
+        memcpy(&sim_flash[address - SIM_FLASH_BASE], data, SIM_FLASH_ROW_SIZE);
+    }
+    return result;
+}
+
+/* [] END OF FILE */
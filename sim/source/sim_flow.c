@@ -0,0 +1,104 @@
+/******************************************************************************
+* File Name:   sim_flow.c
+*
+* Description: Model of a turbine flow meter on FLOW_PIN. The flow follows
+*              PUMP_ONE: it ramps up when the pump starts and runs down
+*              slowly after it stops, so both the counted and the
+*              period-captured ranges of flow_sensor.c are exercised. Each
+*              pulse is an edge on the timer inputs routed from FLOW_PIN.
+*
+* Related Document: See README.md
+*
+*******************************************************************************/
+
+#include <math.h>
+
+#include "FreeRTOS.h"
+#include "task.h"
+
+#include "cyhal.h"
+#include "functions.h"
+#include "macros.h"
+
+/******************************************************************************
+* Macros
+******************************************************************************/
+/* 4 L/min +/- 0.3 L/min over 2 minutes while the pump runs, through a
+ * meter with the firmware's default K-factor */
+#define SIM_FLOW_LPM                    (4.0)
+#define SIM_FLOW_SWING_LPM              (0.3)
+#define SIM_FLOW_PERIOD_S               (120.0)
+#define SIM_FLOW_PULSES_PER_L           (FLOW_K_FACTOR / 100.0)
+
+/* Time constant of the ramp after the pump switches */
+#define SIM_FLOW_TAU_S                  (3.0)
+
+/* Below this the turbine stops and no pulse is produced */
+#define SIM_FLOW_MIN_LPM                (0.05)
+
+/* Pump state is checked this often while the turbine stands still */
+#define SIM_FLOW_IDLE_POLL_US           (100000u)
+
+#ifndef M_PI
+#define M_PI                            (3.14159265358979323846)
+#endif
+
+/******************************************************************************
+* Global Variables
+*******************************************************************************/
+static sim_event_t pulse_event;
+static double flow_lpm = 0.0;
+static uint64_t flow_last_us = 0;
+
+/* Moves flow_lpm towards the pump's flow over the time since the last call */
+static double sim_flow_lpm(uint64_t now_us)
+{
+    double t = (double)now_us / 1e6;
+    double dt = (double)(now_us - flow_last_us) / 1e6;
+    double target = 0.0;
+
+    if (sim_gpio_master_level(PUMP_ONE))
+    {
+        target = SIM_FLOW_LPM + SIM_FLOW_SWING_LPM * sin(2.0 * M_PI * t / SIM_FLOW_PERIOD_S);
+    }
+
+    flow_lpm = target + (flow_lpm - target) * exp(-dt / SIM_FLOW_TAU_S);
+    flow_last_us = now_us;
+    return flow_lpm;
+}
+
+/******************************************************************************
+ * Function Name: sim_flow_pulse
+ ******************************************************************************
+ * Summary:
+ *  Emits a pulse, except on an idle poll, and schedules the next one from
+ *  the current flow.
+ *
+ ******************************************************************************/
+static void sim_flow_pulse(void *arg)
+{
+    bool pulse = (arg != NULL);
+    double lpm = sim_flow_lpm(sim_time_us());
+
+    if (pulse)
+    {
+        sim_timer_input_edge((uint32_t)FLOW_PIN);
+    }
+
+    if (lpm < SIM_FLOW_MIN_LPM)
+    {
+        sim_event_schedule(&pulse_event, SIM_FLOW_IDLE_POLL_US, sim_flow_pulse, NULL);
+        return;
+    }
+
+    double hz = lpm * SIM_FLOW_PULSES_PER_L / 60.0;
+    sim_event_schedule(&pulse_event, (uint64_t)(1e6 / hz), sim_flow_pulse, &pulse_event);
+}
+
+void sim_flow_init(void)
+{
+    flow_last_us = sim_time_us();
+    sim_event_schedule(&pulse_event, SIM_FLOW_IDLE_POLL_US, sim_flow_pulse, NULL);
+}
+
+/* [] END OF FILE */
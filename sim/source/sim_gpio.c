@@ -0,0 +1,282 @@
+/******************************************************************************
+* File Name:   sim_gpio.c
+*
+* Description: Simulated cyhal_gpio. Every pin is a wired-AND of the firmware
+*              output and any device models pulling it low, so open-drain
+*              buses such as the 1-Wire line behave like the real pull-up
+*              network. Edge callbacks are delivered after the pin state has
+*              settled, outside the scheduler lock, the same way the GPIO
+*              interrupt would fire on the board.
+*
+* Related Document: See README.md
+*
+*******************************************************************************/
+
+#include "FreeRTOS.h"
+#include "task.h"
+
+#include "cyhal.h"
+
+/******************************************************************************
+* Macros
+******************************************************************************/
+#define SIM_GPIO_NUM_PINS               (0x70u)
+#define SIM_GPIO_PENDING_MAX            (8u)
+
+/******************************************************************************
+* Global Variables
+*******************************************************************************/
+typedef struct
+{
+    bool initialized;
+    cyhal_gpio_direction_t direction;
+    cyhal_gpio_drive_mode_t drive_mode;
+    bool master_out;
+    uint8_t device_pulls;               /* One bit per attached device model */
+    bool level;
+    cyhal_gpio_event_t enabled_events;
+    cyhal_gpio_callback_data_t *callback_data;
+    sim_pin_hook_t hook;
+} sim_pin_t;
+
+typedef struct
+{
+    cyhal_gpio_t pin;
+    cyhal_gpio_event_t event;
+} sim_pending_edge_t;
+
+static sim_pin_t pins[SIM_GPIO_NUM_PINS];
+
+/* Edges raised while the scheduler is locked, flushed by the outermost call */
+static sim_pending_edge_t pending_edges[SIM_GPIO_PENDING_MAX];
+static uint32_t pending_count;
+static uint32_t lock_depth;
+
+/******************************************************************************
+ * Function Name: sim_gpio_lock / sim_gpio_unlock
+ ******************************************************************************
+ * Summary:
+ *  Serializes pin updates between tasks and the hardware engine. Callbacks
+ *  collected while locked run once the outermost caller unlocks.
+ *
+ ******************************************************************************/
+static void sim_gpio_lock(void)
+{
+    vTaskSuspendAll();
+    lock_depth++;
+}
+
+static void sim_gpio_unlock(void)
+{
+    sim_pending_edge_t edges[SIM_GPIO_PENDING_MAX];
+    uint32_t count = 0;
+    cyhal_gpio_callback_data_t *cb;
+
+    if (--lock_depth == 0)
+    {
+        count = pending_count;
+        memcpy(edges, pending_edges, count * sizeof(edges[0]));
+        pending_count = 0;
+    }
+    (void) xTaskResumeAll();
+
+    for (uint32_t i = 0; i < count; i++)
+    {
+        for (cb = pins[edges[i].pin].callback_data; cb != NULL; cb = cb->next)
+        {
+            cb->callback(cb->callback_arg, edges[i].event);
+        }
+    }
+}
+
+/******************************************************************************
+ * Function Name: sim_gpio_update
+ ******************************************************************************
+ * Summary:
+ *  Recomputes the pin level and queues an edge event if it changed.
+ *
+ ******************************************************************************/
+static void sim_gpio_update(cyhal_gpio_t pin)
+{
+    sim_pin_t *p = &pins[pin];
+    bool level;
+    cyhal_gpio_event_t edge;
+
+    switch (p->drive_mode)
+    {
+        case CYHAL_GPIO_DRIVE_STRONG:
+            level = p->master_out;
+            break;
+        case CYHAL_GPIO_DRIVE_NONE:
+        case CYHAL_GPIO_DRIVE_ANALOG:
+            level = (p->device_pulls == 0u);
+            break;
+        default:
+            level = p->master_out && (p->device_pulls == 0u);
+            break;
+    }
+
+    if (level == p->level)
+    {
+        return;
+    }
+    p->level = level;
+
+    edge = level ? CYHAL_GPIO_IRQ_RISE : CYHAL_GPIO_IRQ_FALL;
+    if ((p->enabled_events & edge) && (p->callback_data != NULL) && (pending_count < SIM_GPIO_PENDING_MAX))
+    {
+        pending_edges[pending_count].pin = pin;
+        pending_edges[pending_count].event = edge;
+        pending_count++;
+    }
+}
+
+cy_rslt_t cyhal_gpio_init(cyhal_gpio_t pin, cyhal_gpio_direction_t direction, cyhal_gpio_drive_mode_t drive_mode, bool init_val)
+{
+    if (pin >= SIM_GPIO_NUM_PINS)
+    {
+        return CY_RSLT_SIM_ERROR;
+    }
+
+    sim_gpio_lock();
+    pins[pin].initialized = true;
+    pins[pin].direction = direction;
+    pins[pin].drive_mode = drive_mode;
+    pins[pin].master_out = init_val;
+    pins[pin].level = init_val;
+    sim_gpio_update(pin);
+    sim_gpio_unlock();
+
+    return CY_RSLT_SUCCESS;
+}
+
+void cyhal_gpio_free(cyhal_gpio_t pin)
+{
+    if (pin < SIM_GPIO_NUM_PINS)
+    {
+        pins[pin].initialized = false;
+        pins[pin].enabled_events = CYHAL_GPIO_IRQ_NONE;
+        pins[pin].callback_data = NULL;
+    }
+}
+
+void cyhal_gpio_write(cyhal_gpio_t pin, bool value)
+{
+    sim_pin_t *p = &pins[pin];
+    bool changed;
+
+    CY_ASSERT(pin < SIM_GPIO_NUM_PINS);
+
+    sim_gpio_lock();
+    changed = (p->master_out != value);
+    p->master_out = value;
+    sim_gpio_update(pin);
+    if (changed && (p->hook != NULL))
+    {
+        p->hook(pin, value);
+    }
+    sim_gpio_unlock();
+}
+
+bool cyhal_gpio_read(cyhal_gpio_t pin)
+{
+    CY_ASSERT(pin < SIM_GPIO_NUM_PINS);
+    return pins[pin].level;
+}
+
+void cyhal_gpio_toggle(cyhal_gpio_t pin)
+{
+    cyhal_gpio_write(pin, !pins[pin].master_out);
+}
+
+void cyhal_gpio_register_callback(cyhal_gpio_t pin, cyhal_gpio_callback_data_t *callback_data)
+{
+    CY_ASSERT(pin < SIM_GPIO_NUM_PINS);
+
+    if (callback_data != NULL)
+    {
+        callback_data->pin = pin;
+        callback_data->next = NULL;
+    }
+    pins[pin].callback_data = callback_data;
+}
+
+void cyhal_gpio_enable_event(cyhal_gpio_t pin, cyhal_gpio_event_t event, uint8_t intr_priority, bool enable)
+{
+    (void) intr_priority;
+    CY_ASSERT(pin < SIM_GPIO_NUM_PINS);
+
+    if (enable)
+    {
+        pins[pin].enabled_events |= event;
+    }
+    else
+    {
+        pins[pin].enabled_events &= ~event;
+    }
+}
+
+cy_rslt_t cyhal_gpio_enable_output(cyhal_gpio_t pin, cyhal_signal_type_t type, cyhal_source_t *source)
+{
+    (void) type;
+
+    if ((pin >= SIM_GPIO_NUM_PINS) || (source == NULL))
+    {
+        return CY_RSLT_SIM_ERROR;
+    }
+    *source = (cyhal_source_t)pin;
+    return CY_RSLT_SUCCESS;
+}
+
+/******************************************************************************
+ * Function Name: sim_gpio_attach
+ ******************************************************************************
+ * Summary:
+ *  Connects a device model to 'pin'. The hook sees every change of the
+ *  firmware output on that pin.
+ *
+ ******************************************************************************/
+void sim_gpio_attach(uint8_t pin, sim_pin_hook_t on_master_write)
+{
+    CY_ASSERT(pin < SIM_GPIO_NUM_PINS);
+    pins[pin].hook = on_master_write;
+}
+
+/******************************************************************************
+ * Function Name: sim_gpio_set_device_pull
+ ******************************************************************************
+ * Summary:
+ *  Device model 'device' (0..7) pulls 'pin' low or releases it.
+ *
+ ******************************************************************************/
+void sim_gpio_set_device_pull(uint8_t pin, uint8_t device, bool pull_low)
+{
+    CY_ASSERT((pin < SIM_GPIO_NUM_PINS) && (device < 8u));
+
+    sim_gpio_lock();
+    if (pull_low)
+    {
+        pins[pin].device_pulls |= (uint8_t)(1u << device);
+    }
+    else
+    {
+        pins[pin].device_pulls &= (uint8_t)~(1u << device);
+    }
+    sim_gpio_update(pin);
+    sim_gpio_unlock();
+}
+
+/******************************************************************************
+ * Function Name: sim_gpio_master_level
+ ******************************************************************************
+ * Summary:
+ *  Level the firmware is driving on 'pin', ignoring device pulls.
+ *
+ ******************************************************************************/
+bool sim_gpio_master_level(uint8_t pin)
+{
+    CY_ASSERT(pin < SIM_GPIO_NUM_PINS);
+    return pins[pin].master_out;
+}
+
+/* [] END OF FILE */
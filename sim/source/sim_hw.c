@@ -0,0 +1,191 @@
+/******************************************************************************
+* File Name:   sim_hw.c
+*
+* Description: Virtual hardware event engine for the host simulation build.
+*
+*              Peripherals schedule events against a virtual microsecond
+*              clock. The engine task runs at the highest FreeRTOS priority
+*              and executes due callbacks exactly like an ISR would preempt
+*              the firmware tasks. Events closer than one RTOS tick are run
+*              back to back and advance the virtual clock ahead of the tick
+*              count, so sub-millisecond bus slots (1-Wire) complete quickly
+*              while periodic timers still track wall-clock time.
+*
+* Related Document: See README.md
+*
+*******************************************************************************/
+
+#include <stddef.h>
+
+#include "FreeRTOS.h"
+#include "task.h"
+
+#include "sim_hw.h"
+
+/******************************************************************************
+* Macros
+******************************************************************************/
+#define SIM_HW_TASK_PRIORITY            (configMAX_PRIORITIES - 1)
+#define SIM_HW_TASK_STACK_SIZE          (configMINIMAL_STACK_SIZE)
+#define US_PER_TICK                     (1000000u / configTICK_RATE_HZ)
+
+/******************************************************************************
+* Global Variables
+*******************************************************************************/
+static TaskHandle_t sim_hw_task_handle;
+
+/* Events sorted by deadline */
+static sim_event_t *pending_events;
+
+/* Virtual clock, never behind the RTOS tick count */
+static uint64_t virtual_us;
+
+static void sim_hw_task(void *pvParameters);
+
+/******************************************************************************
+ * Function Name: sim_time_us
+ ******************************************************************************
+ * Summary:
+ *  Current simulated time in microseconds.
+ *
+ ******************************************************************************/
+uint64_t sim_time_us(void)
+{
+    uint64_t tick_us = (uint64_t)xTaskGetTickCount() * US_PER_TICK;
+
+    return (virtual_us > tick_us) ? virtual_us : tick_us;
+}
+
+/******************************************************************************
+ * Function Name: sim_event_schedule
+ ******************************************************************************
+ * Summary:
+ *  Arms 'event' to call fn(arg) delay_us from now. Re-arming a pending event
+ *  moves it.
+ *
+ ******************************************************************************/
+void sim_event_schedule(sim_event_t *event, uint64_t delay_us, sim_event_fn_t fn, void *arg)
+{
+    sim_event_t **link;
+
+    taskENTER_CRITICAL();
+    sim_event_cancel(event);
+
+    event->deadline_us = sim_time_us() + delay_us;
+    event->fn = fn;
+    event->arg = arg;
+    event->armed = true;
+
+    for (link = &pending_events; *link != NULL; link = &(*link)->next)
+    {
+        if ((*link)->deadline_us > event->deadline_us)
+        {
+            break;
+        }
+    }
+    event->next = *link;
+    *link = event;
+    taskEXIT_CRITICAL();
+
+    if ((sim_hw_task_handle != NULL) && (xTaskGetCurrentTaskHandle() != sim_hw_task_handle))
+    {
+        xTaskNotifyGive(sim_hw_task_handle);
+    }
+}
+
+/******************************************************************************
+ * Function Name: sim_event_cancel
+ ******************************************************************************
+ * Summary:
+ *  Disarms 'event' if it is pending.
+ *
+ ******************************************************************************/
+void sim_event_cancel(sim_event_t *event)
+{
+    sim_event_t **link;
+
+    taskENTER_CRITICAL();
+    if (event->armed)
+    {
+        for (link = &pending_events; *link != NULL; link = &(*link)->next)
+        {
+            if (*link == event)
+            {
+                *link = event->next;
+                break;
+            }
+        }
+        event->armed = false;
+        event->next = NULL;
+    }
+    taskEXIT_CRITICAL();
+}
+
+/******************************************************************************
+ * Function Name: sim_hw_start
+ ******************************************************************************
+ * Summary:
+ *  Creates the engine task. Called from cybsp_init() before the scheduler
+ *  starts.
+ *
+ ******************************************************************************/
+void sim_hw_start(void)
+{
+    xTaskCreate(sim_hw_task, "Sim HW", SIM_HW_TASK_STACK_SIZE, NULL,
+                SIM_HW_TASK_PRIORITY, &sim_hw_task_handle);
+}
+
+/******************************************************************************
+ * Function Name: sim_hw_task
+ ******************************************************************************
+ * Summary:
+ *  Runs due events in deadline order and sleeps until the next one.
+ *
+ ******************************************************************************/
+static void sim_hw_task(void *pvParameters)
+{
+    sim_event_t *event;
+    TickType_t wait_ticks;
+    uint64_t tick_us;
+
+    (void) pvParameters;
+
+    while (true)
+    {
+        wait_ticks = portMAX_DELAY;
+        event = NULL;
+
+        taskENTER_CRITICAL();
+        tick_us = (uint64_t)xTaskGetTickCount() * US_PER_TICK;
+        if (pending_events != NULL)
+        {
+            if (pending_events->deadline_us < (tick_us + US_PER_TICK))
+            {
+                event = pending_events;
+                pending_events = event->next;
+                event->next = NULL;
+                event->armed = false;
+                if (event->deadline_us > virtual_us)
+                {
+                    virtual_us = event->deadline_us;
+                }
+            }
+            else
+            {
+                wait_ticks = (TickType_t)((pending_events->deadline_us - tick_us) / US_PER_TICK);
+            }
+        }
+        taskEXIT_CRITICAL();
+
+        if (event != NULL)
+        {
+            event->fn(event->arg);
+        }
+        else
+        {
+            ulTaskNotifyTake(pdTRUE, wait_ticks);
+        }
+    }
+}
+
+/* [] END OF FILE */
@@ -0,0 +1,422 @@
+/******************************************************************************
+* File Name:   sim_mqtt.c
+*
+* Description: cy_mqtt API on top of libmosquitto for the host simulation
+*              build. The broker defaults to a local Mosquitto and can be
+*              overridden with the SIM_MQTT_BROKER / SIM_MQTT_PORT
+*              environment variables.
+*
+*              FreeRTOS POSIX tasks are pthreads that the scheduler suspends
+*              at arbitrary points, so libmosquitto is only ever entered with
+*              a FreeRTOS mutex held; a pthread lock inside the library held
+*              by a suspended task would otherwise stall the whole simulation.
+*              Incoming messages are queued by the network loop task and
+*              handed to the firmware callback after the mutex is released,
+*              the same way the cy_mqtt library calls back from its own task.
+*
+* Related Document: See README.md
+*
+*******************************************************************************/
+
+#include <mosquitto.h>
+
+#include "FreeRTOS.h"
+#include "task.h"
+#include "semphr.h"
+
+#include "cy_mqtt_api.h"
+
+/******************************************************************************
+* Macros
+******************************************************************************/
+#ifndef SIM_MQTT_BROKER
+#define SIM_MQTT_BROKER                 "127.0.0.1"
+#endif
+
+#define SIM_MQTT_LOOP_PERIOD_MS         (5u)
+#define SIM_MQTT_CONNACK_TIMEOUT_MS     (5000u)
+#define SIM_MQTT_TASK_PRIORITY          (configMAX_PRIORITIES - 2)
+#define SIM_MQTT_TASK_STACK_SIZE        (configMINIMAL_STACK_SIZE * 4u)
+
+/******************************************************************************
+* Global Variables
+*******************************************************************************/
+typedef struct sim_mqtt_msg_s
+{
+    struct sim_mqtt_msg_s *next;
+    cy_mqtt_qos_t qos;
+    bool retain;
+    char *topic;
+    void *payload;
+    size_t payload_len;
+} sim_mqtt_msg_t;
+
+typedef struct
+{
+    struct mosquitto *mosq;
+    char host[64];
+    uint16_t port;
+    cy_mqtt_callback_t callback;
+    void *user_data;
+    volatile bool connected;
+    volatile bool connack_received;
+    volatile bool disconnect_pending;
+    sim_mqtt_msg_t *rx_head;
+    sim_mqtt_msg_t *rx_tail;
+    TaskHandle_t loop_task;
+} sim_mqtt_client_t;
+
+static SemaphoreHandle_t mosq_lock;
+
+/******************************************************************************
+* Function Prototypes
+*******************************************************************************/
+static void sim_mqtt_loop_task(void *pvParameters);
+
+static void sim_mqtt_lock(void)
+{
+    (void) xSemaphoreTakeRecursive(mosq_lock, portMAX_DELAY);
+}
+
+static void sim_mqtt_unlock(void)
+{
+    (void) xSemaphoreGiveRecursive(mosq_lock);
+}
+
+/******************************************************************************
+ * libmosquitto callbacks, run inside mosquitto_loop() with the lock held
+ ******************************************************************************/
+static void on_connect(struct mosquitto *mosq, void *obj, int rc)
+{
+    sim_mqtt_client_t *client = (sim_mqtt_client_t *)obj;
+
+    (void) mosq;
+    client->connack_received = true;
+    client->connected = (rc == 0);
+}
+
+static void on_disconnect(struct mosquitto *mosq, void *obj, int rc)
+{
+    sim_mqtt_client_t *client = (sim_mqtt_client_t *)obj;
+
+    (void) mosq;
+    if (client->connected && (rc != 0))
+    {
+        client->disconnect_pending = true;
+    }
+    client->connected = false;
+}
+
+static void on_message(struct mosquitto *mosq, void *obj, const struct mosquitto_message *message)
+{
+    sim_mqtt_client_t *client = (sim_mqtt_client_t *)obj;
+    sim_mqtt_msg_t *msg;
+
+    (void) mosq;
+
+    msg = calloc(1, sizeof(*msg));
+    if (msg == NULL)
+    {
+        return;
+    }
+    msg->qos = (cy_mqtt_qos_t)message->qos;
+    msg->retain = message->retain;
+    msg->topic = strdup(message->topic);
+    msg->payload_len = (size_t)message->payloadlen;
+    /* NUL terminated so the firmware can atoi() the payload */
+    msg->payload = calloc(1, msg->payload_len + 1u);
+    if ((msg->topic == NULL) || (msg->payload == NULL))
+    {
+        free(msg->topic);
+        free(msg->payload);
+        free(msg);
+        return;
+    }
+    memcpy(msg->payload, message->payload, msg->payload_len);
+
+    if (client->rx_tail == NULL)
+    {
+        client->rx_head = msg;
+    }
+    else
+    {
+        client->rx_tail->next = msg;
+    }
+    client->rx_tail = msg;
+}
+
+/******************************************************************************
+ * Function Name: sim_mqtt_dispatch
+ ******************************************************************************
+ * Summary:
+ *  Hands queued messages and disconnect notifications to the firmware.
+ *
+ ******************************************************************************/
+static void sim_mqtt_dispatch(sim_mqtt_client_t *client)
+{
+    sim_mqtt_msg_t *msg;
+    bool disconnected;
+    cy_mqtt_event_t event;
+
+    sim_mqtt_lock();
+    msg = client->rx_head;
+    client->rx_head = NULL;
+    client->rx_tail = NULL;
+    disconnected = client->disconnect_pending;
+    client->disconnect_pending = false;
+    sim_mqtt_unlock();
+
+    while (msg != NULL)
+    {
+        sim_mqtt_msg_t *next = msg->next;
+
+        if (client->callback != NULL)
+        {
+            memset(&event, 0, sizeof(event));
+            event.type = CY_MQTT_EVENT_TYPE_SUBSCRIPTION_MESSAGE_RECEIVE;
+            event.data.pub_msg.received_message.qos = msg->qos;
+            event.data.pub_msg.received_message.retain = msg->retain;
+            event.data.pub_msg.received_message.topic = msg->topic;
+            event.data.pub_msg.received_message.topic_len = (uint16_t)strlen(msg->topic);
+            event.data.pub_msg.received_message.payload = msg->payload;
+            event.data.pub_msg.received_message.payload_len = msg->payload_len;
+            client->callback((cy_mqtt_t)client, event, client->user_data);
+        }
+        free(msg->topic);
+        free(msg->payload);
+        free(msg);
+        msg = next;
+    }
+
+    if (disconnected && (client->callback != NULL))
+    {
+        memset(&event, 0, sizeof(event));
+        event.type = CY_MQTT_EVENT_TYPE_DISCONNECT;
+        event.data.reason = CY_MQTT_DISCONN_TYPE_BROKER_DOWN;
+        client->callback((cy_mqtt_t)client, event, client->user_data);
+    }
+}
+
+/******************************************************************************
+ * Function Name: sim_mqtt_loop_task
+ ******************************************************************************
+ * Summary:
+ *  Services the broker socket without blocking the scheduler.
+ *
+ ******************************************************************************/
+static void sim_mqtt_loop_task(void *pvParameters)
+{
+    sim_mqtt_client_t *client = (sim_mqtt_client_t *)pvParameters;
+
+    while (true)
+    {
+        sim_mqtt_lock();
+        if (client->mosq != NULL)
+        {
+            (void) mosquitto_loop(client->mosq, 0, 1);
+        }
+        sim_mqtt_unlock();
+
+        sim_mqtt_dispatch(client);
+        vTaskDelay(pdMS_TO_TICKS(SIM_MQTT_LOOP_PERIOD_MS));
+    }
+}
+
+cy_rslt_t cy_mqtt_init(void)
+{
+    if (mosq_lock == NULL)
+    {
+        mosq_lock = xSemaphoreCreateRecursiveMutex();
+        if (mosq_lock == NULL)
+        {
+            return CY_RSLT_SIM_ERROR;
+        }
+    }
+    return (mosquitto_lib_init() == MOSQ_ERR_SUCCESS) ? CY_RSLT_SUCCESS : CY_RSLT_SIM_ERROR;
+}
+
+cy_rslt_t cy_mqtt_deinit(void)
+{
+    (void) mosquitto_lib_cleanup();
+    return CY_RSLT_SUCCESS;
+}
+
+cy_rslt_t cy_mqtt_create(uint8_t *buffer, uint32_t buff_len,
+                         cy_awsport_ssl_credentials_t *security,
+                         cy_mqtt_broker_info_t *broker_info,
+                         char *descriptor, cy_mqtt_t *mqtt_handle)
+{
+    sim_mqtt_client_t *client;
+    const char *host = getenv("SIM_MQTT_BROKER");
+    const char *port = getenv("SIM_MQTT_PORT");
+
+    (void) buffer;
+    (void) buff_len;
+    (void) security;
+
+    client = calloc(1, sizeof(*client));
+    if (client == NULL)
+    {
+        return CY_RSLT_SIM_ERROR;
+    }
+
+    snprintf(client->host, sizeof(client->host), "%s", (host != NULL) ? host : SIM_MQTT_BROKER);
+    client->port = (port != NULL) ? (uint16_t)atoi(port) : broker_info->port;
+    printf("sim: MQTT broker %s:%u (firmware configured %.*s)\n", client->host,
+           (unsigned)client->port, broker_info->hostname_len, broker_info->hostname);
+
+    if (xTaskCreate(sim_mqtt_loop_task, descriptor, SIM_MQTT_TASK_STACK_SIZE, client,
+                    SIM_MQTT_TASK_PRIORITY, &client->loop_task) != pdPASS)
+    {
+        free(client);
+        return CY_RSLT_SIM_ERROR;
+    }
+
+    *mqtt_handle = (cy_mqtt_t)client;
+    return CY_RSLT_SUCCESS;
+}
+
+cy_rslt_t cy_mqtt_register_event_callback(cy_mqtt_t mqtt_handle, cy_mqtt_callback_t event_callback, void *user_data)
+{
+    sim_mqtt_client_t *client = (sim_mqtt_client_t *)mqtt_handle;
+
+    client->callback = event_callback;
+    client->user_data = user_data;
+    return CY_RSLT_SUCCESS;
+}
+
+cy_rslt_t cy_mqtt_connect(cy_mqtt_t mqtt_handle, cy_mqtt_connect_info_t *connect_info)
+{
+    sim_mqtt_client_t *client = (sim_mqtt_client_t *)mqtt_handle;
+    char client_id[64];
+    char user[64];
+    char password[64];
+    TickType_t start;
+    int rc;
+
+    snprintf(client_id, sizeof(client_id), "%.*s", connect_info->client_id_len, connect_info->client_id);
+
+    sim_mqtt_lock();
+    if (client->mosq != NULL)
+    {
+        mosquitto_destroy(client->mosq);
+    }
+    client->mosq = mosquitto_new(client_id, connect_info->clean_session, client);
+    if (client->mosq == NULL)
+    {
+        sim_mqtt_unlock();
+        return CY_RSLT_SIM_ERROR;
+    }
+    mosquitto_connect_callback_set(client->mosq, on_connect);
+    mosquitto_disconnect_callback_set(client->mosq, on_disconnect);
+    mosquitto_message_callback_set(client->mosq, on_message);
+
+    if ((connect_info->username != NULL) && (connect_info->username_len > 0u))
+    {
+        snprintf(user, sizeof(user), "%.*s", connect_info->username_len, connect_info->username);
+        snprintf(password, sizeof(password), "%.*s", connect_info->password_len,
+                 (connect_info->password != NULL) ? connect_info->password : "");
+        (void) mosquitto_username_pw_set(client->mosq, user, password);
+    }
+    if (connect_info->will_info != NULL)
+    {
+        char topic[128];
+        snprintf(topic, sizeof(topic), "%.*s", connect_info->will_info->topic_len, connect_info->will_info->topic);
+        (void) mosquitto_will_set(client->mosq, topic, (int)connect_info->will_info->payload_len,
+                                  connect_info->will_info->payload, (int)connect_info->will_info->qos,
+                                  connect_info->will_info->retain);
+    }
+
+    client->connack_received = false;
+    client->connected = false;
+    rc = mosquitto_connect(client->mosq, client->host, client->port, connect_info->keep_alive_sec);
+    sim_mqtt_unlock();
+
+    if (rc != MOSQ_ERR_SUCCESS)
+    {
+        printf("sim: mosquitto_connect failed: %s\n", mosquitto_strerror(rc));
+        return CY_RSLT_SIM_ERROR;
+    }
+
+    /* The loop task processes the CONNACK */
+    start = xTaskGetTickCount();
+    while (!client->connack_received &&
+           ((xTaskGetTickCount() - start) < pdMS_TO_TICKS(SIM_MQTT_CONNACK_TIMEOUT_MS)))
+    {
+        vTaskDelay(pdMS_TO_TICKS(SIM_MQTT_LOOP_PERIOD_MS));
+    }
+
+    return client->connected ? CY_RSLT_SUCCESS : CY_RSLT_SIM_ERROR;
+}
+
+cy_rslt_t cy_mqtt_publish(cy_mqtt_t mqtt_handle, cy_mqtt_publish_info_t *pub_msg)
+{
+    sim_mqtt_client_t *client = (sim_mqtt_client_t *)mqtt_handle;
+    char topic[128];
+    int rc;
+
+    if (!client->connected)
+    {
+        return CY_RSLT_SIM_ERROR;
+    }
+
+    snprintf(topic, sizeof(topic), "%.*s", pub_msg->topic_len, pub_msg->topic);
+
+    sim_mqtt_lock();
+    rc = mosquitto_publish(client->mosq, NULL, topic, (int)pub_msg->payload_len, pub_msg->payload,
+                           (int)pub_msg->qos, pub_msg->retain);
+    sim_mqtt_unlock();
+
+    return (rc == MOSQ_ERR_SUCCESS) ? CY_RSLT_SUCCESS : CY_RSLT_SIM_ERROR;
+}
+
+cy_rslt_t cy_mqtt_subscribe(cy_mqtt_t mqtt_handle, cy_mqtt_subscribe_info_t *sub_info, uint8_t sub_count)
+{
+    sim_mqtt_client_t *client = (sim_mqtt_client_t *)mqtt_handle;
+    char topic[128];
+    int rc = MOSQ_ERR_SUCCESS;
+
+    if (!client->connected)
+    {
+        return CY_RSLT_SIM_ERROR;
+    }
+
+    sim_mqtt_lock();
+    for (uint8_t i = 0; (i < sub_count) && (rc == MOSQ_ERR_SUCCESS); i++)
+    {
+        snprintf(topic, sizeof(topic), "%.*s", sub_info[i].topic_len, sub_info[i].topic);
+        rc = mosquitto_subscribe(client->mosq, NULL, topic, (int)sub_info[i].qos);
+        sub_info[i].allocated_qos = sub_info[i].qos;
+    }
+    sim_mqtt_unlock();
+
+    return (rc == MOSQ_ERR_SUCCESS) ? CY_RSLT_SUCCESS : CY_RSLT_SIM_ERROR;
+}
+
+cy_rslt_t cy_mqtt_disconnect(cy_mqtt_t mqtt_handle)
+{
+    sim_mqtt_client_t *client = (sim_mqtt_client_t *)mqtt_handle;
+
+    sim_mqtt_lock();
+    client->connected = false;
+    if (client->mosq != NULL)
+    {
+        (void) mosquitto_disconnect(client->mosq);
+        mosquitto_destroy(client->mosq);
+        client->mosq = NULL;
+    }
+    sim_mqtt_unlock();
+    return CY_RSLT_SUCCESS;
+}
+
+cy_rslt_t cy_mqtt_delete(cy_mqtt_t mqtt_handle)
+{
+    sim_mqtt_client_t *client = (sim_mqtt_client_t *)mqtt_handle;
+
+    (void) cy_mqtt_disconnect(mqtt_handle);
+    vTaskDelete(client->loop_task);
+    free(client);
+    return CY_RSLT_SUCCESS;
+}
+
+/* [] END OF FILE */
@@ -0,0 +1,177 @@
+/******************************************************************************
+* File Name:   sim_platform.c
+*
+* Description: Board support, retarget-io and FreeRTOS hooks for the host
+*              simulation build.
+*
+* Related Document: See README.md
+*
+*******************************************************************************/
+
+#include <stdio.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+
+#include "FreeRTOS.h"
+#include "task.h"
+
+#include "cy_pdl.h"
+#include "cybsp.h"
+#include "cy_retarget_io.h"
+#include "clock.h"
+#include "lwip/netif.h"
+
+/******************************************************************************
+ * Function Name: cybsp_init
+ ******************************************************************************
+ * Summary:
+ *  Brings up the virtual hardware. Runs before the scheduler starts, like
+ *  the real BSP init.
+ *
+ ******************************************************************************/
+cy_rslt_t cybsp_init(void)
+{
+    setvbuf(stdout, NULL, _IOLBF, 0);
+
+    sim_hw_start();
+    sim_ds18b20_init();
+    sim_flow_init();
+    return CY_RSLT_SUCCESS;
+}
+
+cyhal_uart_t cy_retarget_io_uart_obj;
+
+cy_rslt_t cy_retarget_io_init(cyhal_gpio_t tx, cyhal_gpio_t rx, uint32_t baudrate)
+{
+    (void) tx;
+    (void) rx;
+    (void) baudrate;
+    cy_retarget_io_uart_obj.stream = stdout;
+    return CY_RSLT_SUCCESS;
+}
+
+cy_rslt_t cyhal_uart_write(cyhal_uart_t *obj, void *tx, size_t *tx_length)
+{
+    if (obj->stream == NULL)
+    {
+        return CY_RSLT_SIM_ERROR;
+    }
+    *tx_length = fwrite(tx, 1, *tx_length, obj->stream);
+    fflush(obj->stream);
+    return CY_RSLT_SUCCESS;
+}
+
+/* Stable per host; SIM_DEVICE_UID (hex) gives several instances on one
+ * host distinct identities. */
+uint64_t Cy_SysLib_GetUniqueId(void)
+{
+    const char *uid = getenv("SIM_DEVICE_UID");
+
+    if (uid != NULL)
+    {
+        return strtoull(uid, NULL, 16);
+    }
+    return (uint64_t)(uint32_t)gethostid();
+}
+
+uint32_t Clock_GetTimeMs(void)
+{
+    return (uint32_t)(sim_time_us() / 1000u);
+}
+
+char *ip4addr_ntoa(const ip4_addr_t *addr)
+{
+    static char buf[INET_ADDRSTRLEN];
+    return (char *)inet_ntop(AF_INET, &addr->addr, buf, sizeof(buf));
+}
+
+char *ip6addr_ntoa(const ip6_addr_t *addr)
+{
+    static char buf[INET6_ADDRSTRLEN];
+    return (char *)inet_ntop(AF_INET6, addr->addr, buf, sizeof(buf));
+}
+
+/******************************************************************************
+ * Function Name: sim_task_create
+ ******************************************************************************
+ * Summary:
+ *  Firmware sources are built with -DxTaskCreate=sim_task_create. Stack
+ *  depths sized for the Cortex-M4 are too small for a host pthread, so they
+ *  are scaled by SIM_TASK_STACK_SCALE before the real xTaskCreate().
+ *
+ ******************************************************************************/
+BaseType_t sim_task_create(TaskFunction_t pxTaskCode, const char * const pcName,
+                           const configSTACK_DEPTH_TYPE usStackDepth, void * const pvParameters,
+                           UBaseType_t uxPriority, TaskHandle_t * const pxCreatedTask)
+{
+    return xTaskCreate(pxTaskCode, pcName, usStackDepth * SIM_TASK_STACK_SCALE,
+                       pvParameters, uxPriority, pxCreatedTask);
+}
+
+/******************************************************************************
+ * Function Name: sim_task_create_static
+ ******************************************************************************
+ * Summary:
+ *  Firmware sources are built with -DxTaskCreateStatic=sim_task_create_static.
+ *  The POSIX port runs each task on a pthread using the given stack, which
+ *  at the Cortex-M4 size is below PTHREAD_STACK_MIN, so the buffers are left
+ *  unused and the task is created like sim_task_create().
+ *
+ ******************************************************************************/
+TaskHandle_t sim_task_create_static(TaskFunction_t pxTaskCode, const char * const pcName,
+                                    const uint32_t ulStackDepth, void * const pvParameters,
+                                    UBaseType_t uxPriority, StackType_t * const puxStackBuffer,
+                                    StaticTask_t * const pxTaskBuffer)
+{
+    TaskHandle_t handle = NULL;
+
+    (void) puxStackBuffer;
+    (void) pxTaskBuffer;
+    if (xTaskCreate(pxTaskCode, pcName, ulStackDepth * SIM_TASK_STACK_SCALE,
+                    pvParameters, uxPriority, &handle) != pdPASS)
+    {
+        return NULL;
+    }
+    return handle;
+}
+
+/******************************************************************************
+ * FreeRTOS hooks
+ ******************************************************************************/
+void vApplicationMallocFailedHook(void)
+{
+    fprintf(stderr, "sim: pvPortMalloc failed\n");
+    abort();
+}
+
+void vAssertCalled(const char * const pcFileName, unsigned long ulLine)
+{
+    fprintf(stderr, "sim: configASSERT %s:%lu\n", pcFileName, ulLine);
+    abort();
+}
+
+void vApplicationGetIdleTaskMemory(StaticTask_t **ppxIdleTaskTCBBuffer,
+                                   StackType_t **ppxIdleTaskStackBuffer,
+                                   uint32_t *pulIdleTaskStackSize)
+{
+    static StaticTask_t idle_tcb;
+    static StackType_t idle_stack[configMINIMAL_STACK_SIZE];
+
+    *ppxIdleTaskTCBBuffer = &idle_tcb;
+    *ppxIdleTaskStackBuffer = idle_stack;
+    *pulIdleTaskStackSize = configMINIMAL_STACK_SIZE;
+}
+
+void vApplicationGetTimerTaskMemory(StaticTask_t **ppxTimerTaskTCBBuffer,
+                                    StackType_t **ppxTimerTaskStackBuffer,
+                                    uint32_t *pulTimerTaskStackSize)
+{
+    static StaticTask_t timer_tcb;
+    static StackType_t timer_stack[configTIMER_TASK_STACK_DEPTH];
+
+    *ppxTimerTaskTCBBuffer = &timer_tcb;
+    *ppxTimerTaskStackBuffer = timer_stack;
+    *pulTimerTaskStackSize = configTIMER_TASK_STACK_DEPTH;
+}
+
+/* [] END OF FILE */
@@ -0,0 +1,326 @@
+/******************************************************************************
+* File Name:   sim_timer.c
+*
+* Description: Simulated cyhal_timer (TCPWM counter). The counter value is
+*              derived from the virtual clock; terminal count and compare
+*              interrupts are scheduled on the hardware event engine.
+*              One-shot timers stop at terminal count like the TCPWM does.
+*              A timer with a count input counts that input's edges
+*              instead, and a capture input latches the count on each edge.
+*
+* Related Document: See README.md
+*
+*******************************************************************************/
+
+#include "FreeRTOS.h"
+#include "task.h"
+
+#include "cyhal.h"
+#include "cy_pdl.h"
+
+/******************************************************************************
+* Macros
+******************************************************************************/
+/* cyhal_timer_init() default clock */
+#define SIM_TIMER_DEFAULT_HZ            (1000000u)
+
+/* Timers with a count or capture input */
+#define SIM_TIMER_MAX_INPUTS            (4u)
+
+/******************************************************************************
+* Global Variables
+*******************************************************************************/
+static cyhal_timer_t *input_timers[SIM_TIMER_MAX_INPUTS];
+
+/******************************************************************************
+* Function Prototypes
+*******************************************************************************/
+static void sim_timer_tc(void *arg);
+static void sim_timer_cc(void *arg);
+
+static uint64_t ticks_to_us(const cyhal_timer_t *obj, uint64_t ticks)
+{
+    return (ticks * 1000000u) / obj->frequency_hz;
+}
+
+static uint32_t sim_timer_elapsed_ticks(const cyhal_timer_t *obj)
+{
+    return (uint32_t)(((sim_time_us() - obj->start_us) * obj->frequency_hz) / 1000000u);
+}
+
+/******************************************************************************
+ * Function Name: sim_timer_arm
+ ******************************************************************************
+ * Summary:
+ *  Schedules the next terminal count and compare events from the current
+ *  counter value.
+ *
+ ******************************************************************************/
+static void sim_timer_arm(cyhal_timer_t *obj)
+{
+    uint32_t period_ticks = obj->cfg.period + 1u;
+
+    obj->start_us = sim_time_us();
+    if (obj->count_external)
+    {
+        return;
+    }
+    sim_event_schedule(&obj->tc_event, ticks_to_us(obj, period_ticks - obj->start_value), sim_timer_tc, obj);
+
+    if (obj->cfg.is_compare && (obj->cfg.compare_value > obj->start_value))
+    {
+        sim_event_schedule(&obj->cc_event, ticks_to_us(obj, obj->cfg.compare_value - obj->start_value),
+                           sim_timer_cc, obj);
+    }
+    else
+    {
+        sim_event_cancel(&obj->cc_event);
+    }
+}
+
+static void sim_timer_tc(void *arg)
+{
+    cyhal_timer_t *obj = (cyhal_timer_t *)arg;
+
+    obj->start_value = 0;
+    if (obj->cfg.is_continuous)
+    {
+        sim_timer_arm(obj);
+    }
+    else
+    {
+        obj->running = false;
+    }
+
+    if ((obj->events & CYHAL_TIMER_IRQ_TERMINAL_COUNT) && (obj->callback != NULL))
+    {
+        obj->callback(obj->callback_arg, CYHAL_TIMER_IRQ_TERMINAL_COUNT);
+    }
+}
+
+static void sim_timer_cc(void *arg)
+{
+    cyhal_timer_t *obj = (cyhal_timer_t *)arg;
+
+    if ((obj->events & CYHAL_TIMER_IRQ_CAPTURE_COMPARE) && (obj->callback != NULL))
+    {
+        obj->callback(obj->callback_arg, CYHAL_TIMER_IRQ_CAPTURE_COMPARE);
+    }
+}
+
+cy_rslt_t cyhal_timer_init(cyhal_timer_t *obj, cyhal_gpio_t pin, const cyhal_clock_t *clk)
+{
+    (void) pin;
+    (void) clk;
+
+    memset(obj, 0, sizeof(*obj));
+    obj->tcpwm.base = obj;
+    obj->frequency_hz = SIM_TIMER_DEFAULT_HZ;
+    return CY_RSLT_SUCCESS;
+}
+
+void cyhal_timer_free(cyhal_timer_t *obj)
+{
+    (void) cyhal_timer_stop(obj);
+}
+
+cy_rslt_t cyhal_timer_configure(cyhal_timer_t *obj, const cyhal_timer_cfg_t *cfg)
+{
+    obj->cfg = *cfg;
+    obj->start_value = cfg->value;
+    return CY_RSLT_SUCCESS;
+}
+
+cy_rslt_t cyhal_timer_set_frequency(cyhal_timer_t *obj, uint32_t hz)
+{
+    if (hz == 0u)
+    {
+        return CY_RSLT_SIM_ERROR;
+    }
+    obj->frequency_hz = hz;
+    return CY_RSLT_SUCCESS;
+}
+
+/* Like the TCPWM reload trigger, starting a running timer restarts it. */
+cy_rslt_t cyhal_timer_start(cyhal_timer_t *obj)
+{
+    taskENTER_CRITICAL();
+    if (obj->running)
+    {
+        obj->start_value = obj->cfg.value;
+    }
+    obj->running = true;
+    taskEXIT_CRITICAL();
+
+    sim_timer_arm(obj);
+    return CY_RSLT_SUCCESS;
+}
+
+cy_rslt_t cyhal_timer_stop(cyhal_timer_t *obj)
+{
+    sim_event_cancel(&obj->tc_event);
+    sim_event_cancel(&obj->cc_event);
+
+    taskENTER_CRITICAL();
+    if (obj->running)
+    {
+        obj->start_value = cyhal_timer_read(obj);
+        obj->running = false;
+    }
+    taskEXIT_CRITICAL();
+    return CY_RSLT_SUCCESS;
+}
+
+cy_rslt_t cyhal_timer_reset(cyhal_timer_t *obj)
+{
+    obj->start_value = 0;
+    if (obj->running)
+    {
+        sim_timer_arm(obj);
+    }
+    return CY_RSLT_SUCCESS;
+}
+
+uint32_t cyhal_timer_read(const cyhal_timer_t *obj)
+{
+    if (!obj->running || obj->count_external)
+    {
+        return obj->start_value;
+    }
+    return (obj->start_value + sim_timer_elapsed_ticks(obj)) % (obj->cfg.period + 1u);
+}
+
+void cyhal_timer_register_callback(cyhal_timer_t *obj, cyhal_timer_event_callback_t callback, void *callback_arg)
+{
+    obj->callback = callback;
+    obj->callback_arg = callback_arg;
+}
+
+void cyhal_timer_enable_event(cyhal_timer_t *obj, cyhal_timer_event_t event, uint8_t intr_priority, bool enable)
+{
+    (void) intr_priority;
+
+    if (enable)
+    {
+        obj->events |= event;
+    }
+    else
+    {
+        obj->events &= ~event;
+    }
+}
+
+/* Like the TCPWM, a compare below the current count matches in the next
+ * period. */
+void Cy_TCPWM_Counter_SetCompare0(void *base, uint32_t cntNum, uint32_t compare0)
+{
+    cyhal_timer_t *obj = (cyhal_timer_t *)base;
+    uint32_t count;
+
+    (void) cntNum;
+
+    obj->cfg.compare_value = compare0;
+    if (!obj->running || !obj->cfg.is_compare)
+    {
+        return;
+    }
+
+    count = cyhal_timer_read(obj);
+    if (compare0 > count)
+    {
+        sim_event_schedule(&obj->cc_event, ticks_to_us(obj, compare0 - count), sim_timer_cc, obj);
+    }
+    else
+    {
+        sim_event_cancel(&obj->cc_event);
+    }
+}
+
+cy_rslt_t cyhal_timer_connect_digital2(cyhal_timer_t *obj, cyhal_source_t source, cyhal_timer_input_t signal, cyhal_edge_type_t edge_type)
+{
+    uint32_t i;
+
+    (void) edge_type;
+
+    switch (signal)
+    {
+        case CYHAL_TIMER_INPUT_COUNT:
+            obj->count_source = source;
+            obj->count_external = true;
+            break;
+        case CYHAL_TIMER_INPUT_CAPTURE:
+            obj->capture_source = source;
+            obj->capture_external = true;
+            break;
+        default:
+            return CY_RSLT_SIM_ERROR;
+    }
+
+    for (i = 0; (i < SIM_TIMER_MAX_INPUTS) && (input_timers[i] != NULL) && (input_timers[i] != obj); i++)
+    {
+    }
+    if (i == SIM_TIMER_MAX_INPUTS)
+    {
+        return CY_RSLT_SIM_ERROR;
+    }
+    input_timers[i] = obj;
+    return CY_RSLT_SUCCESS;
+}
+
+uint32_t Cy_TCPWM_Counter_GetCapture0Val(void *base, uint32_t cntNum)
+{
+    (void) cntNum;
+    return ((cyhal_timer_t *)base)->capture;
+}
+
+uint32_t Cy_TCPWM_Counter_GetCapture0BufVal(void *base, uint32_t cntNum)
+{
+    (void) cntNum;
+    return ((cyhal_timer_t *)base)->capture_buf;
+}
+
+/******************************************************************************
+ * Function Name: sim_timer_input_edge
+ ******************************************************************************
+ * Summary:
+ *  An active edge on GPIO 'source', from a device model on the event
+ *  engine. Counts it on the timers it clocks and latches the count of the
+ *  timers it captures.
+ *
+ ******************************************************************************/
+void sim_timer_input_edge(uint32_t source)
+{
+    for (uint32_t i = 0; (i < SIM_TIMER_MAX_INPUTS) && (input_timers[i] != NULL); i++)
+    {
+        cyhal_timer_t *obj = input_timers[i];
+        cyhal_timer_event_t events = CYHAL_TIMER_IRQ_NONE;
+
+        if (!obj->running)
+        {
+            continue;
+        }
+
+        if (obj->count_external && (obj->count_source == source))
+        {
+            obj->start_value = (obj->start_value + 1u) % (obj->cfg.period + 1u);
+            if (obj->start_value == 0u)
+            {
+                events |= CYHAL_TIMER_IRQ_TERMINAL_COUNT;
+            }
+        }
+        if (obj->capture_external && (obj->capture_source == source))
+        {
+            obj->capture_buf = obj->capture;
+            obj->capture = cyhal_timer_read(obj);
+            events |= CYHAL_TIMER_IRQ_CAPTURE_COMPARE;
+        }
+
+        events &= obj->events;
+        if ((events != CYHAL_TIMER_IRQ_NONE) && (obj->callback != NULL))
+        {
+            obj->callback(obj->callback_arg, events);
+        }
+    }
+}
+
+/* [] END OF FILE */
@@ -0,0 +1,56 @@
+/******************************************************************************
+* File Name:   sim_wcm.c
+*
+* Description: Wi-Fi Connection Manager stand-in for the host simulation
+*              build. The host network is always up; the loopback address is
+*              reported as the assigned IP.
+*
+* Related Document: See README.md
+*
+*******************************************************************************/
+
+#include "cy_wcm.h"
+
+/******************************************************************************
+* Global Variables
+*******************************************************************************/
+static bool wcm_connected;
+
+cy_rslt_t cy_wcm_init(cy_wcm_config_t *config)
+{
+    (void) config;
+    return CY_RSLT_SUCCESS;
+}
+
+cy_rslt_t cy_wcm_deinit(void)
+{
+    wcm_connected = false;
+    return CY_RSLT_SUCCESS;
+}
+
+cy_rslt_t cy_wcm_connect_ap(cy_wcm_connect_params_t *connect_params, cy_wcm_ip_address_t *ip_addr)
+{
+    (void) connect_params;
+
+    if (ip_addr != NULL)
+    {
+        memset(ip_addr, 0, sizeof(*ip_addr));
+        ip_addr->version = CY_WCM_IP_VER_V4;
+        ip_addr->ip.v4 = 0x0100007Fu;       /* 127.0.0.1, network byte order */
+    }
+    wcm_connected = true;
+    return CY_RSLT_SUCCESS;
+}
+
+cy_rslt_t cy_wcm_disconnect_ap(void)
+{
+    wcm_connected = false;
+    return CY_RSLT_SUCCESS;
+}
+
+uint8_t cy_wcm_is_connected_to_ap(void)
+{
+    return wcm_connected ? 1u : 0u;
+}
+
+/* [] END OF FILE */
@@ -0,0 +1,238 @@
+/******************************************************************************
+* File Name:   sensor_filter_test.c
+*
+* Description: Host test of the ADC filter chain in source/sensor_filter.c.
+*              Pushes known sequences through each stage and checks the
+*              outputs. Needs no FreeRTOS or HAL:
+*
+*                make -C sim test
+*
+* Related Document: See README.md
+*
+*******************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "sensor_filter.h"
+
+/******************************************************************************
+* Macros
+******************************************************************************/
+#define CHECK(cond)                                                         \
+    do                                                                      \
+    {                                                                       \
+        if (!(cond))                                                        \
+        {                                                                   \
+            printf("%s:%d: %s\n", __func__, __LINE__, #cond);               \
+            failures++;                                                     \
+        }                                                                   \
+    } while (0)
+
+#define ARRAY_LEN(a)                    (sizeof(a) / sizeof((a)[0]))
+
+/******************************************************************************
+* Global Variables
+*******************************************************************************/
+static unsigned failures = 0;
+
+/* Pushes one sample and returns whether an output came, in 'out' */
+static bool push(sensor_filter_t *f, int32_t sample, int32_t *out)
+{
+    *out = INT32_MIN;
+    return sensor_filter_push(f, sample, out);
+}
+
+static int compare_int32(const void *a, const void *b)
+{
+    int32_t x = *(const int32_t *)a;
+    int32_t y = *(const int32_t *)b;
+
+    return (x > y) - (x < y);
+}
+
+/* A single spike is dropped, and the samples around it pass unchanged */
+static void test_spike_rejected(void)
+{
+    const sensor_filter_cfg_t cfg = { .outlier_limit = 100, .outlier_run = 3 };
+    sensor_filter_t f;
+    int32_t out;
+
+    sensor_filter_init(&f, &cfg);
+    CHECK(push(&f, 1000, &out) && (out == 1000));
+    CHECK(!push(&f, 5000, &out));
+    CHECK(push(&f, 1010, &out) && (out == 1010));
+    CHECK(push(&f, 1090, &out) && (out == 1090));     /* Within the limit */
+    CHECK(f.rejected == 1u);
+}
+
+/* A real step is kept once outlier_run samples in a row have been dropped */
+static void test_step_accepted(void)
+{
+    const sensor_filter_cfg_t cfg = { .outlier_limit = 100, .outlier_run = 3 };
+    sensor_filter_t f;
+    int32_t out;
+
+    sensor_filter_init(&f, &cfg);
+    CHECK(push(&f, 1000, &out));
+    for (unsigned i = 0; i < cfg.outlier_run; i++)
+    {
+        CHECK(!push(&f, 2000, &out));
+    }
+    CHECK(push(&f, 2000, &out) && (out == 2000));
+    CHECK(push(&f, 2001, &out) && (out == 2001));     /* New reference */
+    CHECK(f.rejected == cfg.outlier_run);
+
+    /* An interrupted run starts counting again */
+    CHECK(!push(&f, 3000, &out));
+    CHECK(push(&f, 2002, &out) && (out == 2002));
+    CHECK(!push(&f, 3000, &out));
+    CHECK(!push(&f, 3000, &out));
+    CHECK(!push(&f, 3000, &out));
+    CHECK(push(&f, 3000, &out) && (out == 3000));
+}
+
+/* The running median matches a sort of the last median_len samples, also
+ * after the ring has wrapped and with repeated values */
+static void test_median_wraps(void)
+{
+    const sensor_filter_cfg_t cfg = { .median_len = 5 };
+    const int32_t samples[] = { 7, -3, 7, 100, 2, 2, -50, 7, 8, 8, 8, -1, 0, 99, 7, 7 };
+    sensor_filter_t f;
+    int32_t window[5];
+    int32_t out;
+
+    sensor_filter_init(&f, &cfg);
+    for (size_t n = 0; n < ARRAY_LEN(samples); n++)
+    {
+        size_t count = (n + 1u < cfg.median_len) ? (n + 1u) : cfg.median_len;
+
+        memcpy(window, &samples[n + 1u - count], count * sizeof(window[0]));
+        qsort(window, count, sizeof(window[0]), compare_int32);
+
+        CHECK(push(&f, samples[n], &out));
+        CHECK(out == window[count / 2u]);
+    }
+}
+
+/* An even or too long window is cut to the next odd length that fits */
+static void test_median_len_odd(void)
+{
+    sensor_filter_cfg_t cfg = { .median_len = 4 };
+    sensor_filter_t f;
+    int32_t out;
+
+    sensor_filter_init(&f, &cfg);
+    CHECK(f.cfg.median_len == 3u);
+
+    /* A 3 window forgets the first 100 after three more samples */
+    push(&f, 100, &out);
+    push(&f, 0, &out);
+    push(&f, 100, &out);
+    CHECK(push(&f, 0, &out) && (out == 0));
+
+    cfg.median_len = SENSOR_FILTER_MEDIAN_MAX + 3u;
+    sensor_filter_init(&f, &cfg);
+    CHECK(f.cfg.median_len == SENSOR_FILTER_MEDIAN_MAX);
+}
+
+/* Step response of a 2^-2 EMA, rounded to the nearest unit */
+static void test_ema_step(void)
+{
+    const sensor_filter_cfg_t cfg = { .ema_shift = 2 };
+    const int32_t expected[] = { 250, 438, 578, 684, 763 };
+    sensor_filter_t f;
+    int32_t out;
+
+    sensor_filter_init(&f, &cfg);
+    CHECK(push(&f, 0, &out) && (out == 0));
+    for (size_t n = 0; n < ARRAY_LEN(expected); n++)
+    {
+        CHECK(push(&f, 1000, &out) && (out == expected[n]));
+    }
+    for (unsigned n = 0; n < 100u; n++)
+    {
+        push(&f, 1000, &out);
+    }
+    CHECK(out == 1000);
+
+    /* Settles on negative values too */
+    for (unsigned n = 0; n < 100u; n++)
+    {
+        push(&f, -1000, &out);
+    }
+    CHECK(out == -1000);
+}
+
+/* Exactly one output per 'decimation' kept samples, their mean */
+static void test_decimation(void)
+{
+    const sensor_filter_cfg_t cfg = { .outlier_limit = 1000, .outlier_run = 2, .decimation = 4 };
+    sensor_filter_t f;
+    int32_t out;
+    unsigned outputs = 0;
+
+    sensor_filter_init(&f, &cfg);
+    for (int32_t n = 1; n <= 12; n++)
+    {
+        bool ready = push(&f, n * 10, &out);
+
+        CHECK(ready == ((n % 4) == 0));
+        if (ready)
+        {
+            outputs++;
+            CHECK(out == ((n * 10) - 15));    /* Mean of the last four */
+        }
+    }
+    CHECK(outputs == 3u);
+
+    /* Dropped samples do not count towards the next output */
+    CHECK(!push(&f, 5000, &out));
+    CHECK(!push(&f, 130, &out));
+    CHECK(!push(&f, 140, &out));
+    CHECK(!push(&f, 150, &out));
+    CHECK(push(&f, 160, &out) && (out == 145));
+}
+
+/* After a reset the next sample starts every stage again */
+static void test_reset(void)
+{
+    const sensor_filter_cfg_t cfg = { .outlier_limit = 100, .outlier_run = 3, .median_len = 5,
+                                      .ema_shift = 2, .decimation = 2 };
+    sensor_filter_t f;
+    int32_t out;
+
+    sensor_filter_init(&f, &cfg);
+    for (unsigned n = 0; n < 20u; n++)
+    {
+        push(&f, 1000, &out);
+    }
+    push(&f, 1000, &out);           /* Leaves the decimator half full */
+
+    sensor_filter_reset(&f);
+    CHECK(!push(&f, 5000, &out));   /* Kept, first of a new output */
+    CHECK(push(&f, 5000, &out) && (out == 5000));
+    CHECK(f.rejected == 0u);
+}
+
+int main(void)
+{
+    test_spike_rejected();
+    test_step_accepted();
+    test_median_wraps();
+    test_median_len_odd();
+    test_ema_step();
+    test_decimation();
+    test_reset();
+
+    if (failures != 0u)
+    {
+        printf("sensor_filter: %u checks failed\n", failures);
+        return EXIT_FAILURE;
+    }
+    printf("sensor_filter: all checks passed\n");
+    return EXIT_SUCCESS;
+}
+
+/* [] END OF FILE */
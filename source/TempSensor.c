@@ -1,183 +1,636 @@
+#include <string.h>
+
 #include "macros.h"
 #include "cyhal.h"
 #include "cybsp.h"
 #include "cy_retarget_io.h"
 #include "functions.h"
+#include "timer_service.h"
+#include "dlog.h"
 
 /* FreeRTOS header files */
 #include "FreeRTOS.h"
 #include "task.h"
 
 
-volatile unsigned ringBuffer[RING_BUFFER_SIZE];
 unsigned char skip = 0xCC;      //Skip ROM
 unsigned char convert = 0x44;   //Start conversion
 unsigned char read = 0xBE;   //Read scratchpad
+unsigned char match = 0x55;     //Match ROM
+unsigned char search = 0xF0;    //Search ROM
+unsigned char write_scratch = 0x4E; //Write scratchpad
 
-unsigned volatile ringHead = 0;
-unsigned volatile ringTail = 0;
-
-extern cyhal_timer_t wire_timer;
-extern cyhal_timer_t write_timer;
-extern cyhal_timer_t read_timer;
-extern bool wire_busy;
-extern bool wire_initialized;
+extern timer_service_timer_t wire_timer;
+extern timer_service_timer_t write_timer;
+extern timer_service_timer_t read_timer;
+extern timer_service_timer_t read_sample_timer;
 
 
-bool skip_rom = true;
 bool conversionComplete = false;
 
 volatile transaction_t transaction;
 
-uint8_t bit = 0;
+/* Temperature task handle, notified by the 1-Wire ISRs */
+TaskHandle_t wire_task_handle = NULL;
+
 uint8_t timeoutCounter = INIT_RETRIES;
 uint16_t binaryTemp = 0;
 float temp = 0;
+static bool temp_valid = false;
+
+/* Probes found by the last search, in ROM search order */
+typedef struct
+{
+    uint8_t rom[WIRE_ROM_SIZE];
+    int16_t raw;                //Last reading, 1/16 C
+    bool valid;
+} wire_device_t;
+
+static wire_device_t wire_devices[WIRE_MAX_DEVICES];
+static uint8_t device_count = 0;
+static uint8_t device_current = 0;     //Probe read by MATCH_ROM/SCRATCH/PARSE
+static uint8_t read_retries = 0;        //Failed scratchpad reads of device_current
+static uint8_t poll_count = 0;          //Read slots issued after CONVERT_T
+static bool rescan = false;
 
+/* Written to the probes by WRITE_CONFIG before the next conversion */
+static volatile uint8_t resolution_bits = WIRE_RESOLUTION_BITS;
+static volatile bool configure = true;
+static uint8_t config_written = 0;      //Configuration register the probes hold
 
+static uint8_t scratchpad[WIRE_SCRATCHPAD_SIZE];
+static wire_stats_t wire_stats;
+
+//Maxim 1-Wire CRC8 of every byte value, x^8 + x^5 + x^4 + 1 reflected
+static const uint8_t crc8_table[256] =
+{
+    0x00, 0x5E, 0xBC, 0xE2, 0x61, 0x3F, 0xDD, 0x83, 0xC2, 0x9C, 0x7E, 0x20, 0xA3, 0xFD, 0x1F, 0x41,
+    0x9D, 0xC3, 0x21, 0x7F, 0xFC, 0xA2, 0x40, 0x1E, 0x5F, 0x01, 0xE3, 0xBD, 0x3E, 0x60, 0x82, 0xDC,
+    0x23, 0x7D, 0x9F, 0xC1, 0x42, 0x1C, 0xFE, 0xA0, 0xE1, 0xBF, 0x5D, 0x03, 0x80, 0xDE, 0x3C, 0x62,
+    0xBE, 0xE0, 0x02, 0x5C, 0xDF, 0x81, 0x63, 0x3D, 0x7C, 0x22, 0xC0, 0x9E, 0x1D, 0x43, 0xA1, 0xFF,
+    0x46, 0x18, 0xFA, 0xA4, 0x27, 0x79, 0x9B, 0xC5, 0x84, 0xDA, 0x38, 0x66, 0xE5, 0xBB, 0x59, 0x07,
+    0xDB, 0x85, 0x67, 0x39, 0xBA, 0xE4, 0x06, 0x58, 0x19, 0x47, 0xA5, 0xFB, 0x78, 0x26, 0xC4, 0x9A,
+    0x65, 0x3B, 0xD9, 0x87, 0x04, 0x5A, 0xB8, 0xE6, 0xA7, 0xF9, 0x1B, 0x45, 0xC6, 0x98, 0x7A, 0x24,
+    0xF8, 0xA6, 0x44, 0x1A, 0x99, 0xC7, 0x25, 0x7B, 0x3A, 0x64, 0x86, 0xD8, 0x5B, 0x05, 0xE7, 0xB9,
+    0x8C, 0xD2, 0x30, 0x6E, 0xED, 0xB3, 0x51, 0x0F, 0x4E, 0x10, 0xF2, 0xAC, 0x2F, 0x71, 0x93, 0xCD,
+    0x11, 0x4F, 0xAD, 0xF3, 0x70, 0x2E, 0xCC, 0x92, 0xD3, 0x8D, 0x6F, 0x31, 0xB2, 0xEC, 0x0E, 0x50,
+    0xAF, 0xF1, 0x13, 0x4D, 0xCE, 0x90, 0x72, 0x2C, 0x6D, 0x33, 0xD1, 0x8F, 0x0C, 0x52, 0xB0, 0xEE,
+    0x32, 0x6C, 0x8E, 0xD0, 0x53, 0x0D, 0xEF, 0xB1, 0xF0, 0xAE, 0x4C, 0x12, 0x91, 0xCF, 0x2D, 0x73,
+    0xCA, 0x94, 0x76, 0x28, 0xAB, 0xF5, 0x17, 0x49, 0x08, 0x56, 0xB4, 0xEA, 0x69, 0x37, 0xD5, 0x8B,
+    0x57, 0x09, 0xEB, 0xB5, 0x36, 0x68, 0x8A, 0xD4, 0x95, 0xCB, 0x29, 0x77, 0xF4, 0xAA, 0x48, 0x16,
+    0xE9, 0xB7, 0x55, 0x0B, 0x88, 0xD6, 0x34, 0x6A, 0x2B, 0x75, 0x97, 0xC9, 0x4A, 0x14, 0xF6, 0xA8,
+    0x74, 0x2A, 0xC8, 0x96, 0x15, 0x4B, 0xA9, 0xF7, 0xB6, 0xE8, 0x0A, 0x54, 0xD7, 0x89, 0x6B, 0x35
+};
+
+
+//wire_notify_from_isr
+//Wakes the temperature task from the 1-Wire timer and GPIO ISRs.
+void wire_notify_from_isr(uint32_t events){
+    BaseType_t xHigherPriorityTaskWoken = pdFALSE;
+
+    if (wire_task_handle == NULL){return;}
+    xTaskNotifyFromISR(wire_task_handle, events, eSetBits, &xHigherPriorityTaskWoken);
+    portYIELD_FROM_ISR(xHigherPriorityTaskWoken);
+}
+
+//wire_request_conversion
+//Starts a new conversion once the previous one is DONE (or in ERROR).
+void wire_request_conversion(void){
+    if (wire_task_handle == NULL){return;}
+    xTaskNotify(wire_task_handle, WIRE_EVT_START, eSetBits);
+}
+
+//wire_wait_slot
+//Sleeps until the running slot (or UART transfer) finishes. Returns the
+//events collected while waiting, without WIRE_EVT_SLOT_DONE if it timed out.
+uint32_t wire_wait_slot(void){
+    return wire_wait_slot_ms(WIRE_SLOT_TIMEOUT_MS);
+}
+
+//wire_wait_slot_ms
+//wire_wait_slot() for operations longer than one slot.
+uint32_t wire_wait_slot_ms(uint32_t timeout_ms){
+    uint32_t events = 0;
+    uint32_t received;
+
+    do {
+        if (xTaskNotifyWait(0, WIRE_EVT_ALL, &received, pdMS_TO_TICKS(timeout_ms)) != pdTRUE){
+            break;
+        }
+        events |= received;
+    } while ((events & WIRE_EVT_SLOT_DONE) == 0);
+
+    return events;
+}
+
+//wire_temperature_get
+//Last good water temperature in 0.01 C, from the first probe. Returns false
+//until the first conversion has been read.
+bool wire_temperature_get(int16_t *centi_celsius){
+    if (!temp_valid){return false;}
+    *centi_celsius = (int16_t)(temp * 100.0f);
+    return true;
+}
+
+//wire_stats_get
+//Copies the scratchpad read and bus error counters since boot.
+void wire_stats_get(wire_stats_t *stats){
+    taskENTER_CRITICAL();
+    *stats = wire_stats;
+    taskEXIT_CRITICAL();
+}
+
+//wire_set_resolution
+//Sets the resolution of every probe, 9 to 12 bits, from the next conversion.
+bool wire_set_resolution(uint8_t bits){
+    if ((bits < WIRE_RESOLUTION_MIN_BITS) || (bits > WIRE_RESOLUTION_MAX_BITS)){return false;}
+    resolution_bits = bits;
+    configure = true;
+    return true;
+}
+
+//wire_conversion_ms
+//Datasheet maximum conversion time for the resolution the probes were
+//configured with, rounded up.
+static uint32_t wire_conversion_ms(void){
+    uint32_t shift = (WIRE_RESOLUTION_MAX_BITS - WIRE_RESOLUTION_MIN_BITS) - ((config_written >> 5) & 0x03);
+
+    return (WIRE_CONVERSION_MAX_MS + (1u << shift) - 1u) >> shift;
+}
+
+//wire_device_count
+//Number of probes found on the bus by the last search.
+uint8_t wire_device_count(void){
+    return device_count;
+}
+
+//wire_device_temperature_get
+//Last good temperature of probe 'index' in 0.01 C. Returns false until the
+//probe has been read, or if it stopped answering.
+bool wire_device_temperature_get(uint8_t index, int16_t *centi_celsius){
+    if ((index >= device_count) || !wire_devices[index].valid){return false;}
+    *centi_celsius = (int16_t)(((int32_t)wire_devices[index].raw * 25) / 4);
+    return true;
+}
+
+#if !WIRE_BUS_UART
+//Bit-banged bus: TEMP_PIN timed by wire_timer, write_timer and read_timer
+//on the timer service. Slots are opened with interrupts masked, so the
+//timers start right at the falling edge.
+
+/* Bytes assembled by isr_read_sample. The ISR is the only producer and the
+ * temperature task the only consumer; the indices run freely and are
+ * masked on access. */
+static uint8_t rx_queue[WIRE_RX_QUEUE_SIZE];
+static uint32_t rx_head = 0;            //Written by the ISR only
+static uint32_t rx_tail = 0;            //Written by the task only
+
+/* Read in progress, owned by the ISR until WIRE_EVT_SLOT_DONE */
+static volatile uint32_t rx_slots_left = 0;
+static uint8_t rx_byte = 0;
+static uint8_t rx_bits = 0;
 
 void initialize_wire(void){
-    //Reset pulse
+    //Reset pulse, isr_wire_timer releases the bus and opens the presence window
+    taskENTER_CRITICAL();
     cyhal_gpio_write(TEMP_PIN, 0);
-    cyhal_timer_start(&wire_timer);
-    wire_busy = true;
+    timer_service_start_from_isr(&wire_timer, WIRE_RESET_US, 0);
+    taskEXIT_CRITICAL();
 }
 
-void write_wire_byte(uint8_t data){
-    unsigned char temp;
-    temp = data>>bit++;
-    temp &= 0x01;
+//wire_bus_reset
+//Reset pulse and presence window. Returns the events of the window.
+uint32_t wire_bus_reset(void){
+    transaction = RESET;        //isr_wire_timer only ends the pulse in RESET
+    initialize_wire();
+    return wire_wait_slot();
+}
+
+bool wire_bus_write_bit(uint8_t value){
+    taskENTER_CRITICAL();
+    cyhal_gpio_write(TEMP_PIN, 0);
+    cyhal_gpio_write(TEMP_PIN, value & 0x01);
+    timer_service_start_from_isr(&write_timer, WIRE_WRITE_SLOT_US, 0);
+    taskEXIT_CRITICAL();
+    return (wire_wait_slot() & WIRE_EVT_SLOT_DONE) != 0;
+}
+
+//wire_read_slot_start
+//Opens a read slot, from the slot end ISR or a task critical section.
+static void wire_read_slot_start(void){
     cyhal_gpio_write(TEMP_PIN, 0);
-    cyhal_gpio_write(TEMP_PIN, temp);
-    cyhal_timer_start(&write_timer);
-    wire_busy = true;
-    if (bit >= 8){
-        bit = 0;
-        transaction++;
+    cyhal_gpio_write(TEMP_PIN, 1);
+    timer_service_start_from_isr(&read_sample_timer, WIRE_READ_SAMPLE_US, 0);
+    timer_service_start_from_isr(&read_timer, WIRE_READ_SLOT_US, 0);
+}
+
+//wire_read_sample_from_isr
+//Adds the level sampled by isr_read_sample to the byte being assembled. The
+//byte is published once complete, or after the last slot of a shorter read.
+void wire_read_sample_from_isr(uint8_t level){
+    rx_byte |= (uint8_t)((level & 0x01) << rx_bits);
+    if ((++rx_bits < 8) && (rx_slots_left > 1)){return;}
+
+    uint32_t head = __atomic_load_n(&rx_head, __ATOMIC_RELAXED);
+    if ((head - __atomic_load_n(&rx_tail, __ATOMIC_ACQUIRE)) < WIRE_RX_QUEUE_SIZE){
+        rx_queue[head & (WIRE_RX_QUEUE_SIZE - 1)] = rx_byte;
+        __atomic_store_n(&rx_head, head + 1, __ATOMIC_RELEASE);    //Byte before index
+    }
+    rx_byte = 0;
+    rx_bits = 0;
+}
+
+//wire_read_slot_end_from_isr
+//Opens the next read slot from the ISR, and wakes the task only once every
+//slot of the read has been sampled.
+void wire_read_slot_end_from_isr(void){
+    if (rx_slots_left > 1){
+        rx_slots_left--;
+        wire_read_slot_start();
+        return;
+    }
+    rx_slots_left = 0;
+    wire_notify_from_isr(WIRE_EVT_SLOT_DONE);
+}
+
+static bool wire_rx_pop(uint8_t *data){
+    uint32_t tail = __atomic_load_n(&rx_tail, __ATOMIC_RELAXED);
+
+    if (tail == __atomic_load_n(&rx_head, __ATOMIC_ACQUIRE)){return false;}
+    *data = rx_queue[tail & (WIRE_RX_QUEUE_SIZE - 1)];
+    __atomic_store_n(&rx_tail, tail + 1, __ATOMIC_RELEASE);     //Slot free after the read
+    return true;
+}
+
+//wire_rx_flush
+//Drops bytes left over from an abandoned read.
+static void wire_rx_flush(void){
+    __atomic_store_n(&rx_tail, __atomic_load_n(&rx_head, __ATOMIC_ACQUIRE), __ATOMIC_RELEASE);
+}
+
+//wire_read_slots
+//Runs 'slots' read slots back to back and sleeps until the last one ends.
+static bool wire_read_slots(uint32_t slots){
+    wire_rx_flush();
+    rx_byte = 0;
+    rx_bits = 0;
+    rx_slots_left = slots;
+    taskENTER_CRITICAL();
+    wire_read_slot_start();
+    taskEXIT_CRITICAL();
+    if ((wire_wait_slot_ms(WIRE_SLOT_TIMEOUT_MS + (slots / 10)) & WIRE_EVT_SLOT_DONE) == 0){
+        rx_slots_left = 0;
+        return false;
     }
+    return true;
+}
+
+//wire_bus_read_bit
+//Returns the bus level sampled by isr_read_sample, or -1 on timeout.
+int wire_bus_read_bit(void){
+    uint8_t value;
 
+    if (!wire_read_slots(1) || !wire_rx_pop(&value)){return -1;}
+    return value & 0x01;
 }
 
-void read_wire(void){
-    switch (transaction)
-    {
-    case PRESENSE:
+//wire_bus_write
+//Writes 'len' bytes LSB first, sleeping between bit slots.
+bool wire_bus_write(const uint8_t *data, uint8_t len){
+    for (uint8_t i = 0; i < len; i++){
+        for (uint8_t bit = 0; bit < 8; bit++){
+            if (!wire_bus_write_bit(data[i] >> bit)){return false;}
+        }
+    }
+    return true;
+}
+
+//wire_bus_read
+//Reads 'len' bytes LSB first, up to WIRE_RX_QUEUE_SIZE per task wake-up.
+//Returns false on a slot timeout.
+bool wire_bus_read(uint8_t *data, uint8_t len){
+    while (len > 0){
+        uint8_t block = (len > WIRE_RX_QUEUE_SIZE) ? WIRE_RX_QUEUE_SIZE : len;
+
+        if (!wire_read_slots(block * 8u)){return false;}
+        for (uint8_t i = 0; i < block; i++){
+            if (!wire_rx_pop(&data[i])){return false;}
+        }
+        data += block;
+        len -= block;
+    }
+    return true;
+}
+#endif /* !WIRE_BUS_UART */
 
-    case POLL:
-        ringBuffer[ringHead++] = cyhal_gpio_read(TEMP_PIN);
-        if (ringHead >= RING_BUFFER_SIZE) ringHead = 0;
-        break;
-    default:
-        break;
+//write_wire_byte
+//Writes one byte on the bus. Advances the transaction once the byte is on
+//the bus.
+void write_wire_byte(uint8_t data){
+    if (!wire_bus_write(&data, 1)){
+        transaction = ERROR;
+        return;
     }
+    transaction++;
+}
+
+//wire_crc8
+//Maxim 1-Wire CRC8, one table lookup per byte. A block that ends in its own
+//CRC gives 0.
+static uint8_t wire_crc8(const uint8_t *data, uint8_t len){
+    uint8_t crc = 0;
 
+    while (len--){
+        crc = crc8_table[crc ^ *data++];
+    }
+    return crc;
 }
 
-void print_wire(void){
-    for (int i = 0; i < RING_BUFFER_SIZE; i++){
-        printf("%u,", ringBuffer[i]);
+//scratchpad_valid
+//A bus held low reads as all zeros, which passes the CRC.
+static bool scratchpad_valid(void){
+    bool zero = true;
+
+    for (uint8_t i = 0; i < WIRE_SCRATCHPAD_SIZE; i++){
+        if (scratchpad[i] != 0){zero = false;}
     }
-    printf("\r\nWire\r\n");
+    return !zero && (wire_crc8(scratchpad, WIRE_SCRATCHPAD_SIZE) == 0);
+}
+
+//wire_search_next
+//One SEARCH ROM pass (Maxim AN187). 'rom' holds the previous ROM found and
+//'last_discrepancy' the bit where that pass took the 1 branch, 0 before the
+//first pass. Returns false if no device answered or the ROM failed its CRC.
+static bool wire_search_next(uint8_t rom[WIRE_ROM_SIZE], uint8_t *last_discrepancy){
+    uint8_t last_zero = 0;
+    uint32_t events = wire_bus_reset();
+
+    if ((events & (WIRE_EVT_SLOT_DONE | WIRE_EVT_PRESENCE)) != (WIRE_EVT_SLOT_DONE | WIRE_EVT_PRESENCE)){
+        return false;
+    }
+    if (!wire_bus_write(&search, 1)){return false;}
+
+    for (uint8_t bit = 1; bit <= WIRE_ROM_BITS; bit++){
+        uint8_t *byte = &rom[(bit - 1) / 8];
+        uint8_t mask = (uint8_t)(1u << ((bit - 1) % 8));
+        int id_bit = wire_bus_read_bit();
+        int cmp_bit = wire_bus_read_bit();
+        bool direction;
+
+        if ((id_bit < 0) || (cmp_bit < 0) || ((id_bit == 1) && (cmp_bit == 1))){
+            return false;       //Slot timeout, or every device dropped out
+        }
+        if (id_bit != cmp_bit){
+            direction = (id_bit == 1);      //All remaining devices agree
+        }
+        else {
+            //Discrepancy: repeat the last path below it, take 1 at it
+            if (bit < *last_discrepancy){
+                direction = (*byte & mask) != 0;
+            }
+            else {
+                direction = (bit == *last_discrepancy);
+            }
+            if (!direction){last_zero = bit;}
+        }
+
+        if (direction){*byte |= mask;}
+        else {*byte &= (uint8_t)~mask;}
+        if (!wire_bus_write_bit(direction ? 1 : 0)){return false;}
+    }
+
+    *last_discrepancy = last_zero;
+    return wire_crc8(rom, WIRE_ROM_SIZE) == 0;
+}
+
+//wire_search
+//Enumerates the DS18B20 probes on the bus. Probes found again keep their
+//last reading. A new or power-cycled probe holds its EEPROM resolution, so
+//every probe is configured again before the next conversion. Returns the
+//number found.
+static uint8_t wire_search(void){
+    wire_device_t found[WIRE_MAX_DEVICES];
+    uint8_t rom[WIRE_ROM_SIZE] = {0};
+    uint8_t last_discrepancy = 0;
+    uint8_t count = 0;
+
+    do {
+        if (!wire_search_next(rom, &last_discrepancy)){break;}
+        if (rom[0] != DS18B20_FAMILY_CODE){continue;}
+
+        memcpy(found[count].rom, rom, WIRE_ROM_SIZE);
+        found[count].raw = 0;
+        found[count].valid = false;
+        for (uint8_t i = 0; i < device_count; i++){
+            if (memcmp(wire_devices[i].rom, rom, WIRE_ROM_SIZE) == 0){
+                found[count] = wire_devices[i];
+                break;
+            }
+        }
+        DLOG3(DLOG_MSG_WIRE_PROBE_ROM, count,
+              ((uint32_t)rom[7] << 24) | ((uint32_t)rom[6] << 16) | ((uint32_t)rom[5] << 8) | rom[4],
+              ((uint32_t)rom[3] << 24) | ((uint32_t)rom[2] << 16) | ((uint32_t)rom[1] << 8) | rom[0]);
+        count++;
+    } while ((last_discrepancy != 0) && (count < WIRE_MAX_DEVICES));
+
+    memcpy(wire_devices, found, count * sizeof(found[0]));
+    device_count = count;
+    rescan = false;
+    configure = true;
+    return count;
+}
+
+//wire_write_config
+//Writes the alarm and configuration registers of every probe at once.
+static bool wire_write_config(void){
+    uint8_t config[5] = {skip, write_scratch, WIRE_ALARM_TH, WIRE_ALARM_TL, 0};
+
+    config[4] = (uint8_t)(((resolution_bits - WIRE_RESOLUTION_MIN_BITS) << 5) | 0x1F);
+    config_written = config[4];
+    return wire_bus_write(config, sizeof(config));
+}
+
+//wire_match_rom
+//Addresses one probe, the next function command goes to it alone.
+static bool wire_match_rom(const uint8_t rom[WIRE_ROM_SIZE]){
+    uint8_t command[1 + WIRE_ROM_SIZE];
+
+    command[0] = match;
+    memcpy(&command[1], rom, WIRE_ROM_SIZE);
+    return wire_bus_write(command, sizeof(command));
+}
+
+//wire_wait_start
+//Blocks the task until wire_request_conversion() is called.
+static void wire_wait_start(void){
+    uint32_t events = 0;
+
+    while ((events & WIRE_EVT_START) == 0){
+        xTaskNotifyWait(0, WIRE_EVT_ALL, &events, portMAX_DELAY);
+    }
+    timeoutCounter = INIT_RETRIES;
+    read_retries = 0;
+    poll_count = 0;
+    transaction = RESET;
 }
 
 //wire_process
-//function to be called in main loop
+//Temperature task. Each state starts a bus operation and sleeps until the
+//1-Wire ISRs report it finished, so the task never spins on the bus.
 void wire_process(void *pvParameters){
-    
+
     (void) pvParameters;
+    uint32_t events;
+    int value;
 
     for (;;){
 
         switch (transaction)
         {
         case RESET:
-            if (wire_busy){break;}
-            initialize_wire();
-            transaction++;
+            events = wire_bus_reset();
+            if ((events & WIRE_EVT_SLOT_DONE) == 0){
+                transaction = ERROR;        //Reset or presence window never ended
+                break;
+            }
+            if (events & WIRE_EVT_PRESENCE){
+                timeoutCounter = INIT_RETRIES;
+                if ((device_count == 0) || (rescan && !conversionComplete)){
+                    //A search in the middle of the reads would reorder the
+                    //probes under device_current, so it waits for the next
+                    //conversion
+                    transaction = SEARCH_ROM;
+                }
+                else if (configure && !conversionComplete){
+                    transaction = WRITE_CONFIG;
+                }
+                else if (conversionComplete){
+                    transaction = MATCH_ROM;    //Read the probes one by one
+                }
+                else {
+                    transaction = SKIP_ROM;     //Every probe converts at once
+                }
+                break;
+            }
+            transaction = RESET;
+            if (--timeoutCounter == 0){
+                transaction = ERROR;
+            }
             break;
         case PRESENSE:
-            if (wire_busy){break;}
-            if (timeoutCounter-- <= 0){
+            //Presence window is handled by isr_wire_timer and isr_wire
+            transaction = RESET;
+            break;
+        case SEARCH_ROM:
+            if (wire_search() == 0){
+                printf("No temperature probes found\r\n");
                 transaction = ERROR;
                 break;
             }
-            cyhal_timer_start(&wire_timer);
-            wire_busy = true;
+            transaction = RESET;
             break;
-        case SKIP_ROM:
-            if (wire_busy){break;}
-            if (wire_initialized){
-                printf("Wire Initialized\r\n");
-                wire_initialized = false;
+        case WRITE_CONFIG:
+            configure = false;
+            if (!wire_write_config()){
+                configure = true;
+                transaction = ERROR;
+                break;
             }
+            transaction = RESET;
+            break;
+        case SKIP_ROM:
             write_wire_byte(skip);
             break;
         case CONVERT_T:
-            if (conversionComplete){        //Happens after transaction gets reset after temp conversion
-                transaction = SCRATCH;
+            write_wire_byte(convert);
+            break;
+        case POLL:
+            //Sleep through the conversion, then one read slot confirms every
+            //probe has finished
+            vTaskDelay(pdMS_TO_TICKS((poll_count == 0) ? wire_conversion_ms() : WIRE_POLL_INTERVAL_MS) + 1);
+            value = wire_bus_read_bit();
+            if (value < 0){
+                transaction = ERROR;
                 break;
             }
-            if (wire_busy){break;}
-            else{write_wire_byte(convert);}
+            if (value == 1){
+                printf("Temperature Conversion Complete\r\n");
+                poll_count = 0;
+                transaction = RESET;
+                conversionComplete = true;
+                device_current = 0;
+                break;
+            }
+            if (++poll_count > WIRE_POLL_RETRIES){
+                transaction = ERROR;
+            }
             break;
-        case POLL:
-            if (wire_busy){break;}
-            if (ringTail >= RING_BUFFER_SIZE){ringTail = 0;}
-            if (ringTail != ringHead){
-                if (ringBuffer[ringTail++] == 1){
-                    printf("Temperature Conversion Complete\r\n");
-                    ringHead = 0;
-                    ringTail = 0;
-                    transaction = RESET;
-                    conversionComplete = true;
-                    break;
-                }
+        case MATCH_ROM:
+            if (!wire_match_rom(wire_devices[device_current].rom)){
+                transaction = ERROR;
+                break;
             }
-            cyhal_gpio_write(TEMP_PIN, 0);
-            cyhal_gpio_write(TEMP_PIN, 1);
-            wire_busy = true;
-            cyhal_timer_start(&read_timer);
+            transaction = SCRATCH;
             break;
         case SCRATCH:
-            if (wire_busy){break;}
             write_wire_byte(read);
             break;
         case PARSE:
-            if (wire_busy){break;}
-            cyhal_gpio_write(TEMP_PIN, 0);
-            cyhal_gpio_write(TEMP_PIN, 1);
-            wire_busy = true;
-            cyhal_timer_start(&read_timer);
-
-            if (ringTail >= RING_BUFFER_SIZE){ringTail = 0;}
-            if (ringTail != ringHead){
-                binaryTemp += ringBuffer[ringTail++] << bit++;
-                if (bit >= REG_SIZE){
-                    bit = 0;
-                    temp = binaryTemp * TEMP_CONVERSION;
-                    binaryTemp = 0;
-                    transaction = DONE;
+            if (!wire_bus_read(scratchpad, WIRE_SCRATCHPAD_SIZE)){
+                transaction = ERROR;
+                break;
+            }
+            if (!scratchpad_valid()){
+                //Read the same scratchpad again, the conversion result stays
+                wire_stats.crc_errors++;
+                if (read_retries++ < WIRE_READ_RETRIES){
+                    wire_stats.retries++;
+                    transaction = RESET;
                     break;
                 }
+                //Give up on this probe for this conversion, it may be gone.
+                //The bus is searched again before the next conversion.
+                wire_stats.read_failures++;
+                wire_devices[device_current].valid = false;
+                rescan = true;
+            }
+            else {
+                binaryTemp = (uint16_t)(scratchpad[0] | (scratchpad[1] << 8));
+                if (scratchpad[4] != config_written){
+                    configure = true;       //Power cycled back to its EEPROM setting
+                }
+                wire_devices[device_current].raw = (int16_t)binaryTemp;
+                wire_devices[device_current].valid = true;
+                wire_stats.reads++;
             }
+            if (device_current == 0){
+                temp = wire_devices[0].raw * TEMP_CONVERSION;
+                temp_valid = wire_devices[0].valid;
+            }
+            read_retries = 0;
+            transaction = (++device_current < device_count) ? RESET : DONE;
             break;
         case DONE:
 
-            printf("Temperature: %f\r\n", temp);
-            transaction = -1;
-            // transaction = RESET;
+            for (uint8_t i = 0; i < device_count; i++){
+                if (wire_devices[i].valid){
+                    DLOG2(DLOG_MSG_WIRE_PROBE_TEMP, i, ((int32_t)wire_devices[i].raw * 25) / 4);
+                }
+            }
             conversionComplete = false;
-            
-            //vTaskDelete(NULL);
+            wire_wait_start();
             break;
         case ERROR:
             printf("Wire Initialization Failed\r\n");
-            transaction = -1;
+            wire_stats.bus_errors++;
+            conversionComplete = false;
+            rescan = true;
+            wire_wait_start();
             break;
         default:
+            wire_wait_start();
             break;
         }
     }
-        
-}
 
+}
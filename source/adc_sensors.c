@@ -5,6 +5,12 @@
 #include "cy_retarget_io.h"
 #include "cyhal_adc.h"
 #include "functions.h"
+#include "sensor_filter.h"
+#include "probe_scheduler.h"
+
+/* FreeRTOS header files */
+#include "FreeRTOS.h"
+#include "task.h"
 
 /* ADC Object */
 cyhal_adc_t adc_obj;
@@ -13,6 +19,30 @@ cyhal_adc_t adc_obj;
 cyhal_adc_channel_t adc_chan_0_obj;
 cyhal_adc_channel_t adc_chan_1_obj;
 
+/*******************************************************************************
+*       Enumerated Types
+*******************************************************************************/
+/* ADC Channel constants*/
+enum ADC_CHANNELS
+{
+  CHANNEL_0 = 0,
+  CHANNEL_1,
+  NUM_CHANNELS
+} adc_channel;
+
+#if ADC_CONTINUOUS_SCAN
+/* Continuous scanning, each channel result is the SAR average of
+ * ADC_HW_AVERAGE_COUNT conversions */
+const cyhal_adc_config_t adc_config = {
+        .continuous_scanning=true,  // Free running scans, results moved by DMA
+        .average_mode_flags=CYHAL_ADC_AVG_MODE_AVERAGE,
+        .average_count=ADC_HW_AVERAGE_COUNT,
+        .vref=CYHAL_ADC_REF_VDDA,   // VREF for Single ended channel set to VDDA
+        .vneg=CYHAL_ADC_VNEG_VSSA,  // VNEG for Single ended channel set to VSSA
+        .resolution = 12u,          // 12-bit resolution
+        .ext_vref = NC,             // No connection
+        .bypass_pin = NC };       // No connection
+#else
 /* Default ADC configuration */
 const cyhal_adc_config_t adc_config = {
         .continuous_scanning=false, // Continuous Scanning is disabled
@@ -22,27 +52,57 @@ const cyhal_adc_config_t adc_config = {
         .resolution = 12u,          // 12-bit resolution
         .ext_vref = NC,             // No connection
         .bypass_pin = NC };       // No connection
-
-/* Asynchronous read complete flag, used in Event Handler */
-static bool async_read_complete = false;
+#endif /* ADC_CONTINUOUS_SCAN */
 
 /* Variable to store results from multiple channels during asynchronous read*/
 int32_t result_arr[2 * NUM_SCAN] = {0};
 
-static void adc_event_handler(void* arg, cyhal_adc_event_t event);
+/* Latest completed sample, written by adc_event_handler */
+static adc_sample_t adc_latest;
 
+/* Task waiting in adc_sample_get() for the next completed window */
+static volatile TaskHandle_t adc_consumer = NULL;
 
+#if ADC_CONTINUOUS_SCAN
+/* DMA double buffer. The DMA fills one block of ADC_OVERSAMPLE_SCANS scans
+ * while the other block is decimated by the event handler. */
+static int32_t adc_dma_buffer[2][ADC_OVERSAMPLE_SCANS * NUM_CHANNELS];
+static volatile uint8_t adc_dma_block = 0;
 
-/*******************************************************************************
-*       Enumerated Types
-*******************************************************************************/
-/* ADC Channel constants*/
-enum ADC_CHANNELS
+#endif /* ADC_CONTINUOUS_SCAN */
+
+/* Filter chain of each channel, run on every scan. In single read mode
+ * there is one scan per sample and nothing to decimate. */
+static const sensor_filter_cfg_t adc_filter_cfg[NUM_CHANNELS] =
 {
-  CHANNEL_0 = 0,
-  CHANNEL_1,
-  NUM_CHANNELS
-} adc_channel;
+    [CHANNEL_0] =
+    {
+        .outlier_limit = ADC_FILTER_PH_OUTLIER_UV,
+        .outlier_run = ADC_FILTER_OUTLIER_RUN,
+        .median_len = ADC_FILTER_MEDIAN_LEN,
+        .ema_shift = ADC_FILTER_EMA_SHIFT,
+        .decimation = ADC_CONTINUOUS_SCAN ? ADC_OVERSAMPLE_SCANS : 1u
+    },
+    [CHANNEL_1] =
+    {
+        .outlier_limit = ADC_FILTER_EC_OUTLIER_UV,
+        .outlier_run = ADC_FILTER_OUTLIER_RUN,
+        .median_len = ADC_FILTER_MEDIAN_LEN,
+        .ema_shift = ADC_FILTER_EMA_SHIFT,
+        .decimation = ADC_CONTINUOUS_SCAN ? ADC_OVERSAMPLE_SCANS : 1u
+    }
+};
+
+static sensor_filter_t adc_filter[NUM_CHANNELS];
+
+/* Last filter output of each channel, in uV */
+static int32_t adc_filtered_uv[NUM_CHANNELS];
+
+/* Set to reset a channel's filter before its next scan. One flag per
+ * channel so setting one needs no lock. */
+static volatile bool adc_filter_reset_pending[NUM_CHANNELS];
+
+static void adc_event_handler(void* arg, cyhal_adc_event_t event);
 /******************************************************************************
  * Function Name: adc_multi_channel_init
  ******************************************************************************
@@ -72,7 +132,7 @@ void adc_multi_channel_init(void)
 
     /* ADC channel configuration */
     const cyhal_adc_channel_config_t channel_config = {
-            .enable_averaging = false,  // Disable averaging for channel
+            .enable_averaging = ADC_CONTINUOUS_SCAN,  // Hardware averaging in continuous mode
             .min_acquisition_ns = ACQUISITION_TIME_NS, // Minimum acquisition time set to 1us
             .enabled = true };          // Sample this channel when ADC performs a scan
 
@@ -102,6 +162,11 @@ void adc_multi_channel_init(void)
         CY_ASSERT(0);
     }
 
+    for (uint32_t channel = 0; channel < NUM_CHANNELS; channel++)
+    {
+        sensor_filter_init(&adc_filter[channel], &adc_filter_cfg[channel]);
+    }
+
     /* Register a callback to handle asynchronous read completion */
      cyhal_adc_register_callback(&adc_obj, &adc_event_handler, result_arr);
 
@@ -116,6 +181,23 @@ void adc_multi_channel_init(void)
              printf("ADC configuration update failed. Error: %ld\n", (long unsigned int)result);
              CY_ASSERT(0);
      }
+
+#if ADC_CONTINUOUS_SCAN
+     /* Move scan results with DMA so the CPU only runs once per block */
+     result = cyhal_adc_set_async_mode(&adc_obj, CYHAL_ASYNC_DMA, CYHAL_DMA_PRIORITY_DEFAULT);
+     if(result != CY_RSLT_SUCCESS)
+     {
+             printf("ADC DMA mode failed. Error: %ld\n", (long unsigned int)result);
+             CY_ASSERT(0);
+     }
+
+     result = cyhal_adc_read_async_uv(&adc_obj, ADC_OVERSAMPLE_SCANS, adc_dma_buffer[adc_dma_block]);
+     if(result != CY_RSLT_SUCCESS)
+     {
+             printf("ADC continuous scan start failed. Error: %ld\n", (long unsigned int)result);
+             CY_ASSERT(0);
+     }
+#endif /* ADC_CONTINUOUS_SCAN */
 }	// end of adc_multi_channel_init function
 
 /*******************************************************************************
@@ -123,8 +205,8 @@ void adc_multi_channel_init(void)
  *******************************************************************************
  *
  * Summary:
- *  ADC event handler. This function handles the asynchronous read complete event
- *  and sets the async_read_complete flag to true.
+ *  ADC event handler. Turns the completed read (or DMA block) into a
+ *  sequenced, timestamped sample and wakes the task waiting for it.
  *
  * Parameters:
  *  void *arg : pointer to result list
@@ -136,31 +218,130 @@ void adc_multi_channel_init(void)
  *******************************************************************************/
 static void adc_event_handler(void* arg, cyhal_adc_event_t event)
 {
+    BaseType_t xHigherPriorityTaskWoken = pdFALSE;
+    const int32_t *block;
+    uint32_t scans;
+
     if(0u != (event & CYHAL_ADC_ASYNC_READ_COMPLETE))
     {
-        /* Set async read complete flag to true */
-        async_read_complete = true;
+#if ADC_CONTINUOUS_SCAN
+        block = adc_dma_buffer[adc_dma_block];
+        scans = ADC_OVERSAMPLE_SCANS;
+
+        /* Point the DMA at the other half first so no scan is lost */
+        adc_dma_block ^= 1u;
+        (void) cyhal_adc_read_async_uv(&adc_obj, ADC_OVERSAMPLE_SCANS, adc_dma_buffer[adc_dma_block]);
+#else
+        block = result_arr;
+        scans = NUM_SCAN;
+#endif /* ADC_CONTINUOUS_SCAN */
+
+        adc_latest.seq++;
+        adc_latest.timestamp_ms = xTaskGetTickCountFromISR() * portTICK_PERIOD_MS;
+
+        /* Filter every scan and decimate to one value per block. Results are
+         * interleaved by channel. A block with dropped outliers completes its
+         * output in the next one. Only outputs taken while the probe scheduler
+         * has the channel's probe settled are reported. */
+        for (uint32_t channel = 0; channel < NUM_CHANNELS; channel++)
+        {
+            bool ready = false;
+
+            if (adc_filter_reset_pending[channel])
+            {
+                adc_filter_reset_pending[channel] = false;
+                sensor_filter_reset(&adc_filter[channel]);
+            }
+            for (uint32_t scan = 0; scan < scans; scan++)
+            {
+                ready |= sensor_filter_push(&adc_filter[channel], block[(scan * NUM_CHANNELS) + channel],
+                                            &adc_filtered_uv[channel]);
+            }
+
+            if (ready && probe_scheduler_valid(channel))
+            {
+                adc_latest.mv[channel] = adc_filtered_uv[channel] / (int32_t)MICRO_TO_MILLI_CONV_RATIO;
+                adc_latest.valid_mask |= (uint8_t)(1u << channel);
+            }
+        }
+
+        if (adc_consumer != NULL)
+        {
+            vTaskNotifyGiveFromISR(adc_consumer, &xHigherPriorityTaskWoken);
+            adc_consumer = NULL;
+        }
     }
+    (void) arg;
+    portYIELD_FROM_ISR(xHigherPriorityTaskWoken);
 } // end of adc_event_handler function
 
-
-/*
- * Following functions are used in publisher_task() of publisher_task.c to compute adc output
- */
-cy_rslt_t result_return(void)
+/******************************************************************************
+ * Function Name: adc_sample_get
+ ******************************************************************************
+ * Summary:
+ *  Waits for the next sampling window to complete and copies its sample.
+ *  In single read mode this starts the conversion; in continuous mode it
+ *  waits for the next DMA block, so the result is never older than one
+ *  block.
+ *
+ * Parameters:
+ *  adc_sample_t *sample : filled with the completed sample
+ *  uint32_t timeout_ms : longest time to wait for the window
+ *
+ * Return:
+ *  cy_rslt_t : CY_RSLT_SUCCESS, the read error, or ADC_RSLT_TIMEOUT
+ *
+ ******************************************************************************/
+cy_rslt_t adc_sample_get(adc_sample_t *sample, uint32_t timeout_ms)
 {
-	return cyhal_adc_read_async_uv(&adc_obj, NUM_SCAN, result_arr);
-}
+    cy_rslt_t result = CY_RSLT_SUCCESS;
 
-int32_t channel0_return(void)
-{
-	return result_arr[CHANNEL_0] / MICRO_TO_MILLI_CONV_RATIO;
+    /* Drop a wake-up left over from a window that already timed out */
+    (void) ulTaskNotifyTake(pdTRUE, 0);
+    adc_consumer = xTaskGetCurrentTaskHandle();
+
+#if !ADC_CONTINUOUS_SCAN
+    result = cyhal_adc_read_async_uv(&adc_obj, NUM_SCAN, result_arr);
+    if (result != CY_RSLT_SUCCESS)
+    {
+        adc_consumer = NULL;
+        return result;
+    }
+#endif /* !ADC_CONTINUOUS_SCAN */
+
+    if (ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(timeout_ms)) == 0)
+    {
+        adc_consumer = NULL;
+        return ADC_RSLT_TIMEOUT;
+    }
+
+    taskENTER_CRITICAL();
+    *sample = adc_latest;
+    adc_latest.valid_mask = 0;
+    taskEXIT_CRITICAL();
+
+    return result;
 }
 
-int32_t channel1_return(void)
+/******************************************************************************
+ * Function Name: adc_filter_reset
+ ******************************************************************************
+ * Summary:
+ *  Restarts a channel's filter chain with the next DMA block, for when its
+ *  probe has just settled and the older scans describe it settling or
+ *  switched off. Safe from an interrupt.
+ *
+ * Parameters:
+ *  uint32_t channel : ADC_CHANNEL_PH or ADC_CHANNEL_EC
+ *
+ * Return:
+ *  void
+ *
+ ******************************************************************************/
+void adc_filter_reset(uint32_t channel)
 {
-	async_read_complete = false;
-	return result_arr[CHANNEL_1] / MICRO_TO_MILLI_CONV_RATIO;
+    if (channel < NUM_CHANNELS)
+    {
+        adc_filter_reset_pending[channel] = true;
+    }
 }
-
-
@@ -0,0 +1,89 @@
+/******************************************************************************
+* File Name:   app_alloc.h
+*
+* Description: This file selects static or heap allocation for the tasks,
+*              queues and buffers created by the application. With
+*              APP_STATIC_ALLOCATION set, every stack, TCB and queue is
+*              placed at link time, so reconnect cycles cannot grow or
+*              fragment the heap and tools/memory_budget.sh can report the
+*              RAM they use.
+*
+* Related Document: See README.md
+*
+*******************************************************************************/
+
+#ifndef APP_ALLOC_H_
+#define APP_ALLOC_H_
+
+#include "FreeRTOS.h"
+#include "task.h"
+#include "queue.h"
+
+/*******************************************************************************
+* Macros
+********************************************************************************/
+#ifndef APP_STATIC_ALLOCATION
+#define APP_STATIC_ALLOCATION           (1)
+#endif
+
+#if APP_STATIC_ALLOCATION
+
+#if (configSUPPORT_STATIC_ALLOCATION == 0)
+#error "APP_STATIC_ALLOCATION needs configSUPPORT_STATIC_ALLOCATION"
+#endif
+
+/* Storage for task 'tag', at file scope of the file creating the task */
+#define APP_TASK_DEFINE(tag, depth)                                         \
+    static StackType_t tag##_stack[(depth)];                                \
+    static StaticTask_t tag##_tcb
+
+/* Same arguments and result as xTaskCreate() */
+#define APP_TASK_CREATE(tag, fn, name, depth, param, priority, handle)      \
+    app_task_create_static((fn), (name), (depth), (param), (priority),      \
+                           (handle), tag##_stack, &tag##_tcb)
+
+/* Storage for queue 'tag' */
+#define APP_QUEUE_DEFINE(tag, length, item_size)                            \
+    static uint8_t tag##_storage[(length) * (item_size)];                   \
+    static StaticQueue_t tag##_queue
+
+#define APP_QUEUE_CREATE(tag, length, item_size)                            \
+    xQueueCreateStatic((length), (item_size), tag##_storage, &tag##_queue)
+
+#else
+
+#define APP_TASK_DEFINE(tag, depth)                                         \
+    extern StaticTask_t tag##_tcb
+#define APP_TASK_CREATE(tag, fn, name, depth, param, priority, handle)      \
+    xTaskCreate((fn), (name), (depth), (param), (priority), (handle))
+
+#define APP_QUEUE_DEFINE(tag, length, item_size)                            \
+    extern StaticQueue_t tag##_queue
+#define APP_QUEUE_CREATE(tag, length, item_size)                            \
+    xQueueCreate((length), (item_size))
+
+#endif /* APP_STATIC_ALLOCATION */
+
+/*******************************************************************************
+* Function Prototypes
+********************************************************************************/
+#if APP_STATIC_ALLOCATION
+/* xTaskCreateStatic() with the xTaskCreate() calling convention */
+static inline BaseType_t app_task_create_static(TaskFunction_t fn, const char * const name,
+                                                uint32_t depth, void * const param,
+                                                UBaseType_t priority, TaskHandle_t * const handle,
+                                                StackType_t * const stack, StaticTask_t * const tcb)
+{
+    TaskHandle_t created = xTaskCreateStatic(fn, name, depth, param, priority, stack, tcb);
+
+    if (handle != NULL)
+    {
+        *handle = created;
+    }
+    return (created != NULL) ? pdPASS : pdFAIL;
+}
+#endif /* APP_STATIC_ALLOCATION */
+
+#endif /* APP_ALLOC_H_ */
+
+/* [] END OF FILE */
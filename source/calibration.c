@@ -0,0 +1,644 @@
+/******************************************************************************
+* File Name:   calibration.c
+*
+* Description: This file contains the probe calibration. pH is converted
+*              with the slope and offset fitted to up to three buffers,
+*              scaled with the water temperature as the Nernst slope is. EC
+*              is the front end conductance times the cell constant, brought
+*              back to 25 C with a linear or quadratic coefficient.
+*
+*              The coefficients are one CRC protected record in internal
+*              flash, written to the two rows in turn with a sequence number
+*              so the newest good row wins at boot. The flow meter K-factor
+*              is kept in the same record.
+*
+*              Commands build a new record from a copy, save it, and only
+*              then swap it in, so publisher_task always converts with a
+*              whole calibration.
+*
+* Related Document: See README.md
+*
+*******************************************************************************/
+
+#include <stddef.h>
+#include <string.h>
+
+#include "cy_pdl.h"
+#include "cyhal.h"
+
+/* FreeRTOS header files */
+#include "FreeRTOS.h"
+#include "task.h"
+
+#include "functions.h"
+#include "macros.h"
+#include "calibration.h"
+
+/******************************************************************************
+* Macros
+******************************************************************************/
+#define CALIBRATION_MAGIC               (0x43414C31u)   /* "CAL1" */
+
+#define CALIBRATION_KELVIN_25C          (298.15f)
+
+/* Ranges accepted from commands */
+#define CALIBRATION_PH_MAX              (14.0f)
+#define CALIBRATION_PH_SLOPE_MIN_MV     (1.0f)
+#define CALIBRATION_EC_STANDARD_MAX     (200000.0f)
+#define CALIBRATION_EC_CELL_MIN         (0.01f)
+#define CALIBRATION_EC_CELL_MAX         (100.0f)
+#define CALIBRATION_EC_ALPHA_MAX        (0.1f)
+#define CALIBRATION_EC_BETA_MAX         (0.01f)
+
+/* Compensation factors below this mean coefficients far outside the
+ * probe's range, the reading is not converted */
+#define CALIBRATION_EC_FACTOR_MIN       (0.1f)
+
+/******************************************************************************
+* Global Variables
+*******************************************************************************/
+typedef struct
+{
+    float mv;
+    float ph;
+    int16_t temp_cdeg;          /* Buffer temperature when it was read */
+    uint8_t reserved[2];
+} calibration_ph_point_t;
+
+/* The flash record, also the calibration in use */
+typedef struct
+{
+    uint32_t magic;
+    uint32_t seq;
+    uint8_t ph_points;
+    uint8_t reserved[3];
+    calibration_ph_point_t ph[CALIBRATION_PH_POINTS];   /* pH ascending */
+    float ec_cell;
+    float ec_alpha;
+    float ec_beta;
+    uint32_t flow_k;
+    uint32_t crc;               /* CRC-32 of everything before it */
+} calibration_record_t;
+
+static cyhal_flash_t flash_obj;
+static uint32_t row_size = 0;           /* 0 while the flash is not usable */
+static uint32_t row_current = 0;        /* Row holding the record in use */
+static uint32_t row_buffer[CALIBRATION_ROW_MAX / sizeof(uint32_t)];
+
+static calibration_record_t cal;
+
+/* Last readings converted, for the calibration commands */
+static int32_t last_ph_mv;
+static int16_t last_ph_cdeg;
+static bool last_ph_valid = false;
+static int32_t last_ec_mv;
+static int16_t last_ec_cdeg;
+static bool last_ec_valid = false;
+
+/******************************************************************************
+ * Record
+ ******************************************************************************/
+static uint32_t calibration_crc32(const uint8_t *data, size_t len)
+{
+    uint32_t crc = 0xFFFFFFFFu;
+
+    for (size_t i = 0; i < len; i++)
+    {
+        crc ^= data[i];
+        for (uint8_t bit = 0; bit < 8u; bit++)
+        {
+            crc = (crc >> 1) ^ (0xEDB88320u & (0u - (crc & 1u)));
+        }
+    }
+    return ~crc;
+}
+
+static void calibration_defaults(calibration_record_t *rec)
+{
+    memset(rec, 0, sizeof(*rec));
+    rec->magic = CALIBRATION_MAGIC;
+    rec->ec_cell = CALIBRATION_EC_CELL_DEFAULT;
+    rec->ec_alpha = CALIBRATION_EC_ALPHA_DEFAULT;
+    rec->ec_beta = CALIBRATION_EC_BETA_DEFAULT;
+    rec->flow_k = FLOW_K_FACTOR;
+}
+
+static bool calibration_record_valid(const calibration_record_t *rec)
+{
+    return (rec->magic == CALIBRATION_MAGIC) &&
+           (rec->ph_points <= CALIBRATION_PH_POINTS) &&
+           (rec->crc == calibration_crc32((const uint8_t *)rec, offsetof(calibration_record_t, crc)));
+}
+
+static uint32_t calibration_row_addr(uint32_t row)
+{
+    return CALIBRATION_FLASH_ADDR + (row * row_size);
+}
+
+/* Writes 'rec' to the row not in use and reads it back */
+static cy_rslt_t calibration_save(calibration_record_t *rec)
+{
+    uint32_t row = (row_current + 1u) % CALIBRATION_FLASH_ROWS;
+    cy_rslt_t result;
+
+    if (row_size == 0u)
+    {
+        return CALIBRATION_RSLT_BAD_GEOMETRY;
+    }
+
+    rec->seq = cal.seq + 1u;
+    rec->crc = calibration_crc32((const uint8_t *)rec, offsetof(calibration_record_t, crc));
+
+    memset(row_buffer, 0, row_size);
+    memcpy(row_buffer, rec, sizeof(*rec));
+    result = cyhal_flash_write(&flash_obj, calibration_row_addr(row), row_buffer);
+    if (result == CY_RSLT_SUCCESS)
+    {
+        result = cyhal_flash_read(&flash_obj, calibration_row_addr(row), (uint8_t *)row_buffer, sizeof(*rec));
+    }
+    if ((result == CY_RSLT_SUCCESS) && (memcmp(row_buffer, rec, sizeof(*rec)) != 0))
+    {
+        result = CALIBRATION_RSLT_BAD_GEOMETRY;
+    }
+    if (result == CY_RSLT_SUCCESS)
+    {
+        row_current = row;
+    }
+    return result;
+}
+
+/* Saves 'rec' and makes it the calibration in use */
+static cy_rslt_t calibration_commit(calibration_record_t *rec)
+{
+    cy_rslt_t result = calibration_save(rec);
+
+    if (result == CY_RSLT_SUCCESS)
+    {
+        taskENTER_CRITICAL();
+        cal = *rec;
+        taskEXIT_CRITICAL();
+    }
+    return result;
+}
+
+static void calibration_snapshot(calibration_record_t *rec)
+{
+    taskENTER_CRITICAL();
+    *rec = cal;
+    taskEXIT_CRITICAL();
+}
+
+/******************************************************************************
+ * pH
+ ******************************************************************************/
+/* Nernst slope at 'cdeg' relative to 25 C */
+static float calibration_ph_scale(int16_t cdeg)
+{
+    return (CALIBRATION_KELVIN_25C + ((float)(cdeg - CALIBRATION_REF_CDEG) / 100.0f)) / CALIBRATION_KELVIN_25C;
+}
+
+/******************************************************************************
+ * Function Name: calibration_ph_line
+ ******************************************************************************
+ * Summary:
+ *  Fits mv = iso + slope * scale(T) * (pH - 7) through two buffers read at
+ *  their own temperatures, or through one buffer at the nominal slope when
+ *  'b' is NULL.
+ *
+ * Return:
+ *  bool : false when the buffers give no usable slope
+ *
+ ******************************************************************************/
+static bool calibration_ph_line(const calibration_ph_point_t *a, const calibration_ph_point_t *b,
+                                float *slope, float *iso_mv)
+{
+    float ka = calibration_ph_scale(a->temp_cdeg) * (a->ph - CALIBRATION_PH_ISOPOTENTIAL);
+
+    if (b == NULL)
+    {
+        *slope = CALIBRATION_PH_NOMINAL_SLOPE_MV;
+    }
+    else
+    {
+        float kb = calibration_ph_scale(b->temp_cdeg) * (b->ph - CALIBRATION_PH_ISOPOTENTIAL);
+
+        if ((kb - ka) == 0.0f)
+        {
+            return false;
+        }
+        *slope = (b->mv - a->mv) / (kb - ka);
+    }
+
+    if ((*slope < CALIBRATION_PH_SLOPE_MIN_MV) && (*slope > -CALIBRATION_PH_SLOPE_MIN_MV))
+    {
+        return false;
+    }
+    *iso_mv = a->mv - (*slope * ka);
+    return true;
+}
+
+/* Line for a reading: with three buffers the segment on its side of the
+ * middle one */
+static bool calibration_ph_segment(const calibration_record_t *rec, float mv, float *slope, float *iso_mv)
+{
+    uint8_t seg = 0;
+
+    if (rec->ph_points == 0u)
+    {
+        return false;
+    }
+    if (rec->ph_points == 1u)
+    {
+        return calibration_ph_line(&rec->ph[0], NULL, slope, iso_mv);
+    }
+    if ((rec->ph_points == 3u) && (((mv - rec->ph[1].mv) * (rec->ph[2].mv - rec->ph[1].mv)) > 0.0f))
+    {
+        seg = 1;
+    }
+    return calibration_ph_line(&rec->ph[seg], &rec->ph[seg + 1u], slope, iso_mv);
+}
+
+/* Every segment fits, with slopes of one sign */
+static bool calibration_ph_fit_valid(const calibration_record_t *rec)
+{
+    float slope;
+    float first = 0.0f;
+    float iso_mv;
+
+    if (rec->ph_points == 1u)
+    {
+        return calibration_ph_line(&rec->ph[0], NULL, &slope, &iso_mv);
+    }
+    for (uint8_t p = 0; (p + 1u) < rec->ph_points; p++)
+    {
+        if (!calibration_ph_line(&rec->ph[p], &rec->ph[p + 1u], &slope, &iso_mv))
+        {
+            return false;
+        }
+        if ((p > 0u) && ((slope > 0.0f) != (first > 0.0f)))
+        {
+            return false;
+        }
+        first = slope;
+    }
+    return true;
+}
+
+/******************************************************************************
+ * EC
+ ******************************************************************************/
+static float calibration_ec_factor(const calibration_record_t *rec, int16_t cdeg)
+{
+    float dt = (float)(cdeg - CALIBRATION_REF_CDEG) / 100.0f;
+
+    return 1.0f + (rec->ec_alpha * dt) + (rec->ec_beta * dt * dt);
+}
+
+static int32_t calibration_round(float value)
+{
+    return (int32_t)((value >= 0.0f) ? (value + 0.5f) : (value - 0.5f));
+}
+
+/******************************************************************************
+ * Function Name: calibration_init
+ ******************************************************************************
+ * Summary:
+ *  Loads the newest valid record from the two flash rows, or the defaults
+ *  when neither holds one, and applies its flow meter K-factor.
+ *
+ * Return:
+ *  cy_rslt_t : CY_RSLT_SUCCESS, or the reason the flash is not used. The
+ *              defaults are in use either way.
+ *
+ ******************************************************************************/
+cy_rslt_t calibration_init(void)
+{
+    cyhal_flash_info_t info;
+    calibration_record_t rec;
+    bool found = false;
+    cy_rslt_t result;
+
+    calibration_defaults(&cal);
+
+    result = cyhal_flash_init(&flash_obj);
+    if (result != CY_RSLT_SUCCESS)
+    {
+        return result;
+    }
+
+    cyhal_flash_get_info(&flash_obj, &info);
+    for (uint8_t b = 0; b < info.block_count; b++)
+    {
+        const cyhal_flash_block_info_t *block = &info.blocks[b];
+
+        if ((CALIBRATION_FLASH_ADDR >= block->start_address) &&
+            ((CALIBRATION_FLASH_ADDR - block->start_address) < block->size))
+        {
+            uint32_t room = block->size - (CALIBRATION_FLASH_ADDR - block->start_address);
+
+            if ((block->page_size <= CALIBRATION_ROW_MAX) && (block->page_size >= sizeof(calibration_record_t)) &&
+                (room >= (block->page_size * CALIBRATION_FLASH_ROWS)))
+            {
+                row_size = block->page_size;
+            }
+        }
+    }
+    if (row_size == 0u)
+    {
+        return CALIBRATION_RSLT_BAD_GEOMETRY;
+    }
+
+    for (uint32_t row = 0; row < CALIBRATION_FLASH_ROWS; row++)
+    {
+        if ((cyhal_flash_read(&flash_obj, calibration_row_addr(row), (uint8_t *)&rec, sizeof(rec)) == CY_RSLT_SUCCESS) &&
+            calibration_record_valid(&rec) && (!found || ((int32_t)(rec.seq - cal.seq) > 0)))
+        {
+            cal = rec;
+            row_current = row;
+            found = true;
+        }
+    }
+
+    if (found && !flow_k_factor_set(cal.flow_k))
+    {
+        cal.flow_k = FLOW_K_FACTOR;
+    }
+    return CY_RSLT_SUCCESS;
+}
+
+/******************************************************************************
+ * Function Name: calibration_ph
+ ******************************************************************************
+ * Summary:
+ *  Converts a pH probe reading at the given water temperature.
+ *
+ * Parameters:
+ *  int32_t mv : probe reading in millivolts
+ *  bool temp_valid : false uses CALIBRATION_REF_CDEG
+ *  int16_t temp_cdeg : water temperature, 0.01 C
+ *  int32_t *ph_milli : pH x 1000
+ *
+ * Return:
+ *  bool : false until a buffer has been read
+ *
+ ******************************************************************************/
+bool calibration_ph(int32_t mv, bool temp_valid, int16_t temp_cdeg, int32_t *ph_milli)
+{
+    calibration_record_t rec;
+    float slope;
+    float iso_mv;
+    int16_t cdeg = temp_valid ? temp_cdeg : CALIBRATION_REF_CDEG;
+
+    taskENTER_CRITICAL();
+    last_ph_mv = mv;
+    last_ph_cdeg = cdeg;
+    last_ph_valid = true;
+    rec = cal;
+    taskEXIT_CRITICAL();
+
+    if (!calibration_ph_segment(&rec, (float)mv, &slope, &iso_mv))
+    {
+        return false;
+    }
+
+    *ph_milli = calibration_round(1000.0f * (CALIBRATION_PH_ISOPOTENTIAL +
+                                             (((float)mv - iso_mv) / (slope * calibration_ph_scale(cdeg)))));
+    return true;
+}
+
+/******************************************************************************
+ * Function Name: calibration_ec
+ ******************************************************************************
+ * Summary:
+ *  Converts an EC probe reading to uS/cm at 25 C.
+ *
+ * Parameters:
+ *  int32_t mv : probe reading in millivolts
+ *  bool temp_valid : false uses CALIBRATION_REF_CDEG
+ *  int16_t temp_cdeg : water temperature, 0.01 C
+ *  int32_t *ec_us : EC at 25 C, uS/cm
+ *
+ * Return:
+ *  bool : false when the compensation does not apply at this temperature
+ *
+ ******************************************************************************/
+bool calibration_ec(int32_t mv, bool temp_valid, int16_t temp_cdeg, int32_t *ec_us)
+{
+    calibration_record_t rec;
+    float factor;
+    int16_t cdeg = temp_valid ? temp_cdeg : CALIBRATION_REF_CDEG;
+
+    taskENTER_CRITICAL();
+    last_ec_mv = mv;
+    last_ec_cdeg = cdeg;
+    last_ec_valid = true;
+    rec = cal;
+    taskEXIT_CRITICAL();
+
+    factor = calibration_ec_factor(&rec, cdeg);
+    if (factor < CALIBRATION_EC_FACTOR_MIN)
+    {
+        return false;
+    }
+
+    *ec_us = calibration_round(((float)mv * CALIBRATION_EC_US_PER_MV * rec.ec_cell) / factor);
+    return true;
+}
+
+/******************************************************************************
+ * Function Name: calibration_ph_point
+ ******************************************************************************
+ * Summary:
+ *  Takes the last pH reading as the probe in buffer 'ph'. The buffer
+ *  replaces a kept one within CALIBRATION_PH_SPACING, otherwise it is
+ *  added, or replaces the nearest one when all points are used.
+ *
+ * Parameters:
+ *  float ph : pH of the buffer at its temperature
+ *  uint8_t *points : buffers in the calibration afterwards
+ *
+ * Return:
+ *  cy_rslt_t : CY_RSLT_SUCCESS once saved
+ *
+ ******************************************************************************/
+cy_rslt_t calibration_ph_point(float ph, uint8_t *points)
+{
+    calibration_record_t rec;
+    calibration_ph_point_t point;
+    uint8_t slot;
+    float nearest = CALIBRATION_PH_MAX;
+
+    if (!(ph >= 0.0f) || (ph > CALIBRATION_PH_MAX))
+    {
+        return CALIBRATION_RSLT_BAD_VALUE;
+    }
+    if (!last_ph_valid)
+    {
+        return CALIBRATION_RSLT_NO_READING;
+    }
+
+    taskENTER_CRITICAL();
+    rec = cal;
+    point.mv = (float)last_ph_mv;
+    point.temp_cdeg = last_ph_cdeg;
+    taskEXIT_CRITICAL();
+    point.ph = ph;
+    memset(point.reserved, 0, sizeof(point.reserved));
+
+    slot = rec.ph_points;
+    for (uint8_t p = 0; p < rec.ph_points; p++)
+    {
+        float distance = (rec.ph[p].ph > ph) ? (rec.ph[p].ph - ph) : (ph - rec.ph[p].ph);
+
+        if (((distance < CALIBRATION_PH_SPACING) || (rec.ph_points == CALIBRATION_PH_POINTS)) &&
+            (distance < nearest))
+        {
+            nearest = distance;
+            slot = p;
+        }
+    }
+    if (slot == rec.ph_points)
+    {
+        rec.ph_points++;
+    }
+    rec.ph[slot] = point;
+
+    /* Keep the buffers in pH order */
+    for (uint8_t p = 1; p < rec.ph_points; p++)
+    {
+        for (uint8_t q = p; (q > 0u) && (rec.ph[q - 1u].ph > rec.ph[q].ph); q--)
+        {
+            point = rec.ph[q];
+            rec.ph[q] = rec.ph[q - 1u];
+            rec.ph[q - 1u] = point;
+        }
+    }
+
+    if (!calibration_ph_fit_valid(&rec))
+    {
+        return CALIBRATION_RSLT_BAD_VALUE;
+    }
+
+    *points = rec.ph_points;
+    return calibration_commit(&rec);
+}
+
+/******************************************************************************
+ * Function Name: calibration_ec_standard
+ ******************************************************************************
+ * Summary:
+ *  Sets the cell constant from the last EC reading taken in a standard
+ *  solution, with the compensation in use.
+ *
+ * Parameters:
+ *  float ec_us : the standard's EC at 25 C, uS/cm
+ *
+ ******************************************************************************/
+cy_rslt_t calibration_ec_standard(float ec_us)
+{
+    calibration_record_t rec;
+    float conductance;
+    float factor;
+    float cell;
+
+    if (!(ec_us > 0.0f) || (ec_us > CALIBRATION_EC_STANDARD_MAX))
+    {
+        return CALIBRATION_RSLT_BAD_VALUE;
+    }
+    if (!last_ec_valid)
+    {
+        return CALIBRATION_RSLT_NO_READING;
+    }
+
+    taskENTER_CRITICAL();
+    rec = cal;
+    conductance = (float)last_ec_mv * CALIBRATION_EC_US_PER_MV;
+    factor = calibration_ec_factor(&rec, last_ec_cdeg);
+    taskEXIT_CRITICAL();
+
+    if ((conductance < 1.0f) || (factor < CALIBRATION_EC_FACTOR_MIN))
+    {
+        return CALIBRATION_RSLT_NO_READING;
+    }
+
+    cell = (ec_us * factor) / conductance;
+    if ((cell < CALIBRATION_EC_CELL_MIN) || (cell > CALIBRATION_EC_CELL_MAX))
+    {
+        return CALIBRATION_RSLT_BAD_VALUE;
+    }
+
+    rec.ec_cell = cell;
+    return calibration_commit(&rec);
+}
+
+/******************************************************************************
+ * Function Name: calibration_ec_compensation
+ ******************************************************************************
+ * Summary:
+ *  Sets the EC temperature coefficients, per C and per C squared.
+ *
+ ******************************************************************************/
+cy_rslt_t calibration_ec_compensation(float alpha, float beta)
+{
+    calibration_record_t rec;
+
+    if (!(alpha >= 0.0f) || (alpha > CALIBRATION_EC_ALPHA_MAX) ||
+        !(beta >= -CALIBRATION_EC_BETA_MAX) || (beta > CALIBRATION_EC_BETA_MAX))
+    {
+        return CALIBRATION_RSLT_BAD_VALUE;
+    }
+
+    calibration_snapshot(&rec);
+    rec.ec_alpha = alpha;
+    rec.ec_beta = beta;
+    return calibration_commit(&rec);
+}
+
+void calibration_ec_compensation_get(float *alpha, float *beta)
+{
+    calibration_record_t rec;
+
+    calibration_snapshot(&rec);
+    *alpha = rec.ec_alpha;
+    *beta = rec.ec_beta;
+}
+
+/******************************************************************************
+ * Function Name: calibration_flow_k
+ ******************************************************************************
+ * Summary:
+ *  Sets and saves the flow meter K-factor, pulses per litre x 100.
+ *
+ ******************************************************************************/
+cy_rslt_t calibration_flow_k(uint32_t pulses_per_litre_x100)
+{
+    calibration_record_t rec;
+
+    if (!flow_k_factor_set(pulses_per_litre_x100))
+    {
+        return CALIBRATION_RSLT_BAD_VALUE;
+    }
+
+    calibration_snapshot(&rec);
+    rec.flow_k = pulses_per_litre_x100;
+    return calibration_commit(&rec);
+}
+
+/******************************************************************************
+ * Function Name: calibration_clear
+ ******************************************************************************
+ * Summary:
+ *  Forgets the pH buffers and puts the EC cell constant and compensation
+ *  back to their defaults. The flow meter K-factor is kept.
+ *
+ ******************************************************************************/
+cy_rslt_t calibration_clear(void)
+{
+    calibration_record_t rec;
+
+    calibration_defaults(&rec);
+    rec.flow_k = cal.flow_k;
+    return calibration_commit(&rec);
+}
+
+/* [] END OF FILE */
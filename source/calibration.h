@@ -0,0 +1,84 @@
+/******************************************************************************
+* File Name:   calibration.h
+*
+* Description: This file is the public interface of calibration.c, which
+*              turns the probe millivolts into pH and EC at 25 C and keeps
+*              the calibration in internal flash.
+*
+* Related Document: See README.md
+*
+*******************************************************************************/
+
+#ifndef CALIBRATION_H_
+#define CALIBRATION_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "cyhal.h"
+
+/*******************************************************************************
+* Macros
+********************************************************************************/
+/* Two rows at the start of the auxiliary (EEPROM) flash, written in turn so
+ * a reset during a write leaves the previous calibration */
+#define CALIBRATION_FLASH_ADDR            (0x14000000u)
+#define CALIBRATION_FLASH_ROWS            (2u)
+#define CALIBRATION_ROW_MAX               (512u)
+
+/* pH buffers kept; a buffer within CALIBRATION_PH_SPACING of a kept one
+ * replaces it. One point sets the offset at the nominal slope, two set the
+ * slope, three set a slope each side of the middle buffer. */
+#define CALIBRATION_PH_POINTS             (3u)
+#define CALIBRATION_PH_SPACING            (0.5f)
+
+/* Front end: reading falls 59.16 mV per pH at 25 C. Slopes are scaled with
+ * absolute temperature about the isopotential point at pH 7. */
+#define CALIBRATION_PH_NOMINAL_SLOPE_MV   (-59.16f)
+#define CALIBRATION_PH_ISOPOTENTIAL       (7.0f)
+
+/* Front end: 1 mV per uS of conductance, so a K = 1.0 cell reads 1 mV per
+ * uS/cm. The cell constant is set from one standard solution. */
+#define CALIBRATION_EC_US_PER_MV          (1.0f)
+#define CALIBRATION_EC_CELL_DEFAULT       (1.0f)
+
+/* EC(T) = EC25 * (1 + alpha * (T - 25) + beta * (T - 25)^2). beta = 0 is
+ * the usual linear compensation, 1.9 %/C suits nutrient solutions. */
+#define CALIBRATION_EC_ALPHA_DEFAULT      (0.019f)
+#define CALIBRATION_EC_BETA_DEFAULT       (0.0f)
+
+/* Reference temperature, used when no probe reading is valid */
+#define CALIBRATION_REF_CDEG              (2500)
+
+/* Returned when the probe has not been read yet or reads too low */
+#define CALIBRATION_RSLT_NO_READING       ((cy_rslt_t)0x04A00401u)
+
+/* Returned for a buffer, standard or coefficient out of range */
+#define CALIBRATION_RSLT_BAD_VALUE        ((cy_rslt_t)0x04A00402u)
+
+/* Returned when the flash rows do not fit the record */
+#define CALIBRATION_RSLT_BAD_GEOMETRY     ((cy_rslt_t)0x04A00403u)
+
+/*******************************************************************************
+* Function Prototypes
+********************************************************************************/
+cy_rslt_t calibration_init(void);
+
+/* Conversions, from publisher_task, only once the probe has given a real
+ * reading. The readings are kept for the calibration commands, which fail
+ * with CALIBRATION_RSLT_NO_READING before the first one. 'temp_valid'
+ * false uses CALIBRATION_REF_CDEG. */
+bool calibration_ph(int32_t mv, bool temp_valid, int16_t temp_cdeg, int32_t *ph_milli);
+bool calibration_ec(int32_t mv, bool temp_valid, int16_t temp_cdeg, int32_t *ec_us);
+
+/* Commands, from subscriber_task. Each one saves the calibration. */
+cy_rslt_t calibration_ph_point(float ph, uint8_t *points);
+cy_rslt_t calibration_ec_standard(float ec_us);
+cy_rslt_t calibration_ec_compensation(float alpha, float beta);
+void calibration_ec_compensation_get(float *alpha, float *beta);
+cy_rslt_t calibration_flow_k(uint32_t pulses_per_litre_x100);
+cy_rslt_t calibration_clear(void);
+
+#endif /* CALIBRATION_H_ */
+
+/* [] END OF FILE */
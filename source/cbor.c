@@ -0,0 +1,504 @@
+/******************************************************************************
+* File Name:   cbor.c
+*
+* Description: This file contains a minimal CBOR (RFC 8949) encoder for the
+*              telemetry payloads and the decoder used for MQTT command
+*              payloads. Only definite-length items are produced or accepted.
+*
+* Related Document: See README.md
+*
+*******************************************************************************/
+
+#include <string.h>
+
+#include "cbor.h"
+
+/******************************************************************************
+* Macros
+******************************************************************************/
+#define CBOR_MAJOR_SHIFT                (5u)
+#define CBOR_INFO_MASK                  (0x1Fu)
+
+#define CBOR_INFO_UINT8                 (24u)
+#define CBOR_INFO_UINT16                (25u)
+#define CBOR_INFO_UINT32                (26u)
+#define CBOR_INFO_UINT64                (27u)
+
+#define CBOR_SIMPLE_FALSE               (20u)
+#define CBOR_SIMPLE_TRUE                (21u)
+#define CBOR_SIMPLE_NULL                (22u)
+#define CBOR_SIMPLE_FLOAT16             (25u)
+#define CBOR_SIMPLE_FLOAT32             (26u)
+#define CBOR_SIMPLE_FLOAT64             (27u)
+
+/******************************************************************************
+ * Encoder
+ ******************************************************************************/
+void cbor_writer_init(cbor_writer_t *w, uint8_t *buf, size_t size)
+{
+    w->buf = buf;
+    w->size = size;
+    w->len = 0;
+    w->overflow = false;
+}
+
+/* Encoded length, 0 if anything was dropped */
+size_t cbor_writer_length(const cbor_writer_t *w)
+{
+    return w->overflow ? 0 : w->len;
+}
+
+static void cbor_write(cbor_writer_t *w, const uint8_t *data, size_t len)
+{
+    if (w->overflow || (len > (w->size - w->len)))
+    {
+        w->overflow = true;
+        return;
+    }
+    memcpy(&w->buf[w->len], data, len);
+    w->len += len;
+}
+
+/******************************************************************************
+ * Function Name: cbor_put_head
+ ******************************************************************************
+ * Summary:
+ *  Writes the initial byte and argument of an item in its shortest form.
+ *
+ ******************************************************************************/
+static void cbor_put_head(cbor_writer_t *w, uint8_t major, uint64_t arg)
+{
+    uint8_t head[9];
+    size_t len;
+
+    major <<= CBOR_MAJOR_SHIFT;
+    if (arg < CBOR_INFO_UINT8)
+    {
+        head[0] = major | (uint8_t)arg;
+        len = 1;
+    }
+    else if (arg <= 0xFFu)
+    {
+        head[0] = major | CBOR_INFO_UINT8;
+        head[1] = (uint8_t)arg;
+        len = 2;
+    }
+    else if (arg <= 0xFFFFu)
+    {
+        head[0] = major | CBOR_INFO_UINT16;
+        head[1] = (uint8_t)(arg >> 8);
+        head[2] = (uint8_t)arg;
+        len = 3;
+    }
+    else if (arg <= 0xFFFFFFFFu)
+    {
+        head[0] = major | CBOR_INFO_UINT32;
+        for (size_t i = 0; i < 4u; i++)
+        {
+            head[1 + i] = (uint8_t)(arg >> (24u - (8u * i)));
+        }
+        len = 5;
+    }
+    else
+    {
+        head[0] = major | CBOR_INFO_UINT64;
+        for (size_t i = 0; i < 8u; i++)
+        {
+            head[1 + i] = (uint8_t)(arg >> (56u - (8u * i)));
+        }
+        len = 9;
+    }
+    cbor_write(w, head, len);
+}
+
+void cbor_put_uint(cbor_writer_t *w, uint64_t value)
+{
+    cbor_put_head(w, CBOR_TYPE_UINT, value);
+}
+
+void cbor_put_int(cbor_writer_t *w, int64_t value)
+{
+    if (value < 0)
+    {
+        /* -1 - n, computed without overflowing INT64_MIN */
+        cbor_put_head(w, CBOR_TYPE_NEGINT, (uint64_t)(-(value + 1)));
+    }
+    else
+    {
+        cbor_put_head(w, CBOR_TYPE_UINT, (uint64_t)value);
+    }
+}
+
+void cbor_put_bytes(cbor_writer_t *w, const uint8_t *data, size_t len)
+{
+    cbor_put_head(w, CBOR_TYPE_BYTES, len);
+    cbor_write(w, data, len);
+}
+
+void cbor_put_text(cbor_writer_t *w, const char *text, size_t len)
+{
+    cbor_put_head(w, CBOR_TYPE_TEXT, len);
+    cbor_write(w, (const uint8_t *)text, len);
+}
+
+void cbor_put_array(cbor_writer_t *w, size_t count)
+{
+    cbor_put_head(w, CBOR_TYPE_ARRAY, count);
+}
+
+void cbor_put_map(cbor_writer_t *w, size_t count)
+{
+    cbor_put_head(w, CBOR_TYPE_MAP, count);
+}
+
+void cbor_put_tag(cbor_writer_t *w, uint64_t tag)
+{
+    cbor_put_head(w, CBOR_TYPE_TAG, tag);
+}
+
+void cbor_put_bool(cbor_writer_t *w, bool value)
+{
+    cbor_put_head(w, CBOR_TYPE_SIMPLE, value ? CBOR_SIMPLE_TRUE : CBOR_SIMPLE_FALSE);
+}
+
+void cbor_put_null(cbor_writer_t *w)
+{
+    cbor_put_head(w, CBOR_TYPE_SIMPLE, CBOR_SIMPLE_NULL);
+}
+
+void cbor_put_float(cbor_writer_t *w, float value)
+{
+    uint8_t out[5];
+    uint32_t bits;
+
+    memcpy(&bits, &value, sizeof(bits));
+    out[0] = (uint8_t)((CBOR_TYPE_SIMPLE << CBOR_MAJOR_SHIFT) | CBOR_SIMPLE_FLOAT32);
+    out[1] = (uint8_t)(bits >> 24);
+    out[2] = (uint8_t)(bits >> 16);
+    out[3] = (uint8_t)(bits >> 8);
+    out[4] = (uint8_t)bits;
+    cbor_write(w, out, sizeof(out));
+}
+
+/******************************************************************************
+ * Decoder
+ ******************************************************************************/
+void cbor_reader_init(cbor_reader_t *r, const uint8_t *buf, size_t size)
+{
+    r->buf = buf;
+    r->size = size;
+    r->pos = 0;
+    r->error = false;
+}
+
+cbor_type_t cbor_peek_type(const cbor_reader_t *r)
+{
+    if (r->error || (r->pos >= r->size))
+    {
+        return CBOR_TYPE_INVALID;
+    }
+    return (cbor_type_t)(r->buf[r->pos] >> CBOR_MAJOR_SHIFT);
+}
+
+/******************************************************************************
+ * Function Name: cbor_get_head
+ ******************************************************************************
+ * Summary:
+ *  Reads the initial byte and argument of the next item. Indefinite lengths
+ *  and reserved encodings are treated as errors.
+ *
+ ******************************************************************************/
+static bool cbor_get_head(cbor_reader_t *r, uint8_t *major, uint8_t *info, uint64_t *arg)
+{
+    size_t extra;
+    uint8_t initial;
+
+    if (cbor_peek_type(r) == CBOR_TYPE_INVALID)
+    {
+        r->error = true;
+        return false;
+    }
+
+    initial = r->buf[r->pos++];
+    *major = initial >> CBOR_MAJOR_SHIFT;
+    *info = initial & CBOR_INFO_MASK;
+
+    if (*info < CBOR_INFO_UINT8)
+    {
+        *arg = *info;
+        return true;
+    }
+    if (*info > CBOR_INFO_UINT64)
+    {
+        r->error = true;
+        return false;
+    }
+
+    extra = (size_t)1u << (*info - CBOR_INFO_UINT8);
+    if (extra > (r->size - r->pos))
+    {
+        r->error = true;
+        return false;
+    }
+    *arg = 0;
+    for (size_t i = 0; i < extra; i++)
+    {
+        *arg = (*arg << 8) | r->buf[r->pos++];
+    }
+    return true;
+}
+
+static bool cbor_expect(cbor_reader_t *r, uint8_t expected, uint64_t *arg)
+{
+    uint8_t major;
+    uint8_t info;
+    size_t start = r->pos;
+
+    if (!cbor_get_head(r, &major, &info, arg))
+    {
+        return false;
+    }
+    if (major != expected)
+    {
+        r->pos = start;     /* Leave the item for the caller to skip */
+        return false;
+    }
+    return true;
+}
+
+bool cbor_get_uint(cbor_reader_t *r, uint64_t *value)
+{
+    return cbor_expect(r, CBOR_TYPE_UINT, value);
+}
+
+bool cbor_get_int(cbor_reader_t *r, int64_t *value)
+{
+    uint64_t arg;
+    cbor_type_t type = cbor_peek_type(r);
+
+    if ((type != CBOR_TYPE_UINT) && (type != CBOR_TYPE_NEGINT))
+    {
+        return false;
+    }
+    if (!cbor_expect(r, (uint8_t)type, &arg) || (arg > (uint64_t)INT64_MAX))
+    {
+        return false;
+    }
+    *value = (type == CBOR_TYPE_UINT) ? (int64_t)arg : (-1 - (int64_t)arg);
+    return true;
+}
+
+static bool cbor_get_string(cbor_reader_t *r, uint8_t major, const uint8_t **data, size_t *len)
+{
+    uint64_t arg;
+
+    if (!cbor_expect(r, major, &arg))
+    {
+        return false;
+    }
+    if (arg > (r->size - r->pos))
+    {
+        r->error = true;
+        return false;
+    }
+    *data = &r->buf[r->pos];
+    *len = (size_t)arg;
+    r->pos += (size_t)arg;
+    return true;
+}
+
+/* Not NUL terminated, the text stays in the input buffer */
+bool cbor_get_text(cbor_reader_t *r, const char **text, size_t *len)
+{
+    return cbor_get_string(r, CBOR_TYPE_TEXT, (const uint8_t **)text, len);
+}
+
+bool cbor_get_bytes(cbor_reader_t *r, const uint8_t **data, size_t *len)
+{
+    return cbor_get_string(r, CBOR_TYPE_BYTES, data, len);
+}
+
+bool cbor_get_array(cbor_reader_t *r, size_t *count)
+{
+    uint64_t arg;
+
+    if (!cbor_expect(r, CBOR_TYPE_ARRAY, &arg))
+    {
+        return false;
+    }
+    *count = (size_t)arg;
+    return true;
+}
+
+bool cbor_get_map(cbor_reader_t *r, size_t *count)
+{
+    uint64_t arg;
+
+    if (!cbor_expect(r, CBOR_TYPE_MAP, &arg))
+    {
+        return false;
+    }
+    *count = (size_t)arg;
+    return true;
+}
+
+bool cbor_get_bool(cbor_reader_t *r, bool *value)
+{
+    uint64_t arg;
+    size_t start = r->pos;
+
+    if (!cbor_expect(r, CBOR_TYPE_SIMPLE, &arg))
+    {
+        return false;
+    }
+    if ((arg != CBOR_SIMPLE_FALSE) && (arg != CBOR_SIMPLE_TRUE))
+    {
+        r->pos = start;
+        return false;
+    }
+    *value = (arg == CBOR_SIMPLE_TRUE);
+    return true;
+}
+
+/* IEEE 754 half precision bits to float, without libm */
+static float cbor_half_to_float(uint16_t half)
+{
+    uint32_t sign = (uint32_t)(half & 0x8000u) << 16;
+    uint32_t exponent = (half >> 10) & 0x1Fu;
+    uint32_t mantissa = half & 0x03FFu;
+    uint32_t bits;
+    float value;
+
+    if (exponent == 0u)
+    {
+        /* Zero and subnormals, mantissa * 2^-24 */
+        value = (float)mantissa * (1.0f / 16777216.0f);
+        return (sign != 0u) ? -value : value;
+    }
+    if (exponent == 0x1Fu)
+    {
+        bits = sign | 0x7F800000u | (mantissa << 13);      /* Inf, NaN */
+    }
+    else
+    {
+        bits = sign | ((exponent + (127u - 15u)) << 23) | (mantissa << 13);
+    }
+    memcpy(&value, &bits, sizeof(value));
+    return value;
+}
+
+/* Accepts float16, float32 and float64, narrowed to float, and integers,
+ * which senders often use for whole values. Common encoders pick the
+ * shortest float that holds the value exactly, or always float64. */
+bool cbor_get_float(cbor_reader_t *r, float *value)
+{
+    int64_t integer;
+    uint8_t major;
+    uint8_t info;
+    uint64_t arg;
+    uint32_t bits;
+    double wide;
+    size_t start = r->pos;
+
+    if (cbor_get_int(r, &integer))
+    {
+        *value = (float)integer;
+        return true;
+    }
+    if (!cbor_get_head(r, &major, &info, &arg))
+    {
+        return false;
+    }
+    if (major != CBOR_TYPE_SIMPLE)
+    {
+        r->pos = start;
+        return false;
+    }
+
+    switch (info)
+    {
+        case CBOR_SIMPLE_FLOAT16:
+        {
+            *value = cbor_half_to_float((uint16_t)arg);
+            return true;
+        }
+        case CBOR_SIMPLE_FLOAT32:
+        {
+            bits = (uint32_t)arg;
+            memcpy(value, &bits, sizeof(*value));
+            return true;
+        }
+        case CBOR_SIMPLE_FLOAT64:
+        {
+            memcpy(&wide, &arg, sizeof(wide));
+            *value = (float)wide;
+            return true;
+        }
+        default:
+        {
+            r->pos = start;
+            return false;
+        }
+    }
+}
+
+/******************************************************************************
+ * Function Name: cbor_skip_nested
+ ******************************************************************************
+ * Summary:
+ *  Skips one complete item, including the contents of arrays, maps and tags.
+ *
+ ******************************************************************************/
+static bool cbor_skip_nested(cbor_reader_t *r, uint32_t depth)
+{
+    uint8_t major;
+    uint8_t info;
+    uint64_t arg;
+
+    if ((depth > CBOR_MAX_NESTING) || !cbor_get_head(r, &major, &info, &arg))
+    {
+        r->error = true;
+        return false;
+    }
+
+    switch (major)
+    {
+        case CBOR_TYPE_BYTES:
+        case CBOR_TYPE_TEXT:
+            if (arg > (r->size - r->pos))
+            {
+                r->error = true;
+                return false;
+            }
+            r->pos += (size_t)arg;
+            return true;
+        case CBOR_TYPE_MAP:
+            if (arg > (r->size - r->pos))
+            {
+                r->error = true;
+                return false;
+            }
+            arg *= 2u;
+            /* fall through */
+        case CBOR_TYPE_ARRAY:
+            for (uint64_t i = 0; i < arg; i++)
+            {
+                if (!cbor_skip_nested(r, depth + 1u))
+                {
+                    return false;
+                }
+            }
+            return true;
+        case CBOR_TYPE_TAG:
+            return cbor_skip_nested(r, depth + 1u);
+        default:
+            return true;
+    }
+}
+
+bool cbor_skip(cbor_reader_t *r)
+{
+    return cbor_skip_nested(r, 0);
+}
+
+/* [] END OF FILE */
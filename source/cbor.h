@@ -0,0 +1,90 @@
+/******************************************************************************
+* File Name:   cbor.h
+*
+* Description: This file is the public interface of cbor.c, a streaming CBOR
+*              (RFC 8949) encoder and decoder that works in caller-owned
+*              buffers without heap allocation.
+*
+* Related Document: See README.md
+*
+*******************************************************************************/
+
+#ifndef CBOR_H_
+#define CBOR_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+/*******************************************************************************
+* Macros
+********************************************************************************/
+/* Deepest nesting cbor_skip() follows */
+#define CBOR_MAX_NESTING                  (8u)
+
+/*******************************************************************************
+* Global Variables
+********************************************************************************/
+/* Encoder state. Writes past 'size' set 'overflow' and are dropped. */
+typedef struct
+{
+    uint8_t *buf;
+    size_t size;
+    size_t len;
+    bool overflow;
+} cbor_writer_t;
+
+/* Decoder state. Malformed or truncated input sets 'error'. */
+typedef struct
+{
+    const uint8_t *buf;
+    size_t size;
+    size_t pos;
+    bool error;
+} cbor_reader_t;
+
+/* CBOR major types, plus CBOR_TYPE_INVALID at the end of input */
+typedef enum
+{
+    CBOR_TYPE_UINT = 0,
+    CBOR_TYPE_NEGINT,
+    CBOR_TYPE_BYTES,
+    CBOR_TYPE_TEXT,
+    CBOR_TYPE_ARRAY,
+    CBOR_TYPE_MAP,
+    CBOR_TYPE_TAG,
+    CBOR_TYPE_SIMPLE,
+    CBOR_TYPE_INVALID
+} cbor_type_t;
+
+/*******************************************************************************
+* Function Prototypes
+********************************************************************************/
+void cbor_writer_init(cbor_writer_t *w, uint8_t *buf, size_t size);
+size_t cbor_writer_length(const cbor_writer_t *w);
+void cbor_put_uint(cbor_writer_t *w, uint64_t value);
+void cbor_put_int(cbor_writer_t *w, int64_t value);
+void cbor_put_bytes(cbor_writer_t *w, const uint8_t *data, size_t len);
+void cbor_put_text(cbor_writer_t *w, const char *text, size_t len);
+void cbor_put_array(cbor_writer_t *w, size_t count);
+void cbor_put_map(cbor_writer_t *w, size_t count);
+void cbor_put_tag(cbor_writer_t *w, uint64_t tag);
+void cbor_put_bool(cbor_writer_t *w, bool value);
+void cbor_put_null(cbor_writer_t *w);
+void cbor_put_float(cbor_writer_t *w, float value);
+
+void cbor_reader_init(cbor_reader_t *r, const uint8_t *buf, size_t size);
+cbor_type_t cbor_peek_type(const cbor_reader_t *r);
+bool cbor_get_uint(cbor_reader_t *r, uint64_t *value);
+bool cbor_get_int(cbor_reader_t *r, int64_t *value);
+bool cbor_get_text(cbor_reader_t *r, const char **text, size_t *len);
+bool cbor_get_bytes(cbor_reader_t *r, const uint8_t **data, size_t *len);
+bool cbor_get_array(cbor_reader_t *r, size_t *count);
+bool cbor_get_map(cbor_reader_t *r, size_t *count);
+bool cbor_get_bool(cbor_reader_t *r, bool *value);
+bool cbor_get_float(cbor_reader_t *r, float *value);
+bool cbor_skip(cbor_reader_t *r);
+
+#endif /* CBOR_H_ */
+
+/* [] END OF FILE */
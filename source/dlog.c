@@ -0,0 +1,290 @@
+/******************************************************************************
+* File Name:   dlog.c
+*
+* Description: This file implements the deferred binary logger. Call sites
+*              store a message ID and up to DLOG_MAX_ARGS words in a lock-free
+*              ring, which takes a few dozen cycles and is safe from tasks and
+*              interrupts alike. dlog_task() runs below the MQTT tasks and
+*              sends the records as binary frames to the debug UART or to the
+*              per-device log topic, where tools/log_decode.c turns them back
+*              into text.
+*
+* Related Document: See README.md
+*
+*******************************************************************************/
+
+#include <stdio.h>
+#include <string.h>
+#include <stdbool.h>
+
+#include "cy_pdl.h"
+#include "cyhal.h"
+#include "cy_retarget_io.h"
+
+/* FreeRTOS header files */
+#include "FreeRTOS.h"
+#include "task.h"
+
+#include "dlog.h"
+
+#if (DLOG_SINK == DLOG_SINK_MQTT)
+#include "cy_mqtt_api.h"
+#include "mqtt_client_config.h"
+#include "mqtt_task.h"
+#include "telemetry.h"
+#endif /* (DLOG_SINK == DLOG_SINK_MQTT) */
+
+/******************************************************************************
+* Macros
+******************************************************************************/
+#define DLOG_RING_MASK                  (DLOG_RING_SLOTS - 1u)
+
+/* Frames are collected and written to the sink in one call */
+#define DLOG_TX_BUFFER_LEN              (256u)
+
+#if ((DLOG_RING_SLOTS & DLOG_RING_MASK) != 0u)
+#error "DLOG_RING_SLOTS must be a power of two"
+#endif
+
+/******************************************************************************
+* Global Variables
+*******************************************************************************/
+/* A slot is free for the producer claiming ring position 'pos' when its
+ * sequence equals pos, and holds a complete record for the consumer when it
+ * equals pos + 1. The sequence is written last, so a producer interrupted
+ * half way through a record only holds up the consumer, never corrupts it. */
+typedef struct
+{
+    uint32_t sequence;
+    uint32_t timestamp_ms;
+    uint8_t id;
+    uint8_t nargs;
+    uint32_t args[DLOG_MAX_ARGS];
+} dlog_slot_t;
+
+static dlog_slot_t ring[DLOG_RING_SLOTS];
+static uint32_t ring_head = 0;      /* Next position to claim, producers */
+static uint32_t ring_tail = 0;      /* Next position to read, dlog_task() */
+static uint32_t ring_dropped = 0;
+
+static uint8_t tx_buffer[DLOG_TX_BUFFER_LEN];
+static size_t tx_len = 0;
+
+#if (DLOG_SINK == DLOG_SINK_MQTT)
+static cy_mqtt_publish_info_t log_publish_info =
+{
+    .qos = CY_MQTT_QOS0,
+    .retain = false,
+    .dup = false
+};
+#endif /* (DLOG_SINK == DLOG_SINK_MQTT) */
+
+/******************************************************************************
+ * Function Name: dlog_init
+ ******************************************************************************
+ * Summary:
+ *  Marks every ring slot free. Called from main() before anything logs.
+ *
+ ******************************************************************************/
+void dlog_init(void)
+{
+    for (uint32_t i = 0; i < DLOG_RING_SLOTS; i++)
+    {
+        ring[i].sequence = i;
+    }
+    ring_head = 0;
+    ring_tail = 0;
+    ring_dropped = 0;
+    tx_len = 0;
+}
+
+/******************************************************************************
+ * Function Name: dlog_record
+ ******************************************************************************
+ * Summary:
+ *  Claims the next ring slot with a compare-and-swap and fills it. Use the
+ *  DLOG0() .. DLOG4() macros rather than calling this directly.
+ *
+ * Parameters:
+ *  dlog_id_t id : message, see dlog_messages.h
+ *  uint32_t nargs : number of words in 'args', at most DLOG_MAX_ARGS
+ *  const uint32_t *args : message arguments
+ *
+ * Return:
+ *  void
+ *
+ ******************************************************************************/
+void dlog_record(dlog_id_t id, uint32_t nargs, const uint32_t *args)
+{
+    dlog_slot_t *slot;
+    uint32_t pos = __atomic_load_n(&ring_head, __ATOMIC_RELAXED);
+
+    for (;;)
+    {
+        slot = &ring[pos & DLOG_RING_MASK];
+        int32_t lag = (int32_t)(__atomic_load_n(&slot->sequence, __ATOMIC_ACQUIRE) - pos);
+
+        if (lag == 0)
+        {
+            if (__atomic_compare_exchange_n(&ring_head, &pos, pos + 1u, true,
+                                            __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+            {
+                break;
+            }
+        }
+        else if (lag < 0)
+        {
+            /* Not yet read by dlog_task() */
+            __atomic_fetch_add(&ring_dropped, 1u, __ATOMIC_RELAXED);
+            return;
+        }
+        else
+        {
+            /* Claimed by an interrupt that preempted us */
+            pos = __atomic_load_n(&ring_head, __ATOMIC_RELAXED);
+        }
+    }
+
+    if (nargs > DLOG_MAX_ARGS)
+    {
+        nargs = DLOG_MAX_ARGS;
+    }
+    slot->timestamp_ms = xTaskGetTickCountFromISR() * portTICK_PERIOD_MS;
+    slot->id = (uint8_t)id;
+    slot->nargs = (uint8_t)nargs;
+    for (uint32_t i = 0; i < nargs; i++)
+    {
+        slot->args[i] = args[i];
+    }
+
+    __atomic_store_n(&slot->sequence, pos + 1u, __ATOMIC_RELEASE);
+}
+
+/* Writes 'value' little endian at 'out' */
+static uint8_t *dlog_put_u32(uint8_t *out, uint32_t value)
+{
+    out[0] = (uint8_t)value;
+    out[1] = (uint8_t)(value >> 8);
+    out[2] = (uint8_t)(value >> 16);
+    out[3] = (uint8_t)(value >> 24);
+    return out + 4;
+}
+
+/******************************************************************************
+ * Function Name: dlog_sink_flush
+ ******************************************************************************
+ * Summary:
+ *  Sends the collected frames to the sink. With the MQTT sink, frames made
+ *  while the broker is unreachable are discarded.
+ *
+ ******************************************************************************/
+static void dlog_sink_flush(void)
+{
+    if (tx_len == 0u)
+    {
+        return;
+    }
+
+#if (DLOG_SINK == DLOG_SINK_MQTT)
+    if (mqtt_connection != NULL)
+    {
+        log_publish_info.topic = telemetry_log_topic();
+        log_publish_info.topic_len = strlen(log_publish_info.topic);
+        log_publish_info.payload = (const char *)tx_buffer;
+        log_publish_info.payload_len = tx_len;
+        (void) cy_mqtt_publish(mqtt_connection, &log_publish_info);
+    }
+#else
+    size_t len = tx_len;
+    (void) cyhal_uart_write(&cy_retarget_io_uart_obj, tx_buffer, &len);
+#endif /* (DLOG_SINK == DLOG_SINK_MQTT) */
+
+    tx_len = 0;
+}
+
+/******************************************************************************
+ * Function Name: dlog_frame
+ ******************************************************************************
+ * Summary:
+ *  Appends one record to the transmit buffer as a frame, flushing first if
+ *  it does not fit.
+ *
+ ******************************************************************************/
+static void dlog_frame(uint8_t id, uint32_t timestamp_ms, uint32_t nargs, const uint32_t *args)
+{
+    uint8_t *frame;
+    uint8_t *out;
+    uint8_t sum = 0;
+
+    if ((tx_len + DLOG_FRAME_MAX_LEN) > sizeof(tx_buffer))
+    {
+        dlog_sink_flush();
+    }
+
+    frame = &tx_buffer[tx_len];
+    out = frame;
+    *out++ = DLOG_FRAME_SYNC;
+    *out++ = id;
+    *out++ = (uint8_t)nargs;
+    out = dlog_put_u32(out, timestamp_ms);
+    for (uint32_t i = 0; i < nargs; i++)
+    {
+        out = dlog_put_u32(out, args[i]);
+    }
+    for (uint8_t *p = frame + 1; p < out; p++)
+    {
+        sum += *p;
+    }
+    *out++ = (uint8_t)(0u - sum);
+
+    tx_len += (size_t)(out - frame);
+}
+
+/******************************************************************************
+ * Function Name: dlog_task
+ ******************************************************************************
+ * Summary:
+ *  Drains the ring every DLOG_DRAIN_PERIOD_MS. Records are read in the order
+ *  their slots were claimed, and a DLOG_MSG_DROPPED frame reports records
+ *  lost to a full ring since the last pass.
+ *
+ * Parameters:
+ *  void *pvParameters : Task parameter defined during task creation (unused)
+ *
+ * Return:
+ *  void
+ *
+ ******************************************************************************/
+void dlog_task(void *pvParameters)
+{
+    (void) pvParameters;
+
+    while (true)
+    {
+        for (;;)
+        {
+            dlog_slot_t *slot = &ring[ring_tail & DLOG_RING_MASK];
+
+            if (__atomic_load_n(&slot->sequence, __ATOMIC_ACQUIRE) != (ring_tail + 1u))
+            {
+                break;
+            }
+            dlog_frame(slot->id, slot->timestamp_ms, slot->nargs, slot->args);
+
+            /* Hand the slot back for the position one lap ahead */
+            __atomic_store_n(&slot->sequence, ring_tail + DLOG_RING_SLOTS, __ATOMIC_RELEASE);
+            ring_tail++;
+        }
+
+        uint32_t dropped = __atomic_exchange_n(&ring_dropped, 0u, __ATOMIC_RELAXED);
+        if (dropped > 0u)
+        {
+            dlog_frame(DLOG_MSG_DROPPED, xTaskGetTickCount() * portTICK_PERIOD_MS, 1u, &dropped);
+        }
+
+        dlog_sink_flush();
+        vTaskDelay(pdMS_TO_TICKS(DLOG_DRAIN_PERIOD_MS));
+    }
+}
+
+/* [] END OF FILE */
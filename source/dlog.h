@@ -0,0 +1,65 @@
+/******************************************************************************
+* File Name:   dlog.h
+*
+* Description: This file is the public interface of dlog.c, the deferred
+*              binary logger.
+*
+* Related Document: See README.md
+*
+*******************************************************************************/
+
+#ifndef DLOG_H_
+#define DLOG_H_
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include "dlog_messages.h"
+
+/*******************************************************************************
+* Macros
+********************************************************************************/
+/* Where dlog_task() sends the frames */
+#define DLOG_SINK_UART                  (0u)    /* retarget-io debug UART */
+#define DLOG_SINK_MQTT                  (1u)    /* "hydro/<id>/log" topic */
+
+#ifndef DLOG_SINK
+#define DLOG_SINK                       DLOG_SINK_UART
+#endif
+
+/* Ring slots, a power of two. One slot holds one record. */
+#define DLOG_RING_SLOTS                 (64u)
+#define DLOG_MAX_ARGS                   (4u)
+
+/* Below the MQTT tasks, the log is drained when nothing else runs */
+#define DLOG_TASK_PRIORITY              (1)
+#define DLOG_TASK_STACK_SIZE            (1024 * 1)
+#define DLOG_DRAIN_PERIOD_MS            (20u)
+
+/* Frame on the sink, little endian:
+ *  sync, id, argument count, timestamp ms (4), arguments (4 each), checksum
+ * The checksum makes the sum of every byte after the sync zero. */
+#define DLOG_FRAME_SYNC                 (0xA5u)
+#define DLOG_FRAME_HEADER_LEN           (7u)
+#define DLOG_FRAME_MAX_LEN              (DLOG_FRAME_HEADER_LEN + (DLOG_MAX_ARGS * 4u) + 1u)
+
+/* Records a message from any task or interrupt. Never blocks; the record is
+ * dropped and counted when the ring is full. */
+#define DLOG0(id)                       dlog_record((id), 0u, NULL)
+#define DLOG1(id, a)                    dlog_record((id), 1u, (const uint32_t[]){ (uint32_t)(a) })
+#define DLOG2(id, a, b)                 dlog_record((id), 2u, (const uint32_t[]){ (uint32_t)(a), (uint32_t)(b) })
+#define DLOG3(id, a, b, c)              dlog_record((id), 3u, (const uint32_t[]){ (uint32_t)(a), (uint32_t)(b), \
+                                                                              (uint32_t)(c) })
+#define DLOG4(id, a, b, c, d)           dlog_record((id), 4u, (const uint32_t[]){ (uint32_t)(a), (uint32_t)(b), \
+                                                                              (uint32_t)(c), (uint32_t)(d) })
+
+/*******************************************************************************
+* Function Prototypes
+********************************************************************************/
+void dlog_init(void);
+void dlog_record(dlog_id_t id, uint32_t nargs, const uint32_t *args);
+void dlog_task(void *pvParameters);
+
+#endif /* DLOG_H_ */
+
+/* [] END OF FILE */
@@ -0,0 +1,77 @@
+/******************************************************************************
+* File Name:   dlog_messages.h
+*
+* Description: This file lists the deferred log messages. The firmware only
+*              stores the message ID and the arguments; the format strings
+*              are used by the host decoder, tools/log_decode.c.
+*
+* Related Document: See README.md
+*
+*******************************************************************************/
+
+#ifndef DLOG_MESSAGES_H_
+#define DLOG_MESSAGES_H_
+
+/*******************************************************************************
+* Macros
+********************************************************************************/
+/* X(ID, format). Every argument is a 32-bit word, so conversions are limited
+ * to %d %i %u %x %X %c with optional flags and width. The ID is the position
+ * in this list: append new messages at the end and never reorder, or logs
+ * captured from older firmware decode with the wrong text. */
+#define DLOG_MESSAGES(X) \
+    X(DLOG_MSG_DROPPED,                 "Log: %u records dropped.\n") \
+    X(DLOG_MSG_ADC_SAMPLE_FAILED,       "ADC sample failed. Error: 0x%08X\n") \
+    X(DLOG_MSG_JOURNAL_DRAINING,        "\nPublisher: Draining %u journalled frames.\n") \
+    X(DLOG_MSG_BATCH_TOO_LARGE,         "  Publisher: Telemetry batch did not fit the payload buffer.\n") \
+    X(DLOG_MSG_PUBLISH_FAILED,          "  Publisher: MQTT Publish failed with error 0x%0X.\n\n") \
+    X(DLOG_MSG_JOURNAL_APPEND_FAILED,   "  Publisher: Journal append failed with error 0x%0X.\n") \
+    X(DLOG_MSG_DIAG_PUBLISH_FAILED,     "  Publisher: Diagnostics publish failed with error 0x%0X.\n") \
+    X(DLOG_MSG_MESSAGE_RECEIVED,        "  \nSubsciber: Incoming MQTT message received:\n" \
+                                        "    Publish topic length: %u\n" \
+                                        "    Publish QoS: %d\n" \
+                                        "    Publish payload length: %u\n") \
+    X(DLOG_MSG_PUMP_SECONDS,            "\nPump for %u seconds.") \
+    X(DLOG_MSG_PUMP_INVALID,            "\nSubscriber: Invalid pump time.\n") \
+    X(DLOG_MSG_DOSE_A_MS,               "\nDose pump A for %u ms.") \
+    X(DLOG_MSG_COMMAND_NOT_MAP,         "\nSubscriber: Command payload is not a CBOR map.\n") \
+    X(DLOG_MSG_COMMAND_MALFORMED,       "\nSubscriber: Malformed command payload.\n") \
+    X(DLOG_MSG_HEAP_PUBLISHER,          "publisher_task: After publishing an MQTT message, heap " \
+                                        "in use %u bytes, peak %u of %u bytes\n") \
+    X(DLOG_MSG_HEAP_SUBSCRIPTION,       "MQTT subscription callback, heap " \
+                                        "in use %u bytes, peak %u of %u bytes\n") \
+    X(DLOG_MSG_HEAP_SUBSCRIBER,         "subscriber_task: After updating LED state, heap " \
+                                        "in use %u bytes, peak %u of %u bytes\n") \
+    X(DLOG_MSG_TEMP_BITS,               "\nTemperature resolution %u bits.") \
+    X(DLOG_MSG_FLOW_K,                  "\nFlow K-factor %u pulses/L x 100.") \
+    X(DLOG_MSG_DOSING_SETPOINT,         "\nDosing loop %u setpoint %u mV.") \
+    X(DLOG_MSG_DOSING_DOSE,             "\nDosing loop %u dosed %u ms at %d mV.") \
+    X(DLOG_MSG_PUMP_CONTROLLED,         "\nSubscriber: Pump %u is run by a dosing loop.\n") \
+    X(DLOG_MSG_CAL_PH,                  "\nCalibration: pH %u/1000 buffer taken, %u buffers.") \
+    X(DLOG_MSG_CAL_EC,                  "\nCalibration: EC cell constant set from %u uS/cm.") \
+    X(DLOG_MSG_CAL_EC_TC,               "\nCalibration: EC compensation %d/1000000 per C, %d/1000000 per C^2.") \
+    X(DLOG_MSG_CAL_CLEAR,               "\nCalibration: Probe calibration cleared.") \
+    X(DLOG_MSG_CAL_FAILED,              "\nCalibration: Command failed. Error: 0x%08X\n") \
+    X(DLOG_MSG_PROBE_WINDOW,            "\nProbe %u window %u ms.") \
+    X(DLOG_MSG_PUBLISH_ADAPTIVE,        "\nAdaptive telemetry rate %u.") \
+    X(DLOG_MSG_REPORT_BAND,             "\nReport deadband %u set to %u.") \
+    X(DLOG_MSG_REPORT_BAND_PCT,         "\nReport deadband %u set to %u/10 %%.") \
+    X(DLOG_MSG_REPORT_SILENCE,          "\nReport silence limit %u s.") \
+    X(DLOG_MSG_DOSING_SETPOINT_CAL,     "\nDosing loop %u setpoint %u (pH x 1000 or uS/cm).") \
+    X(DLOG_MSG_WIRE_PROBE_ROM,          "\nProbe %u: ROM %08X%08X.") \
+    X(DLOG_MSG_WIRE_PROBE_TEMP,         "\nTemperature %u: %d/100 C.")
+
+#define DLOG_MESSAGE_ENUM(id, format)   id,
+
+/*******************************************************************************
+* Global Variables
+********************************************************************************/
+typedef enum
+{
+    DLOG_MESSAGES(DLOG_MESSAGE_ENUM)
+    DLOG_MSG_COUNT
+} dlog_id_t;
+
+#endif /* DLOG_MESSAGES_H_ */
+
+/* [] END OF FILE */
@@ -0,0 +1,340 @@
+/******************************************************************************
+* File Name:   dosing_control.c
+*
+* Description: This file contains the closed pH and EC dosing loops. Each
+*              loop runs on every sample its probe gives while powered, so
+*              a correction follows within one sampling period instead of a
+*              round trip through the broker. Commands only set the
+*              setpoints; the doses are decided here.
+*
+*              A loop is a PI controller with derivative on the reading,
+*              giving a dose in ms. The pumps can only add, so the output
+*              and the integral are held between 0 and the largest dose,
+*              and the integral stops while the output is saturated.
+*
+*              The loops act on the calibrated pH and temperature
+*              compensated EC once the probe has a calibration, and on the
+*              probe millivolts until then, each with its own setpoint.
+*              Calibrated readings are scaled to the nominal front end's
+*              millivolts so the gains and deadbands serve both.
+*
+*              A dose takes a while to mix in, and until then the probes
+*              still read the old value. After each dose both loops skip
+*              their samples for DOSING_MIX_DELAY_MS, so the integral does
+*              not wind up on error the dose has already answered.
+*
+* Related Document: See README.md
+*
+*******************************************************************************/
+
+#include "cyhal.h"
+
+/* FreeRTOS header files */
+#include "FreeRTOS.h"
+#include "task.h"
+
+#include "dosing_control.h"
+#include "pump_scheduler.h"
+#include "dlog.h"
+
+/******************************************************************************
+* Global Variables
+*******************************************************************************/
+typedef struct
+{
+    pump_id_t pump;
+    bool dose_raises;           /* Dosing raises the reading */
+    float kp;
+    float ki;
+    float kd;
+    int32_t deadband_mv;
+    uint32_t dose_max_ms;
+    float mv_per_unit;          /* Front end mV per calibrated unit */
+    uint32_t setpoint_max;      /* Calibrated units */
+} dosing_loop_cfg_t;
+
+typedef struct
+{
+    volatile uint32_t setpoint_mv;  /* 0 while off, written by commands */
+    volatile uint32_t setpoint_cal; /* pH x 1000 or uS/cm, 0 while off */
+    uint32_t running_setpoint;      /* Setpoint the state below belongs to */
+    bool running_calibrated;
+    float integral_ms;
+    int32_t last_mv;
+    uint32_t last_ms;
+    bool last_valid;
+} dosing_loop_state_t;
+
+static const dosing_loop_cfg_t loop_cfg[DOSING_LOOP_COUNT] =
+{
+    [DOSING_LOOP_PH] =
+    {
+        .pump = DOSING_PH_PUMP,
+        .dose_raises = true,
+        .kp = DOSING_PH_KP,
+        .ki = DOSING_PH_KI,
+        .kd = DOSING_PH_KD,
+        .deadband_mv = DOSING_PH_DEADBAND_MV,
+        .dose_max_ms = DOSING_PH_DOSE_MAX_MS,
+        .mv_per_unit = DOSING_PH_MV_PER_UNIT,
+        .setpoint_max = DOSING_PH_SETPOINT_MAX
+    },
+    [DOSING_LOOP_EC] =
+    {
+        .pump = DOSING_EC_PUMP,
+        .dose_raises = true,
+        .kp = DOSING_EC_KP,
+        .ki = DOSING_EC_KI,
+        .kd = DOSING_EC_KD,
+        .deadband_mv = DOSING_EC_DEADBAND_MV,
+        .dose_max_ms = DOSING_EC_DOSE_MAX_MS,
+        .mv_per_unit = DOSING_EC_MV_PER_UNIT,
+        .setpoint_max = DOSING_EC_SETPOINT_MAX
+    }
+};
+
+static dosing_loop_state_t loop_state[DOSING_LOOP_COUNT];
+
+/* End of the mixing dead time after the last dose, in sample time */
+static uint32_t hold_until_ms = 0;
+static bool hold_active = false;
+
+/******************************************************************************
+ * Function Name: dosing_control_update
+ ******************************************************************************
+ * Summary:
+ *  Runs one step of a loop on a fresh probe reading and starts a dose when
+ *  the output is large enough. Called by publisher_task only, with the
+ *  sample's timestamp.
+ *
+ * Parameters:
+ *  dosing_loop_t loop : loop the reading belongs to
+ *  int32_t mv : probe reading in millivolts
+ *  bool calibrated : 'value' holds the calibrated reading
+ *  int32_t value : pH x 1000 or uS/cm at 25 C
+ *  uint32_t timestamp_ms : RTOS time the sample completed
+ *
+ * Return:
+ *  void
+ *
+ ******************************************************************************/
+void dosing_control_update(dosing_loop_t loop, int32_t mv, bool calibrated, int32_t value,
+                           uint32_t timestamp_ms)
+{
+    const dosing_loop_cfg_t *cfg;
+    dosing_loop_state_t *state;
+    uint32_t setpoint;
+    int32_t setpoint_mv;
+    int32_t reading_mv;
+    int32_t error_mv;
+    float dt_s = 0.0f;
+    float slope = 0.0f;
+    float integral;
+    float output;
+
+    if (loop >= DOSING_LOOP_COUNT)
+    {
+        return;
+    }
+    cfg = &loop_cfg[loop];
+    state = &loop_state[loop];
+
+    /* A new setpoint, or a change between mV and calibrated units, starts
+     * the loop from rest */
+    setpoint = calibrated ? state->setpoint_cal : state->setpoint_mv;
+    if ((setpoint != state->running_setpoint) || (calibrated != state->running_calibrated))
+    {
+        state->running_setpoint = setpoint;
+        state->running_calibrated = calibrated;
+        state->integral_ms = 0.0f;
+        state->last_valid = false;
+    }
+    if (setpoint == 0u)
+    {
+        return;
+    }
+
+    if (calibrated)
+    {
+        reading_mv = (int32_t)((float)value * cfg->mv_per_unit);
+        setpoint_mv = (int32_t)((float)setpoint * cfg->mv_per_unit);
+    }
+    else
+    {
+        reading_mv = mv;
+        setpoint_mv = (int32_t)setpoint;
+    }
+
+    if (hold_active)
+    {
+        if ((int32_t)(timestamp_ms - hold_until_ms) < 0)
+        {
+            state->last_valid = false;
+            return;
+        }
+        hold_active = false;
+    }
+
+    error_mv = cfg->dose_raises ? (setpoint_mv - reading_mv) : (reading_mv - setpoint_mv);
+    if ((error_mv < cfg->deadband_mv) && (error_mv > -cfg->deadband_mv))
+    {
+        error_mv = 0;
+    }
+
+    if (state->last_valid)
+    {
+        uint32_t dt_ms = timestamp_ms - state->last_ms;
+
+        dt_s = (float)((dt_ms > DOSING_DT_MAX_MS) ? DOSING_DT_MAX_MS : dt_ms) / 1000.0f;
+        if (dt_ms > 0u)
+        {
+            /* Change of the error from the reading alone, so a setpoint
+             * step does not kick the output */
+            slope = (float)(state->last_mv - reading_mv) * 1000.0f / (float)dt_ms;
+            if (!cfg->dose_raises)
+            {
+                slope = -slope;
+            }
+        }
+    }
+    state->last_mv = reading_mv;
+    state->last_ms = timestamp_ms;
+    state->last_valid = true;
+
+    /* Conditional integration: keep the new integral only if the output
+     * is not saturated, or if it moves the output back into range */
+    integral = state->integral_ms + (cfg->ki * (float)error_mv * dt_s);
+    if (integral < 0.0f)
+    {
+        integral = 0.0f;
+    }
+    else if (integral > (float)cfg->dose_max_ms)
+    {
+        integral = (float)cfg->dose_max_ms;
+    }
+
+    output = (cfg->kp * (float)error_mv) + integral + (cfg->kd * slope);
+    if (((output < (float)cfg->dose_max_ms) || (error_mv < 0)) &&
+        ((output > 0.0f) || (error_mv > 0)))
+    {
+        state->integral_ms = integral;
+    }
+    else
+    {
+        output = (cfg->kp * (float)error_mv) + state->integral_ms + (cfg->kd * slope);
+    }
+
+    if (output > (float)cfg->dose_max_ms)
+    {
+        output = (float)cfg->dose_max_ms;
+    }
+    if (output < (float)DOSING_DOSE_MIN_MS)
+    {
+        return;
+    }
+
+    if (pump_run(cfg->pump, (uint32_t)output) == CY_RSLT_SUCCESS)
+    {
+        hold_until_ms = timestamp_ms + (uint32_t)output + DOSING_MIX_DELAY_MS;
+        hold_active = true;
+        state->last_valid = false;
+        DLOG3(DLOG_MSG_DOSING_DOSE, loop, (uint32_t)output, mv);
+    }
+}
+
+/******************************************************************************
+ * Function Name: dosing_setpoint_set
+ ******************************************************************************
+ * Summary:
+ *  Sets a loop's setpoint in probe millivolts from a command, used while
+ *  the probe is not calibrated. The loop picks it up with its next sample.
+ *  Turning a loop off stops its pump.
+ *
+ * Parameters:
+ *  dosing_loop_t loop : loop to set
+ *  uint32_t setpoint_mv : probe reading to hold, 0 turns the loop off
+ *
+ * Return:
+ *  bool : false for an unknown loop or a setpoint out of range
+ *
+ ******************************************************************************/
+bool dosing_setpoint_set(dosing_loop_t loop, uint32_t setpoint_mv)
+{
+    if ((loop >= DOSING_LOOP_COUNT) || (setpoint_mv > DOSING_SETPOINT_MAX_MV))
+    {
+        return false;
+    }
+
+    loop_state[loop].setpoint_mv = setpoint_mv;
+    if (setpoint_mv == 0u)
+    {
+        pump_stop(loop_cfg[loop].pump);
+    }
+    return true;
+}
+
+/******************************************************************************
+ * Function Name: dosing_setpoint_calibrated_set
+ ******************************************************************************
+ * Summary:
+ *  Sets a loop's setpoint in calibrated units from a command, used once
+ *  the probe has a calibration.
+ *
+ * Parameters:
+ *  dosing_loop_t loop : loop to set
+ *  uint32_t setpoint : pH x 1000 or uS/cm at 25 C, 0 turns the loop off
+ *
+ * Return:
+ *  bool : false for an unknown loop or a setpoint out of range
+ *
+ ******************************************************************************/
+bool dosing_setpoint_calibrated_set(dosing_loop_t loop, uint32_t setpoint)
+{
+    if ((loop >= DOSING_LOOP_COUNT) || (setpoint > loop_cfg[loop].setpoint_max))
+    {
+        return false;
+    }
+
+    loop_state[loop].setpoint_cal = setpoint;
+    if (setpoint == 0u)
+    {
+        pump_stop(loop_cfg[loop].pump);
+    }
+    return true;
+}
+
+/******************************************************************************
+ * Function Name: dosing_control_owns
+ ******************************************************************************
+ * Summary:
+ *  Tells whether a running loop doses through 'pump', in which case manual
+ *  pump commands are refused.
+ *
+ ******************************************************************************/
+bool dosing_control_owns(pump_id_t pump)
+{
+    for (uint32_t loop = 0; loop < DOSING_LOOP_COUNT; loop++)
+    {
+        if ((loop_cfg[loop].pump == pump) &&
+            ((loop_state[loop].setpoint_mv != 0u) || (loop_state[loop].setpoint_cal != 0u)))
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+/******************************************************************************
+ * Function Name: dosing_control_mixing
+ ******************************************************************************
+ * Summary:
+ *  Tells whether a dose is still running or mixing in at 'timestamp_ms',
+ *  the same clock as the readings passed to dosing_control_update().
+ *
+ ******************************************************************************/
+bool dosing_control_mixing(uint32_t timestamp_ms)
+{
+    return hold_active && ((int32_t)(timestamp_ms - hold_until_ms) < 0);
+}
+
+/* [] END OF FILE */
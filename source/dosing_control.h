@@ -0,0 +1,96 @@
+/******************************************************************************
+* File Name:   dosing_control.h
+*
+* Description: This file is the public interface of dosing_control.c, the
+*              closed pH and EC dosing loops run on the probe samples taken
+*              by publisher_task.
+*
+* Related Document: See README.md
+*
+*******************************************************************************/
+
+#ifndef DOSING_CONTROL_H_
+#define DOSING_CONTROL_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "pump_scheduler.h"
+#include "calibration.h"
+
+/*******************************************************************************
+* Macros
+********************************************************************************/
+/* Pump each loop doses through. The pH front end reads lower as pH rises,
+ * so pH down raises the pH probe voltage; nutrient raises the EC probe
+ * voltage. */
+#define DOSING_PH_PUMP                    (PUMP_MAIN)
+#define DOSING_EC_PUMP                    (PUMP_DOSE_A)
+
+/* Gains on the error in mV, giving a dose in ms. Ki is per second of
+ * error, Kd per mV/s change of the reading. Calibrated readings are scaled
+ * to the mV of the nominal front end first, so the same gains apply. */
+#define DOSING_PH_KP                      (20.0f)
+#define DOSING_PH_KI                      (0.5f)
+#define DOSING_PH_KD                      (0.0f)
+#define DOSING_EC_KP                      (4.0f)
+#define DOSING_EC_KI                      (0.1f)
+#define DOSING_EC_KD                      (0.0f)
+
+/* Errors smaller than this are treated as on target, above probe noise */
+#define DOSING_PH_DEADBAND_MV             (6)
+#define DOSING_EC_DEADBAND_MV             (20)
+
+/* Largest dose per step; the integral is held to the same range */
+#define DOSING_PH_DOSE_MAX_MS             (2000u)
+#define DOSING_EC_DOSE_MAX_MS             (5000u)
+
+/* Smaller doses are not worth a pump start and are left to the integral */
+#define DOSING_DOSE_MIN_MS                (100u)
+
+/* Dead time after a dose until it has mixed into the reservoir and shows
+ * at the probes. Both loops wait, the tank is shared. */
+#define DOSING_MIX_DELAY_MS               (60u * 1000u)
+
+/* Longest sample interval integrated, covers the other probe's turn */
+#define DOSING_DT_MAX_MS                  (2000u)
+
+/* Nominal front end mV per calibrated unit, pH x 1000 and uS/cm */
+#define DOSING_PH_MV_PER_UNIT             (CALIBRATION_PH_NOMINAL_SLOPE_MV / 1000.0f)
+#define DOSING_EC_MV_PER_UNIT             (1.0f / CALIBRATION_EC_US_PER_MV)
+
+/* Highest setpoints accepted: the ADC full scale, and in calibrated units */
+#define DOSING_SETPOINT_MAX_MV            (3300u)
+#define DOSING_PH_SETPOINT_MAX            (14000u)
+#define DOSING_EC_SETPOINT_MAX            (10000u)
+
+/*******************************************************************************
+* Global Variables
+********************************************************************************/
+typedef enum
+{
+    DOSING_LOOP_PH = 0,
+    DOSING_LOOP_EC,
+    DOSING_LOOP_COUNT
+} dosing_loop_t;
+
+/*******************************************************************************
+* Function Prototypes
+********************************************************************************/
+/* 'value' is the calibrated reading, pH x 1000 or uS/cm at 25 C, when
+ * 'calibrated' is true. The loop holds the calibrated setpoint then, and
+ * the mV setpoint only while the probe is not calibrated. */
+void dosing_control_update(dosing_loop_t loop, int32_t mv, bool calibrated, int32_t value,
+                           uint32_t timestamp_ms);
+
+/* A setpoint of 0 leaves the loop off in those units and stops its pump */
+bool dosing_setpoint_set(dosing_loop_t loop, uint32_t setpoint_mv);
+bool dosing_setpoint_calibrated_set(dosing_loop_t loop, uint32_t setpoint);
+bool dosing_control_owns(pump_id_t pump);
+
+/* True from a dose until DOSING_MIX_DELAY_MS after it ends */
+bool dosing_control_mixing(uint32_t timestamp_ms);
+
+#endif /* DOSING_CONTROL_H_ */
+
+/* [] END OF FILE */
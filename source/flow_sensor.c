@@ -5,4 +5,247 @@
  *      Author: obpki
  */
 
+#include <stdio.h>
 
+#include "cy_pdl.h"
+#include "cyhal.h"
+
+/* FreeRTOS header files */
+#include "FreeRTOS.h"
+#include "task.h"
+
+#include "macros.h"
+#include "functions.h"
+#include "timer_service.h"
+
+/* Full 16-bit period, so both counters wrap the same way whichever
+ * counter width the HAL allocates */
+#define FLOW_COUNTER_PERIOD     (0xFFFFu)
+#define FLOW_COUNTER_SHIFT      (16u)
+
+#define FLOW_IRQ_PRIORITY       (7u)
+
+/* Capture mode is left above FLOW_CAPTURE_MAX_HZ and entered again below
+ * 3/4 of it, so a flow near the limit does not toggle it every tick */
+#define FLOW_CAPTURE_ENTER_HZ   ((FLOW_CAPTURE_MAX_HZ * 3u) / 4u)
+
+static cyhal_timer_t flow_count_timer;      //Counts FLOW_PIN rising edges
+static cyhal_timer_t flow_capture_timer;    //Captures the time of each edge
+
+static uint32_t k_factor = FLOW_K_FACTOR;   //Pulses per litre x 100
+static uint32_t count_last = 0;
+static uint64_t pulses_total = 0;
+static uint64_t window_start_us = 0;
+static uint32_t rate_mlpm = 0;
+static bool capture_mode = false;
+
+//Written by isr_flow_capture, read and reset by flow_sensor_update
+static volatile uint32_t capture_epoch = 0;
+static uint64_t capture_last = 0;           //Last pulse, capture clock ticks
+static bool capture_last_valid = false;
+static TickType_t capture_last_tick = 0;
+static uint32_t capture_period = 0;         //Between the last two pulses
+static uint64_t capture_sum = 0;            //Periods completed this window
+static uint32_t capture_periods = 0;
+
+//isr_flow_capture
+//Extends the capture counter and records the period ending at each
+//captured pulse. A capture taken just after a wrap that is handled in the
+//same interrupt belongs to the new counter period.
+static void isr_flow_capture(void *callback_arg, cyhal_timer_event_t event){
+    uint32_t epoch = capture_epoch;
+
+    (void) callback_arg;
+
+    if ((event & CYHAL_TIMER_IRQ_CAPTURE_COMPARE) != 0u){
+        uint32_t value = Cy_TCPWM_Counter_GetCapture0Val(flow_capture_timer.tcpwm.base,
+                                                         flow_capture_timer.tcpwm.resource.channel_num);
+        if (((event & CYHAL_TIMER_IRQ_TERMINAL_COUNT) != 0u) && (value < (FLOW_COUNTER_PERIOD / 2u))){
+            epoch++;
+        }
+
+        uint64_t now = ((uint64_t)epoch << FLOW_COUNTER_SHIFT) | value;
+        if (capture_last_valid){
+            uint64_t period = now - capture_last;
+
+            capture_period = (period > UINT32_MAX) ? UINT32_MAX : (uint32_t)period;
+            capture_sum += period;
+            capture_periods++;
+        }
+        capture_last = now;
+        capture_last_valid = true;
+        capture_last_tick = xTaskGetTickCountFromISR();
+    }
+
+    if ((event & CYHAL_TIMER_IRQ_TERMINAL_COUNT) != 0u){
+        capture_epoch++;
+    }
+}
+
+//flow_capture_enable
+//Switches the per-pulse capture interrupt on or off. The first pulse after
+//switching on only starts a period.
+static void flow_capture_enable(bool enable){
+    taskENTER_CRITICAL();
+    capture_last_valid = false;
+    capture_period = 0;
+    capture_sum = 0;
+    capture_periods = 0;
+    taskEXIT_CRITICAL();
+
+    cyhal_timer_enable_event(&flow_capture_timer, CYHAL_TIMER_IRQ_CAPTURE_COMPARE, FLOW_IRQ_PRIORITY, enable);
+    capture_mode = enable;
+}
+
+//flow_mlpm
+//mL/min for 'pulses' pulses in 'ticks' of a clock at 'hz'.
+static uint32_t flow_mlpm(uint64_t pulses, uint64_t ticks, uint32_t hz){
+    uint64_t mlpm;
+
+    if ((ticks == 0) || (k_factor == 0)){return 0;}
+    mlpm = (pulses * hz * 60u * 1000u * 100u) / (ticks * k_factor);
+    return (mlpm > UINT32_MAX) ? UINT32_MAX : (uint32_t)mlpm;
+}
+
+//flow_sensor_init
+//Routes FLOW_PIN to a TCPWM counter that counts its rising edges, and to a
+//free-running counter that captures their times. Called from gpio_init()
+//after FLOW_PIN is configured, and after timer_init().
+void flow_sensor_init(void){
+    cy_rslt_t result;
+    cyhal_source_t flow_source;
+
+    const cyhal_timer_cfg_t flow_count_cfg =
+    {
+        .compare_value = 0,                 /* Timer compare value, not used */
+        .period = FLOW_COUNTER_PERIOD,
+        .direction = CYHAL_TIMER_DIR_UP,    /* Timer counts up */
+        .is_compare = false,                /* Don't use compare mode */
+        .is_continuous = true,              /* Run timer indefinitely */
+        .value = 0                          /* Initial value of counter */
+    };
+
+    const cyhal_timer_cfg_t flow_capture_cfg =
+    {
+        .compare_value = 0,                 /* Timer compare value, not used */
+        .period = FLOW_COUNTER_PERIOD,
+        .direction = CYHAL_TIMER_DIR_UP,    /* Timer counts up */
+        .is_compare = false,                /* Capture mode */
+        .is_continuous = true,              /* Run timer indefinitely */
+        .value = 0                          /* Initial value of counter */
+    };
+
+    result = cyhal_gpio_enable_output(FLOW_PIN, CYHAL_SIGNAL_TYPE_EDGE, &flow_source);
+    if (result == CY_RSLT_SUCCESS){
+        result = cyhal_timer_init(&flow_count_timer, NC, NULL);
+    }
+    if (result == CY_RSLT_SUCCESS){
+        result = cyhal_timer_init(&flow_capture_timer, NC, NULL);
+    }
+    if (result != CY_RSLT_SUCCESS){
+        printf("Flow sensor initialization failed. Error: %ld\n", (long unsigned int)result);
+        CY_ASSERT(0);
+    }
+
+    cyhal_timer_configure(&flow_count_timer, &flow_count_cfg);
+    result = cyhal_timer_connect_digital2(&flow_count_timer, flow_source, CYHAL_TIMER_INPUT_COUNT,
+                                         CYHAL_EDGE_TYPE_RISING_EDGE);
+
+    cyhal_timer_configure(&flow_capture_timer, &flow_capture_cfg);
+    cyhal_timer_set_frequency(&flow_capture_timer, FLOW_CAPTURE_CLOCK_HZ);
+    if (result == CY_RSLT_SUCCESS){
+        result = cyhal_timer_connect_digital2(&flow_capture_timer, flow_source, CYHAL_TIMER_INPUT_CAPTURE,
+                                             CYHAL_EDGE_TYPE_RISING_EDGE);
+    }
+    if (result != CY_RSLT_SUCCESS){
+        printf("Flow sensor input routing failed. Error: %ld\n", (long unsigned int)result);
+        CY_ASSERT(0);
+    }
+
+    cyhal_timer_register_callback(&flow_capture_timer, isr_flow_capture, NULL);
+    cyhal_timer_enable_event(&flow_capture_timer, CYHAL_TIMER_IRQ_TERMINAL_COUNT, FLOW_IRQ_PRIORITY, true);
+
+    cyhal_timer_start(&flow_count_timer);
+    cyhal_timer_start(&flow_capture_timer);
+
+    count_last = cyhal_timer_read(&flow_count_timer);
+    window_start_us = timer_service_now_us();
+    flow_capture_enable(true);      //No flow yet
+}
+
+//flow_sensor_update
+//Takes the pulses counted since the last call, once per publish tick. In
+//capture mode the rate comes from the pulse periods completed in the
+//window, or from the last period while pulses are further apart than a
+//tick; otherwise from the count over the window.
+void flow_sensor_update(void){
+    uint64_t now_us = timer_service_now_us();
+    uint64_t window_us = now_us - window_start_us;
+    uint32_t count = cyhal_timer_read(&flow_count_timer);
+    uint32_t pulses = (count - count_last) & FLOW_COUNTER_PERIOD;
+    uint64_t sum;
+    uint32_t periods;
+    uint32_t period;
+    TickType_t last_tick;
+
+    count_last = count;
+    window_start_us = now_us;
+    pulses_total += pulses;
+
+    taskENTER_CRITICAL();
+    sum = capture_sum;
+    periods = capture_periods;
+    period = capture_period;
+    last_tick = capture_last_tick;
+    capture_sum = 0;
+    capture_periods = 0;
+    taskEXIT_CRITICAL();
+
+    rate_mlpm = flow_mlpm(pulses, window_us, TIMER_SERVICE_CLOCK_HZ);
+    if (capture_mode){
+        if (periods > 0){
+            rate_mlpm = flow_mlpm(periods, sum, FLOW_CAPTURE_CLOCK_HZ);
+        }
+        else if (period > 0){
+            //No pulse this window: the period is at least the time since the last one
+            uint32_t elapsed_ms = (uint32_t)(xTaskGetTickCount() - last_tick) * portTICK_PERIOD_MS;
+            uint64_t elapsed = ((uint64_t)elapsed_ms * FLOW_CAPTURE_CLOCK_HZ) / 1000u;
+
+            rate_mlpm = (elapsed_ms >= FLOW_STOPPED_MS) ? 0 :
+                        flow_mlpm(1, (elapsed > period) ? elapsed : period, FLOW_CAPTURE_CLOCK_HZ);
+        }
+    }
+
+    if (window_us == 0){return;}
+    uint64_t hz = ((uint64_t)pulses * 1000000u) / window_us;
+    if (capture_mode && (hz > FLOW_CAPTURE_MAX_HZ)){
+        flow_capture_enable(false);
+    }
+    else if (!capture_mode && (hz < FLOW_CAPTURE_ENTER_HZ)){
+        flow_capture_enable(true);
+    }
+}
+
+//flow_rate_get
+//Flow rate in mL/min over the last publish tick.
+uint32_t flow_rate_get(void){
+    return rate_mlpm;
+}
+
+//flow_total_ml_get
+//Volume since boot in mL, at the current K-factor.
+uint32_t flow_total_ml_get(void){
+    uint64_t ml = (pulses_total * 1000u * 100u) / k_factor;
+
+    return (ml > UINT32_MAX) ? UINT32_MAX : (uint32_t)ml;
+}
+
+//flow_k_factor_set
+//Sets the K-factor in pulses per litre x 100, from the flow_k command.
+bool flow_k_factor_set(uint32_t pulses_per_litre_x100){
+    if ((pulses_per_litre_x100 < FLOW_K_FACTOR_MIN) || (pulses_per_litre_x100 > FLOW_K_FACTOR_MAX)){
+        return false;
+    }
+    k_factor = pulses_per_litre_x100;
+    return true;
+}
@@ -25,6 +25,26 @@
 /* Number of scans every time ADC read is initiated */
 #define NUM_SCAN                         (1)
 
+/* Continuous ADC scanning into a DMA double buffer. Set to 0 for one
+ * asynchronous read per publish. */
+#define ADC_CONTINUOUS_SCAN              (1)
+
+/* SAR hardware averaging per channel result (power of 2, 2 to 256) */
+#define ADC_HW_AVERAGE_COUNT             (16u)
+
+/* Scans per DMA block, averaged again in software (oversampling) */
+#define ADC_OVERSAMPLE_SCANS             (32u)
+
+/* Filter chain every scan of a probe channel goes through before the
+ * block average (see sensor_filter.h), in uV. A scan further from the last
+ * kept one than the channel's outlier limit is dropped, unless
+ * ADC_FILTER_OUTLIER_RUN of them come in a row. */
+#define ADC_FILTER_PH_OUTLIER_UV         (30000)
+#define ADC_FILTER_EC_OUTLIER_UV         (100000)
+#define ADC_FILTER_OUTLIER_RUN           (8u)
+#define ADC_FILTER_MEDIAN_LEN            (5u)
+#define ADC_FILTER_EMA_SHIFT             (2u)
+
 //Pin Macros
 #define PH_FET                          (P11_4)
 #define EC_FET                          (P12_3)
@@ -32,10 +52,29 @@
 
 void gpio_init();
 
+/* Longest wait for a sampling window to complete */
+#define ADC_SAMPLE_TIMEOUT_MS            (100u)
+
+/* Returned by adc_sample_get() when no window completed in time */
+#define ADC_RSLT_TIMEOUT                 ((cy_rslt_t)0x04A00001u)
+
+/* Sample slots, in ADC channel order */
+#define ADC_CHANNEL_PH                   (0u)
+#define ADC_CHANNEL_EC                   (1u)
+#define ADC_NUM_CHANNELS                 (2u)
+
+/* One completed sampling window */
+typedef struct
+{
+    uint32_t seq;                       /* Increments with every window */
+    uint32_t timestamp_ms;              /* RTOS time the window completed */
+    int32_t mv[ADC_NUM_CHANNELS];       /* Last reading while the probe was settled */
+    uint8_t valid_mask;                 /* Bit n: mv[n] is new since the last adc_sample_get() */
+} adc_sample_t;
+
 void adc_multi_channel_init(void);
-cy_rslt_t result_return(void);
-int32_t channel0_return(void);
-int32_t channel1_return(void);
+cy_rslt_t adc_sample_get(adc_sample_t *sample, uint32_t timeout_ms);
+void adc_filter_reset(uint32_t channel);
 
 #endif /* SOURCE_SENSOR_FUNCTIONS_H_ */
 
@@ -52,9 +91,42 @@ void adc_single_channel_init(void);
 void adc_single_channel_process(void);
 
 //Temp Sensor Functions
+typedef struct
+{
+    uint32_t reads;             /* Scratchpads that passed the CRC */
+    uint32_t crc_errors;        /* Scratchpads that failed it */
+    uint32_t retries;           /* Scratchpads read again after a CRC error */
+    uint32_t read_failures;     /* Probes given up on for one conversion */
+    uint32_t bus_errors;        /* Conversions ended by a missing presence or slot timeout */
+} wire_stats_t;
+
 void initialize_wire(void);
 void wire_process(void *pvParameters);
 void write_wire_byte(uint8_t data);
-void read_wire(void);
-void print_wire(void);
+void wire_notify_from_isr(uint32_t events);
+void wire_request_conversion(void);
+uint32_t wire_wait_slot(void);
+uint32_t wire_wait_slot_ms(uint32_t timeout_ms);
+void wire_read_sample_from_isr(uint8_t level);
+void wire_read_slot_end_from_isr(void);
+bool wire_temperature_get(int16_t *centi_celsius);
+void wire_stats_get(wire_stats_t *stats);
+bool wire_set_resolution(uint8_t bits);
+uint8_t wire_device_count(void);
+bool wire_device_temperature_get(uint8_t index, int16_t *centi_celsius);
+
+//1-Wire bus, bit-banged in TempSensor.c or on the SCB UART in wire_uart.c
+uint32_t wire_bus_reset(void);
+bool wire_bus_write_bit(uint8_t value);
+int wire_bus_read_bit(void);
+bool wire_bus_write(const uint8_t *data, uint8_t len);
+bool wire_bus_read(uint8_t *data, uint8_t len);
+void wire_uart_init(void);
+
+//Flow Sensor Functions
+void flow_sensor_init(void);
+void flow_sensor_update(void);
+uint32_t flow_rate_get(void);
+uint32_t flow_total_ml_get(void);
+bool flow_k_factor_set(uint32_t pulses_per_litre_x100);
 
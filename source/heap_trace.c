@@ -0,0 +1,452 @@
+/******************************************************************************
+* File Name:   heap_trace.c
+*
+* Description: This file implements the allocation-site heap profiler. With
+*              HEAP_TRACE set, the linker wraps malloc, calloc, realloc, free,
+*              pvPortMalloc and vPortFree together with the newlib _malloc_r
+*              and _free_r they end in. Every block is attributed to the
+*              return address of the outermost call, so lwIP, mbedTLS, WHD
+*              and application allocations show up as separate sites, and the
+*              table is published on the diagnostics topic on request.
+*              Resolve the addresses with arm-none-eabi-addr2line -f -e <elf>.
+*
+* Related Document: See README.md
+*
+*******************************************************************************/
+
+#include <stdio.h>
+#include <string.h>
+
+#include "cy_pdl.h"
+
+/* FreeRTOS header files */
+#include "FreeRTOS.h"
+#include "task.h"
+
+#include "heap_trace.h"
+#include "cbor.h"
+
+#if HEAP_TRACE
+#include <malloc.h>
+#include <reent.h>
+#endif /* HEAP_TRACE */
+
+/******************************************************************************
+* Macros
+******************************************************************************/
+#define HEAP_TRACE_LIVE_MASK              (HEAP_TRACE_MAX_LIVE - 1u)
+
+/* Live entries allowed, kept below the table size so every probe run ends
+ * at an empty slot */
+#define HEAP_TRACE_LIVE_LIMIT             (HEAP_TRACE_MAX_LIVE - (HEAP_TRACE_MAX_LIVE / 8u))
+
+/* Live table entry: requested size above, site index in the low byte */
+#define HEAP_TRACE_SITE_BITS              (8u)
+#define HEAP_TRACE_SITE_MASK              ((1u << HEAP_TRACE_SITE_BITS) - 1u)
+
+/* Allocations made outside any wrapped entry point (newlib internals) are
+ * attributed to the caller of _malloc_r itself */
+#define HEAP_TRACE_CALLER()               ((uintptr_t)__builtin_return_address(0) & ~(uintptr_t)1u)
+
+#if ((HEAP_TRACE_MAX_LIVE & HEAP_TRACE_LIVE_MASK) != 0u)
+#error "HEAP_TRACE_MAX_LIVE must be a power of two"
+#endif
+
+#if (HEAP_TRACE_MAX_SITES > HEAP_TRACE_SITE_MASK)
+#error "HEAP_TRACE_MAX_SITES does not fit the live table entry"
+#endif
+
+/******************************************************************************
+* Global Variables
+*******************************************************************************/
+typedef struct
+{
+    uintptr_t caller;
+    uint32_t live_blocks;
+    uint32_t live_bytes;
+    uint32_t peak_bytes;
+    uint32_t allocs;
+} heap_site_t;
+
+/* Set by heap_trace_request_dump(), cleared by heap_trace_encode() */
+static volatile bool dump_requested = false;
+
+#if HEAP_TRACE
+/* newlib malloc lock, recursive. Held around every table update. */
+extern void __malloc_lock(struct _reent *reent);
+extern void __malloc_unlock(struct _reent *reent);
+
+void *__real_malloc(size_t size);
+void *__real_calloc(size_t count, size_t size);
+void *__real_realloc(void *ptr, size_t size);
+void __real_free(void *ptr);
+void *__real__malloc_r(struct _reent *reent, size_t size);
+void __real__free_r(struct _reent *reent, void *ptr);
+void *__real_pvPortMalloc(size_t size);
+void __real_vPortFree(void *ptr);
+
+/* newlib-nano free list, walked for the largest free block. Weak, so a full
+ * newlib build links and only reports the unused heap top. */
+typedef struct heap_chunk
+{
+    long size;
+    struct heap_chunk *next;
+} heap_chunk_t;
+
+extern heap_chunk_t *__malloc_free_list __attribute__((weak));
+
+extern uint8_t __HeapBase;  /* Symbol exported by the linker. */
+extern uint8_t __HeapLimit; /* Symbol exported by the linker. */
+
+static heap_site_t sites[HEAP_TRACE_MAX_SITES];
+static uint32_t site_count = 0;
+
+/* Open addressing on the block address, linear probing */
+static void *live_ptr[HEAP_TRACE_MAX_LIVE];
+static uint32_t live_info[HEAP_TRACE_MAX_LIVE];
+static uint32_t live_count = 0;
+
+static uint32_t live_bytes = 0;
+static uint32_t peak_bytes = 0;
+static uint32_t alloc_count = 0;
+static uint32_t free_count = 0;
+static uint32_t untracked = 0;
+
+/* Caller of the outermost wrapped entry point, valid while depth > 0 */
+static uintptr_t trace_caller = 0;
+static uint32_t trace_depth = 0;
+
+static uint32_t heap_trace_hash(const void *ptr)
+{
+    return (((uint32_t)(uintptr_t)ptr >> 3) * 2654435761u) >> 16;
+}
+
+static uint32_t heap_trace_site(uintptr_t caller)
+{
+    for (uint32_t i = 0; i < site_count; i++)
+    {
+        if (sites[i].caller == caller)
+        {
+            return i;
+        }
+    }
+    if (site_count < (HEAP_TRACE_MAX_SITES - 1u))
+    {
+        sites[site_count].caller = caller;
+        return site_count++;
+    }
+    return HEAP_TRACE_MAX_SITES - 1u;
+}
+
+/* Called with the malloc lock held */
+static void heap_trace_alloc(void *ptr, size_t size, uintptr_t caller)
+{
+    uint32_t index = heap_trace_hash(ptr) & HEAP_TRACE_LIVE_MASK;
+    uint32_t site;
+
+    if (ptr == NULL)
+    {
+        return;
+    }
+    if ((live_count >= HEAP_TRACE_LIVE_LIMIT) || (size > (UINT32_MAX >> HEAP_TRACE_SITE_BITS)))
+    {
+        untracked++;
+        return;
+    }
+
+    while (live_ptr[index] != NULL)
+    {
+        index = (index + 1u) & HEAP_TRACE_LIVE_MASK;
+    }
+    live_count++;
+
+    site = heap_trace_site(caller);
+    live_ptr[index] = ptr;
+    live_info[index] = ((uint32_t)size << HEAP_TRACE_SITE_BITS) | site;
+
+    sites[site].allocs++;
+    sites[site].live_blocks++;
+    sites[site].live_bytes += (uint32_t)size;
+    if (sites[site].live_bytes > sites[site].peak_bytes)
+    {
+        sites[site].peak_bytes = sites[site].live_bytes;
+    }
+
+    alloc_count++;
+    live_bytes += (uint32_t)size;
+    if (live_bytes > peak_bytes)
+    {
+        peak_bytes = live_bytes;
+    }
+}
+
+/* Called with the malloc lock held. Blocks counted as untracked are not in
+ * the table and are ignored. */
+static void heap_trace_free(const void *ptr)
+{
+    uint32_t index = heap_trace_hash(ptr) & HEAP_TRACE_LIVE_MASK;
+    uint32_t next;
+
+    if (ptr == NULL)
+    {
+        return;
+    }
+
+    while (live_ptr[index] != ptr)
+    {
+        if (live_ptr[index] == NULL)
+        {
+            return;
+        }
+        index = (index + 1u) & HEAP_TRACE_LIVE_MASK;
+    }
+    live_count--;
+
+    uint32_t site = live_info[index] & HEAP_TRACE_SITE_MASK;
+    uint32_t size = live_info[index] >> HEAP_TRACE_SITE_BITS;
+
+    sites[site].live_blocks--;
+    sites[site].live_bytes -= size;
+    live_bytes -= size;
+    free_count++;
+
+    /* Backward shift deletion: pull later entries of the probe run into the
+     * hole unless their home slot lies cyclically after it */
+    next = index;
+    for (;;)
+    {
+        next = (next + 1u) & HEAP_TRACE_LIVE_MASK;
+        if (live_ptr[next] == NULL)
+        {
+            break;
+        }
+        uint32_t home = heap_trace_hash(live_ptr[next]) & HEAP_TRACE_LIVE_MASK;
+        if (((next - home) & HEAP_TRACE_LIVE_MASK) >= ((next - index) & HEAP_TRACE_LIVE_MASK))
+        {
+            live_ptr[index] = live_ptr[next];
+            live_info[index] = live_info[next];
+            index = next;
+        }
+    }
+    live_ptr[index] = NULL;
+}
+
+static void heap_trace_enter(uintptr_t caller)
+{
+    __malloc_lock(_REENT);
+    if (trace_depth++ == 0u)
+    {
+        trace_caller = caller;
+    }
+}
+
+static void heap_trace_exit(void)
+{
+    if (--trace_depth == 0u)
+    {
+        trace_caller = 0;
+    }
+    __malloc_unlock(_REENT);
+}
+
+/*******************************************************************************
+ * Linker wrappers, see HEAP_TRACE in the Makefile
+ ******************************************************************************/
+void *__wrap__malloc_r(struct _reent *reent, size_t size)
+{
+    void *ptr;
+
+    __malloc_lock(reent);
+    ptr = __real__malloc_r(reent, size);
+    heap_trace_alloc(ptr, size, (trace_depth > 0u) ? trace_caller : HEAP_TRACE_CALLER());
+    __malloc_unlock(reent);
+    return ptr;
+}
+
+void __wrap__free_r(struct _reent *reent, void *ptr)
+{
+    __malloc_lock(reent);
+    heap_trace_free(ptr);
+    __real__free_r(reent, ptr);
+    __malloc_unlock(reent);
+}
+
+void *__wrap_malloc(size_t size)
+{
+    heap_trace_enter(HEAP_TRACE_CALLER());
+    void *ptr = __real_malloc(size);
+    heap_trace_exit();
+    return ptr;
+}
+
+void *__wrap_calloc(size_t count, size_t size)
+{
+    heap_trace_enter(HEAP_TRACE_CALLER());
+    void *ptr = __real_calloc(count, size);
+    heap_trace_exit();
+    return ptr;
+}
+
+void *__wrap_realloc(void *ptr, size_t size)
+{
+    heap_trace_enter(HEAP_TRACE_CALLER());
+    void *resized = __real_realloc(ptr, size);
+    heap_trace_exit();
+    return resized;
+}
+
+void __wrap_free(void *ptr)
+{
+    heap_trace_enter(HEAP_TRACE_CALLER());
+    __real_free(ptr);
+    heap_trace_exit();
+}
+
+void *__wrap_pvPortMalloc(size_t size)
+{
+    heap_trace_enter(HEAP_TRACE_CALLER());
+    void *ptr = __real_pvPortMalloc(size);
+    heap_trace_exit();
+    return ptr;
+}
+
+void __wrap_vPortFree(void *ptr)
+{
+    heap_trace_enter(HEAP_TRACE_CALLER());
+    __real_vPortFree(ptr);
+    heap_trace_exit();
+}
+#endif /* HEAP_TRACE */
+
+/******************************************************************************
+ * Function Name: heap_trace_get_stats
+ ******************************************************************************
+ * Summary:
+ *  Reports the tracked heap use and the allocator's view of the free space.
+ *  The difference between free_bytes and largest_free is the fragmentation:
+ *  free memory that no single allocation can use.
+ *
+ * Parameters:
+ *  heap_trace_stats_t *stats : filled with the current numbers, all zero
+ *                              when HEAP_TRACE is not set
+ *
+ * Return:
+ *  void
+ *
+ ******************************************************************************/
+void heap_trace_get_stats(heap_trace_stats_t *stats)
+{
+    memset(stats, 0, sizeof(*stats));
+
+#if HEAP_TRACE
+    struct mallinfo mall_info = mallinfo();
+    uint32_t heap_size = (uint32_t)(&__HeapLimit - &__HeapBase);
+    uint32_t top = (heap_size > (uint32_t)mall_info.arena) ? (heap_size - (uint32_t)mall_info.arena) : 0u;
+    uint32_t largest = top;
+
+    __malloc_lock(_REENT);
+    if (&__malloc_free_list != NULL)
+    {
+        for (const heap_chunk_t *chunk = __malloc_free_list; chunk != NULL; chunk = chunk->next)
+        {
+            if ((uint32_t)chunk->size > largest)
+            {
+                largest = (uint32_t)chunk->size;
+            }
+        }
+    }
+    stats->live_bytes = live_bytes;
+    stats->peak_bytes = peak_bytes;
+    stats->allocs = alloc_count;
+    stats->frees = free_count;
+    stats->untracked = untracked;
+    __malloc_unlock(_REENT);
+
+    stats->arena_bytes = (uint32_t)mall_info.arena;
+    stats->free_bytes = (uint32_t)mall_info.fordblks + top;
+    stats->largest_free = largest;
+#endif /* HEAP_TRACE */
+}
+
+/* Called by the subscriber for the "heap_dump" command */
+void heap_trace_request_dump(void)
+{
+    dump_requested = (HEAP_TRACE != 0);
+}
+
+bool heap_trace_dump_pending(void)
+{
+    return dump_requested;
+}
+
+/******************************************************************************
+ * Function Name: heap_trace_encode
+ ******************************************************************************
+ * Summary:
+ *  Encodes a snapshot of the heap statistics and of every call site as
+ *  CBOR, see HEAP_TRACE_KEY_STATS and HEAP_TRACE_KEY_SITES, and clears the
+ *  pending dump request.
+ *
+ * Parameters:
+ *  uint8_t *buffer : receives the payload
+ *  size_t buffer_len : size of 'buffer'
+ *
+ * Return:
+ *  size_t : payload length, 0 if it does not fit or HEAP_TRACE is not set
+ *
+ ******************************************************************************/
+size_t heap_trace_encode(uint8_t *buffer, size_t buffer_len)
+{
+    dump_requested = false;
+
+#if HEAP_TRACE
+    static heap_site_t snapshot[HEAP_TRACE_MAX_SITES];
+    heap_trace_stats_t stats;
+    cbor_writer_t w;
+    uint32_t count;
+
+    heap_trace_get_stats(&stats);
+
+    __malloc_lock(_REENT);
+    count = site_count;
+    if (sites[HEAP_TRACE_MAX_SITES - 1u].allocs > 0u)
+    {
+        count = HEAP_TRACE_MAX_SITES;
+    }
+    memcpy(snapshot, sites, count * sizeof(snapshot[0]));
+    __malloc_unlock(_REENT);
+
+    cbor_writer_init(&w, buffer, buffer_len);
+    cbor_put_map(&w, 2);
+    cbor_put_uint(&w, HEAP_TRACE_KEY_STATS);
+    cbor_put_array(&w, HEAP_TRACE_STATS_FIELDS);
+    cbor_put_uint(&w, stats.live_bytes);
+    cbor_put_uint(&w, stats.peak_bytes);
+    cbor_put_uint(&w, stats.arena_bytes);
+    cbor_put_uint(&w, stats.free_bytes);
+    cbor_put_uint(&w, stats.largest_free);
+    cbor_put_uint(&w, stats.allocs);
+    cbor_put_uint(&w, stats.frees);
+    cbor_put_uint(&w, stats.untracked);
+
+    cbor_put_uint(&w, HEAP_TRACE_KEY_SITES);
+    cbor_put_array(&w, count);
+    for (uint32_t i = 0; i < count; i++)
+    {
+        cbor_put_array(&w, HEAP_TRACE_SITE_FIELDS);
+        cbor_put_uint(&w, snapshot[i].caller);
+        cbor_put_uint(&w, snapshot[i].live_blocks);
+        cbor_put_uint(&w, snapshot[i].live_bytes);
+        cbor_put_uint(&w, snapshot[i].peak_bytes);
+        cbor_put_uint(&w, snapshot[i].allocs);
+    }
+
+    return cbor_writer_length(&w);
+#else
+    (void) buffer;
+    (void) buffer_len;
+    return 0;
+#endif /* HEAP_TRACE */
+}
+
+/* [] END OF FILE */
@@ -0,0 +1,74 @@
+/******************************************************************************
+* File Name:   heap_trace.h
+*
+* Description: This file is the public interface of heap_trace.c, the
+*              allocation-site heap profiler.
+*
+* Related Document: See README.md
+*
+*******************************************************************************/
+
+#ifndef HEAP_TRACE_H_
+#define HEAP_TRACE_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+/*******************************************************************************
+* Macros
+********************************************************************************/
+/* Set by the Makefile together with the linker --wrap options, see
+ * HEAP_TRACE in the Makefile. Without them nothing is recorded. */
+#ifndef HEAP_TRACE
+#define HEAP_TRACE                        (0)
+#endif
+
+/* Call sites tracked. Allocations from further sites are added to the last
+ * entry, whose caller is reported as 0. */
+#define HEAP_TRACE_MAX_SITES              (48u)
+
+/* Live allocations tracked, a power of two. Allocations made while the
+ * table is full are counted as untracked. */
+#define HEAP_TRACE_MAX_LIVE               (1024u)
+
+/* Payload buffer size for HEAP_TRACE_MAX_SITES entries */
+#define HEAP_TRACE_PAYLOAD_MAX_LEN        (64u + (HEAP_TRACE_MAX_SITES * 26u))
+
+/* Keys of the CBOR heap snapshot, published on the diagnostics topic. They
+ * follow the keys of runtime_stats.h so both messages can share one map
+ * decoder. HEAP_TRACE_KEY_STATS holds [live bytes, peak bytes, arena bytes,
+ * free bytes, largest free block, allocations, frees, untracked];
+ * HEAP_TRACE_KEY_SITES one array per site: [caller address, live blocks,
+ * live bytes, peak bytes, allocations]. */
+#define HEAP_TRACE_KEY_STATS              (2u)
+#define HEAP_TRACE_KEY_SITES              (3u)
+#define HEAP_TRACE_STATS_FIELDS           (8u)
+#define HEAP_TRACE_SITE_FIELDS            (5u)
+
+/*******************************************************************************
+* Global Variables
+********************************************************************************/
+typedef struct
+{
+    uint32_t live_bytes;        /* Requested bytes currently allocated */
+    uint32_t peak_bytes;        /* Highest live_bytes since boot */
+    uint32_t arena_bytes;       /* Heap taken from sbrk() by the allocator */
+    uint32_t free_bytes;        /* Free in the arena plus the unused heap top */
+    uint32_t largest_free;      /* Largest single block that can be allocated */
+    uint32_t allocs;
+    uint32_t frees;
+    uint32_t untracked;         /* Made while the live table was full */
+} heap_trace_stats_t;
+
+/*******************************************************************************
+* Function Prototypes
+********************************************************************************/
+void heap_trace_get_stats(heap_trace_stats_t *stats);
+void heap_trace_request_dump(void);
+bool heap_trace_dump_pending(void);
+size_t heap_trace_encode(uint8_t *buffer, size_t buffer_len);
+
+#endif /* HEAP_TRACE_H_ */
+
+/* [] END OF FILE */
@@ -53,6 +53,8 @@
 #include <malloc.h>
 #endif /* #if defined (__GNUC__) && !defined(__ARMCC_VERSION) */
 
+#include "dlog.h"
+#include "heap_trace.h"
 
 /*******************************************************************************
  * Macros
@@ -98,4 +100,35 @@ void print_heap_usage(char *msg)
 #endif /* #if defined(PRINT_HEAP_USAGE) && defined (__GNUC__) && !defined(__ARMCC_VERSION) */
 }
 
+/*******************************************************************************
+* Function Name: log_heap_usage
+********************************************************************************
+* Summary:
+* Records the heap in use, the peak and the total heap to the deferred log
+* under message 'id'. For the publish and subscribe paths, where the
+* formatted output of print_heap_usage() costs milliseconds per message.
+* With HEAP_TRACE the numbers come from the allocation tracker, which also
+* sees the peak between two calls.
+*
+*******************************************************************************/
+void log_heap_usage(dlog_id_t id)
+{
+#if HEAP_TRACE
+    heap_trace_stats_t stats;
+
+    heap_trace_get_stats(&stats);
+    DLOG3(id, stats.live_bytes, stats.peak_bytes, stats.arena_bytes + stats.free_bytes - stats.live_bytes);
+    /* ARM compiler also defines __GNUC__ */
+#elif defined(PRINT_HEAP_USAGE) && defined (__GNUC__) && !defined(__ARMCC_VERSION)
+    struct mallinfo mall_info = mallinfo();
+
+    extern uint8_t __HeapBase;  /* Symbol exported by the linker. */
+    extern uint8_t __HeapLimit; /* Symbol exported by the linker. */
+
+    DLOG3(id, mall_info.uordblks, mall_info.arena, (uint32_t)(&__HeapLimit - &__HeapBase));
+#else
+    (void) id;
+#endif /* #if defined(PRINT_HEAP_USAGE) && defined (__GNUC__) && !defined(__ARMCC_VERSION) */
+}
+
 /* [] END OF FILE */
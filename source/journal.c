@@ -0,0 +1,531 @@
+/******************************************************************************
+* File Name:   journal.c
+*
+* Description: This file contains an append-only journal for telemetry
+*              frames, written while the MQTT connection is down and drained
+*              after it comes back. The log is circular over the erase
+*              sectors of the region, so every sector is erased equally
+*              often, and drained records are marked by clearing a state
+*              byte instead of erasing. When the region is full the oldest
+*              sector is dropped.
+*
+*              On CY_DEVICE_PSOC6A512K kits the region is the top of the
+*              external QSPI NOR, so the backlog survives a reset. Other kits
+*              use a RAM region with the same NOR semantics.
+*
+* Related Document: See README.md
+*
+*******************************************************************************/
+
+#include <string.h>
+
+#include "cy_pdl.h"
+#include "cyhal.h"
+
+#include "journal.h"
+
+#if defined(CY_DEVICE_PSOC6A512K)
+#include "cy_serial_flash_qspi.h"
+#endif
+
+/******************************************************************************
+* Macros
+******************************************************************************/
+#define JOURNAL_MAGIC                   (0x4A4Cu)
+
+/* Record state byte, bits can only be cleared without an erase */
+#define JOURNAL_STATE_PENDING           (0xFFu)
+#define JOURNAL_STATE_DRAINED           (0x00u)
+
+#define JOURNAL_ERASED_BYTE             (0xFFu)
+
+/* Payloads are padded so headers stay word aligned */
+#define JOURNAL_ALIGN(len)              (((len) + 3u) & ~3u)
+
+/******************************************************************************
+* Global Variables
+*******************************************************************************/
+/* Written in front of every payload */
+typedef struct
+{
+    uint16_t magic;
+    uint16_t len;
+    uint32_t seq;
+    uint32_t crc;               /* CRC-32 of the payload */
+    uint8_t state;
+    uint8_t reserved[3];
+} journal_header_t;
+
+/* Region geometry, offsets below are relative to region_base */
+static uint32_t region_base;
+static uint32_t region_size;
+static uint32_t sector_size;
+static uint32_t sector_count;
+
+/* Next write offset, inside head_sector or at its end when it is full */
+static uint32_t head;
+static uint32_t head_sector;
+
+/* Oldest pending record, equal to head when nothing is pending */
+static uint32_t tail;
+static uint32_t pending;
+
+static uint32_t next_seq;
+
+#if !defined(CY_DEVICE_PSOC6A512K)
+static uint8_t journal_ram[JOURNAL_RAM_SIZE];
+#endif
+
+/******************************************************************************
+ * Storage
+ ******************************************************************************/
+#if defined(CY_DEVICE_PSOC6A512K)
+/* The Wi-Fi firmware is read through XIP, which has to be off while the
+ * SMIF runs commands. WHD only reads it while cy_wcm_init() runs. */
+static cy_rslt_t journal_flash_read(uint32_t offset, size_t len, uint8_t *buf)
+{
+    cy_rslt_t result = cy_serial_flash_qspi_enable_xip(false);
+
+    if (result == CY_RSLT_SUCCESS)
+    {
+        result = cy_serial_flash_qspi_read(region_base + offset, len, buf);
+        (void) cy_serial_flash_qspi_enable_xip(true);
+    }
+    return result;
+}
+
+static cy_rslt_t journal_flash_write(uint32_t offset, size_t len, const uint8_t *buf)
+{
+    cy_rslt_t result = cy_serial_flash_qspi_enable_xip(false);
+
+    if (result == CY_RSLT_SUCCESS)
+    {
+        result = cy_serial_flash_qspi_write(region_base + offset, len, buf);
+        (void) cy_serial_flash_qspi_enable_xip(true);
+    }
+    return result;
+}
+
+static cy_rslt_t journal_flash_erase(uint32_t offset)
+{
+    cy_rslt_t result = cy_serial_flash_qspi_enable_xip(false);
+
+    if (result == CY_RSLT_SUCCESS)
+    {
+        result = cy_serial_flash_qspi_erase(region_base + offset, sector_size);
+        (void) cy_serial_flash_qspi_enable_xip(true);
+    }
+    return result;
+}
+
+static void journal_flash_geometry(void)
+{
+    region_base = (uint32_t)cy_serial_flash_qspi_get_size() - JOURNAL_QSPI_SIZE;
+    region_size = JOURNAL_QSPI_SIZE;
+    sector_size = (uint32_t)cy_serial_flash_qspi_get_erase_size(region_base);
+}
+#else
+static cy_rslt_t journal_flash_read(uint32_t offset, size_t len, uint8_t *buf)
+{
+    memcpy(buf, &journal_ram[offset], len);
+    return CY_RSLT_SUCCESS;
+}
+
+/* Programming can only clear bits, like the NOR */
+static cy_rslt_t journal_flash_write(uint32_t offset, size_t len, const uint8_t *buf)
+{
+    for (size_t i = 0; i < len; i++)
+    {
+        journal_ram[offset + i] &= buf[i];
+    }
+    return CY_RSLT_SUCCESS;
+}
+
+static cy_rslt_t journal_flash_erase(uint32_t offset)
+{
+    memset(&journal_ram[offset], JOURNAL_ERASED_BYTE, sector_size);
+    return CY_RSLT_SUCCESS;
+}
+
+static void journal_flash_geometry(void)
+{
+    region_base = 0;
+    region_size = JOURNAL_RAM_SIZE;
+    sector_size = JOURNAL_RAM_SECTOR_SIZE;
+    memset(journal_ram, JOURNAL_ERASED_BYTE, sizeof(journal_ram));
+}
+#endif /* CY_DEVICE_PSOC6A512K */
+
+/******************************************************************************
+ * Log helpers
+ ******************************************************************************/
+static uint32_t journal_crc32(const uint8_t *data, size_t len)
+{
+    uint32_t crc = 0xFFFFFFFFu;
+
+    for (size_t i = 0; i < len; i++)
+    {
+        crc ^= data[i];
+        for (uint8_t bit = 0; bit < 8u; bit++)
+        {
+            crc = (crc >> 1) ^ (0xEDB88320u & (0u - (crc & 1u)));
+        }
+    }
+    return ~crc;
+}
+
+static uint32_t journal_sector_end(uint32_t offset)
+{
+    return ((offset / sector_size) + 1u) * sector_size;
+}
+
+static uint32_t journal_record_size(const journal_header_t *hdr)
+{
+    return sizeof(journal_header_t) + JOURNAL_ALIGN((uint32_t)hdr->len);
+}
+
+/* Reads the header at 'offset', false if there is no record there */
+static bool journal_read_header(uint32_t offset, journal_header_t *hdr)
+{
+    if ((journal_sector_end(offset) - offset) < sizeof(journal_header_t))
+    {
+        return false;
+    }
+    if (journal_flash_read(offset, sizeof(*hdr), (uint8_t *)hdr) != CY_RSLT_SUCCESS)
+    {
+        return false;
+    }
+    return (hdr->magic == JOURNAL_MAGIC) && (hdr->len != 0u) &&
+           (hdr->len <= JOURNAL_RECORD_MAX_LEN) &&
+           ((offset + journal_record_size(hdr)) <= journal_sector_end(offset));
+}
+
+/* Start of the sector after the one holding 'offset', or head */
+static uint32_t journal_skip_sector(uint32_t offset)
+{
+    uint32_t next = journal_sector_end(offset);
+
+    if (next == head)
+    {
+        return head;
+    }
+    return (next >= region_size) ? 0u : next;
+}
+
+/******************************************************************************
+ * Function Name: journal_next
+ ******************************************************************************
+ * Summary:
+ *  Offset of the record after the one at 'offset', stepping over the unused
+ *  end of a sector. Stops at head.
+ *
+ ******************************************************************************/
+static uint32_t journal_next(uint32_t offset, const journal_header_t *hdr)
+{
+    journal_header_t next_hdr;
+    uint32_t next = offset + journal_record_size(hdr);
+
+    if (next == head)
+    {
+        return head;
+    }
+    if ((next >= journal_sector_end(offset)) || !journal_read_header(next, &next_hdr))
+    {
+        return journal_skip_sector(offset);
+    }
+    return next;
+}
+
+/* Offset after whatever is at 'offset', valid record or not */
+static uint32_t journal_step(uint32_t offset, journal_header_t *hdr)
+{
+    if (journal_read_header(offset, hdr))
+    {
+        return journal_next(offset, hdr);
+    }
+    return journal_skip_sector(offset);
+}
+
+/* Moves tail to the first pending record at or after it */
+static void journal_seek_pending(void)
+{
+    journal_header_t hdr;
+
+    for (uint32_t guard = region_size / sizeof(hdr); (pending > 0u) && (tail != head) && (guard > 0u); guard--)
+    {
+        if (journal_read_header(tail, &hdr) && (hdr.state == JOURNAL_STATE_PENDING))
+        {
+            return;
+        }
+        tail = journal_step(tail, &hdr);
+    }
+    pending = 0;
+    tail = head;
+}
+
+/******************************************************************************
+ * Function Name: journal_advance_sector
+ ******************************************************************************
+ * Summary:
+ *  Moves head to the start of the next sector and erases it. Pending
+ *  records in that sector, the oldest ones, are dropped.
+ *
+ ******************************************************************************/
+static cy_rslt_t journal_advance_sector(void)
+{
+    journal_header_t hdr;
+    uint32_t sector = (head_sector + 1u) % sector_count;
+    uint32_t start = sector * sector_size;
+
+    while ((pending > 0u) && (tail != head) && ((tail / sector_size) == sector))
+    {
+        if (journal_read_header(tail, &hdr) && (hdr.state == JOURNAL_STATE_PENDING))
+        {
+            pending--;
+        }
+        tail = journal_step(tail, &hdr);
+    }
+
+    head_sector = sector;
+    head = start;
+    if (pending == 0u)
+    {
+        tail = head;
+    }
+    else
+    {
+        journal_seek_pending();
+    }
+    return journal_flash_erase(start);
+}
+
+/******************************************************************************
+ * Function Name: journal_init
+ ******************************************************************************
+ * Summary:
+ *  Finds the newest sector from the record sequence numbers, then rebuilds
+ *  head, tail and the pending count. A partly written header at head is
+ *  left alone and the next append starts a fresh sector.
+ *
+ * Return:
+ *  cy_rslt_t : CY_RSLT_SUCCESS, or the storage error
+ *
+ ******************************************************************************/
+cy_rslt_t journal_init(void)
+{
+    journal_header_t hdr;
+    uint8_t erased[sizeof(journal_header_t)];
+    bool found = false;
+    uint32_t newest_seq = 0;
+    uint32_t oldest_seq = 0;
+    uint32_t oldest_sector = 0;
+    uint32_t offset;
+
+    journal_flash_geometry();
+    sector_count = (sector_size == 0u) ? 0u : (region_size / sector_size);
+    if (sector_count < 2u)
+    {
+        return JOURNAL_RSLT_BAD_GEOMETRY;
+    }
+
+    for (uint32_t sector = 0; sector < sector_count; sector++)
+    {
+        if (!journal_read_header(sector * sector_size, &hdr))
+        {
+            continue;
+        }
+        if (!found || (hdr.seq > newest_seq))
+        {
+            newest_seq = hdr.seq;
+            head_sector = sector;
+        }
+        if (!found || (hdr.seq < oldest_seq))
+        {
+            oldest_seq = hdr.seq;
+            oldest_sector = sector;
+        }
+        found = true;
+    }
+
+    if (!found)
+    {
+        head_sector = 0;
+        head = 0;
+        tail = 0;
+        pending = 0;
+        next_seq = 0;
+        return journal_flash_erase(0);
+    }
+
+    /* End of the newest sector */
+    head = head_sector * sector_size;
+    next_seq = newest_seq;
+    while (journal_read_header(head, &hdr))
+    {
+        next_seq = hdr.seq + 1u;
+        head += journal_record_size(&hdr);
+    }
+    if ((journal_sector_end(head_sector * sector_size) - head) >= sizeof(erased))
+    {
+        (void) journal_flash_read(head, sizeof(erased), erased);
+        for (size_t i = 0; i < sizeof(erased); i++)
+        {
+            if (erased[i] != JOURNAL_ERASED_BYTE)
+            {
+                head = journal_sector_end(head);
+                break;
+            }
+        }
+    }
+
+    /* Count what is still waiting, oldest sector first */
+    pending = 0;
+    tail = head;
+    offset = oldest_sector * sector_size;
+    for (uint32_t guard = region_size / sizeof(hdr); (offset != head) && (guard > 0u); guard--)
+    {
+        if (journal_read_header(offset, &hdr) && (hdr.state == JOURNAL_STATE_PENDING))
+        {
+            if (pending == 0u)
+            {
+                tail = offset;
+            }
+            pending++;
+        }
+        offset = journal_step(offset, &hdr);
+    }
+
+    return CY_RSLT_SUCCESS;
+}
+
+/******************************************************************************
+ * Function Name: journal_append
+ ******************************************************************************
+ * Summary:
+ *  Appends one frame. The header is written before the payload, so a frame
+ *  cut short by a reset fails its CRC and is skipped when draining.
+ *
+ * Parameters:
+ *  const uint8_t *data : frame to store
+ *  size_t len : frame length, 1 to JOURNAL_RECORD_MAX_LEN
+ *
+ * Return:
+ *  cy_rslt_t : CY_RSLT_SUCCESS, JOURNAL_RSLT_BAD_LENGTH or the storage error
+ *
+ ******************************************************************************/
+cy_rslt_t journal_append(const uint8_t *data, size_t len)
+{
+    cy_rslt_t result;
+    journal_header_t hdr;
+    uint32_t size;
+
+    if ((len == 0u) || (len > JOURNAL_RECORD_MAX_LEN) || (sector_count < 2u))
+    {
+        return JOURNAL_RSLT_BAD_LENGTH;
+    }
+
+    memset(&hdr, JOURNAL_ERASED_BYTE, sizeof(hdr));
+    hdr.magic = JOURNAL_MAGIC;
+    hdr.len = (uint16_t)len;
+    hdr.seq = next_seq;
+    hdr.crc = journal_crc32(data, len);
+    hdr.state = JOURNAL_STATE_PENDING;
+    size = journal_record_size(&hdr);
+
+    if ((journal_sector_end(head_sector * sector_size) - head) < size)
+    {
+        result = journal_advance_sector();
+        if (result != CY_RSLT_SUCCESS)
+        {
+            return result;
+        }
+    }
+
+    result = journal_flash_write(head, sizeof(hdr), (const uint8_t *)&hdr);
+    if (result == CY_RSLT_SUCCESS)
+    {
+        result = journal_flash_write(head + sizeof(hdr), len, data);
+    }
+    head += size;
+    next_seq++;
+    if (result == CY_RSLT_SUCCESS)
+    {
+        if (pending == 0u)
+        {
+            tail = head - size;
+        }
+        pending++;
+    }
+    else if (pending == 0u)
+    {
+        tail = head;
+    }
+    return result;
+}
+
+/******************************************************************************
+ * Function Name: journal_peek
+ ******************************************************************************
+ * Summary:
+ *  Copies the oldest pending frame without removing it. Frames that fail
+ *  their CRC are dropped on the way.
+ *
+ * Parameters:
+ *  uint8_t *buffer : receives the frame
+ *  size_t buffer_len : size of 'buffer'
+ *
+ * Return:
+ *  size_t : frame length, 0 when nothing is pending
+ *
+ ******************************************************************************/
+size_t journal_peek(uint8_t *buffer, size_t buffer_len)
+{
+    journal_header_t hdr;
+
+    while (pending > 0u)
+    {
+        if (journal_read_header(tail, &hdr) && (hdr.len <= buffer_len) &&
+            (journal_flash_read(tail + sizeof(hdr), hdr.len, buffer) == CY_RSLT_SUCCESS) &&
+            (journal_crc32(buffer, hdr.len) == hdr.crc))
+        {
+            return hdr.len;
+        }
+        (void) journal_consume();
+    }
+    return 0;
+}
+
+/******************************************************************************
+ * Function Name: journal_consume
+ ******************************************************************************
+ * Summary:
+ *  Marks the oldest pending frame as drained.
+ *
+ * Return:
+ *  cy_rslt_t : CY_RSLT_SUCCESS, or the storage error
+ *
+ ******************************************************************************/
+cy_rslt_t journal_consume(void)
+{
+    cy_rslt_t result;
+    journal_header_t hdr;
+    const uint8_t drained = JOURNAL_STATE_DRAINED;
+
+    if (pending == 0u)
+    {
+        return CY_RSLT_SUCCESS;
+    }
+
+    result = journal_flash_write(tail + offsetof(journal_header_t, state), sizeof(drained), &drained);
+    pending--;
+    tail = journal_step(tail, &hdr);
+    journal_seek_pending();
+    return result;
+}
+
+uint32_t journal_pending(void)
+{
+    return pending;
+}
+
+/* [] END OF FILE */
@@ -0,0 +1,52 @@
+/******************************************************************************
+* File Name:   journal.h
+*
+* Description: This file is the public interface of journal.c, the
+*              store-and-forward log for telemetry frames that could not be
+*              published while the broker was unreachable.
+*
+* Related Document: See README.md
+*
+*******************************************************************************/
+
+#ifndef JOURNAL_H_
+#define JOURNAL_H_
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include "cyhal.h"
+
+/*******************************************************************************
+* Macros
+********************************************************************************/
+/* Journal region at the top of the external QSPI NOR, below it is the
+ * Wi-Fi firmware (CY_DEVICE_PSOC6A512K kits only) */
+#define JOURNAL_QSPI_SIZE                 (1024u * 1024u)
+
+/* RAM journal for kits without the QSPI flash initialised in main(). It has
+ * NOR semantics so both use the same log code, but does not survive reset. */
+#define JOURNAL_RAM_SIZE                  (32u * 1024u)
+#define JOURNAL_RAM_SECTOR_SIZE           (4096u)
+
+/* Largest frame one record can hold */
+#define JOURNAL_RECORD_MAX_LEN            (512u)
+
+/* Returned by journal_append() for an empty or oversized frame */
+#define JOURNAL_RSLT_BAD_LENGTH           ((cy_rslt_t)0x04A00101u)
+
+/* Returned by journal_init() when the region has fewer than two sectors */
+#define JOURNAL_RSLT_BAD_GEOMETRY         ((cy_rslt_t)0x04A00102u)
+
+/*******************************************************************************
+* Function Prototypes
+********************************************************************************/
+cy_rslt_t journal_init(void);
+cy_rslt_t journal_append(const uint8_t *data, size_t len);
+size_t journal_peek(uint8_t *buffer, size_t buffer_len);
+cy_rslt_t journal_consume(void);
+uint32_t journal_pending(void);
+
+#endif /* JOURNAL_H_ */
+
+/* [] END OF FILE */
@@ -5,9 +5,12 @@
 typedef enum transaction{
     RESET,
     PRESENSE,
+    SEARCH_ROM,
+    WRITE_CONFIG,
     SKIP_ROM,
     CONVERT_T,
     POLL,
+    MATCH_ROM,
     SCRATCH,
     PARSE,
     DONE,
@@ -19,34 +22,86 @@ typedef enum transaction{
 /*******************************************************************************
 * Macros
 *******************************************************************************/
-/* LED blink timer clock value in Hz  */
-#define LED_BLINK_TIMER_CLOCK_HZ          (10000)
+/* Publish tick on the timer service, also the telemetry sample period */
+#define PUBLISH_TICK_US                   (1000000u)
 
-/* LED blink timer period value */
-#define LED_BLINK_TIMER_PERIOD            (9999)
+/* 1-Wire slot timing on the timer service, in us. WIRE_RESET_US is both
+ * the reset pulse and the presence window. */
+#define WIRE_RESET_US                     (500u)
+#define WIRE_WRITE_SLOT_US                (100u)
+#define WIRE_READ_SLOT_US                 (100u)
+#define WIRE_READ_SAMPLE_US               (6u)
 
-#define PUMP_TIMER_CLOCK_HZ               (10000)
-#define PUMP_TIMER_PERIOD                 (9999)
+#define INIT_RETRIES                    (10)
+#define TEMP_CONVERSION                 (0.0625)
 
-#define WIRE_TIMER_CLOCK_HZ               (100000)
-#define WIRE_TIMER_PERIOD                 (50)
+/* DS18B20 probes addressed on TEMP_PIN, found by SEARCH_ROM */
+#define WIRE_MAX_DEVICES                (4u)
+#define WIRE_ROM_SIZE                   (8u)
+#define WIRE_ROM_BITS                   (WIRE_ROM_SIZE * 8u)
+#define DS18B20_FAMILY_CODE             (0x28u)
 
-#define WRITE_TIMER_CLOCK_HZ               (1000000)
-#define WRITE_TIMER_PERIOD                 (100)  
+/* Scratchpad bytes, the last one is the CRC8 of the first eight */
+#define WIRE_SCRATCHPAD_SIZE            (9u)
 
-#define READ_TIMER_CLOCK_HZ               (1000000)
-#define READ_TIMER_PERIOD                 (100) 
+/* Further reads of a scratchpad that failed its CRC */
+#define WIRE_READ_RETRIES               (3u)
 
-#define WRITE_TIMER_SLOT                 (12)     
-#define READ_TIMER_SLOT                 (6)  
+/* DS18B20 resolution, 9 to 12 bits. Each bit less halves the conversion
+ * time, 750 ms at 12 bits down to 94 ms at 9 bits. */
+#ifndef WIRE_RESOLUTION_BITS
+#define WIRE_RESOLUTION_BITS            (12u)
+#endif
+#define WIRE_RESOLUTION_MIN_BITS        (9u)
+#define WIRE_RESOLUTION_MAX_BITS        (12u)
+#define WIRE_CONVERSION_MAX_MS          (750u)      /* At 12 bits */
 
-#define INIT_RETRIES                    (10)
-#define REG_SIZE                        (16)
-#define TEMP_CONVERSION                 (0.0625)
+/* Alarm registers written with the configuration, not used: power-on values */
+#define WIRE_ALARM_TH                   (0x4Bu)
+#define WIRE_ALARM_TL                   (0x46u)
+
+/* Read slots after the conversion time, WIRE_POLL_INTERVAL_MS apart, before
+ * a probe that is still converting is given up on */
+#define WIRE_POLL_RETRIES               (5u)
+#define WIRE_POLL_INTERVAL_MS           (10u)
 
 #define FLOW_PIN                        P9_1
 #define TEMP_PIN                        P9_0
 
+/* Flow meter K-factor in pulses per litre x 100, 450 pulses/L for a
+ * YF-S201. Set at run time with the flow_k command. */
+#define FLOW_K_FACTOR                   (45000u)
+#define FLOW_K_FACTOR_MIN               (100u)
+#define FLOW_K_FACTOR_MAX               (10000000u)
+
+/* FLOW_PIN pulses are counted by one TCPWM counter. Below
+ * FLOW_CAPTURE_MAX_HZ a second counter at FLOW_CAPTURE_CLOCK_HZ also
+ * captures the time of every pulse, so low flows are measured from the
+ * pulse period instead of a few counts per second. */
+#define FLOW_CAPTURE_CLOCK_HZ           (100000u)
+#define FLOW_CAPTURE_MAX_HZ             (50u)
+
+/* No pulse for this long reads as no flow */
+#define FLOW_STOPPED_MS                 (5000u)
+
+/* 1-Wire master: 0 bit-bangs TEMP_PIN with wire_timer, write_timer and
+ * read_timer, 1 uses the SCB UART in wire_uart.c. Set by the Makefile. */
+#ifndef WIRE_BUS_UART
+#define WIRE_BUS_UART                   (0)
+#endif
+
+/* SCB6 UART pins for WIRE_BUS_UART. TX is switched to open drain and both
+ * pins are tied to the DQ line, which keeps its 4.7k pull-up. */
+#define WIRE_UART_TX                    P12_1
+#define WIRE_UART_RX                    P12_0
+
+/* Reset and presence at 9600 baud, one UART byte per slot at 115200 */
+#define WIRE_UART_RESET_BAUD            (9600u)
+#define WIRE_UART_SLOT_BAUD             (115200u)
+
+/* Longest 1-Wire block moved by one DMA transfer, 8 UART bytes per byte */
+#define WIRE_UART_MAX_BYTES             (9u)
+
 #define CIRC_PUMP_IN
 
 #define DOSE_PUMP_A                     P9_2
@@ -65,4 +120,14 @@ typedef enum transaction{
 /* ADC Scan delay in millisecond */
 #define ADC_SCAN_DELAY_MS                (200u)
 
-#define RING_BUFFER_SIZE                (16)
\ No newline at end of file
+/* Bytes assembled by isr_read_sample for the temperature task, power of 2 */
+#define WIRE_RX_QUEUE_SIZE              (16u)
+
+/* 1-Wire task notification bits, set by the timer and GPIO ISRs */
+#define WIRE_EVT_SLOT_DONE              (1u << 0)   /* Bus slot or reset window finished */
+#define WIRE_EVT_PRESENCE               (1u << 1)   /* Presence pulse seen during reset window */
+#define WIRE_EVT_START                  (1u << 2)   /* Start a new temperature conversion */
+#define WIRE_EVT_ALL                    (WIRE_EVT_SLOT_DONE | WIRE_EVT_PRESENCE | WIRE_EVT_START)
+
+/* Longest a bus slot may take before the transaction is abandoned */
+#define WIRE_SLOT_TIMEOUT_MS            (10u)
\ No newline at end of file
@@ -49,6 +49,13 @@
 #include "task.h"
 
 #include "functions.h"
+#include "telemetry.h"
+#include "journal.h"
+#include "pump_scheduler.h"
+#include "probe_scheduler.h"
+#include "calibration.h"
+#include "dlog.h"
+#include "app_alloc.h"
 
 /* Include serial flash library and QSPI memory configurations only for the
  * kits that require the Wi-Fi firmware to be loaded in external QSPI NOR flash.
@@ -58,6 +65,18 @@
 #include "cycfg_qspi_memslot.h"
 #endif
 
+/* Temperature task parameters */
+#define WIRE_TASK_STACK_SIZE            (2048)
+#define WIRE_TASK_PRIORITY              (1)
+
+/* Temperature task handle, defined in TempSensor.c */
+extern TaskHandle_t wire_task_handle;
+
+/* Task storage, see app_alloc.h */
+APP_TASK_DEFINE(dlog_task, DLOG_TASK_STACK_SIZE);
+APP_TASK_DEFINE(mqtt_client_task, MQTT_CLIENT_TASK_STACK_SIZE);
+APP_TASK_DEFINE(wire_task, WIRE_TASK_STACK_SIZE);
+
 /******************************************************************************
  * Function Name: main
  ******************************************************************************
@@ -126,17 +145,41 @@ int main()
 #endif
     printf("===============================================================\n\n");
 
+    /* Before any init code or interrupt can log */
+    dlog_init();
+
     //Interrupts can't trigger before RTOS starts. Otherwise, create startup task for inits.
     adc_multi_channel_init();
 	timer_init();
     gpio_init();
+    pump_scheduler_init();
+    probe_scheduler_init();
+    telemetry_init();
+
+    /* After the QSPI flash is up, the journal lives at its top */
+    result = journal_init();
+    if (result != CY_RSLT_SUCCESS)
+    {
+        printf("Journal initialization failed. Error: 0x%0X\n", (int)result);
+    }
+
+    /* Probe calibration and flow K-factor from the internal flash */
+    result = calibration_init();
+    if (result != CY_RSLT_SUCCESS)
+    {
+        printf("Calibration flash not available, using defaults. Error: 0x%0X\n", (int)result);
+    }
+
+    /* Drains the deferred log to the debug UART */
+    APP_TASK_CREATE(dlog_task, dlog_task, "Log task", DLOG_TASK_STACK_SIZE, NULL, DLOG_TASK_PRIORITY, NULL);
 
     /* Create the MQTT Client task. */
-    xTaskCreate(mqtt_client_task, "MQTT Client task", MQTT_CLIENT_TASK_STACK_SIZE, NULL, MQTT_CLIENT_TASK_PRIORITY, NULL);
+    APP_TASK_CREATE(mqtt_client_task, mqtt_client_task, "MQTT Client task", MQTT_CLIENT_TASK_STACK_SIZE, NULL, MQTT_CLIENT_TASK_PRIORITY, NULL);
     
     BaseType_t xReturned;
     //Create temperature sensor task
-    xReturned = xTaskCreate(wire_process, "Temperature task", 2048, NULL, 1, NULL);
+    xReturned = APP_TASK_CREATE(wire_task, wire_process, "Temperature task", WIRE_TASK_STACK_SIZE,
+                                NULL, WIRE_TASK_PRIORITY, &wire_task_handle);
     if (xReturned == pdPASS){
         printf("Temp task created.");
     }
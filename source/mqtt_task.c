@@ -59,6 +59,7 @@
 /* Configuration file for Wi-Fi and MQTT client */
 #include "wifi_config.h"
 #include "mqtt_client_config.h"
+#include "app_alloc.h"
 
 /* Middleware libraries */
 #include "cy_retarget_io.h"
@@ -132,6 +133,16 @@ uint32_t status_flag;
  */
 uint8_t *mqtt_network_buffer = NULL;
 
+#if APP_STATIC_ALLOCATION
+/* Reused by every mqtt_init(), the heap is never touched */
+static uint8_t mqtt_network_buffer_storage[MQTT_NETWORK_BUFFER_SIZE];
+#endif /* APP_STATIC_ALLOCATION */
+
+/* Task and queue storage, see app_alloc.h */
+APP_TASK_DEFINE(subscriber_task, SUBSCRIBER_TASK_STACK_SIZE);
+APP_TASK_DEFINE(publisher_task, PUBLISHER_TASK_STACK_SIZE);
+APP_QUEUE_DEFINE(mqtt_task_q, MQTT_TASK_QUEUE_LENGTH, sizeof(mqtt_task_cmd_t));
+
 /******************************************************************************
 * Function Prototypes
 *******************************************************************************/
@@ -179,7 +190,7 @@ void mqtt_client_task(void *pvParameters)
     (void) pvParameters;
 
     /* Create a message queue to communicate with other tasks and callbacks. */
-    mqtt_task_q = xQueueCreate(MQTT_TASK_QUEUE_LENGTH, sizeof(mqtt_task_cmd_t));
+    mqtt_task_q = APP_QUEUE_CREATE(mqtt_task_q, MQTT_TASK_QUEUE_LENGTH, sizeof(mqtt_task_cmd_t));
 
     /* Initialize the Wi-Fi Connection Manager and jump to the cleanup block 
      * upon failure.
@@ -211,8 +222,8 @@ void mqtt_client_task(void *pvParameters)
     }
 
     /* Create the subscriber task and cleanup if the operation fails. */
-    if (pdPASS != xTaskCreate(subscriber_task, "Subscriber task", SUBSCRIBER_TASK_STACK_SIZE,
-                              NULL, SUBSCRIBER_TASK_PRIORITY, &subscriber_task_handle))
+    if (pdPASS != APP_TASK_CREATE(subscriber_task, subscriber_task, "Subscriber task", SUBSCRIBER_TASK_STACK_SIZE,
+                                  NULL, SUBSCRIBER_TASK_PRIORITY, &subscriber_task_handle))
     {
         printf("Failed to create the Subscriber task!\n");
         goto exit_cleanup;
@@ -222,8 +233,8 @@ void mqtt_client_task(void *pvParameters)
     vTaskDelay(pdMS_TO_TICKS(TASK_CREATION_DELAY_MS));
 
     /* Create the publisher task and cleanup if the operation fails. */
-    if (pdPASS != xTaskCreate(publisher_task, "Publisher task", PUBLISHER_TASK_STACK_SIZE, 
-                              NULL, PUBLISHER_TASK_PRIORITY, &publisher_task_handle))
+    if (pdPASS != APP_TASK_CREATE(publisher_task, publisher_task, "Publisher task", PUBLISHER_TASK_STACK_SIZE,
+                                  NULL, PUBLISHER_TASK_PRIORITY, &publisher_task_handle))
     {
         printf("Failed to create Publisher task!\n");
         goto exit_cleanup;
@@ -419,7 +430,11 @@ static cy_rslt_t mqtt_init(void)
     CHECK_RESULT(result, LIBS_INITIALIZED, "\nMQTT library initialization failed!\n");
 
     /* Allocate buffer for MQTT send and receive operations. */
+#if APP_STATIC_ALLOCATION
+    mqtt_network_buffer = mqtt_network_buffer_storage;
+#else
     mqtt_network_buffer = (uint8_t *) pvPortMalloc(sizeof(uint8_t) * MQTT_NETWORK_BUFFER_SIZE);
+#endif /* APP_STATIC_ALLOCATION */
     if(mqtt_network_buffer == NULL)
     {
         result = ~CY_RSLT_SUCCESS;
@@ -690,7 +705,10 @@ static void cleanup(void)
     /* Deallocate the network buffer. */
     if (status_flag & BUFFER_INITIALIZED)
     {
+#if !APP_STATIC_ALLOCATION
         vPortFree((void *) mqtt_network_buffer);
+#endif /* !APP_STATIC_ALLOCATION */
+        mqtt_network_buffer = NULL;
     }
     /* Deinit the MQTT library. */
     if (status_flag & LIBS_INITIALIZED)
@@ -5,21 +5,25 @@
 #include "functions.h"
 #include "macros.h"
 
-cyhal_gpio_callback_data_t gpio_flow_pin_callback_data;
+/* FreeRTOS header files */
+#include "FreeRTOS.h"
+#include "task.h"
+
 cyhal_gpio_callback_data_t gpio_temp_pin_callback_data;
 
+#if !WIRE_BUS_UART
 //GPIO 1-Wire ISR
 static void isr_wire(void *callback_arg, cyhal_gpio_event_t event);
+#endif
 
 extern volatile transaction_t transaction;
-extern bool wire_initialized;
 
 
 void gpio_init()
 {
 	// GPIO INITIALIZATION
 	cy_rslt_t result;
-	result = cyhal_gpio_init(PH_FET, CYHAL_GPIO_DIR_OUTPUT, CYHAL_GPIO_DRIVE_STRONG, true);
+	result = cyhal_gpio_init(PH_FET, CYHAL_GPIO_DIR_OUTPUT, CYHAL_GPIO_DRIVE_STRONG, false);	//Switched by probe_scheduler.c
 	if(result != CY_RSLT_SUCCESS)
 	{
 	        printf("GPIO initialization failed. Error: %ld\n", (long unsigned int)result);
@@ -37,6 +41,12 @@ void gpio_init()
 	    	printf("ADC initialization failed. Error: %ld\n", (long unsigned int)result);
 	        CY_ASSERT(0);
 	}
+	result = cyhal_gpio_init(DOSE_PUMP_A, CYHAL_GPIO_DIR_OUTPUT, CYHAL_GPIO_DRIVE_STRONG, false);
+	if(result != CY_RSLT_SUCCESS)
+	{
+	    	printf("Dosing pump GPIO initialization failed. Error: %ld\n", (long unsigned int)result);
+	        CY_ASSERT(0);
+	}
 
 	    /* Initialize the User LED */
     result = cyhal_gpio_init(CYBSP_USER_LED, CYHAL_GPIO_DIR_OUTPUT, CYHAL_GPIO_DRIVE_STRONG, CYBSP_LED_STATE_OFF);
@@ -54,6 +64,13 @@ void gpio_init()
         CY_ASSERT(0);
     }
 
+    /* Flow pulses are counted by TCPWM counters, not a GPIO interrupt */
+    flow_sensor_init();
+
+#if WIRE_BUS_UART
+    /* The 1-Wire bus runs on the SCB UART, TEMP_PIN is not used */
+    wire_uart_init();
+#else
      /* Initialize GPIO Temperature Sensor Input/Output */
     result = cyhal_gpio_init(TEMP_PIN, CYHAL_GPIO_DIR_BIDIRECTIONAL, CYHAL_GPIO_DRIVE_PULLUP, 1);
     /* GPIO init failed. Stop program execution */
@@ -63,37 +80,31 @@ void gpio_init()
     }
 
     /* Configure GPIO interrupt */
-    // gpio_flow_pin_callback_data.callback = isr_counter;
     gpio_temp_pin_callback_data.callback = isr_wire;
-    
-    // cyhal_gpio_register_callback(FLOW_PIN, &gpio_flow_pin_callback_data);
-    // cyhal_gpio_enable_event(FLOW_PIN, CYHAL_GPIO_IRQ_RISE, 7u, true);
 
     cyhal_gpio_register_callback(TEMP_PIN, &gpio_temp_pin_callback_data);
     cyhal_gpio_enable_event(TEMP_PIN, CYHAL_GPIO_IRQ_BOTH, 7u, true);
+#endif /* WIRE_BUS_UART */
 }
 
+#if !WIRE_BUS_UART
 //isr_wire
 //gpio interrupt service routine for 1-wire temperature sensor pin.
+//A falling edge inside the presence window wakes the temperature task.
 void isr_wire(void *callback_arg, cyhal_gpio_event_t event)
 {
     switch (event){
         case CYHAL_GPIO_IRQ_RISE:
-            if (transaction == PRESENSE){
-                // ringBuffer[1] = cyhal_timer_read(&wire_timer);
-                // cyhal_gpio_enable_event(TEMP_PIN, CYHAL_GPIO_IRQ_BOTH, 7u, false);
-            }
         break;
         case CYHAL_GPIO_IRQ_FALL:
             if (transaction == PRESENSE){
-                wire_initialized = true;
-                transaction++;
+                wire_notify_from_isr(WIRE_EVT_PRESENCE);
             }
-            // printf("Wire Fall\r\n");
         break;
             default:
         break;
     }
     (void) callback_arg;
     (void) event;
-}
\ No newline at end of file
+}
+#endif /* !WIRE_BUS_UART */
@@ -0,0 +1,192 @@
+/******************************************************************************
+* File Name:   probe_scheduler.c
+*
+* Description: This file contains the probe scheduler. The pH and EC probes
+*              share the solution, so only one of them is powered at a time.
+*              Each turn switches the probe's FET on, waits out its settling
+*              time, and then opens its valid window; the ADC only reports
+*              the probe's scans inside that window. At the end of the
+*              window the FET goes off and, after a short gap with both off,
+*              the other probe's turn starts.
+*
+*              probe_timer is a one-shot on the timer service that expires
+*              at each step, so the switching does not wait for the publish
+*              tick. A probe whose window is 0 is skipped, and the other
+*              one then stays powered and valid without settling again.
+*
+* Related Document: See README.md
+*
+*******************************************************************************/
+
+#include "cyhal.h"
+#include "cybsp.h"
+
+/* FreeRTOS header files */
+#include "FreeRTOS.h"
+#include "task.h"
+
+#include "functions.h"
+#include "macros.h"
+#include "probe_scheduler.h"
+#include "timer_service.h"
+
+/******************************************************************************
+* Global Variables
+*******************************************************************************/
+extern timer_service_timer_t probe_timer;
+
+typedef enum
+{
+    PROBE_STEP_GAP = 0,         /* Both off, next probe switches on at expiry */
+    PROBE_STEP_SETTLING,
+    PROBE_STEP_VALID
+} probe_step_t;
+
+static const cyhal_gpio_t probe_fet[ADC_NUM_CHANNELS] =
+{
+    [ADC_CHANNEL_PH] = PH_FET,
+    [ADC_CHANNEL_EC] = EC_FET
+};
+
+static const uint32_t probe_settle_ms[ADC_NUM_CHANNELS] =
+{
+    [ADC_CHANNEL_PH] = PROBE_PH_TAU_MS * PROBE_SETTLE_TAUS,
+    [ADC_CHANNEL_EC] = PROBE_EC_TAU_MS * PROBE_SETTLE_TAUS
+};
+
+static volatile uint32_t probe_window_ms[ADC_NUM_CHANNELS] =
+{
+    [ADC_CHANNEL_PH] = PROBE_PH_WINDOW_MS,
+    [ADC_CHANNEL_EC] = PROBE_EC_WINDOW_MS
+};
+
+static probe_step_t probe_step = PROBE_STEP_GAP;
+static uint32_t probe_active = ADC_CHANNEL_PH;     /* Probe of the current turn */
+static volatile uint8_t probe_valid_mask = 0;
+
+/* The probe whose turn follows the active one */
+static uint32_t probe_next(void)
+{
+    uint32_t other = (probe_active + 1u) % ADC_NUM_CHANNELS;
+
+    return (probe_window_ms[other] != 0u) ? other : probe_active;
+}
+
+/******************************************************************************
+ * Function Name: probe_scheduler_init
+ ******************************************************************************
+ * Summary:
+ *  Switches both probes off and starts the first turn after the gap, with
+ *  the pH probe unless its window is 0. Called after gpio_init() and
+ *  timer_init().
+ *
+ ******************************************************************************/
+void probe_scheduler_init(void)
+{
+    for (uint32_t channel = 0; channel < ADC_NUM_CHANNELS; channel++)
+    {
+        cyhal_gpio_write(probe_fet[channel], false);
+    }
+
+    probe_active = (probe_window_ms[ADC_CHANNEL_PH] != 0u) ? ADC_CHANNEL_PH : ADC_CHANNEL_EC;
+    probe_step = PROBE_STEP_GAP;
+    probe_valid_mask = 0;
+    timer_service_start(&probe_timer, PROBE_SWITCH_GAP_US, 0);
+}
+
+/******************************************************************************
+ * Function Name: probe_timer_expired_from_isr
+ ******************************************************************************
+ * Summary:
+ *  Moves the active probe to its next step and arms probe_timer for the
+ *  one after. Called from the timer callback.
+ *
+ ******************************************************************************/
+void probe_timer_expired_from_isr(void)
+{
+    uint32_t next;
+
+    switch (probe_step)
+    {
+        case PROBE_STEP_GAP:
+        {
+            cyhal_gpio_write(probe_fet[probe_active], true);
+            probe_step = PROBE_STEP_SETTLING;
+            timer_service_start_from_isr(&probe_timer, probe_settle_ms[probe_active] * 1000u, 0);
+            break;
+        }
+        case PROBE_STEP_SETTLING:
+        {
+            /* Earlier scans describe the probe still settling */
+            adc_filter_reset(probe_active);
+            probe_valid_mask = (uint8_t)(1u << probe_active);
+            probe_step = PROBE_STEP_VALID;
+            timer_service_start_from_isr(&probe_timer, probe_window_ms[probe_active] * 1000u, 0);
+            break;
+        }
+        case PROBE_STEP_VALID:
+        default:
+        {
+            next = probe_next();
+            if ((next == probe_active) && (probe_window_ms[next] != 0u))
+            {
+                /* Only probe in use, it stays on and settled */
+                timer_service_start_from_isr(&probe_timer, probe_window_ms[next] * 1000u, 0);
+                break;
+            }
+
+            probe_valid_mask = 0;
+            cyhal_gpio_write(probe_fet[probe_active], false);
+            probe_active = next;
+            probe_step = PROBE_STEP_GAP;
+            timer_service_start_from_isr(&probe_timer, PROBE_SWITCH_GAP_US, 0);
+            break;
+        }
+    }
+}
+
+/******************************************************************************
+ * Function Name: probe_scheduler_valid
+ ******************************************************************************
+ * Summary:
+ *  Tells the ADC whether a channel's scans can be used. Safe from the ADC
+ *  interrupt.
+ *
+ ******************************************************************************/
+bool probe_scheduler_valid(uint32_t channel)
+{
+    return (channel < ADC_NUM_CHANNELS) && ((probe_valid_mask & (1u << channel)) != 0u);
+}
+
+/******************************************************************************
+ * Function Name: probe_scheduler_window_set
+ ******************************************************************************
+ * Summary:
+ *  Sets a probe's valid window, from a command. It applies from the
+ *  probe's next turn.
+ *
+ * Parameters:
+ *  uint32_t channel : ADC_CHANNEL_PH or ADC_CHANNEL_EC
+ *  uint32_t window_ms : settled time per turn, 0 leaves the probe off
+ *
+ * Return:
+ *  bool : false for an unknown probe, a window over PROBE_WINDOW_MAX_MS, or
+ *         a 0 that would leave both probes off
+ *
+ ******************************************************************************/
+bool probe_scheduler_window_set(uint32_t channel, uint32_t window_ms)
+{
+    if ((channel >= ADC_NUM_CHANNELS) || (window_ms > PROBE_WINDOW_MAX_MS))
+    {
+        return false;
+    }
+    if ((window_ms == 0u) && (probe_window_ms[(channel + 1u) % ADC_NUM_CHANNELS] == 0u))
+    {
+        return false;
+    }
+
+    probe_window_ms[channel] = window_ms;
+    return true;
+}
+
+/* [] END OF FILE */
@@ -0,0 +1,53 @@
+/******************************************************************************
+* File Name:   probe_scheduler.h
+*
+* Description: This file is the public interface of probe_scheduler.c, which
+*              powers the pH and EC probes in turn and tells the ADC when
+*              each probe has settled.
+*
+* Related Document: See README.md
+*
+*******************************************************************************/
+
+#ifndef PROBE_SCHEDULER_H_
+#define PROBE_SCHEDULER_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/*******************************************************************************
+* Macros
+********************************************************************************/
+/* Front end time constant after its FET switches on. A probe is read after
+ * PROBE_SETTLE_TAUS time constants, when the step is within 0.05 %. */
+#define PROBE_PH_TAU_MS                   (250u)
+#define PROBE_EC_TAU_MS                   (250u)
+#define PROBE_SETTLE_TAUS                 (8u)
+
+/* Settled time per turn, the duty cycle of each probe. A longer window
+ * spends less of the cycle settling but leaves the other probe dark for
+ * longer. 0 leaves a probe off, so the other one is read all the time. */
+#define PROBE_PH_WINDOW_MS                (6000u)
+#define PROBE_EC_WINDOW_MS                (6000u)
+#define PROBE_WINDOW_MAX_MS               (600u * 1000u)
+
+/* Both FETs are off this long between turns, so the probes never share
+ * the solution */
+#define PROBE_SWITCH_GAP_US               (1000u)
+
+/*******************************************************************************
+* Function Prototypes
+********************************************************************************/
+void probe_scheduler_init(void);
+void probe_timer_expired_from_isr(void);
+
+/* True while the probe on ADC channel 'channel' is powered and settled */
+bool probe_scheduler_valid(uint32_t channel);
+
+/* Sets a probe's window from the next turn. Fails if it would leave both
+ * probes off. */
+bool probe_scheduler_window_set(uint32_t channel, uint32_t window_ms);
+
+#endif /* PROBE_SCHEDULER_H_ */
+
+/* [] END OF FILE */
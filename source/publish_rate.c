@@ -0,0 +1,147 @@
+/******************************************************************************
+* File Name:   publish_rate.c
+*
+* Description: This file contains the adaptive telemetry rate. The publish
+*              tick still runs every second for the control loops; this
+*              only decides which ticks become telemetry records.
+*
+*              Each signal keeps a rolling window of its last readings with
+*              a running sum and sum of squares, so the variance costs one
+*              update per reading. While every signal stays quiet the
+*              interval between records doubles each PUBLISH_RATE_HOLD_TICKS
+*              up to the heartbeat, PUBLISH_RATE_INTERVAL_MAX. A disturbed
+*              signal, a running pump or a dose mixing in brings it back to
+*              every tick at once.
+*
+* Related Document: See README.md
+*
+*******************************************************************************/
+
+#include "publish_rate.h"
+
+/******************************************************************************
+* Global Variables
+*******************************************************************************/
+typedef struct
+{
+    int32_t ring[PUBLISH_RATE_WINDOW];
+    uint32_t head;
+    uint32_t count;
+    int64_t sum;
+    int64_t sum_sq;
+} publish_rate_window_t;
+
+static const int64_t variance_limit[PUBLISH_RATE_SIGNALS] =
+{
+    [PUBLISH_RATE_PH] = (int64_t)PUBLISH_RATE_PH_STD_MV * PUBLISH_RATE_PH_STD_MV,
+    [PUBLISH_RATE_EC] = (int64_t)PUBLISH_RATE_EC_STD_MV * PUBLISH_RATE_EC_STD_MV,
+    [PUBLISH_RATE_TEMP] = (int64_t)PUBLISH_RATE_TEMP_STD_CDEG * PUBLISH_RATE_TEMP_STD_CDEG
+};
+
+static publish_rate_window_t windows[PUBLISH_RATE_SIGNALS];
+
+static volatile bool adaptive = PUBLISH_RATE_ADAPTIVE_DEFAULT;
+static uint32_t interval = 1;       /* Ticks per record */
+static uint32_t ticks_since_record = 0;
+static uint32_t quiet_ticks = 0;
+
+void publish_rate_sample(publish_rate_signal_t signal, int32_t value)
+{
+    publish_rate_window_t *w;
+
+    if (signal >= PUBLISH_RATE_SIGNALS)
+    {
+        return;
+    }
+    w = &windows[signal];
+
+    if (w->count == PUBLISH_RATE_WINDOW)
+    {
+        int32_t oldest = w->ring[w->head];
+
+        w->sum -= oldest;
+        w->sum_sq -= (int64_t)oldest * oldest;
+    }
+    else
+    {
+        w->count++;
+    }
+
+    w->ring[w->head] = value;
+    w->head = (w->head + 1u) % PUBLISH_RATE_WINDOW;
+    w->sum += value;
+    w->sum_sq += (int64_t)value * value;
+}
+
+/* n^2 * variance = n * sum_sq - sum^2, compared without dividing */
+static bool publish_rate_disturbed(const publish_rate_window_t *w, int64_t limit)
+{
+    int64_t n = (int64_t)w->count;
+
+    if (n < 2)
+    {
+        return false;
+    }
+    return ((n * w->sum_sq) - (w->sum * w->sum)) > (limit * n * n);
+}
+
+/******************************************************************************
+ * Function Name: publish_rate_tick
+ ******************************************************************************
+ * Summary:
+ *  Updates the interval from the windows and says whether this tick's
+ *  record is taken.
+ *
+ * Parameters:
+ *  bool active : pumps running or a dose mixing in
+ *  bool *burst : set when the interval has just dropped back to 1
+ *
+ * Return:
+ *  bool : true when a record is due
+ *
+ ******************************************************************************/
+bool publish_rate_tick(bool active, bool *burst)
+{
+    bool disturbed = active;
+
+    for (uint32_t s = 0; (s < PUBLISH_RATE_SIGNALS) && !disturbed; s++)
+    {
+        disturbed = publish_rate_disturbed(&windows[s], variance_limit[s]);
+    }
+
+    *burst = false;
+    if (!adaptive || disturbed)
+    {
+        *burst = adaptive && (interval > 1u);
+        interval = 1;
+        quiet_ticks = 0;
+    }
+    else if (++quiet_ticks >= PUBLISH_RATE_HOLD_TICKS)
+    {
+        quiet_ticks = 0;
+        if (interval < PUBLISH_RATE_INTERVAL_MAX)
+        {
+            interval *= 2u;
+        }
+    }
+
+    if (*burst || (++ticks_since_record >= interval))
+    {
+        ticks_since_record = 0;
+        return true;
+    }
+    return false;
+}
+
+uint32_t publish_rate_interval(void)
+{
+    return interval;
+}
+
+/* From the "adaptive" command; off takes a record every tick */
+void publish_rate_adaptive_set(bool enable)
+{
+    adaptive = enable;
+}
+
+/* [] END OF FILE */
@@ -0,0 +1,67 @@
+/******************************************************************************
+* File Name:   publish_rate.h
+*
+* Description: This file is the public interface of publish_rate.c, which
+*              decides on each publish tick whether a telemetry record is
+*              taken, from the recent variance of the readings.
+*
+* Related Document: See README.md
+*
+*******************************************************************************/
+
+#ifndef PUBLISH_RATE_H_
+#define PUBLISH_RATE_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/*******************************************************************************
+* Macros
+********************************************************************************/
+/* Readings kept per signal for the rolling variance, power of 2 */
+#define PUBLISH_RATE_WINDOW               (16u)
+
+/* A signal is disturbed while its standard deviation over the window is
+ * above these. Probe noise after the ADC filter is well below them. */
+#define PUBLISH_RATE_PH_STD_MV            (3)
+#define PUBLISH_RATE_EC_STD_MV            (10)
+#define PUBLISH_RATE_TEMP_STD_CDEG        (10)
+
+/* Ticks between records at the slow heartbeat. With TELEMETRY_BATCH_SIZE
+ * records per message, a quiet reservoir publishes every 160 s. */
+#define PUBLISH_RATE_INTERVAL_MAX         (16u)
+
+/* Quiet ticks before the interval doubles again */
+#define PUBLISH_RATE_HOLD_TICKS           (30u)
+
+/* Adaptive mode at boot, the "adaptive" command changes it */
+#define PUBLISH_RATE_ADAPTIVE_DEFAULT     (true)
+
+/*******************************************************************************
+* Global Variables
+********************************************************************************/
+typedef enum
+{
+    PUBLISH_RATE_PH = 0,
+    PUBLISH_RATE_EC,
+    PUBLISH_RATE_TEMP,
+    PUBLISH_RATE_SIGNALS
+} publish_rate_signal_t;
+
+/*******************************************************************************
+* Function Prototypes
+********************************************************************************/
+/* New readings, from publisher_task */
+void publish_rate_sample(publish_rate_signal_t signal, int32_t value);
+
+/* Once per publish tick. 'active' is true while pumps run or a dose mixes
+ * in. Returns true when this tick's record is taken; 'burst' is set on the
+ * tick the rate goes back to every tick, to flush the batch. */
+bool publish_rate_tick(bool active, bool *burst);
+
+uint32_t publish_rate_interval(void);
+void publish_rate_adaptive_set(bool adaptive);
+
+#endif /* PUBLISH_RATE_H_ */
+
+/* [] END OF FILE */
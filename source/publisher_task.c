@@ -62,6 +62,18 @@
 
 #include "functions.h"
 #include "macros.h"
+#include "telemetry.h"
+#include "journal.h"
+#include "pump_scheduler.h"
+#include "dosing_control.h"
+#include "calibration.h"
+#include "publish_rate.h"
+#include "report_filter.h"
+#include "runtime_stats.h"
+#include "timer_service.h"
+#include "dlog.h"
+#include "app_alloc.h"
+#include "heap_trace.h"
 
 /******************************************************************************
 * Macros
@@ -81,17 +93,20 @@
 #define PUBLISHER_TASK_QUEUE_LENGTH     (3u)
 
 
-/* LED blink timer clock value in Hz  */
-// #define LED_BLINK_TIMER_CLOCK_HZ          (5000)
-
-/* LED blink timer period value */
-#define LED_BLINK_TIMER_PERIOD            (9999)
+/* Journalled frames published per publish tick once the broker is back,
+ * so the backlog does not starve the live telemetry */
+#define JOURNAL_DRAIN_PER_TICK          (3u)
 
 /******************************************************************************
 * Function Prototypes
 *******************************************************************************/
 // static void publisher_init(void);
 void print_heap_usage(char *msg);
+void log_heap_usage(dlog_id_t id);
+static void publish_telemetry_batch(uint32_t timestamp_ms);
+static void publish_journal_backlog(void);
+static void publish_runtime_stats(void);
+static void publish_heap_trace(void);
 // void timer_init(void);
 /* Multichannel initialization function */
 
@@ -104,8 +119,10 @@ TaskHandle_t publisher_task_handle;
 
 /* Handle of the queue holding the commands for the publisher task */
 QueueHandle_t publisher_task_q;
+APP_QUEUE_DEFINE(publisher_task_q, PUBLISHER_TASK_QUEUE_LENGTH, sizeof(publisher_data_t));
 
-/* Structure to store publish message information. */
+/* Structure to store publish message information. The topic is set to the
+ * per-device telemetry topic when the task starts. */
 cy_mqtt_publish_info_t publish_info =
 {
     .qos = (cy_mqtt_qos_t) MQTT_MESSAGES_QOS,
@@ -115,6 +132,33 @@ cy_mqtt_publish_info_t publish_info =
     .dup = false
 };
 
+/* Encoded telemetry batch, kept off the task stack */
+static uint8_t telemetry_payload[TELEMETRY_PAYLOAD_MAX_LEN];
+
+/* Diagnostics go to their own topic, set when the task starts */
+static cy_mqtt_publish_info_t diag_publish_info =
+{
+    .qos = (cy_mqtt_qos_t) MQTT_MESSAGES_QOS,
+    .retain = false,
+    .dup = false
+};
+
+static uint8_t diag_payload[RUNTIME_STATS_PAYLOAD_MAX_LEN];
+static uint8_t heap_payload[HEAP_TRACE_PAYLOAD_MAX_LEN];
+static uint32_t diag_ticks = 0;
+
+/* Cleared between PUBLISHER_DEINIT and PUBLISHER_INIT while the MQTT task
+ * reconnects. Batches made in that time go to the journal. */
+static bool publisher_online = true;
+
+/* Last reading of each probe taken while it was powered */
+static int32_t last_ph_mv = 0;
+static int32_t last_ec_mv = 0;
+
+/* Bit per ADC channel, set once its probe has given a reading. Until then
+ * last_*_mv hold no reading and are not calibrated. */
+static uint8_t probes_read = 0;
+
 
 
 /*******************************************************************************
@@ -127,24 +171,15 @@ uint8_t uart_read_value;
 /* Variable for storing character read from terminal */
 uint8_t uart_read_value;
 
-/* Timer object used for blinking the LED */
-extern cyhal_timer_t led_blink_timer;
-extern cyhal_timer_t pump_timer;
+/* Publish tick, run by the timer service */
+extern timer_service_timer_t publish_tick_timer;
 
 // FLAGS
-bool EC_active = false;
-bool pH_active = true;
 extern bool timer_interrupt_flag;
 extern bool led_blink_active_flag;
 
-extern volatile transaction_t transaction;
-
 // timer increment variables
 int timerCount = 0;
-int pumpCountUp = 0;
-
-int pumpsOn = 0;
-int pumpSeconds = 0;
 
 /******************************************************************************
  * Function Name: publisher_task
@@ -167,22 +202,19 @@ void publisher_task(void *pvParameters)
 
     publisher_data_t publisher_q_data;
 
-    /* Command to the MQTT client task */
-    mqtt_task_cmd_t mqtt_task_cmd;
-
     /* To avoid compiler warnings */
     (void) pvParameters;
 
-	cyhal_timer_start(&led_blink_timer);
-    // publisher_init();    //Removed, inits below
-    	// Initialize channel 0
-	// adc_multi_channel_init();
-	// timer_init();
-    // gpio_init();
-    
+    /* Create a message queue to communicate with other tasks and callbacks.
+     * Must exist before the timer starts, publish_timer() sends to it. */
+    publisher_task_q = APP_QUEUE_CREATE(publisher_task_q, PUBLISHER_TASK_QUEUE_LENGTH, sizeof(publisher_data_t));
+
+    publish_info.topic = telemetry_topic();
+    publish_info.topic_len = strlen(publish_info.topic);
+    diag_publish_info.topic = telemetry_diag_topic();
+    diag_publish_info.topic_len = strlen(diag_publish_info.topic);
 
-    /* Create a message queue to communicate with other tasks and callbacks. */
-    publisher_task_q = xQueueCreate(PUBLISHER_TASK_QUEUE_LENGTH, sizeof(publisher_data_t));
+	timer_service_start(&publish_tick_timer, PUBLISH_TICK_US, PUBLISH_TICK_US);
 
     // publisher_task is a task in scheduler, program execution doesn't get stuck in this loop
     // because it switches between this task and subscriber_task
@@ -195,109 +227,131 @@ void publisher_task(void *pvParameters)
             {
                 case PUBLISH_MQTT_MSG:
                 {
-                	//call function with timerCount as var
-
-                	// enables pH sensor if EC sensor has activated, pH is on by default.
-                	// will only activate after the first run through, at which point EC would become active
-                	if(timerCount < 6 && EC_active)
-                	{
-                		EC_active = false;
-                		pH_active = true;
-                		cyhal_gpio_write(PH_FET, true);
-                		cyhal_gpio_write(EC_FET, false);
-                		publish_info.topic = MQTT_PUB_TOPIC;
-                		publish_info.topic_len = (sizeof(MQTT_PUB_TOPIC) - 1);
-                	}
-                	// enables EC sensor
-                	// if 6 seconds have passed and pH is active start up the EC
-                	else if (timerCount >= 6 && pH_active)
-                	{
-                		EC_active = true;
-                		pH_active = false;
-                		cyhal_gpio_write(PH_FET, false);
-                		cyhal_gpio_write(EC_FET, true);
-                		publish_info.topic = MQTT_PUB_TOPIC_TWO;
-                		publish_info.topic_len = (sizeof(MQTT_PUB_TOPIC_TWO) - 1);
-                	}
-
-                	// reset timer count so timer can continue
+                	// restart the temperature conversion every 11 ticks
                 	if (timerCount >= 11)
                 	{
                 		timerCount = 0;
-						transaction = RESET;	//Reset temperature sensor
+						wire_request_conversion();	//Restart temperature conversion
                 	}
 
-                    /* Variable to store ADC conversion result from channel 0 */
-               	    int32_t adc_result_0 = 0;
+                    /* Sample of the current window, pH and EC in millivolts */
+               	    adc_sample_t sample;
 
-               	    /* Variable to store ADC conversion result from channel 1 */
-               	    int32_t adc_result_1 = 0;
-
-               	    /* Initiate an asynchronous read operation. The event handler will be called
-               	     * when it is complete. */
-               	    result = result_return();
+               	    /* Wait for the ADC window that completes after this tick, so the
+               	     * published value is never left over from the previous second. */
+               	    result = adc_sample_get(&sample, ADC_SAMPLE_TIMEOUT_MS);
                	    if(result != CY_RSLT_SUCCESS)
                	    {
-               	        printf("ADC async read failed. Error: %ld\n", (long unsigned int)result);
-               	        CY_ASSERT(0);
+               	        DLOG1(DLOG_MSG_ADC_SAMPLE_FAILED, result);
+               	        break;
                	    }
 
-               	    // if pumpSeconds topic has been written to, activate this block of code
-               	    if(pumpsOn == 1)
-               	     {
-               	     	cyhal_gpio_write(PUMP_ONE, true);
-               	     	pumpCountUp++;
-               	     	if(pumpCountUp == pumpSeconds)
-               	     	{
-               	     		pumpsOn = 0;
-               	     		pumpCountUp = 0;
-               	     		cyhal_gpio_write(PUMP_ONE, false);
-               	     	}
-               	     }
-
-               	    /*
-               	     * Read data from result list, input voltage in the result list is in
-               	     * microvolts. Convert it millivolts and print input voltage
-               	     *
-               	     */
-                    adc_result_0 = channel0_return();
-                	adc_result_1 = channel1_return();
-
-                    /* Publish the data received over the message queue. */
-                	//int32_t adc_result_0 = cyhal_adc_read_uv(&adc_chan_0_obj) / MICRO_TO_MILLI_CONV_RATIO;
-                	//char* buffer[20];
-					char buffer[20];
-
-                	// Depending on flag a certain value is written
-                	if(EC_active)
+                    /* probe_scheduler.c powers the probes in turn; a channel
+                     * only has a new reading if its probe was settled */
+                    probes_read |= sample.valid_mask;
+                	if (sample.valid_mask & (1u << ADC_CHANNEL_EC))
                 	{
-                		sprintf(buffer, "%d", (int)adc_result_1);
+                		last_ec_mv = sample.mv[ADC_CHANNEL_EC];
+                		publish_rate_sample(PUBLISH_RATE_EC, last_ec_mv);
                 	}
-                	else
+                	if (sample.valid_mask & (1u << ADC_CHANNEL_PH))
                 	{
-                		sprintf(buffer, "%d", (int)adc_result_0);
+                		last_ph_mv = sample.mv[ADC_CHANNEL_PH];
+                		publish_rate_sample(PUBLISH_RATE_PH, last_ph_mv);
                 	}
-                    publish_info.payload = buffer;
-                    publish_info.payload_len = strlen(publish_info.payload);
 
-                    printf("\nPublisher: Publishing '%s' on the topic '%s'\n", (char *) publish_info.payload, publish_info.topic);
+                    flow_sensor_update();
+
+                    telemetry_record_t record =
+                    {
+                        .timestamp_ms = sample.timestamp_ms,
+                        .ph_mv = last_ph_mv,
+                        .ec_mv = last_ec_mv,
+                        .flow_mlpm = flow_rate_get(),
+                        .flow_total_ml = flow_total_ml_get(),
+                        .pump_state = pump_state_mask()
+                    };
+                    record.temp_valid = wire_temperature_get(&record.temp_cdeg);
+                    record.ph_valid = ((probes_read & (1u << ADC_CHANNEL_PH)) != 0u) &&
+                                      calibration_ph(last_ph_mv, record.temp_valid, record.temp_cdeg, &record.ph_milli);
+                    record.ec_valid = ((probes_read & (1u << ADC_CHANNEL_EC)) != 0u) &&
+                                      calibration_ec(last_ec_mv, record.temp_valid, record.temp_cdeg, &record.ec_us);
+
+                    /* The loops run on fresh readings only, in calibrated
+                     * units once the probe has a calibration */
+                    if (sample.valid_mask & (1u << ADC_CHANNEL_EC))
+                    {
+                        dosing_control_update(DOSING_LOOP_EC, last_ec_mv, record.ec_valid, record.ec_us,
+                                              sample.timestamp_ms);
+                    }
+                    if (sample.valid_mask & (1u << ADC_CHANNEL_PH))
+                    {
+                        dosing_control_update(DOSING_LOOP_PH, last_ph_mv, record.ph_valid, record.ph_milli,
+                                              sample.timestamp_ms);
+                    }
+                    record.probe_count = wire_device_count();
+                    if (record.probe_count > TELEMETRY_MAX_PROBES)
+                    {
+                        record.probe_count = TELEMETRY_MAX_PROBES;
+                    }
+                    for (uint8_t p = 0; p < record.probe_count; p++)
+                    {
+                        if (wire_device_temperature_get(p, &record.probe_cdeg[p]))
+                        {
+                            record.probe_valid |= (uint8_t)(1u << p);
+                        }
+                    }
 
-                    // handle, publish info (type cy_mqtt_publish_info_t)
-                    result = cy_mqtt_publish(mqtt_connection, &publish_info);
+                    if (record.temp_valid)
+                    {
+                        publish_rate_sample(PUBLISH_RATE_TEMP, record.temp_cdeg);
+                    }
 
-                    if (result != CY_RSLT_SUCCESS)
+                    /* publish_rate.c takes a record every tick while anything
+                     * moves and every PUBLISH_RATE_INTERVAL_MAX ticks when the
+                     * reservoir is quiet, and report_filter.c drops the ones
+                     * inside the deadbands. The batch is published when full,
+                     * at once when the rate goes back up so the disturbance is
+                     * not held behind slow records, and at the silence limit. */
+                    bool burst;
+                    bool flush;
+                    bool active = (record.pump_state != 0u) ||
+                                  dosing_control_mixing(sample.timestamp_ms);
+                    if (publish_rate_tick(active, &burst) &&
+                        report_filter_keep(&record, burst, &flush))
                     {
-                        printf("  Publisher: MQTT Publish failed with error 0x%0X.\n\n", (int)result);
+                        if (telemetry_add(&record) || burst || flush)
+                        {
+                            publish_telemetry_batch(record.timestamp_ms);
+                        }
+                    }
+
+                    publish_journal_backlog();
 
-                        /* Communicate the publish failure with the the MQTT 
-                         * client task.
-                         */
-                        mqtt_task_cmd = HANDLE_MQTT_PUBLISH_FAILURE;
-                        xQueueSend(mqtt_task_q, &mqtt_task_cmd, portMAX_DELAY);
+                    if (++diag_ticks >= RUNTIME_STATS_PERIOD_S)
+                    {
+                        diag_ticks = 0;
+                        publish_runtime_stats();
                     }
 
-                    // is this the message that's printed after successful MQTT sending?
-                    print_heap_usage("publisher_task: After publishing an MQTT message");
+                    if (heap_trace_dump_pending())
+                    {
+                        publish_heap_trace();
+                    }
+                    break;
+                }
+                case PUBLISHER_INIT:
+                {
+                    publisher_online = true;
+                    if (journal_pending() > 0u)
+                    {
+                        DLOG1(DLOG_MSG_JOURNAL_DRAINING, journal_pending());
+                    }
+                    break;
+                }
+                case PUBLISHER_DEINIT:
+                {
+                    publisher_online = false;
                     break;
                 }
 				default: break;
@@ -306,5 +360,158 @@ void publisher_task(void *pvParameters)
     } // end of while loop
 } // end of publisher_task function
 
+/******************************************************************************
+ * Function Name: publish_runtime_stats
+ ******************************************************************************
+ * Summary:
+ *  Publishes the per-task CPU load, stack high-water marks and context
+ *  switch counts of the last RUNTIME_STATS_PERIOD_S seconds. Diagnostics
+ *  are not journalled while offline, the interval is restarted instead.
+ *
+ * Parameters:
+ *  void
+ *
+ * Return:
+ *  void
+ *
+ ******************************************************************************/
+static void publish_runtime_stats(void)
+{
+    diag_publish_info.payload = (const char *)diag_payload;
+    diag_publish_info.payload_len = runtime_stats_encode(diag_payload, sizeof(diag_payload));
+    if ((diag_publish_info.payload_len == 0) || !publisher_online)
+    {
+        return;
+    }
+
+    cy_rslt_t result = cy_mqtt_publish(mqtt_connection, &diag_publish_info);
+    if (result != CY_RSLT_SUCCESS)
+    {
+        DLOG1(DLOG_MSG_DIAG_PUBLISH_FAILED, result);
+    }
+}
+
+/******************************************************************************
+ * Function Name: publish_heap_trace
+ ******************************************************************************
+ * Summary:
+ *  Publishes the heap snapshot requested with the "heap_dump" command on
+ *  the diagnostics topic. The request is dropped when offline.
+ *
+ * Parameters:
+ *  void
+ *
+ * Return:
+ *  void
+ *
+ ******************************************************************************/
+static void publish_heap_trace(void)
+{
+    diag_publish_info.payload = (const char *)heap_payload;
+    diag_publish_info.payload_len = heap_trace_encode(heap_payload, sizeof(heap_payload));
+    if ((diag_publish_info.payload_len == 0) || !publisher_online)
+    {
+        return;
+    }
+
+    cy_rslt_t result = cy_mqtt_publish(mqtt_connection, &diag_publish_info);
+    if (result != CY_RSLT_SUCCESS)
+    {
+        DLOG1(DLOG_MSG_DIAG_PUBLISH_FAILED, result);
+    }
+}
+
+/******************************************************************************
+ * Function Name: publish_telemetry_batch
+ ******************************************************************************
+ * Summary:
+ *  Encodes the telemetry batch and publishes it, or stores it in the
+ *  journal when the broker is unreachable or the publish fails.
+ *
+ * Parameters:
+ *  uint32_t timestamp_ms : time of the last record, restarts the silence
+ *                          limit of report_filter.c
+ *
+ * Return:
+ *  void
+ *
+ ******************************************************************************/
+static void publish_telemetry_batch(uint32_t timestamp_ms)
+{
+    /* Status variable */
+    cy_rslt_t result = ~CY_RSLT_SUCCESS;
+
+    /* Command to the MQTT client task */
+    mqtt_task_cmd_t mqtt_task_cmd;
+
+    publish_info.payload = (const char *)telemetry_payload;
+    publish_info.payload_len = telemetry_encode(telemetry_payload, sizeof(telemetry_payload));
+    if (publish_info.payload_len == 0)
+    {
+        DLOG0(DLOG_MSG_BATCH_TOO_LARGE);
+        return;
+    }
+    report_filter_flushed(timestamp_ms);
+
+    if (publisher_online)
+    {
+        // handle, publish info (type cy_mqtt_publish_info_t)
+        result = cy_mqtt_publish(mqtt_connection, &publish_info);
+        if (result != CY_RSLT_SUCCESS)
+        {
+            DLOG1(DLOG_MSG_PUBLISH_FAILED, result);
+
+            /* Communicate the publish failure with the the MQTT
+             * client task.
+             */
+            mqtt_task_cmd = HANDLE_MQTT_PUBLISH_FAILURE;
+            xQueueSend(mqtt_task_q, &mqtt_task_cmd, portMAX_DELAY);
+        }
+    }
+
+    if (result != CY_RSLT_SUCCESS)
+    {
+        result = journal_append(telemetry_payload, publish_info.payload_len);
+        if (result != CY_RSLT_SUCCESS)
+        {
+            DLOG1(DLOG_MSG_JOURNAL_APPEND_FAILED, result);
+        }
+    }
+
+    log_heap_usage(DLOG_MSG_HEAP_PUBLISHER);
+}
+
+/******************************************************************************
+ * Function Name: publish_journal_backlog
+ ******************************************************************************
+ * Summary:
+ *  Publishes up to JOURNAL_DRAIN_PER_TICK journalled frames, oldest first.
+ *  A frame leaves the journal only after its publish succeeded.
+ *
+ * Parameters:
+ *  void
+ *
+ * Return:
+ *  void
+ *
+ ******************************************************************************/
+static void publish_journal_backlog(void)
+{
+    for (uint32_t i = 0; publisher_online && (i < JOURNAL_DRAIN_PER_TICK); i++)
+    {
+        publish_info.payload = (const char *)telemetry_payload;
+        publish_info.payload_len = journal_peek(telemetry_payload, sizeof(telemetry_payload));
+        if (publish_info.payload_len == 0)
+        {
+            return;
+        }
+        if (cy_mqtt_publish(mqtt_connection, &publish_info) != CY_RSLT_SUCCESS)
+        {
+            return;
+        }
+        (void) journal_consume();
+    }
+}
+
 
 /* [] END OF FILE */
@@ -0,0 +1,165 @@
+/******************************************************************************
+* File Name:   pump_scheduler.c
+*
+* Description: This file contains the pump scheduler. Each pump has an off
+*              deadline on the 1 ms RTOS tick, and pump_timer is armed as a
+*              one-shot on the timer service that expires at the nearest
+*              deadline, so run times do not depend on the publish tick or
+*              on how long a publish takes.
+*
+*              The timer only decides when to look; every expiry compares
+*              the deadlines with the tick count. A stale or early expiry
+*              therefore just re-arms the timer, so the timer can be
+*              restarted from a task at any moment.
+*
+* Related Document: See README.md
+*
+*******************************************************************************/
+
+#include "cy_pdl.h"
+#include "cyhal.h"
+#include "cybsp.h"
+
+/* FreeRTOS header files */
+#include "FreeRTOS.h"
+#include "task.h"
+
+#include "functions.h"
+#include "macros.h"
+#include "pump_scheduler.h"
+#include "timer_service.h"
+
+/******************************************************************************
+* Global Variables
+*******************************************************************************/
+extern timer_service_timer_t pump_timer;
+
+static const cyhal_gpio_t pump_pins[PUMP_COUNT] =
+{
+    [PUMP_MAIN] = PUMP_ONE,
+    [PUMP_DOSE_A] = DOSE_PUMP_A
+};
+
+/* Off deadline of each running pump, in RTOS ticks */
+static TickType_t pump_off_tick[PUMP_COUNT];
+static volatile uint8_t pump_on_mask = 0;
+
+/******************************************************************************
+ * Function Name: pump_scheduler_init
+ ******************************************************************************
+ * Summary:
+ *  Turns every pump off. pump_timer itself is set up in timer_init().
+ *
+ ******************************************************************************/
+void pump_scheduler_init(void)
+{
+    for (uint32_t pump = 0; pump < PUMP_COUNT; pump++)
+    {
+        cyhal_gpio_write(pump_pins[pump], false);
+    }
+    pump_on_mask = 0;
+}
+
+/******************************************************************************
+ * Function Name: pump_update
+ ******************************************************************************
+ * Summary:
+ *  Turns off every pump whose deadline has passed and arms pump_timer for
+ *  the nearest remaining one. The timer stays stopped while no pump runs.
+ *  Called from the timer callback, or from a task inside a critical
+ *  section. PUMP_RUN_MAX_MS in us still fits the 32-bit delay.
+ *
+ ******************************************************************************/
+static void pump_update(TickType_t now)
+{
+    uint32_t next_ms = PUMP_RUN_MAX_MS;
+
+    timer_service_stop_from_isr(&pump_timer);
+
+    for (uint32_t pump = 0; pump < PUMP_COUNT; pump++)
+    {
+        if ((pump_on_mask & (1u << pump)) == 0u)
+        {
+            continue;
+        }
+
+        int32_t remaining = (int32_t)(pump_off_tick[pump] - now);
+        if (remaining <= 0)
+        {
+            cyhal_gpio_write(pump_pins[pump], false);
+            pump_on_mask &= (uint8_t)~(1u << pump);
+        }
+        else if ((uint32_t)remaining * portTICK_PERIOD_MS < next_ms)
+        {
+            next_ms = (uint32_t)remaining * portTICK_PERIOD_MS;
+        }
+    }
+
+    if (pump_on_mask == 0u)
+    {
+        return;
+    }
+
+    timer_service_start_from_isr(&pump_timer, next_ms * 1000u, 0);
+}
+
+/* Called from the pump_timer callback */
+void pump_timer_expired_from_isr(void)
+{
+    pump_update(xTaskGetTickCountFromISR());
+}
+
+/******************************************************************************
+ * Function Name: pump_run
+ ******************************************************************************
+ * Summary:
+ *  Turns a pump on now and off after 'duration_ms'. A pump that is already
+ *  running gets the new off time. A duration of 0 turns it off.
+ *
+ * Parameters:
+ *  pump_id_t pump : pump to run
+ *  uint32_t duration_ms : run time, clamped to PUMP_RUN_MAX_MS
+ *
+ * Return:
+ *  cy_rslt_t : CY_RSLT_SUCCESS, or PUMP_RSLT_BAD_PUMP
+ *
+ ******************************************************************************/
+cy_rslt_t pump_run(pump_id_t pump, uint32_t duration_ms)
+{
+    TickType_t now;
+
+    if ((uint32_t)pump >= PUMP_COUNT)
+    {
+        return PUMP_RSLT_BAD_PUMP;
+    }
+    if (duration_ms > PUMP_RUN_MAX_MS)
+    {
+        duration_ms = PUMP_RUN_MAX_MS;
+    }
+
+    taskENTER_CRITICAL();
+    now = xTaskGetTickCount();
+    pump_off_tick[pump] = now + pdMS_TO_TICKS(duration_ms);
+    if (duration_ms != 0u)
+    {
+        pump_on_mask |= (uint8_t)(1u << pump);
+        cyhal_gpio_write(pump_pins[pump], true);
+    }
+    pump_update(now);
+    taskEXIT_CRITICAL();
+
+    return CY_RSLT_SUCCESS;
+}
+
+void pump_stop(pump_id_t pump)
+{
+    (void) pump_run(pump, 0);
+}
+
+/* Bit n set while pump n (pump_id_t) is running */
+uint8_t pump_state_mask(void)
+{
+    return pump_on_mask;
+}
+
+/* [] END OF FILE */
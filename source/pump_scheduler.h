@@ -0,0 +1,50 @@
+/******************************************************************************
+* File Name:   pump_scheduler.h
+*
+* Description: This file is the public interface of pump_scheduler.c, which
+*              switches the pumps on and off from the pump_timer callback.
+*
+* Related Document: See README.md
+*
+*******************************************************************************/
+
+#ifndef PUMP_SCHEDULER_H_
+#define PUMP_SCHEDULER_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "cyhal.h"
+
+/*******************************************************************************
+* Macros
+********************************************************************************/
+/* Longest single run, longer requests are clamped */
+#define PUMP_RUN_MAX_MS                   (3600u * 1000u)
+
+/* Returned by pump_run() for a pump that does not exist */
+#define PUMP_RSLT_BAD_PUMP                ((cy_rslt_t)0x04A00201u)
+
+/*******************************************************************************
+* Global Variables
+********************************************************************************/
+/* Pumps driven by the scheduler, also the bit order of pump_state_mask() */
+typedef enum
+{
+    PUMP_MAIN = 0,          /* PUMP_ONE */
+    PUMP_DOSE_A,            /* DOSE_PUMP_A */
+    PUMP_COUNT
+} pump_id_t;
+
+/*******************************************************************************
+* Function Prototypes
+********************************************************************************/
+void pump_scheduler_init(void);
+cy_rslt_t pump_run(pump_id_t pump, uint32_t duration_ms);
+void pump_stop(pump_id_t pump);
+uint8_t pump_state_mask(void);
+void pump_timer_expired_from_isr(void);
+
+#endif /* PUMP_SCHEDULER_H_ */
+
+/* [] END OF FILE */
@@ -0,0 +1,204 @@
+/******************************************************************************
+* File Name:   report_filter.c
+*
+* Description: This file contains the report-by-exception filter. Each
+*              record the publish rate takes is compared with the last
+*              record sent, and only goes into the batch if a reading has
+*              moved beyond its deadband, a validity bit or the pump state
+*              has changed, or the caller forces it.
+*
+*              A flat reservoir would otherwise never fill a batch, so once
+*              nothing has been published for the silence limit the current
+*              record is sent as a heartbeat and the batch goes out with it.
+*              Disturbances do not wait for it: publish_rate.c flushes the
+*              batch as soon as the readings start to move.
+*
+* Related Document: See README.md
+*
+*******************************************************************************/
+
+#include <stdlib.h>
+
+#include "report_filter.h"
+
+/******************************************************************************
+* Global Variables
+*******************************************************************************/
+static volatile uint32_t band[REPORT_METRIC_COUNT] =
+{
+    [REPORT_METRIC_PH] = REPORT_PH_BAND_MV,
+    [REPORT_METRIC_EC] = REPORT_EC_BAND_MV,
+    [REPORT_METRIC_TEMP] = REPORT_TEMP_BAND_CDEG,
+    [REPORT_METRIC_FLOW] = REPORT_FLOW_BAND_MLPM
+};
+
+static volatile uint32_t band_pct_x10[REPORT_METRIC_COUNT] =
+{
+    [REPORT_METRIC_PH] = REPORT_PH_BAND_PCT_X10,
+    [REPORT_METRIC_EC] = REPORT_EC_BAND_PCT_X10,
+    [REPORT_METRIC_TEMP] = REPORT_TEMP_BAND_PCT_X10,
+    [REPORT_METRIC_FLOW] = REPORT_FLOW_BAND_PCT_X10
+};
+
+static volatile uint32_t silence_ms = REPORT_SILENCE_DEFAULT_S * 1000u;
+
+static telemetry_record_t last_sent;
+static bool last_sent_valid = false;
+static uint32_t last_flush_ms = 0;
+static bool started = false;
+
+static report_stats_t stats;
+
+/* True when 'value' is outside the metric's band around 'sent' */
+static bool report_filter_moved(report_metric_t metric, int32_t value, int32_t sent)
+{
+    int64_t diff = llabs((int64_t)value - sent);
+    int64_t limit = ((int64_t)llabs(sent) * band_pct_x10[metric]) / 1000;
+
+    if (limit < (int64_t)band[metric])
+    {
+        limit = (int64_t)band[metric];
+    }
+    return diff > limit;
+}
+
+/* True when 'r' differs from the last record sent by more than the bands */
+static bool report_filter_changed(const telemetry_record_t *r)
+{
+    const telemetry_record_t *s = &last_sent;
+
+    if (!last_sent_valid ||
+        (r->pump_state != s->pump_state) ||
+        (r->temp_valid != s->temp_valid) ||
+        (r->ph_valid != s->ph_valid) ||
+        (r->ec_valid != s->ec_valid) ||
+        (r->probe_count != s->probe_count) ||
+        (r->probe_valid != s->probe_valid))
+    {
+        return true;
+    }
+
+    if (report_filter_moved(REPORT_METRIC_PH, r->ph_mv, s->ph_mv) ||
+        report_filter_moved(REPORT_METRIC_EC, r->ec_mv, s->ec_mv) ||
+        report_filter_moved(REPORT_METRIC_FLOW, (int32_t)r->flow_mlpm, (int32_t)s->flow_mlpm))
+    {
+        return true;
+    }
+
+    if (r->temp_valid && report_filter_moved(REPORT_METRIC_TEMP, r->temp_cdeg, s->temp_cdeg))
+    {
+        return true;
+    }
+    for (uint8_t p = 0; p < r->probe_count; p++)
+    {
+        if ((r->probe_valid & (1u << p)) &&
+            report_filter_moved(REPORT_METRIC_TEMP, r->probe_cdeg[p], s->probe_cdeg[p]))
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+/******************************************************************************
+ * Function Name: report_filter_keep
+ ******************************************************************************
+ * Summary:
+ *  Decides whether a record goes into the batch and keeps it as the
+ *  reference for the next ones if it does.
+ *
+ * Parameters:
+ *  const telemetry_record_t *record : readings of this tick
+ *  bool force : keep the record whatever the deadbands say
+ *  bool *flush : set when the silence limit has passed
+ *
+ * Return:
+ *  bool : true when the record is to be added to the batch
+ *
+ ******************************************************************************/
+bool report_filter_keep(const telemetry_record_t *record, bool force, bool *flush)
+{
+    bool changed;
+
+    if (!started)
+    {
+        started = true;
+        last_flush_ms = record->timestamp_ms;
+    }
+
+    *flush = ((record->timestamp_ms - last_flush_ms) >= silence_ms);
+    changed = force || report_filter_changed(record);
+
+    if (!changed && !*flush)
+    {
+        stats.suppressed++;
+        return false;
+    }
+
+    if (!changed)
+    {
+        stats.heartbeats++;
+    }
+    stats.records++;
+    last_sent = *record;
+    last_sent_valid = true;
+    return true;
+}
+
+/* Restarts the silence limit, from publisher_task after each batch */
+void report_filter_flushed(uint32_t timestamp_ms)
+{
+    stats.messages++;
+    last_flush_ms = timestamp_ms;
+    started = true;
+}
+
+/******************************************************************************
+ * Function Name: report_filter_band_set
+ ******************************************************************************
+ * Summary:
+ *  Sets a metric's absolute deadband, from a command. The units are those
+ *  of the record: mV, 0.01 C or mL/min.
+ *
+ * Return:
+ *  bool : false for an unknown metric or a band over REPORT_BAND_MAX
+ *
+ ******************************************************************************/
+bool report_filter_band_set(report_metric_t metric, uint32_t value)
+{
+    if ((metric >= REPORT_METRIC_COUNT) || (value > REPORT_BAND_MAX))
+    {
+        return false;
+    }
+    band[metric] = value;
+    return true;
+}
+
+/* Percent deadband in 0.1 % of the value last sent, from a command */
+bool report_filter_band_pct_set(report_metric_t metric, uint32_t pct_x10)
+{
+    if ((metric >= REPORT_METRIC_COUNT) || (pct_x10 > REPORT_BAND_PCT_X10_MAX))
+    {
+        return false;
+    }
+    band_pct_x10[metric] = pct_x10;
+    return true;
+}
+
+/* Silence limit, from a command */
+bool report_filter_silence_set(uint32_t seconds)
+{
+    if ((seconds < REPORT_SILENCE_MIN_S) || (seconds > REPORT_SILENCE_MAX_S))
+    {
+        return false;
+    }
+    silence_ms = seconds * 1000u;
+    return true;
+}
+
+void report_filter_stats_get(report_stats_t *out)
+{
+    *out = stats;
+}
+
+/* [] END OF FILE */
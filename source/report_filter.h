@@ -0,0 +1,84 @@
+/******************************************************************************
+* File Name:   report_filter.h
+*
+* Description: This file is the public interface of report_filter.c, which
+*              drops telemetry records whose readings have not moved beyond
+*              their deadband since the last record sent.
+*
+* Related Document: See README.md
+*
+*******************************************************************************/
+
+#ifndef REPORT_FILTER_H_
+#define REPORT_FILTER_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "telemetry.h"
+
+/*******************************************************************************
+* Macros
+********************************************************************************/
+/* Deadbands. A reading is reported once it moves more than the larger of
+ * the absolute band and the percent band (0.1 % units) of the value last
+ * sent. Both 0 reports every change. */
+#define REPORT_PH_BAND_MV                 (3u)      /* About 0.05 pH */
+#define REPORT_PH_BAND_PCT_X10            (0u)
+#define REPORT_EC_BAND_MV                 (10u)
+#define REPORT_EC_BAND_PCT_X10            (10u)     /* 1 % */
+#define REPORT_TEMP_BAND_CDEG             (10u)     /* Every probe */
+#define REPORT_TEMP_BAND_PCT_X10          (0u)
+#define REPORT_FLOW_BAND_MLPM             (50u)
+#define REPORT_FLOW_BAND_PCT_X10          (50u)     /* 5 % */
+#define REPORT_BAND_MAX                   (100000u)
+#define REPORT_BAND_PCT_X10_MAX           (1000u)
+
+/* Longest time without a telemetry message. Once it passes, the current
+ * record is sent and the batch is published, whatever the deadbands say. */
+#define REPORT_SILENCE_DEFAULT_S          (300u)
+#define REPORT_SILENCE_MIN_S              (10u)
+#define REPORT_SILENCE_MAX_S              (86400u)
+
+/*******************************************************************************
+* Global Variables
+********************************************************************************/
+typedef enum
+{
+    REPORT_METRIC_PH = 0,
+    REPORT_METRIC_EC,
+    REPORT_METRIC_TEMP,
+    REPORT_METRIC_FLOW,
+    REPORT_METRIC_COUNT
+} report_metric_t;
+
+/* Counters since boot, for the diagnostics topic */
+typedef struct
+{
+    uint32_t messages;          /* Batches published or journalled */
+    uint32_t records;           /* Records added to a batch */
+    uint32_t suppressed;        /* Records dropped inside the deadbands */
+    uint32_t heartbeats;        /* Records sent because of the silence limit */
+} report_stats_t;
+
+/*******************************************************************************
+* Function Prototypes
+********************************************************************************/
+/* Once per record the publish rate takes. 'force' keeps it regardless of
+ * the deadbands. Returns true to add it to the batch; 'flush' is set when
+ * the silence limit has passed and the batch must be published. */
+bool report_filter_keep(const telemetry_record_t *record, bool force, bool *flush);
+
+/* After each batch is published or journalled */
+void report_filter_flushed(uint32_t timestamp_ms);
+
+/* Commands, from subscriber_task */
+bool report_filter_band_set(report_metric_t metric, uint32_t band);
+bool report_filter_band_pct_set(report_metric_t metric, uint32_t pct_x10);
+bool report_filter_silence_set(uint32_t seconds);
+
+void report_filter_stats_get(report_stats_t *stats);
+
+#endif /* REPORT_FILTER_H_ */
+
+/* [] END OF FILE */
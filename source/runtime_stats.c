@@ -0,0 +1,195 @@
+/******************************************************************************
+* File Name:   runtime_stats.c
+*
+* Description: This file provides the FreeRTOS run time stats counter from
+*              the timer service's time base, counts context switches per task
+*              from the traceTASK_SWITCHED_IN hook, and encodes per-task CPU
+*              load, stack high-water marks and switch counts for the
+*              diagnostics topic.
+*
+* Related Document: See README.md
+*
+*******************************************************************************/
+
+#include <stdio.h>
+#include <string.h>
+
+#include "cy_pdl.h"
+#include "cyhal.h"
+
+/* FreeRTOS header files */
+#include "FreeRTOS.h"
+#include "task.h"
+
+#include "runtime_stats.h"
+#include "cbor.h"
+#include "functions.h"
+#include "timer_service.h"
+#include "report_filter.h"
+
+/******************************************************************************
+* Global Variables
+*******************************************************************************/
+/* Switch count per FreeRTOS task number */
+static volatile uint32_t task_switches[RUNTIME_STATS_MAX_TASKS];
+
+/* Snapshot taken by runtime_stats_encode() */
+static TaskStatus_t task_status[RUNTIME_STATS_MAX_TASKS];
+static uint32_t task_status_switches[RUNTIME_STATS_MAX_TASKS];
+
+/* Previous snapshot per task, for the interval deltas */
+typedef struct
+{
+    UBaseType_t number;
+    uint32_t run_time;
+    uint32_t switches;
+} task_previous_t;
+
+static task_previous_t previous[RUNTIME_STATS_MAX_TASKS];
+static uint32_t previous_count = 0;
+static uint32_t previous_total = 0;
+static TickType_t previous_tick = 0;
+
+/******************************************************************************
+ * Function Name: runtime_stats_timer_init
+ ******************************************************************************
+ * Summary:
+ *  portCONFIGURE_TIMER_FOR_RUN_TIME_STATS(), called by vTaskStartScheduler().
+ *  The counter is the timer service's time base, already running when
+ *  timer_init() has been called.
+ *
+ ******************************************************************************/
+void runtime_stats_timer_init(void)
+{
+    timer_service_init();
+}
+
+/******************************************************************************
+ * Function Name: runtime_stats_counter
+ ******************************************************************************
+ * Summary:
+ *  portGET_RUN_TIME_COUNTER_VALUE(), the low 32 bits of the timer service
+ *  time.
+ *
+ ******************************************************************************/
+uint32_t runtime_stats_counter(void)
+{
+    return (uint32_t)timer_service_now_us();
+}
+
+/* traceTASK_SWITCHED_IN(), runs inside the scheduler */
+void runtime_stats_task_switched_in(uint32_t task_number)
+{
+    if (task_number < RUNTIME_STATS_MAX_TASKS)
+    {
+        task_switches[task_number]++;
+    }
+}
+
+static const task_previous_t *runtime_stats_previous(UBaseType_t number)
+{
+    for (uint32_t i = 0; i < previous_count; i++)
+    {
+        if (previous[i].number == number)
+        {
+            return &previous[i];
+        }
+    }
+    return NULL;
+}
+
+/******************************************************************************
+ * Function Name: runtime_stats_encode
+ ******************************************************************************
+ * Summary:
+ *  Encodes the diagnostics for the interval since the previous call as CBOR:
+ *  {0: interval ms, 1: [[name, cpu 0.1 %, free stack bytes, switches], ...],
+ *   4: [reads, crc errors, retries, failed reads, bus errors],
+ *   5: [messages, records, suppressed, heartbeats]}
+ *  Tasks created during the interval report their totals.
+ *
+ * Parameters:
+ *  uint8_t *buffer : receives the payload
+ *  size_t buffer_len : size of 'buffer'
+ *
+ * Return:
+ *  size_t : payload length, 0 if it does not fit
+ *
+ ******************************************************************************/
+size_t runtime_stats_encode(uint8_t *buffer, size_t buffer_len)
+{
+    cbor_writer_t w;
+    uint32_t total;
+    uint32_t interval;
+    UBaseType_t count;
+    TickType_t now = xTaskGetTickCount();
+    wire_stats_t wire;
+    report_stats_t report;
+
+    count = uxTaskGetSystemState(task_status, RUNTIME_STATS_MAX_TASKS, &total);
+    interval = total - previous_total;
+
+    cbor_writer_init(&w, buffer, buffer_len);
+    cbor_put_map(&w, 4);
+    cbor_put_uint(&w, RUNTIME_STATS_KEY_INTERVAL);
+    cbor_put_uint(&w, (now - previous_tick) * portTICK_PERIOD_MS);
+    cbor_put_uint(&w, RUNTIME_STATS_KEY_TASKS);
+    cbor_put_array(&w, count);
+
+    for (UBaseType_t i = 0; i < count; i++)
+    {
+        const TaskStatus_t *task = &task_status[i];
+        const task_previous_t *last = runtime_stats_previous(task->xTaskNumber);
+        uint32_t switches = 0;
+        uint32_t run_time = task->ulRunTimeCounter;
+
+        if (task->xTaskNumber < RUNTIME_STATS_MAX_TASKS)
+        {
+            switches = task_switches[task->xTaskNumber];
+        }
+        task_status_switches[i] = switches;
+        if (last != NULL)
+        {
+            run_time -= last->run_time;
+            switches -= last->switches;
+        }
+
+        cbor_put_array(&w, RUNTIME_STATS_TASK_FIELDS);
+        cbor_put_text(&w, task->pcTaskName, strlen(task->pcTaskName));
+        cbor_put_uint(&w, (interval == 0u) ? 0u : (((uint64_t)run_time * 1000u) / interval));
+        cbor_put_uint(&w, (uint32_t)task->usStackHighWaterMark * sizeof(StackType_t));
+        cbor_put_uint(&w, switches);
+    }
+
+    wire_stats_get(&wire);
+    cbor_put_uint(&w, RUNTIME_STATS_KEY_WIRE);
+    cbor_put_array(&w, RUNTIME_STATS_WIRE_FIELDS);
+    cbor_put_uint(&w, wire.reads);
+    cbor_put_uint(&w, wire.crc_errors);
+    cbor_put_uint(&w, wire.retries);
+    cbor_put_uint(&w, wire.read_failures);
+    cbor_put_uint(&w, wire.bus_errors);
+
+    report_filter_stats_get(&report);
+    cbor_put_uint(&w, RUNTIME_STATS_KEY_REPORT);
+    cbor_put_array(&w, RUNTIME_STATS_REPORT_FIELDS);
+    cbor_put_uint(&w, report.messages);
+    cbor_put_uint(&w, report.records);
+    cbor_put_uint(&w, report.suppressed);
+    cbor_put_uint(&w, report.heartbeats);
+
+    /* Deltas are taken from this snapshot next time */
+    for (UBaseType_t i = 0; i < count; i++)
+    {
+        previous[i].number = task_status[i].xTaskNumber;
+        previous[i].run_time = task_status[i].ulRunTimeCounter;
+        previous[i].switches = task_status_switches[i];
+    }
+    previous_count = count;
+    previous_total = total;
+    previous_tick = now;
+
+    return cbor_writer_length(&w);
+}
+
+/* [] END OF FILE */
@@ -0,0 +1,63 @@
+/******************************************************************************
+* File Name:   runtime_stats.h
+*
+* Description: This file is the public interface of runtime_stats.c, the
+*              FreeRTOS run time counter and the per-task diagnostics it
+*              feeds.
+*
+* Related Document: See README.md
+*
+*******************************************************************************/
+
+#ifndef RUNTIME_STATS_H_
+#define RUNTIME_STATS_H_
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include "timer_service.h"
+
+/*******************************************************************************
+* Macros
+********************************************************************************/
+/* Run time counter clock, 1 us resolution from the timer service. The
+ * 32-bit count wraps after about 71 minutes, longer than one reporting
+ * period. */
+#define RUNTIME_STATS_TIMER_CLOCK_HZ      (TIMER_SERVICE_CLOCK_HZ)
+
+/* Publish ticks (1 s) between two diagnostics messages */
+#define RUNTIME_STATS_PERIOD_S            (60u)
+
+/* Most tasks reported, FreeRTOS, lwIP and WHD threads included */
+#define RUNTIME_STATS_MAX_TASKS           (24u)
+
+/* Payload buffer size for RUNTIME_STATS_MAX_TASKS entries, the 1-Wire
+ * counters and the report counters */
+#define RUNTIME_STATS_PAYLOAD_MAX_LEN     (72u + (RUNTIME_STATS_MAX_TASKS * 32u))
+
+/* Keys of the CBOR diagnostics map. RUNTIME_STATS_KEY_TASKS holds one array
+ * per task: [name, CPU 0.1 %, free stack bytes, context switches], CPU and
+ * switches counted over the interval. RUNTIME_STATS_KEY_WIRE holds the
+ * 1-Wire counters since boot: [good reads, CRC errors, retries, failed
+ * reads, bus errors]. RUNTIME_STATS_KEY_REPORT holds the telemetry report
+ * counters since boot: [messages, records sent, records suppressed,
+ * heartbeats]. Keys 2 and 3 are used by heap_trace.h. */
+#define RUNTIME_STATS_KEY_INTERVAL        (0u)
+#define RUNTIME_STATS_KEY_TASKS           (1u)
+#define RUNTIME_STATS_KEY_WIRE            (4u)
+#define RUNTIME_STATS_KEY_REPORT          (5u)
+#define RUNTIME_STATS_TASK_FIELDS         (4u)
+#define RUNTIME_STATS_WIRE_FIELDS         (5u)
+#define RUNTIME_STATS_REPORT_FIELDS       (4u)
+
+/*******************************************************************************
+* Function Prototypes
+********************************************************************************/
+void runtime_stats_timer_init(void);
+uint32_t runtime_stats_counter(void);
+void runtime_stats_task_switched_in(uint32_t task_number);
+size_t runtime_stats_encode(uint8_t *buffer, size_t buffer_len);
+
+#endif /* RUNTIME_STATS_H_ */
+
+/* [] END OF FILE */
@@ -0,0 +1,189 @@
+/******************************************************************************
+* File Name:   sensor_filter.c
+*
+* Description: This file contains the sensor filter chain. Every stage works
+*              on integers in the caller's unit and keeps its state in the
+*              sensor_filter_t, so one chain per channel can run in an
+*              interrupt.
+*
+*              Outlier rejection drops a sample further than outlier_limit
+*              from the last kept one, such as a switching spike. When
+*              outlier_run samples in a row are dropped the reading has
+*              really moved, and the next one is kept as the new reference.
+*
+*              The median keeps its window twice, in arrival order and
+*              sorted, so a sample costs one removal and one insertion.
+*
+* Related Document: See README.md
+*
+*******************************************************************************/
+
+#include <string.h>
+
+#include "sensor_filter.h"
+
+/******************************************************************************
+ * Function Name: sensor_filter_init
+ ******************************************************************************
+ * Summary:
+ *  Sets up a channel with 'cfg'. A median window that is even or too long
+ *  is cut to the next odd length that fits.
+ *
+ ******************************************************************************/
+void sensor_filter_init(sensor_filter_t *filter, const sensor_filter_cfg_t *cfg)
+{
+    filter->cfg = *cfg;
+    if (filter->cfg.median_len > SENSOR_FILTER_MEDIAN_MAX)
+    {
+        filter->cfg.median_len = SENSOR_FILTER_MEDIAN_MAX;
+    }
+    if ((filter->cfg.median_len > 0u) && ((filter->cfg.median_len & 1u) == 0u))
+    {
+        filter->cfg.median_len--;
+    }
+    filter->rejected = 0;
+    sensor_filter_reset(filter);
+}
+
+/******************************************************************************
+ * Function Name: sensor_filter_reset
+ ******************************************************************************
+ * Summary:
+ *  Forgets the history, for when the input has been switched and earlier
+ *  samples no longer describe it. The next sample starts every stage.
+ *
+ ******************************************************************************/
+void sensor_filter_reset(sensor_filter_t *filter)
+{
+    filter->outlier_ref_valid = false;
+    filter->outlier_count = 0;
+    filter->median_count = 0;
+    filter->median_head = 0;
+    filter->ema_valid = false;
+    filter->box_sum = 0;
+    filter->box_count = 0;
+}
+
+/* False when 'sample' is dropped as an outlier */
+static bool sensor_filter_outlier(sensor_filter_t *filter, int32_t sample)
+{
+    int32_t limit = filter->cfg.outlier_limit;
+
+    if ((limit > 0) && filter->outlier_ref_valid &&
+        ((sample > (filter->outlier_ref + limit)) || (sample < (filter->outlier_ref - limit))))
+    {
+        if (filter->outlier_count < filter->cfg.outlier_run)
+        {
+            filter->outlier_count++;
+            filter->rejected++;
+            return false;
+        }
+    }
+
+    filter->outlier_ref = sample;
+    filter->outlier_ref_valid = true;
+    filter->outlier_count = 0;
+    return true;
+}
+
+/* Median of the window after adding 'sample' */
+static int32_t sensor_filter_median(sensor_filter_t *filter, int32_t sample)
+{
+    uint8_t len = filter->cfg.median_len;
+    int32_t *sorted = filter->median_sorted;
+    uint8_t count = filter->median_count;
+    uint8_t i;
+
+    if (len <= 1u)
+    {
+        return sample;
+    }
+
+    /* Take the oldest sample out of the sorted window */
+    if (count == len)
+    {
+        int32_t oldest = filter->median_ring[filter->median_head];
+
+        for (i = 0; (i < count) && (sorted[i] != oldest); i++)
+        {
+        }
+        memmove(&sorted[i], &sorted[i + 1u], (size_t)(count - i - 1u) * sizeof(sorted[0]));
+        count--;
+    }
+
+    filter->median_ring[filter->median_head] = sample;
+    filter->median_head = (uint8_t)((filter->median_head + 1u) % len);
+
+    for (i = count; (i > 0u) && (sorted[i - 1u] > sample); i--)
+    {
+        sorted[i] = sorted[i - 1u];
+    }
+    sorted[i] = sample;
+    count++;
+
+    filter->median_count = count;
+    return sorted[count / 2u];
+}
+
+static int32_t sensor_filter_ema(sensor_filter_t *filter, int32_t sample)
+{
+    int32_t scaled = (int32_t)((uint32_t)sample << SENSOR_FILTER_EMA_FRAC);
+
+    if (filter->cfg.ema_shift == 0u)
+    {
+        return sample;
+    }
+
+    if (!filter->ema_valid)
+    {
+        filter->ema_state = scaled;
+        filter->ema_valid = true;
+    }
+    else
+    {
+        filter->ema_state += (scaled - filter->ema_state) >> filter->cfg.ema_shift;
+    }
+    return (filter->ema_state + (1 << (SENSOR_FILTER_EMA_FRAC - 1u))) >> SENSOR_FILTER_EMA_FRAC;
+}
+
+/******************************************************************************
+ * Function Name: sensor_filter_push
+ ******************************************************************************
+ * Summary:
+ *  Runs 'sample' through outlier rejection, median, EMA and decimation.
+ *
+ * Parameters:
+ *  sensor_filter_t *filter : channel state
+ *  int32_t sample : raw sample
+ *  int32_t *out : the filtered value when true is returned
+ *
+ * Return:
+ *  bool : true when the decimator completed an output
+ *
+ ******************************************************************************/
+bool sensor_filter_push(sensor_filter_t *filter, int32_t sample, int32_t *out)
+{
+    int32_t value;
+    uint16_t decimation = (filter->cfg.decimation == 0u) ? 1u : filter->cfg.decimation;
+
+    if (!sensor_filter_outlier(filter, sample))
+    {
+        return false;
+    }
+
+    value = sensor_filter_median(filter, sample);
+    value = sensor_filter_ema(filter, value);
+
+    filter->box_sum += value;
+    if (++filter->box_count < decimation)
+    {
+        return false;
+    }
+
+    *out = (int32_t)(filter->box_sum / (int64_t)decimation);
+    filter->box_sum = 0;
+    filter->box_count = 0;
+    return true;
+}
+
+/* [] END OF FILE */
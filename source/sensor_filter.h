@@ -0,0 +1,76 @@
+/******************************************************************************
+* File Name:   sensor_filter.h
+*
+* Description: This file is the public interface of sensor_filter.c, a
+*              fixed-point filter chain for one sensor channel: outlier
+*              rejection, sliding median, exponential moving average and
+*              boxcar decimation. It has no HAL or RTOS dependencies and
+*              allocates nothing, so it also builds on the host.
+*
+* Related Document: See README.md
+*
+*******************************************************************************/
+
+#ifndef SENSOR_FILTER_H_
+#define SENSOR_FILTER_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/*******************************************************************************
+* Macros
+********************************************************************************/
+/* Longest median window, odd */
+#define SENSOR_FILTER_MEDIAN_MAX          (9u)
+
+/* Fraction bits kept by the EMA. Inputs must stay within +/- 2^23. */
+#define SENSOR_FILTER_EMA_FRAC            (8u)
+
+/*******************************************************************************
+* Global Variables
+********************************************************************************/
+/* Stages run in the order below; a zero field leaves its stage out */
+typedef struct
+{
+    int32_t outlier_limit;      /* Largest step from the last kept sample */
+    uint8_t outlier_run;        /* Rejects in a row before a step is kept */
+    uint8_t median_len;         /* Odd window, up to SENSOR_FILTER_MEDIAN_MAX */
+    uint8_t ema_shift;          /* Weight of a new sample is 2^-ema_shift */
+    uint16_t decimation;        /* Samples averaged into one output */
+} sensor_filter_cfg_t;
+
+/* State of one channel, owned by the caller */
+typedef struct
+{
+    sensor_filter_cfg_t cfg;
+
+    int32_t outlier_ref;
+    bool outlier_ref_valid;
+    uint8_t outlier_count;
+    uint32_t rejected;          /* Samples dropped as outliers, ever */
+
+    int32_t median_ring[SENSOR_FILTER_MEDIAN_MAX];   /* Arrival order */
+    int32_t median_sorted[SENSOR_FILTER_MEDIAN_MAX];
+    uint8_t median_count;
+    uint8_t median_head;
+
+    int32_t ema_state;          /* SENSOR_FILTER_EMA_FRAC fraction bits */
+    bool ema_valid;
+
+    int64_t box_sum;
+    uint16_t box_count;
+} sensor_filter_t;
+
+/*******************************************************************************
+* Function Prototypes
+********************************************************************************/
+void sensor_filter_init(sensor_filter_t *filter, const sensor_filter_cfg_t *cfg);
+void sensor_filter_reset(sensor_filter_t *filter);
+
+/* Runs one sample through the chain. True when 'out' holds a new output,
+ * once per 'decimation' kept samples. */
+bool sensor_filter_push(sensor_filter_t *filter, int32_t sample, int32_t *out);
+
+#endif /* SENSOR_FILTER_H_ */
+
+/* [] END OF FILE */
@@ -59,6 +59,17 @@
 #include "cy_retarget_io.h"
 
 #include "functions.h"
+#include "telemetry.h"
+#include "cbor.h"
+#include "app_alloc.h"
+#include "heap_trace.h"
+#include "pump_scheduler.h"
+#include "dosing_control.h"
+#include "calibration.h"
+#include "probe_scheduler.h"
+#include "publish_rate.h"
+#include "report_filter.h"
+#include "dlog.h"
 
 /******************************************************************************
 * Macros
@@ -86,6 +97,7 @@ TaskHandle_t subscriber_task_handle;
 
 /* Handle of the queue holding the commands for the subscriber task */
 QueueHandle_t subscriber_task_q;
+APP_QUEUE_DEFINE(subscriber_task_q, SUBSCRIBER_TASK_QUEUE_LENGTH, sizeof(subscriber_data_t));
 
 /* Variable to denote the current state of the user LED that is also used by
  * the publisher task.
@@ -101,16 +113,35 @@ static cy_mqtt_subscribe_info_t subscribe_info =
     .topic_len = (sizeof(MQTT_SUB_TOPIC) - 1)
 };
 
+/* Subscription to the per-device command topic, set up in subscribe_to_topic() */
+static cy_mqtt_subscribe_info_t command_subscribe_info =
+{
+    .qos = (cy_mqtt_qos_t) MQTT_MESSAGES_QOS
+};
+
+/* Deadband command keys, in report_metric_t order */
+static const char * const command_band_keys[REPORT_METRIC_COUNT] =
+{
+    COMMAND_KEY_DB_PH_MV, COMMAND_KEY_DB_EC_MV, COMMAND_KEY_DB_TEMP_CDEG, COMMAND_KEY_DB_FLOW_MLPM
+};
+
+static const char * const command_band_pct_keys[REPORT_METRIC_COUNT] =
+{
+    COMMAND_KEY_DB_PH_PCT, COMMAND_KEY_DB_EC_PCT, COMMAND_KEY_DB_TEMP_PCT, COMMAND_KEY_DB_FLOW_PCT
+};
+
 /******************************************************************************
 * Function Prototypes
 *******************************************************************************/
 static void subscribe_to_topic(void);
+static bool pump_seconds_decode(const uint8_t *payload, size_t len, uint64_t *seconds);
+static void command_decode(const uint8_t *payload, size_t len);
+static uint32_t command_metric_key(const char *key, size_t key_len, const char * const *names);
 void print_heap_usage(char *msg);
+void log_heap_usage(dlog_id_t id);
 
 
 
-extern int pumpSeconds;
-extern int pumpsOn;
 
 /******************************************************************************
  * Function Name: subscriber_task
@@ -136,7 +167,7 @@ void subscriber_task(void *pvParameters)
     subscribe_to_topic();
 
     /* Create a message queue to communicate with other tasks and callbacks. */
-    subscriber_task_q = xQueueCreate(SUBSCRIBER_TASK_QUEUE_LENGTH, sizeof(subscriber_data_t));
+    subscriber_task_q = APP_QUEUE_CREATE(subscriber_task_q, SUBSCRIBER_TASK_QUEUE_LENGTH, sizeof(subscriber_data_t));
 
     while (true)
     {
@@ -146,7 +177,7 @@ void subscriber_task(void *pvParameters)
             {
                 case UPDATE_DEVICE_STATE:
                 {
-                    print_heap_usage("subscriber_task: After updating LED state");
+                    log_heap_usage(DLOG_MSG_HEAP_SUBSCRIBER);
                     break;
                 }
                 default:
@@ -213,6 +244,19 @@ static void subscribe_to_topic(void)
         vTaskDelay(pdMS_TO_TICKS(MQTT_SUBSCRIBE_RETRY_INTERVAL_MS));
     }
 
+    /* Commands addressed to this device only */
+    if (result == CY_RSLT_SUCCESS)
+    {
+        command_subscribe_info.topic = telemetry_command_topic();
+        command_subscribe_info.topic_len = strlen(command_subscribe_info.topic);
+        result = cy_mqtt_subscribe(mqtt_connection, &command_subscribe_info, SUBSCRIPTION_COUNT);
+        if (result == CY_RSLT_SUCCESS)
+        {
+            printf("\nMQTT client subscribed to the topic '%.*s' successfully.\n",
+                   command_subscribe_info.topic_len, command_subscribe_info.topic);
+        }
+    }
+
     if (result != CY_RSLT_SUCCESS)
     {
         printf("\nMQTT Subscribe failed with error 0x%0X after %d retries...\n\n", 
@@ -228,8 +272,8 @@ static void subscribe_to_topic(void)
  * Function Name: mqtt_subscription_callback
  ******************************************************************************
  * Summary:
- *  Callback to handle incoming MQTT messages. This callback prints the 
- *  contents of the incoming message and changes variable values used in
+ *  Callback to handle incoming MQTT messages. This callback logs the
+ *  size of the incoming message and changes variable values used in
  *  publisher_task() in publisher_task.c which activate the GPIO pin for
  *  the specific number of seconds
  *
@@ -245,30 +289,355 @@ void mqtt_subscription_callback(cy_mqtt_publish_info_t *received_msg_info)
 {
     subscriber_data_t subscriber_q_data;
 
-    printf("  \nSubsciber: Incoming MQTT message received:\n"
-           "    Publish topic name: %.*s\n"
-           "    Publish QoS: %d\n"
-           "    Publish payload: %.*s\n",
-           received_msg_info->topic_len, received_msg_info->topic,
-           (int) received_msg_info->qos,
-           (int) received_msg_info->payload_len, (const char *)received_msg_info->payload);
-
-    // if there's an upload to pump seconds topic, convert the payload to int and pass it to extern var payloadTimer
-    // payloadTimer is used in publisher_task.c publisher_task() switch statement
-    if (strncmp(received_msg_info->topic, MQTT_SUB_TOPIC_THREE, received_msg_info->topic_len) == 0)
+    DLOG3(DLOG_MSG_MESSAGE_RECEIVED, received_msg_info->topic_len,
+          received_msg_info->qos, received_msg_info->payload_len);
+
+    const uint8_t *payload = (const uint8_t *)received_msg_info->payload;
+    uint64_t seconds;
+
+    if ((received_msg_info->topic_len == command_subscribe_info.topic_len) &&
+        (memcmp(received_msg_info->topic, command_subscribe_info.topic, received_msg_info->topic_len) == 0))
     {
-    	int payloadTimer = atoi(received_msg_info->payload);
-    	pumpSeconds = payloadTimer;
-    	pumpsOn = 1;
-    	printf("\nPUMPING NOW");
-    	printf("\nPump for %d seconds.", pumpSeconds);
+        command_decode(payload, received_msg_info->payload_len);
+    }
+    // if there's an upload to pump seconds topic, run PUMP_ONE for that many seconds
+    else if (strncmp(received_msg_info->topic, MQTT_SUB_TOPIC_THREE, received_msg_info->topic_len) == 0)
+    {
+        if (dosing_control_owns(PUMP_MAIN))
+        {
+            DLOG1(DLOG_MSG_PUMP_CONTROLLED, PUMP_MAIN);
+        }
+        else if (pump_seconds_decode(payload, received_msg_info->payload_len, &seconds))
+        {
+            (void) pump_run(PUMP_MAIN, (uint32_t)seconds * 1000u);
+            DLOG1(DLOG_MSG_PUMP_SECONDS, seconds);
+        }
+        else
+        {
+            DLOG0(DLOG_MSG_PUMP_INVALID);
+        }
     }
 
-    print_heap_usage("MQTT subscription callback");
+    log_heap_usage(DLOG_MSG_HEAP_SUBSCRIPTION);
 
     /* Send the command and data to subscriber task queue */
     xQueueSend(subscriber_task_q, &subscriber_q_data, portMAX_DELAY);
 } // end of mqtt_subscription_callback function
 
+/******************************************************************************
+ * Function Name: pump_seconds_decode
+ ******************************************************************************
+ * Summary:
+ *  Reads the pump time from a 'MQTT_SUB_TOPIC_THREE' payload. The payload is
+ *  a CBOR unsigned integer; ASCII digits are still accepted for dashboards
+ *  that publish plain text. ASCII digits never decode as a CBOR unsigned
+ *  integer, so the two forms cannot be confused.
+ *
+ * Parameters:
+ *  const uint8_t *payload : message payload, not NUL terminated
+ *  size_t len : payload length
+ *  uint64_t *seconds : decoded pump time
+ *
+ * Return:
+ *  bool : true if the payload held a time up to COMMAND_PUMP_SECONDS_MAX
+ *
+ ******************************************************************************/
+static bool pump_seconds_decode(const uint8_t *payload, size_t len, uint64_t *seconds)
+{
+    cbor_reader_t reader;
+
+    cbor_reader_init(&reader, payload, len);
+    if (cbor_get_uint(&reader, seconds) && (reader.pos == len))
+    {
+        return (*seconds <= COMMAND_PUMP_SECONDS_MAX);
+    }
+
+    *seconds = 0;
+    for (size_t i = 0; i < len; i++)
+    {
+        if ((payload[i] < '0') || (payload[i] > '9'))
+        {
+            return false;
+        }
+        *seconds = (*seconds * 10u) + (uint64_t)(payload[i] - '0');
+        if (*seconds > COMMAND_PUMP_SECONDS_MAX)
+        {
+            return false;
+        }
+    }
+    return (len > 0);
+}
+
+/* Compares a CBOR text key, which is not NUL terminated, with 'name' */
+static bool command_key_is(const char *key, size_t key_len, const char *name)
+{
+    return (key_len == strlen(name)) && (memcmp(key, name, key_len) == 0);
+}
+
+/* Index of 'key' in a table of keys in report_metric_t order,
+ * REPORT_METRIC_COUNT if it is not there */
+static uint32_t command_metric_key(const char *key, size_t key_len, const char * const *names)
+{
+    uint32_t metric = 0;
+
+    while ((metric < REPORT_METRIC_COUNT) && !command_key_is(key, key_len, names[metric]))
+    {
+        metric++;
+    }
+    return metric;
+}
+
+/******************************************************************************
+ * Function Name: command_decode
+ ******************************************************************************
+ * Summary:
+ *  Applies a CBOR command map received on the per-device command topic.
+ *  Unknown keys and values of the wrong type are skipped so newer tools can
+ *  send commands this firmware does not know yet.
+ *
+ * Parameters:
+ *  const uint8_t *payload : message payload
+ *  size_t len : payload length
+ *
+ * Return:
+ *  void
+ *
+ ******************************************************************************/
+static void command_decode(const uint8_t *payload, size_t len)
+{
+    cbor_reader_t reader;
+    size_t count;
+    const char *key;
+    size_t key_len;
+    uint64_t value;
+    float number;
+    bool flag;
+    uint32_t metric;
+    cy_rslt_t result;
+
+    cbor_reader_init(&reader, payload, len);
+    if (!cbor_get_map(&reader, &count))
+    {
+        DLOG0(DLOG_MSG_COMMAND_NOT_MAP);
+        return;
+    }
+
+    for (size_t i = 0; (i < count) && !reader.error; i++)
+    {
+        if (!cbor_get_text(&reader, &key, &key_len))
+        {
+            (void) cbor_skip(&reader);
+            (void) cbor_skip(&reader);
+            continue;
+        }
+
+        if (command_key_is(key, key_len, COMMAND_KEY_PUMP_SECONDS) && cbor_get_uint(&reader, &value))
+        {
+            if (dosing_control_owns(PUMP_MAIN))
+            {
+                DLOG1(DLOG_MSG_PUMP_CONTROLLED, PUMP_MAIN);
+            }
+            else if (value <= COMMAND_PUMP_SECONDS_MAX)
+            {
+                (void) pump_run(PUMP_MAIN, (uint32_t)value * 1000u);
+                DLOG1(DLOG_MSG_PUMP_SECONDS, value);
+            }
+        }
+        else if (command_key_is(key, key_len, COMMAND_KEY_DOSE_A_MS) && cbor_get_uint(&reader, &value))
+        {
+            if (dosing_control_owns(PUMP_DOSE_A))
+            {
+                DLOG1(DLOG_MSG_PUMP_CONTROLLED, PUMP_DOSE_A);
+            }
+            else if (value <= PUMP_RUN_MAX_MS)
+            {
+                (void) pump_run(PUMP_DOSE_A, (uint32_t)value);
+                DLOG1(DLOG_MSG_DOSE_A_MS, value);
+            }
+        }
+        else if (command_key_is(key, key_len, COMMAND_KEY_TEMP_BITS) && cbor_get_uint(&reader, &value))
+        {
+            if ((value <= UINT8_MAX) && wire_set_resolution((uint8_t)value))
+            {
+                DLOG1(DLOG_MSG_TEMP_BITS, value);
+            }
+        }
+        else if (command_key_is(key, key_len, COMMAND_KEY_FLOW_K) && cbor_get_uint(&reader, &value))
+        {
+            if (value <= UINT32_MAX)
+            {
+                result = calibration_flow_k((uint32_t)value);
+                if (result == CY_RSLT_SUCCESS)
+                {
+                    DLOG1(DLOG_MSG_FLOW_K, value);
+                }
+                else
+                {
+                    DLOG1(DLOG_MSG_CAL_FAILED, result);
+                }
+            }
+        }
+        else if (command_key_is(key, key_len, COMMAND_KEY_CAL_PH) && cbor_get_float(&reader, &number))
+        {
+            uint8_t points = 0;
+
+            result = calibration_ph_point(number, &points);
+            if (result == CY_RSLT_SUCCESS)
+            {
+                DLOG2(DLOG_MSG_CAL_PH, (uint32_t)((number * 1000.0f) + 0.5f), points);
+            }
+            else
+            {
+                DLOG1(DLOG_MSG_CAL_FAILED, result);
+            }
+        }
+        else if (command_key_is(key, key_len, COMMAND_KEY_CAL_EC_US) && cbor_get_float(&reader, &number))
+        {
+            result = calibration_ec_standard(number);
+            if (result == CY_RSLT_SUCCESS)
+            {
+                DLOG1(DLOG_MSG_CAL_EC, (uint32_t)(number + 0.5f));
+            }
+            else
+            {
+                DLOG1(DLOG_MSG_CAL_FAILED, result);
+            }
+        }
+        else if ((command_key_is(key, key_len, COMMAND_KEY_EC_ALPHA) || command_key_is(key, key_len, COMMAND_KEY_EC_BETA)) &&
+                 cbor_get_float(&reader, &number))
+        {
+            float alpha;
+            float beta;
+
+            calibration_ec_compensation_get(&alpha, &beta);
+            if (command_key_is(key, key_len, COMMAND_KEY_EC_ALPHA))
+            {
+                alpha = number;
+            }
+            else
+            {
+                beta = number;
+            }
+
+            result = calibration_ec_compensation(alpha, beta);
+            if (result == CY_RSLT_SUCCESS)
+            {
+                DLOG2(DLOG_MSG_CAL_EC_TC, (int32_t)(alpha * 1e6f), (int32_t)(beta * 1e6f));
+            }
+            else
+            {
+                DLOG1(DLOG_MSG_CAL_FAILED, result);
+            }
+        }
+        else if (command_key_is(key, key_len, COMMAND_KEY_CAL_CLEAR) && cbor_get_bool(&reader, &flag))
+        {
+            if (flag)
+            {
+                result = calibration_clear();
+                if (result == CY_RSLT_SUCCESS)
+                {
+                    DLOG0(DLOG_MSG_CAL_CLEAR);
+                }
+                else
+                {
+                    DLOG1(DLOG_MSG_CAL_FAILED, result);
+                }
+            }
+        }
+        else if (command_key_is(key, key_len, COMMAND_KEY_PH_SETPOINT) && cbor_get_float(&reader, &number))
+        {
+            if ((number >= 0.0f) && (number <= (DOSING_PH_SETPOINT_MAX / 1000.0f)) &&
+                dosing_setpoint_calibrated_set(DOSING_LOOP_PH, (uint32_t)((number * 1000.0f) + 0.5f)))
+            {
+                DLOG2(DLOG_MSG_DOSING_SETPOINT_CAL, DOSING_LOOP_PH, (uint32_t)((number * 1000.0f) + 0.5f));
+            }
+        }
+        else if (command_key_is(key, key_len, COMMAND_KEY_EC_SETPOINT_US) && cbor_get_uint(&reader, &value))
+        {
+            if ((value <= UINT32_MAX) && dosing_setpoint_calibrated_set(DOSING_LOOP_EC, (uint32_t)value))
+            {
+                DLOG2(DLOG_MSG_DOSING_SETPOINT_CAL, DOSING_LOOP_EC, value);
+            }
+        }
+        else if (command_key_is(key, key_len, COMMAND_KEY_PH_SETPOINT_MV) && cbor_get_uint(&reader, &value))
+        {
+            if ((value <= UINT32_MAX) && dosing_setpoint_set(DOSING_LOOP_PH, (uint32_t)value))
+            {
+                DLOG2(DLOG_MSG_DOSING_SETPOINT, DOSING_LOOP_PH, value);
+            }
+        }
+        else if (command_key_is(key, key_len, COMMAND_KEY_EC_SETPOINT_MV) && cbor_get_uint(&reader, &value))
+        {
+            if ((value <= UINT32_MAX) && dosing_setpoint_set(DOSING_LOOP_EC, (uint32_t)value))
+            {
+                DLOG2(DLOG_MSG_DOSING_SETPOINT, DOSING_LOOP_EC, value);
+            }
+        }
+        else if (command_key_is(key, key_len, COMMAND_KEY_PH_WINDOW_MS) && cbor_get_uint(&reader, &value))
+        {
+            if ((value <= UINT32_MAX) && probe_scheduler_window_set(ADC_CHANNEL_PH, (uint32_t)value))
+            {
+                DLOG2(DLOG_MSG_PROBE_WINDOW, ADC_CHANNEL_PH, value);
+            }
+        }
+        else if (command_key_is(key, key_len, COMMAND_KEY_EC_WINDOW_MS) && cbor_get_uint(&reader, &value))
+        {
+            if ((value <= UINT32_MAX) && probe_scheduler_window_set(ADC_CHANNEL_EC, (uint32_t)value))
+            {
+                DLOG2(DLOG_MSG_PROBE_WINDOW, ADC_CHANNEL_EC, value);
+            }
+        }
+        else if (command_key_is(key, key_len, COMMAND_KEY_ADAPTIVE) && cbor_get_bool(&reader, &flag))
+        {
+            publish_rate_adaptive_set(flag);
+            DLOG1(DLOG_MSG_PUBLISH_ADAPTIVE, flag);
+        }
+        else if (((metric = command_metric_key(key, key_len, command_band_keys)) < REPORT_METRIC_COUNT) &&
+                 cbor_get_uint(&reader, &value))
+        {
+            if ((value <= UINT32_MAX) && report_filter_band_set((report_metric_t)metric, (uint32_t)value))
+            {
+                DLOG2(DLOG_MSG_REPORT_BAND, metric, value);
+            }
+        }
+        else if (((metric = command_metric_key(key, key_len, command_band_pct_keys)) < REPORT_METRIC_COUNT) &&
+                 cbor_get_float(&reader, &number))
+        {
+            /* Kept in 0.1 % steps */
+            if ((number >= 0.0f) && (number <= (REPORT_BAND_PCT_X10_MAX / 10.0f)))
+            {
+                value = (uint64_t)((number * 10.0f) + 0.5f);
+                if (report_filter_band_pct_set((report_metric_t)metric, (uint32_t)value))
+                {
+                    DLOG2(DLOG_MSG_REPORT_BAND_PCT, metric, value);
+                }
+            }
+        }
+        else if (command_key_is(key, key_len, COMMAND_KEY_SILENCE_S) && cbor_get_uint(&reader, &value))
+        {
+            if ((value <= UINT32_MAX) && report_filter_silence_set((uint32_t)value))
+            {
+                DLOG1(DLOG_MSG_REPORT_SILENCE, value);
+            }
+        }
+        else if (command_key_is(key, key_len, COMMAND_KEY_HEAP_DUMP) && cbor_get_bool(&reader, &flag))
+        {
+            if (flag)
+            {
+                heap_trace_request_dump();
+            }
+        }
+        else
+        {
+            (void) cbor_skip(&reader);
+        }
+    }
+
+    if (reader.error)
+    {
+        DLOG0(DLOG_MSG_COMMAND_MALFORMED);
+    }
+} // end of command_decode function
+
 
 /* [] END OF FILE */
@@ -54,6 +54,73 @@
 #define SUBSCRIBER_TASK_PRIORITY           (2)
 #define SUBSCRIBER_TASK_STACK_SIZE         (1024 * 1)
 
+/* Keys of the CBOR command map accepted on the per-device command topic,
+ * e.g. {"pump_s": 30} runs PUMP_ONE for 30 seconds and {"dose_a_ms": 1500}
+ * runs DOSE_PUMP_A for 1.5 seconds. 0 stops the pump. */
+#define COMMAND_KEY_PUMP_SECONDS           "pump_s"
+#define COMMAND_KEY_DOSE_A_MS              "dose_a_ms"
+
+/* {"heap_dump": true} publishes the heap_trace.h snapshot on the
+ * diagnostics topic with the next publish tick */
+#define COMMAND_KEY_HEAP_DUMP              "heap_dump"
+
+/* {"temp_bits": 9} sets every DS18B20 to 9-bit resolution (9 to 12) from
+ * the next conversion */
+#define COMMAND_KEY_TEMP_BITS              "temp_bits"
+
+/* {"flow_k": 45000} sets the flow meter K-factor to 450.00 pulses per
+ * litre and saves it with the calibration */
+#define COMMAND_KEY_FLOW_K                 "flow_k"
+
+/* {"ph_sp": 6.0} and {"ec_sp_us": 1400} set the pH and the EC at 25 C the
+ * dosing loops hold once the probes are calibrated. {"ph_sp_mv": 1559} and
+ * {"ec_sp_mv": 1400} set the probe reading they hold until then. 0 turns a
+ * loop off in those units. Manual runs of a pump a loop doses through are
+ * refused while the loop is on. */
+#define COMMAND_KEY_PH_SETPOINT            "ph_sp"
+#define COMMAND_KEY_EC_SETPOINT_US         "ec_sp_us"
+#define COMMAND_KEY_PH_SETPOINT_MV         "ph_sp_mv"
+#define COMMAND_KEY_EC_SETPOINT_MV         "ec_sp_mv"
+
+/* Calibration, each saved to flash. {"cal_ph": 7.0} takes the pH probe's
+ * current reading as buffer pH 7.00 (up to three buffers),
+ * {"cal_ec_us": 1413} takes the EC probe's as a 1413 uS/cm standard and
+ * sets the cell constant. {"ec_alpha": 0.019} and {"ec_beta": 0.0} set the
+ * temperature compensation per C and per C squared. {"cal_clear": true}
+ * forgets the pH buffers and the EC calibration. */
+#define COMMAND_KEY_CAL_PH                 "cal_ph"
+#define COMMAND_KEY_CAL_EC_US              "cal_ec_us"
+#define COMMAND_KEY_EC_ALPHA               "ec_alpha"
+#define COMMAND_KEY_EC_BETA                "ec_beta"
+#define COMMAND_KEY_CAL_CLEAR              "cal_clear"
+
+/* {"ph_window_ms": 6000} and {"ec_window_ms": 6000} set how long each
+ * probe is read per turn once settled, 0 leaves the probe off */
+#define COMMAND_KEY_PH_WINDOW_MS           "ph_window_ms"
+#define COMMAND_KEY_EC_WINDOW_MS           "ec_window_ms"
+
+/* {"adaptive": false} takes a telemetry record every publish tick,
+ * {"adaptive": true} slows down to the heartbeat while readings are steady */
+#define COMMAND_KEY_ADAPTIVE               "adaptive"
+
+/* Report-by-exception deadbands, in the record's units, and percent of the
+ * value last sent: {"db_ph_mv": 3}, {"db_ec_mv": 10}, {"db_temp_cdeg": 10},
+ * {"db_flow_mlpm": 50}, {"db_ec_pct": 1.5} and so on. Percents are kept
+ * in 0.1 % steps and may be sent as any CBOR float or an integer.
+ * {"silence_s": 300} is the longest time without a telemetry message. */
+#define COMMAND_KEY_DB_PH_MV               "db_ph_mv"
+#define COMMAND_KEY_DB_EC_MV               "db_ec_mv"
+#define COMMAND_KEY_DB_TEMP_CDEG           "db_temp_cdeg"
+#define COMMAND_KEY_DB_FLOW_MLPM           "db_flow_mlpm"
+#define COMMAND_KEY_DB_PH_PCT              "db_ph_pct"
+#define COMMAND_KEY_DB_EC_PCT              "db_ec_pct"
+#define COMMAND_KEY_DB_TEMP_PCT            "db_temp_pct"
+#define COMMAND_KEY_DB_FLOW_PCT            "db_flow_pct"
+#define COMMAND_KEY_SILENCE_S              "silence_s"
+
+/* Longest pump run a command may request, in seconds */
+#define COMMAND_PUMP_SECONDS_MAX           (3600u)
+
 /* 8-bit value denoting the device (LED) state. */
 #define DEVICE_ON_STATE                    (0x00u)
 #define DEVICE_OFF_STATE                   (0x01u)
@@ -0,0 +1,197 @@
+/******************************************************************************
+* File Name:   telemetry.c
+*
+* Description: This file batches the controller readings (pH, EC, water
+*              temperature, flow and pump state) and encodes them into a
+*              single CBOR message for the per-device telemetry topic, so one
+*              publish carries TELEMETRY_BATCH_SIZE ticks of data.
+*
+* Related Document: See README.md
+*
+*******************************************************************************/
+
+#include <stdio.h>
+#include <string.h>
+
+#include "cy_pdl.h"
+
+#include "mqtt_client_config.h"
+#include "telemetry.h"
+#include "cbor.h"
+
+/******************************************************************************
+* Global Variables
+*******************************************************************************/
+/* Topics built once from the device identifier */
+static char topic[TELEMETRY_TOPIC_MAX_LEN];
+static char command_topic[TELEMETRY_TOPIC_MAX_LEN];
+static char diag_topic[TELEMETRY_TOPIC_MAX_LEN];
+static char log_topic[TELEMETRY_TOPIC_MAX_LEN];
+
+/* Records waiting to be published */
+static telemetry_record_t batch[TELEMETRY_BATCH_SIZE];
+static uint32_t batch_count = 0;
+
+/* Increments with every encoded message so gaps are visible at the broker */
+static uint32_t frame_seq = 0;
+
+/******************************************************************************
+ * Function Name: telemetry_init
+ ******************************************************************************
+ * Summary:
+ *  Builds the per-device topics from MQTT_CLIENT_IDENTIFIER and the silicon
+ *  unique ID, which unlike the MQTT client ID stays the same across reboots.
+ *  Called from main() so both topics exist before the MQTT tasks start.
+ *
+ ******************************************************************************/
+void telemetry_init(void)
+{
+    char device_id[TELEMETRY_TOPIC_MAX_LEN / 2];
+    uint64_t unique_id = Cy_SysLib_GetUniqueId();
+
+    snprintf(device_id, sizeof(device_id), MQTT_CLIENT_IDENTIFIER "-%08lx%08lx",
+             (unsigned long)(unique_id >> 32), (unsigned long)(unique_id & 0xFFFFFFFFu));
+    snprintf(topic, sizeof(topic), MQTT_TELEMETRY_TOPIC_FORMAT, device_id);
+    snprintf(command_topic, sizeof(command_topic), MQTT_COMMAND_TOPIC_FORMAT, device_id);
+    snprintf(diag_topic, sizeof(diag_topic), MQTT_DIAG_TOPIC_FORMAT, device_id);
+    snprintf(log_topic, sizeof(log_topic), MQTT_LOG_TOPIC_FORMAT, device_id);
+    batch_count = 0;
+}
+
+const char *telemetry_topic(void)
+{
+    return topic;
+}
+
+const char *telemetry_command_topic(void)
+{
+    return command_topic;
+}
+
+const char *telemetry_diag_topic(void)
+{
+    return diag_topic;
+}
+
+const char *telemetry_log_topic(void)
+{
+    return log_topic;
+}
+
+/******************************************************************************
+ * Function Name: telemetry_add
+ ******************************************************************************
+ * Summary:
+ *  Appends a record to the batch.
+ *
+ * Return:
+ *  bool : true once the batch is full and ready to be encoded
+ *
+ ******************************************************************************/
+bool telemetry_add(const telemetry_record_t *record)
+{
+    if (batch_count < TELEMETRY_BATCH_SIZE)
+    {
+        batch[batch_count++] = *record;
+    }
+    return (batch_count >= TELEMETRY_BATCH_SIZE);
+}
+
+/******************************************************************************
+ * Function Name: telemetry_encode
+ ******************************************************************************
+ * Summary:
+ *  Encodes the batch as CBOR and empties it. Record times are sent relative
+ *  to the first record to keep the message short:
+ *  {0: seq, 1: t0 ms, 2: [[dt, ph, ec, temp, flow, pump, [probes], total,
+ *  pH x 1000, EC uS/cm], ...]}
+ *  Temperatures are null until the first conversion has completed, pH and
+ *  EC until their probe has been read.
+ *
+ * Return:
+ *  size_t : payload length, 0 if the batch is empty or does not fit
+ *
+ ******************************************************************************/
+size_t telemetry_encode(uint8_t *buffer, size_t buffer_len)
+{
+    cbor_writer_t w;
+    size_t len;
+    uint32_t t0;
+
+    if (batch_count == 0)
+    {
+        return 0;
+    }
+
+    t0 = batch[0].timestamp_ms;
+    cbor_writer_init(&w, buffer, buffer_len);
+    cbor_put_map(&w, 3);
+    cbor_put_uint(&w, TELEMETRY_KEY_SEQ);
+    cbor_put_uint(&w, frame_seq);
+    cbor_put_uint(&w, TELEMETRY_KEY_T0);
+    cbor_put_uint(&w, t0);
+    cbor_put_uint(&w, TELEMETRY_KEY_SAMPLES);
+    cbor_put_array(&w, batch_count);
+
+    for (uint32_t i = 0; i < batch_count; i++)
+    {
+        const telemetry_record_t *r = &batch[i];
+
+        cbor_put_array(&w, TELEMETRY_RECORD_FIELDS);
+        cbor_put_uint(&w, r->timestamp_ms - t0);
+        cbor_put_int(&w, r->ph_mv);
+        cbor_put_int(&w, r->ec_mv);
+        if (r->temp_valid)
+        {
+            cbor_put_int(&w, r->temp_cdeg);
+        }
+        else
+        {
+            cbor_put_null(&w);
+        }
+        cbor_put_uint(&w, r->flow_mlpm);
+        cbor_put_uint(&w, r->pump_state);
+
+        cbor_put_array(&w, r->probe_count);
+        for (uint32_t p = 0; p < r->probe_count; p++)
+        {
+            if (r->probe_valid & (1u << p))
+            {
+                cbor_put_int(&w, r->probe_cdeg[p]);
+            }
+            else
+            {
+                cbor_put_null(&w);
+            }
+        }
+        cbor_put_uint(&w, r->flow_total_ml);
+        if (r->ph_valid)
+        {
+            cbor_put_int(&w, r->ph_milli);
+        }
+        else
+        {
+            cbor_put_null(&w);
+        }
+        if (r->ec_valid)
+        {
+            cbor_put_int(&w, r->ec_us);
+        }
+        else
+        {
+            cbor_put_null(&w);
+        }
+    }
+
+    len = cbor_writer_length(&w);
+    if (len == 0)
+    {
+        return 0;
+    }
+
+    batch_count = 0;
+    frame_seq++;
+    return len;
+}
+
+/* [] END OF FILE */
@@ -0,0 +1,79 @@
+/******************************************************************************
+* File Name:   telemetry.h
+*
+* Description: This file is the public interface of telemetry.c
+*
+* Related Document: See README.md
+*
+*******************************************************************************/
+
+#ifndef TELEMETRY_H_
+#define TELEMETRY_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+/*******************************************************************************
+* Macros
+********************************************************************************/
+/* Records collected before one telemetry message is published */
+#define TELEMETRY_BATCH_SIZE              (10u)
+
+/* Longest topic, "hydro/<client id>-<unique id>/telemetry" */
+#define TELEMETRY_TOPIC_MAX_LEN           (64u)
+
+/* Temperature probes reported per record, matches WIRE_MAX_DEVICES */
+#define TELEMETRY_MAX_PROBES              (4u)
+
+/* Payload buffer size for a full batch: the CBOR map header and frame
+ * fields take at most 16 bytes, one encoded record at most 42 plus 3 per
+ * probe */
+#define TELEMETRY_PAYLOAD_MAX_LEN         (16u + (TELEMETRY_BATCH_SIZE * (42u + (TELEMETRY_MAX_PROBES * 3u))))
+
+/* Keys of the CBOR telemetry map. TELEMETRY_KEY_SAMPLES holds one array per
+ * record: [dt ms, pH mV, EC mV, temp 0.01 C or null, flow mL/min, pump,
+ * [probe 0.01 C or null, ...], flow total mL, pH x 1000 or null, EC uS/cm
+ * at 25 C or null]. temp is the first probe, pH is null until calibrated. */
+#define TELEMETRY_KEY_SEQ                 (0u)
+#define TELEMETRY_KEY_T0                  (1u)
+#define TELEMETRY_KEY_SAMPLES             (2u)
+#define TELEMETRY_RECORD_FIELDS           (10u)
+
+/*******************************************************************************
+* Global Variables
+********************************************************************************/
+/* One set of readings taken on a publish tick */
+typedef struct
+{
+    uint32_t timestamp_ms;      /* RTOS time of the ADC window */
+    int32_t ph_mv;              /* pH probe, last reading while powered */
+    int32_t ec_mv;              /* EC probe, last reading while powered */
+    int16_t temp_cdeg;          /* Water temperature, 0.01 C */
+    bool temp_valid;
+    int16_t probe_cdeg[TELEMETRY_MAX_PROBES];   /* Every probe, 0.01 C */
+    uint8_t probe_valid;        /* Bit n: probe_cdeg[n] is valid */
+    uint8_t probe_count;
+    uint32_t flow_mlpm;         /* Flow rate, mL/min */
+    uint32_t flow_total_ml;     /* Volume since boot, mL */
+    uint8_t pump_state;         /* Bit n: pump_id_t n running */
+    int32_t ph_milli;           /* Calibrated pH x 1000 */
+    bool ph_valid;
+    int32_t ec_us;              /* Calibrated EC at 25 C, uS/cm */
+    bool ec_valid;
+} telemetry_record_t;
+
+/*******************************************************************************
+* Function Prototypes
+********************************************************************************/
+void telemetry_init(void);
+const char *telemetry_topic(void);
+const char *telemetry_command_topic(void);
+const char *telemetry_diag_topic(void);
+const char *telemetry_log_topic(void);
+bool telemetry_add(const telemetry_record_t *record);
+size_t telemetry_encode(uint8_t *buffer, size_t buffer_len);
+
+#endif /* TELEMETRY_H_ */
+
+/* [] END OF FILE */
@@ -0,0 +1,552 @@
+/******************************************************************************
+* File Name:   timer_service.c
+*
+* Description: This file contains the timer service. One TCPWM counter runs
+*              freely at 1 MHz and is extended to a 64-bit microsecond time
+*              by its terminal count interrupt, the same way runtime_stats.c
+*              used to. Software timers are filed in a hierarchical timer
+*              wheel and the counter's compare is set to the nearest
+*              deadline, so the publish tick, the pump deadline and the
+*              1-Wire slots share one interrupt and one TCPWM block.
+*
+*              Level 0 slots hold timers due within 2 ms and are checked
+*              against the exact deadline, so timers fire to the
+*              microsecond. Higher levels hold later timers and are moved
+*              down (cascaded) when the wheel reaches them. The wheel only
+*              visits slots that are occupied, so idle stretches cost one
+*              terminal count interrupt per counter wrap.
+*
+* Related Document: See README.md
+*
+*******************************************************************************/
+
+#include <stdio.h>
+
+#include "cy_pdl.h"
+#include "cyhal.h"
+
+/* FreeRTOS header files */
+#include "FreeRTOS.h"
+#include "task.h"
+
+#include "timer_service.h"
+
+/******************************************************************************
+* Macros
+******************************************************************************/
+/* Full 16-bit period, so the count is extended by the terminal count
+ * interrupt whichever counter width the HAL allocates */
+#define TIMER_SERVICE_PERIOD            (0xFFFFu)
+#define TIMER_SERVICE_SHIFT             (16u)
+
+/* Compare is never set closer than this to the current count, so the
+ * match cannot be missed while it is being written */
+#define TIMER_SERVICE_MIN_LEAD_US       (2u)
+
+#define TIMER_WHEEL_MASK                (TIMER_WHEEL_SLOTS - 1u)
+
+/* Level of the expired list, past the last wheel level */
+#define TIMER_WHEEL_EXPIRED             (TIMER_WHEEL_LEVELS)
+
+/******************************************************************************
+* Global Variables
+*******************************************************************************/
+static cyhal_timer_t service_timer;
+static bool service_started = false;
+
+/* Counter wraps, and the last time handed out */
+static volatile uint32_t service_epoch = 0;
+static uint64_t service_last_us = 0;
+
+/* Wheel, in level 0 slot ticks of 2^TIMER_WHEEL_SLOT_SHIFT us. Bit n of
+ * wheel_occupied[level] is set while slot n of the level holds a timer. */
+static timer_service_timer_t *wheel[TIMER_WHEEL_LEVELS][TIMER_WHEEL_SLOTS];
+static uint64_t wheel_occupied[TIMER_WHEEL_LEVELS];
+static uint64_t wheel_tick = 0;
+
+/* Due timers waiting for their callback */
+static timer_service_timer_t *expired = NULL;
+
+/******************************************************************************
+ * Function Name: service_now
+ ******************************************************************************
+ * Summary:
+ *  Current time with interrupts masked. Right after a wrap, before the
+ *  terminal count interrupt has run, the count would step back, so the
+ *  wrap is added here instead.
+ *
+ ******************************************************************************/
+static uint64_t service_now(void)
+{
+    uint64_t now = ((uint64_t)service_epoch << TIMER_SERVICE_SHIFT) | cyhal_timer_read(&service_timer);
+
+    if (now < service_last_us)
+    {
+        now += (1u << TIMER_SERVICE_SHIFT);
+    }
+    service_last_us = now;
+    return now;
+}
+
+static inline uint64_t rotate_right(uint64_t bits, uint32_t count)
+{
+    count &= 63u;
+    return (count == 0u) ? bits : ((bits >> count) | (bits << (64u - count)));
+}
+
+static void timer_link(timer_service_timer_t *timer, timer_service_timer_t **head, uint8_t level, uint8_t slot)
+{
+    timer->level = level;
+    timer->slot = slot;
+    timer->next = *head;
+    if (timer->next != NULL)
+    {
+        timer->next->pprev = &timer->next;
+    }
+    timer->pprev = head;
+    *head = timer;
+}
+
+static void timer_unlink(timer_service_timer_t *timer)
+{
+    *timer->pprev = timer->next;
+    if (timer->next != NULL)
+    {
+        timer->next->pprev = timer->pprev;
+    }
+    if ((timer->level < TIMER_WHEEL_LEVELS) && (wheel[timer->level][timer->slot] == NULL))
+    {
+        wheel_occupied[timer->level] &= ~(1ull << timer->slot);
+    }
+    timer->next = NULL;
+    timer->pprev = NULL;
+}
+
+/******************************************************************************
+ * Function Name: wheel_insert
+ ******************************************************************************
+ * Summary:
+ *  Files a timer in the lowest level whose span covers its deadline,
+ *  relative to wheel_tick. Overdue timers go to the current slot.
+ *
+ ******************************************************************************/
+static void wheel_insert(timer_service_timer_t *timer)
+{
+    uint64_t tick = timer->expires_us >> TIMER_WHEEL_SLOT_SHIFT;
+    uint64_t delta;
+    uint32_t level;
+    uint32_t slot;
+
+    if (tick < wheel_tick)
+    {
+        tick = wheel_tick;
+    }
+    delta = tick - wheel_tick;
+
+    for (level = 0; level < (TIMER_WHEEL_LEVELS - 1u); level++)
+    {
+        if (delta < (1ull << (TIMER_WHEEL_BITS * (level + 1u))))
+        {
+            break;
+        }
+    }
+    if (delta >= (1ull << (TIMER_WHEEL_BITS * TIMER_WHEEL_LEVELS)))
+    {
+        tick = wheel_tick + (1ull << (TIMER_WHEEL_BITS * TIMER_WHEEL_LEVELS)) - 1u;
+    }
+
+    slot = (uint32_t)(tick >> (TIMER_WHEEL_BITS * level)) & TIMER_WHEEL_MASK;
+    timer_link(timer, &wheel[level][slot], (uint8_t)level, (uint8_t)slot);
+    wheel_occupied[level] |= (1ull << slot);
+}
+
+/******************************************************************************
+ * Function Name: wheel_next_tick
+ ******************************************************************************
+ * Summary:
+ *  First tick after wheel_tick at which an occupied level 0 slot comes up
+ *  or an occupied higher slot must be cascaded.
+ *
+ * Return:
+ *  uint64_t : the tick, UINT64_MAX if the wheel is empty
+ *
+ ******************************************************************************/
+static uint64_t wheel_next_tick(void)
+{
+    uint64_t next = UINT64_MAX;
+
+    for (uint32_t level = 0; level < TIMER_WHEEL_LEVELS; level++)
+    {
+        uint32_t shift = TIMER_WHEEL_BITS * level;
+        uint64_t base = wheel_tick >> shift;
+        uint64_t pending = rotate_right(wheel_occupied[level], (uint32_t)(base + 1u));
+        uint64_t tick;
+
+        /* Level 0 holds nothing a full turn ahead, its current slot is
+         * handled by wheel_collect() */
+        if (level == 0u)
+        {
+            pending &= ~(1ull << 63);
+        }
+        if (pending == 0u)
+        {
+            continue;
+        }
+
+        tick = (base + (uint64_t)__builtin_ctzll(pending) + 1u) << shift;
+        if (tick < next)
+        {
+            next = tick;
+        }
+    }
+    return next;
+}
+
+static uint64_t slot_deadline(const timer_service_timer_t *timer)
+{
+    uint64_t deadline = UINT64_MAX;
+
+    for (; timer != NULL; timer = timer->next)
+    {
+        if (timer->expires_us < deadline)
+        {
+            deadline = timer->expires_us;
+        }
+    }
+    return deadline;
+}
+
+/******************************************************************************
+ * Function Name: wheel_next_deadline
+ ******************************************************************************
+ * Summary:
+ *  Time at which the wheel next needs attention: the exact deadline of a
+ *  level 0 timer, or the start of the next cascade.
+ *
+ ******************************************************************************/
+static uint64_t wheel_next_deadline(void)
+{
+    uint64_t deadline = slot_deadline(wheel[0][wheel_tick & TIMER_WHEEL_MASK]);
+    uint64_t tick = wheel_next_tick();
+    uint64_t next;
+
+    if (tick == UINT64_MAX)
+    {
+        return deadline;
+    }
+
+    if ((tick - wheel_tick) < TIMER_WHEEL_SLOTS)
+    {
+        next = slot_deadline(wheel[0][tick & TIMER_WHEEL_MASK]);
+    }
+    else
+    {
+        next = UINT64_MAX;
+    }
+    /* A cascade at 'tick' may bring an earlier level 0 slot */
+    if ((tick & TIMER_WHEEL_MASK) == 0u)
+    {
+        next = tick << TIMER_WHEEL_SLOT_SHIFT;
+    }
+    return (next < deadline) ? next : deadline;
+}
+
+static void wheel_cascade(uint64_t tick)
+{
+    for (uint32_t level = 1; level < TIMER_WHEEL_LEVELS; level++)
+    {
+        uint32_t shift = TIMER_WHEEL_BITS * level;
+        uint32_t slot;
+        timer_service_timer_t *timer;
+
+        if ((tick & ((1ull << shift) - 1u)) != 0u)
+        {
+            break;
+        }
+
+        slot = (uint32_t)(tick >> shift) & TIMER_WHEEL_MASK;
+        while ((timer = wheel[level][slot]) != NULL)
+        {
+            timer_unlink(timer);
+            wheel_insert(timer);
+        }
+    }
+}
+
+/* Moves the due timers of the current level 0 slot to the expired list */
+static void wheel_collect(uint64_t now)
+{
+    timer_service_timer_t *timer = wheel[0][wheel_tick & TIMER_WHEEL_MASK];
+    timer_service_timer_t *next;
+
+    for (; timer != NULL; timer = next)
+    {
+        next = timer->next;
+        if (timer->expires_us <= now)
+        {
+            timer_unlink(timer);
+            timer_link(timer, &expired, TIMER_WHEEL_EXPIRED, 0);
+        }
+    }
+}
+
+/******************************************************************************
+ * Function Name: wheel_advance
+ ******************************************************************************
+ * Summary:
+ *  Runs the wheel up to 'now', jumping over empty slots, and collects the
+ *  timers that are due.
+ *
+ ******************************************************************************/
+static void wheel_advance(uint64_t now)
+{
+    uint64_t now_tick = now >> TIMER_WHEEL_SLOT_SHIFT;
+
+    while (true)
+    {
+        wheel_collect(now);
+        if (wheel_tick >= now_tick)
+        {
+            break;
+        }
+
+        uint64_t next = wheel_next_tick();
+        wheel_tick = (next < now_tick) ? next : now_tick;
+        wheel_cascade(wheel_tick);
+    }
+}
+
+/******************************************************************************
+ * Function Name: service_arm
+ ******************************************************************************
+ * Summary:
+ *  Sets the counter compare to the next deadline. A deadline in a later
+ *  counter period is left to the terminal count interrupt. The count is
+ *  read back after the write, so a compare that was passed while being
+ *  written is set again further ahead.
+ *
+ ******************************************************************************/
+static void service_arm(void)
+{
+    uint64_t deadline = wheel_next_deadline();
+
+    while (true)
+    {
+        uint64_t now = service_now();
+        uint64_t target = deadline;
+        uint32_t compare = TIMER_SERVICE_PERIOD;
+
+        if (target < (now + TIMER_SERVICE_MIN_LEAD_US))
+        {
+            target = now + TIMER_SERVICE_MIN_LEAD_US;
+        }
+        if ((target >> TIMER_SERVICE_SHIFT) == (now >> TIMER_SERVICE_SHIFT))
+        {
+            compare = (uint32_t)target & TIMER_SERVICE_PERIOD;
+        }
+
+        /* channel_num is the counter number on the TCPWM of the PSoC 62 */
+        Cy_TCPWM_Counter_SetCompare0(service_timer.tcpwm.base, service_timer.tcpwm.resource.channel_num, compare);
+
+        if ((compare == TIMER_SERVICE_PERIOD) || (service_now() < target))
+        {
+            return;
+        }
+    }
+}
+
+/******************************************************************************
+ * Function Name: isr_service_timer
+ ******************************************************************************
+ * Summary:
+ *  Counter interrupt. Counts wraps, runs the callbacks of the due timers
+ *  with interrupts unmasked, re-files periodic timers and sets the compare
+ *  for the next deadline. Missed periods are dropped, not replayed.
+ *
+ ******************************************************************************/
+static void isr_service_timer(void *callback_arg, cyhal_timer_event_t event)
+{
+    UBaseType_t mask;
+    timer_service_timer_t *timer;
+    timer_service_callback_t callback;
+    void *arg;
+
+    (void) callback_arg;
+
+    if ((event & CYHAL_TIMER_IRQ_TERMINAL_COUNT) != 0u)
+    {
+        mask = taskENTER_CRITICAL_FROM_ISR();
+        service_epoch++;
+        taskEXIT_CRITICAL_FROM_ISR(mask);
+    }
+
+    while (true)
+    {
+        mask = taskENTER_CRITICAL_FROM_ISR();
+        uint64_t now = service_now();
+        if (expired == NULL)
+        {
+            wheel_advance(now);
+        }
+
+        timer = expired;
+        if (timer == NULL)
+        {
+            service_arm();
+            taskEXIT_CRITICAL_FROM_ISR(mask);
+            return;
+        }
+
+        timer_unlink(timer);
+        if (timer->period_us != 0u)
+        {
+            timer->expires_us += timer->period_us;
+            if (timer->expires_us <= now)
+            {
+                timer->expires_us = now + timer->period_us;
+            }
+            wheel_insert(timer);
+        }
+        callback = timer->callback;
+        arg = timer->arg;
+        taskEXIT_CRITICAL_FROM_ISR(mask);
+
+        callback(arg);
+    }
+}
+
+/******************************************************************************
+ * Function Name: timer_service_init
+ ******************************************************************************
+ * Summary:
+ *  Claims and starts the counter. Called by timer_init(), and again by
+ *  runtime_stats_timer_init(), which needs the time base as well.
+ *
+ ******************************************************************************/
+void timer_service_init(void)
+{
+    cy_rslt_t result;
+
+    const cyhal_timer_cfg_t service_timer_cfg =
+    {
+        .compare_value = TIMER_SERVICE_PERIOD, /* Moved to each deadline */
+        .period = TIMER_SERVICE_PERIOD,
+        .direction = CYHAL_TIMER_DIR_UP,    /* Timer counts up */
+        .is_compare = true,                 /* Compare match per deadline */
+        .is_continuous = true,              /* Run timer indefinitely */
+        .value = 0                          /* Initial value of counter */
+    };
+
+    if (service_started)
+    {
+        return;
+    }
+
+    result = cyhal_timer_init(&service_timer, NC, NULL);
+    if (result != CY_RSLT_SUCCESS)
+    {
+        printf("Timer service initialization failed. Error: %ld\n", (long unsigned int)result);
+        CY_ASSERT(0);
+    }
+
+    cyhal_timer_configure(&service_timer, &service_timer_cfg);
+    cyhal_timer_set_frequency(&service_timer, TIMER_SERVICE_CLOCK_HZ);
+    cyhal_timer_register_callback(&service_timer, isr_service_timer, NULL);
+    cyhal_timer_enable_event(&service_timer, CYHAL_TIMER_IRQ_ALL, TIMER_SERVICE_IRQ_PRIORITY, true);
+    cyhal_timer_start(&service_timer);
+    service_started = true;
+}
+
+/******************************************************************************
+ * Function Name: timer_service_now_us
+ ******************************************************************************
+ * Summary:
+ *  Microseconds since timer_service_init(). Safe from tasks, ISRs and the
+ *  scheduler's run time counter hook.
+ *
+ ******************************************************************************/
+uint64_t timer_service_now_us(void)
+{
+    UBaseType_t mask = taskENTER_CRITICAL_FROM_ISR();
+    uint64_t now = service_now();
+
+    taskEXIT_CRITICAL_FROM_ISR(mask);
+    return now;
+}
+
+void timer_service_timer_init(timer_service_timer_t *timer, timer_service_callback_t callback, void *arg)
+{
+    timer->next = NULL;
+    timer->pprev = NULL;
+    timer->expires_us = 0;
+    timer->period_us = 0;
+    timer->callback = callback;
+    timer->arg = arg;
+}
+
+bool timer_service_active(const timer_service_timer_t *timer)
+{
+    return timer->pprev != NULL;
+}
+
+static void service_start(timer_service_timer_t *timer, uint32_t delay_us, uint32_t period_us)
+{
+    if (timer->pprev != NULL)
+    {
+        timer_unlink(timer);
+    }
+    timer->expires_us = service_now() + delay_us;
+    timer->period_us = period_us;
+    wheel_insert(timer);
+    service_arm();
+}
+
+static void service_stop(timer_service_timer_t *timer)
+{
+    /* The compare is left as it is, an interrupt with nothing due only
+     * sets it again */
+    if (timer->pprev != NULL)
+    {
+        timer_unlink(timer);
+    }
+}
+
+/******************************************************************************
+ * Function Name: timer_service_start
+ ******************************************************************************
+ * Summary:
+ *  Runs the timer's callback 'delay_us' from now, then every 'period_us'
+ *  if that is not 0.
+ *
+ ******************************************************************************/
+void timer_service_start(timer_service_timer_t *timer, uint32_t delay_us, uint32_t period_us)
+{
+    taskENTER_CRITICAL();
+    service_start(timer, delay_us, period_us);
+    taskEXIT_CRITICAL();
+}
+
+void timer_service_stop(timer_service_timer_t *timer)
+{
+    taskENTER_CRITICAL();
+    service_stop(timer);
+    taskEXIT_CRITICAL();
+}
+
+void timer_service_start_from_isr(timer_service_timer_t *timer, uint32_t delay_us, uint32_t period_us)
+{
+    UBaseType_t mask = taskENTER_CRITICAL_FROM_ISR();
+
+    service_start(timer, delay_us, period_us);
+    taskEXIT_CRITICAL_FROM_ISR(mask);
+}
+
+void timer_service_stop_from_isr(timer_service_timer_t *timer)
+{
+    UBaseType_t mask = taskENTER_CRITICAL_FROM_ISR();
+
+    service_stop(timer);
+    taskEXIT_CRITICAL_FROM_ISR(mask);
+}
+
+/* [] END OF FILE */
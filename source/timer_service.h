@@ -0,0 +1,75 @@
+/******************************************************************************
+* File Name:   timer_service.h
+*
+* Description: This file is the public interface of timer_service.c, the
+*              software timers scheduled on one free-running TCPWM counter.
+*
+* Related Document: See README.md
+*
+*******************************************************************************/
+
+#ifndef TIMER_SERVICE_H_
+#define TIMER_SERVICE_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/*******************************************************************************
+* Macros
+********************************************************************************/
+/* Counter clock, so deadlines and timer_service_now_us() are in us */
+#define TIMER_SERVICE_CLOCK_HZ            (1000000u)
+
+/* Same priority the separate timer ISRs had. Callbacks may use the
+ * FreeRTOS FromISR API, so it must not be above
+ * configMAX_SYSCALL_INTERRUPT_PRIORITY. */
+#define TIMER_SERVICE_IRQ_PRIORITY        (7u)
+
+/* Wheel geometry: level 0 slots are 2^TIMER_WHEEL_SLOT_SHIFT us wide and
+ * each level is TIMER_WHEEL_SLOTS times coarser than the one below, so
+ * the wheel spans 32 us * 64^4, about 9 minutes. Longer timers wait in the
+ * last level and are re-filed when they come round. */
+#define TIMER_WHEEL_SLOT_SHIFT            (5u)
+#define TIMER_WHEEL_BITS                  (6u)
+#define TIMER_WHEEL_SLOTS                 (1u << TIMER_WHEEL_BITS)
+#define TIMER_WHEEL_LEVELS                (4u)
+
+/*******************************************************************************
+* Global Variables
+********************************************************************************/
+/* Runs in the timer interrupt, use the _from_isr calls in it */
+typedef void (*timer_service_callback_t)(void *arg);
+
+/* Owned by the caller and left to the service while running */
+typedef struct timer_service_timer
+{
+    struct timer_service_timer *next;
+    struct timer_service_timer **pprev; /* NULL while stopped */
+    uint64_t expires_us;
+    uint32_t period_us;                 /* 0 for a one-shot */
+    timer_service_callback_t callback;
+    void *arg;
+    uint8_t level;
+    uint8_t slot;
+} timer_service_timer_t;
+
+/*******************************************************************************
+* Function Prototypes
+********************************************************************************/
+void timer_service_init(void);
+uint64_t timer_service_now_us(void);
+
+void timer_service_timer_init(timer_service_timer_t *timer, timer_service_callback_t callback, void *arg);
+bool timer_service_active(const timer_service_timer_t *timer);
+
+/* Starting a running timer re-arms it. A 'period_us' of 0 is a one-shot. */
+void timer_service_start(timer_service_timer_t *timer, uint32_t delay_us, uint32_t period_us);
+void timer_service_stop(timer_service_timer_t *timer);
+
+/* From an ISR or timer callback, or from a task inside a critical section */
+void timer_service_start_from_isr(timer_service_timer_t *timer, uint32_t delay_us, uint32_t period_us);
+void timer_service_stop_from_isr(timer_service_timer_t *timer);
+
+#endif /* TIMER_SERVICE_H_ */
+
+/* [] END OF FILE */
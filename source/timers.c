@@ -4,45 +4,48 @@
 #include "macros.h"
 #include "functions.h"
 #include "publisher_task.h"
-
-
-/* Timer objects*/
-cyhal_timer_t led_blink_timer;
-cyhal_timer_t pump_timer;
-cyhal_timer_t wire_timer;
-cyhal_timer_t write_timer;
-cyhal_timer_t read_timer;
+#include "pump_scheduler.h"
+#include "probe_scheduler.h"
+#include "timer_service.h"
+
+
+/* Timer objects, all run by the timer service */
+timer_service_timer_t publish_tick_timer;
+timer_service_timer_t pump_timer;
+timer_service_timer_t probe_timer;
+#if !WIRE_BUS_UART
+timer_service_timer_t wire_timer;
+timer_service_timer_t write_timer;
+timer_service_timer_t read_timer;
+timer_service_timer_t read_sample_timer;
+#endif
 
 bool timer_interrupt_flag = false;
-bool pump_timer_interrupt_flag = false;
 bool led_blink_active_flag = true;
-bool wire_initialized = false;
-bool wire_busy = false;
 
 extern int timerCount;
-extern volatile unsigned flow_count;
 extern volatile transaction_t transaction;
-extern volatile unsigned ringBuffer[RING_BUFFER_SIZE];
-extern unsigned volatile ringHead;
-extern unsigned volatile ringTail;
 
 
 // static void isr_timer(void *callback_arg, cyhal_timer_event_t event);
-static void isr_pump_timer(void *callback_arg, cyhal_timer_event_t event);
-static void isr_wire_timer(void *callback_arg, cyhal_timer_event_t event);
-static void isr_write_timer(void *callback_arg, cyhal_timer_event_t event);
-static void isr_read_timer(void *callback_arg, cyhal_timer_event_t event);
-static void publish_timer(void *callback_arg, cyhal_timer_event_t event);
+static void isr_pump_timer(void *arg);
+static void isr_probe_timer(void *arg);
+#if !WIRE_BUS_UART
+static void isr_wire_timer(void *arg);
+static void isr_write_timer(void *arg);
+static void isr_read_timer(void *arg);
+static void isr_read_sample(void *arg);
+#endif
+static void publish_timer(void *arg);
 
 /*******************************************************************************
 * Function Name: timer_init
 ********************************************************************************
 * Summary:
-* This function creates and configures a Timer object. The timer ticks
-* continuously and produces a periodic interrupt on every terminal count
-* event. The period is defined by the 'period' and 'compare_value' of the
-* timer configuration structure 'led_blink_timer_cfg'. Without any changes,
-* this application is designed to produce an interrupt every 1 second.
+* This function starts the timer service and binds the application timers
+* to their callbacks. They all share the service's one TCPWM counter and
+* interrupt; publisher_task() starts the 1 second publish tick, and the
+* pump, probe and 1-Wire timers are started as one-shots when needed.
 *
 * Parameters:
 *  none
@@ -53,258 +56,110 @@ static void publish_timer(void *callback_arg, cyhal_timer_event_t event);
 *******************************************************************************/
  void timer_init(void)
  {
-    cy_rslt_t result;
-
-    const cyhal_timer_cfg_t led_blink_timer_cfg =
-    {
-        .compare_value = 0,                 /* Timer compare value, not used */
-        .period = LED_BLINK_TIMER_PERIOD,   /* Defines the timer period */
-        .direction = CYHAL_TIMER_DIR_UP,    /* Timer counts up */
-        .is_compare = false,                /* Don't use compare mode */
-        .is_continuous = true,              /* Run timer indefinitely */
-        .value = 0                          /* Initial value of counter */
-    };
-
-    const cyhal_timer_cfg_t pump_timer_cfg =
-    {
-        .compare_value = 0,                 /* Timer compare value, not used */
-        .period = PUMP_TIMER_PERIOD,   /* Defines the timer period */
-        .direction = CYHAL_TIMER_DIR_UP,    /* Timer counts up */
-        .is_compare = false,                /* Don't use compare mode */
-        .is_continuous = true,              /* Run timer indefinitely */
-        .value = 0                          /* Initial value of counter */
-    };
-
-    const cyhal_timer_cfg_t wire_timer_cfg =
-    {
-        .compare_value = 0,                 
-        .period = WIRE_TIMER_PERIOD,   /* Defines the timer period */
-        .direction = CYHAL_TIMER_DIR_UP,    /* Timer counts up */
-        .is_compare = false,                /* Don't use compare mode */
-        .is_continuous = false,              /* Run timer indefinitely */
-        .value = 0                          /* Initial value of counter */
-    };
-
-        const cyhal_timer_cfg_t write_timer_cfg =
-    {
-        .compare_value = 0,                 /* Timer compare value */
-        .period = WRITE_TIMER_PERIOD,       /* Defines the timer period */
-        .direction = CYHAL_TIMER_DIR_UP,    /* Timer counts up */
-        .is_compare = false,                /*  use compare mode */
-        .is_continuous = false,              
-        .value = 0                          /* Initial value of counter */
-    };
-
-        const cyhal_timer_cfg_t read_timer_cfg =
-    {
-        .compare_value =READ_TIMER_SLOT,                 /* Timer compare value */
-        .period = READ_TIMER_PERIOD,       /* Defines the timer period */
-        .direction = CYHAL_TIMER_DIR_UP,    /* Timer counts up */
-        .is_compare = true,                /*  use compare mode */
-        .is_continuous = false,              
-        .value = 0                          /* Initial value of counter */
-    };
-
-    /* Initialize the timer object. Does not use input pin ('pin' is NC) and
-     * does not use a pre-configured clock source ('clk' is NULL). */
-    result = cyhal_timer_init(&led_blink_timer, NC, NULL);
-
-    /* timer init failed. Stop program execution */
-    if (result != CY_RSLT_SUCCESS)
-    {
-        CY_ASSERT(0);
-    }
-
-    /* Initialize the timer object. Does not use input pin ('pin' is NC) and
-     * does not use a pre-configured clock source ('clk' is NULL). */
-    result = cyhal_timer_init(&pump_timer, NC, NULL);
-
-    /* timer init failed. Stop program execution */
-    if (result != CY_RSLT_SUCCESS)
-    {
-        CY_ASSERT(0);
-    }
-
-    /* Initialize the timer object. Does not use input pin ('pin' is NC) and
-     * does not use a pre-configured clock source ('clk' is NULL). */
-    result = cyhal_timer_init(&wire_timer, NC, NULL);
-    
-
-    /* timer init failed. Stop program execution */
-    if (result != CY_RSLT_SUCCESS)
-    {
-        CY_ASSERT(0);
-    }
-
-    /* Initialize the timer object. Does not use input pin ('pin' is NC) and
-     * does not use a pre-configured clock source ('clk' is NULL). */
-    result = cyhal_timer_init(&write_timer, NC, NULL);
-    
-
-    /* timer init failed. Stop program execution */
-    if (result != CY_RSLT_SUCCESS)
-    {
-        CY_ASSERT(0);
-    }
-
-        /* Initialize the timer object. Does not use input pin ('pin' is NC) and
-     * does not use a pre-configured clock source ('clk' is NULL). */
-    result = cyhal_timer_init(&read_timer, NC, NULL);
-    
-
-    /* timer init failed. Stop program execution */
-    if (result != CY_RSLT_SUCCESS)
-    {
-        CY_ASSERT(0);
-    }
+    timer_service_init();
+
+    timer_service_timer_init(&publish_tick_timer, publish_timer, NULL);
+    timer_service_timer_init(&pump_timer, isr_pump_timer, NULL);
+    timer_service_timer_init(&probe_timer, isr_probe_timer, NULL);
+#if !WIRE_BUS_UART
+    /* 1-Wire reset window and bit slots, not needed with the UART master */
+    timer_service_timer_init(&wire_timer, isr_wire_timer, NULL);
+    timer_service_timer_init(&write_timer, isr_write_timer, NULL);
+    timer_service_timer_init(&read_timer, isr_read_timer, NULL);
+    timer_service_timer_init(&read_sample_timer, isr_read_sample, NULL);
+#endif
+ }
 
-    /* Configure timer period and operation mode such as count direction,
-       duration */
-    cyhal_timer_configure(&led_blink_timer, &led_blink_timer_cfg);
-    cyhal_timer_configure(&pump_timer, &pump_timer_cfg);
-    cyhal_timer_configure(&wire_timer, &wire_timer_cfg);
-    cyhal_timer_configure(&write_timer, &write_timer_cfg);
-    cyhal_timer_configure(&read_timer, &read_timer_cfg);
 
-    /* Set the frequency of timer's clock source */
-    cyhal_timer_set_frequency(&led_blink_timer, LED_BLINK_TIMER_CLOCK_HZ);
-    cyhal_timer_set_frequency(&pump_timer, PUMP_TIMER_CLOCK_HZ);
-    cyhal_timer_set_frequency(&wire_timer, WIRE_TIMER_CLOCK_HZ);
-    cyhal_timer_set_frequency(&write_timer, WRITE_TIMER_CLOCK_HZ);
-    cyhal_timer_set_frequency(&read_timer, READ_TIMER_CLOCK_HZ);
-    
-    /* Assign the ISR to execute on timer interrupt */
-    cyhal_timer_register_callback(&led_blink_timer, publish_timer, NULL);
-    cyhal_timer_register_callback(&pump_timer, isr_pump_timer, NULL);
-    cyhal_timer_register_callback(&wire_timer, isr_wire_timer, NULL);
-    cyhal_timer_register_callback(&write_timer, isr_write_timer, NULL);
-    cyhal_timer_register_callback(&read_timer, isr_read_timer, NULL);
+//isr_pump_timer
+//One-shot at the nearest pump deadline, switches off the pumps due.
+static void isr_pump_timer(void *arg)
+{
+    (void) arg;
 
-    /* Set the event on which timer interrupt occurs and enable it */
-    cyhal_timer_enable_event(&led_blink_timer, CYHAL_TIMER_IRQ_TERMINAL_COUNT, 7, true);
-    cyhal_timer_enable_event(&pump_timer, CYHAL_TIMER_IRQ_TERMINAL_COUNT, 7, true);
-    cyhal_timer_enable_event(&wire_timer, CYHAL_TIMER_IRQ_TERMINAL_COUNT, 7, true); 
-    cyhal_timer_enable_event(&write_timer, CYHAL_TIMER_IRQ_ALL, 7, true);
-    cyhal_timer_enable_event(&read_timer, CYHAL_TIMER_IRQ_ALL, 7, true); 
+    pump_timer_expired_from_isr();
+}
 
-    /* Start the timer with the configured settings */
-    // cyhal_timer_start(&led_blink_timer);
- //   cyhal_timer_start(&pump_timer);
- }
+//isr_probe_timer
+//One-shot at the next probe switching step.
+static void isr_probe_timer(void *arg)
+{
+    (void) arg;
 
-/******************************************************************************
- * Function Name: timer_init
- ******************************************************************************
- * Summary:
- *  Timer initialization, uses led_blinker_timer configuration
- *
- * Parameters:
- *  void
- *
- * Return:
- *  void
- *
- ******************************************************************************/
+    probe_timer_expired_from_isr();
+}
 
 
-static void isr_pump_timer(void *callback_arg, cyhal_timer_event_t event)
+#if !WIRE_BUS_UART
+//isr_wire_timer
+//Ends the reset pulse and opens the presence window, then wakes the
+//temperature task when the presence window closes.
+static void isr_wire_timer(void *arg)
 {
-    (void) callback_arg;
-    (void) event;
+    (void) arg;
 
-    /* Set the interrupt flag and process it from the main while(1) loop */
-    pump_timer_interrupt_flag = true;
+    if (transaction == RESET){
+        cyhal_gpio_write(TEMP_PIN, 1);
+        transaction = PRESENSE;     //isr_wire watches for the presence pulse
+        timer_service_start_from_isr(&wire_timer, WIRE_RESET_US, 0);
+        return;
+    }
 
+    cyhal_gpio_write(TEMP_PIN, 1);
+    wire_notify_from_isr(WIRE_EVT_SLOT_DONE);
 }
 
-
-void isr_wire_timer(void *callback_arg, cyhal_timer_event_t event)
+//isr_write_timer
+//End of a write slot, releases the bus.
+static void isr_write_timer(void *arg)
 {
-    (void) callback_arg;
-    (void) event;
-    // cy_rslt_t result;
-    
+    (void) arg;
+
     cyhal_gpio_write(TEMP_PIN, 1);
-    wire_busy = false;
-    // if (transaction == RESET || wire_initialized){
-    //     transaction++;
-    // }
-    
+    wire_notify_from_isr(WIRE_EVT_SLOT_DONE);
 }
 
-void isr_write_timer(void *callback_arg, cyhal_timer_event_t event)
+//isr_read_sample
+//Samples the bus WIRE_READ_SAMPLE_US into a read slot.
+static void isr_read_sample(void *arg)
 {
-    (void) callback_arg;
-    (void) event;
-    
-    
-
-    switch (event)
-    {
-    case CYHAL_TIMER_IRQ_CAPTURE_COMPARE:       //Read
-        // cyhal_gpio_write(TEMP_PIN, 1);
-        // wire_busy = false;
-        break;
-    case CYHAL_TIMER_IRQ_TERMINAL_COUNT:        //Write
-        cyhal_gpio_write(TEMP_PIN, 1);
-        wire_busy = false;
-        // printf("%lu\r\n", cyhal_timer_read(&write_timer));
-        break;
-    default:
-        // cyhal_gpio_toggle(TEMP_PIN);
-        
-        break;
-    }
+    (void) arg;
 
+    wire_read_sample_from_isr(cyhal_gpio_read(TEMP_PIN));
 }
 
-void isr_read_timer(void *callback_arg, cyhal_timer_event_t event)
+//isr_read_timer
+//End of a read slot.
+static void isr_read_timer(void *arg)
 {
-    (void) callback_arg;
-    (void) event;
-    
-    
-
-    switch (event)
-    {
-    case CYHAL_TIMER_IRQ_CAPTURE_COMPARE:
-        ringBuffer[ringHead++] = cyhal_gpio_read(TEMP_PIN);
-        if (ringHead >= RING_BUFFER_SIZE){ringHead = 0;}
-        break;
+    (void) arg;
 
-    case CYHAL_TIMER_IRQ_TERMINAL_COUNT:
-        wire_busy = false;
-        break;
-        
-    default:
-        break;
-    }
+    wire_read_slot_end_from_isr();     //Next slot, or wake the task
 }
+#endif /* !WIRE_BUS_UART */
 
 /******************************************************************************
  * Function Name: publish_timer
  ******************************************************************************
  * Summary:
- *  Timer ISR. Sends publish command to message queue and increment timerCount
- *  variable used to control EC and pH switching in publisher_task()
+ *  Publish tick callback. Sends publish command to message queue and increment timerCount
+ *  variable used to pace the temperature conversions in publisher_task()
  *
  * Parameters:
- *  void *callback_arg : pointer to variable passed to the ISR (unused)
- *  cyhal_gpio_event_t event : GPIO event type (unused)
+ *  void *arg : argument bound in timer_init() (unused)
  *
  * Return:
  *  void
  *
  ******************************************************************************/
 
-static void publish_timer(void *callback_arg, cyhal_timer_event_t event)
+static void publish_timer(void *arg)
 {
 	BaseType_t xHigherPriorityTaskWoken = pdFALSE;
 	publisher_data_t publisher_q_data;
 
 	/* To avoid compiler warnings */
-	(void) callback_arg;
-	(void) event;
+	(void) arg;
 
 	/* Assign the publish command to be sent to the publisher task. */
 	// this is how the while loop knows which function to access
@@ -0,0 +1,287 @@
+/******************************************************************************
+* File Name:   wire_uart.c
+*
+* Description: This file contains the 1-Wire master on an SCB UART, built
+*              with WIRE_BUS_UART=1 in place of the bit-banged bus in
+*              TempSensor.c.
+*
+*              Each 1-Wire slot is one UART byte: the start bit is the low
+*              pulse and the bus level is read back on RX. At 9600 baud 0xF0
+*              is a 520 us reset pulse, and a presence pulse corrupts the
+*              echoed byte. At 115200 baud 0xFF writes a 1 or opens a read
+*              slot, whose echo is 0xFF only if no device held the line low,
+*              and 0x00 writes a 0. Whole blocks are moved by DMA, so a
+*              MATCH ROM or a scratchpad read takes one interrupt.
+*
+* Related Document: See README.md
+*
+*******************************************************************************/
+
+#include <stdio.h>
+#include <string.h>
+
+#include "cy_pdl.h"
+#include "cyhal.h"
+
+#include "FreeRTOS.h"
+#include "task.h"
+
+#include "macros.h"
+#include "functions.h"
+
+#if WIRE_BUS_UART
+
+/******************************************************************************
+* Macros
+******************************************************************************/
+#define WIRE_UART_RESET_BYTE            (0xF0u)
+#define WIRE_UART_SLOT_ONE              (0xFFu)
+#define WIRE_UART_SLOT_ZERO             (0x00u)
+
+#define WIRE_UART_IRQ_PRIORITY          (7u)
+
+/******************************************************************************
+* Global Variables
+*******************************************************************************/
+static cyhal_uart_t wire_uart;
+
+/* One UART byte per 1-Wire slot. The DMA writes rx_slots, so both buffers
+ * stay in RAM for the length of a transfer. */
+static uint8_t tx_slots[WIRE_UART_MAX_BYTES * 8u];
+static uint8_t rx_slots[WIRE_UART_MAX_BYTES * 8u];
+
+static uint32_t current_baud = 0;
+
+/******************************************************************************
+ * Function Name: wire_uart_event
+ ******************************************************************************
+ * Summary:
+ *  UART callback. The last echoed byte ends the transfer and wakes the
+ *  temperature task.
+ *
+ ******************************************************************************/
+static void wire_uart_event(void *callback_arg, cyhal_uart_event_t event)
+{
+    (void) callback_arg;
+
+    if ((event & CYHAL_UART_IRQ_RX_DONE) != 0u)
+    {
+        wire_notify_from_isr(WIRE_EVT_SLOT_DONE);
+    }
+}
+
+/******************************************************************************
+ * Function Name: wire_uart_baud
+ ******************************************************************************
+ * Summary:
+ *  Switches the baud rate between transfers only when it changes.
+ *
+ ******************************************************************************/
+static bool wire_uart_baud(uint32_t baud)
+{
+    uint32_t actual;
+
+    if (baud == current_baud)
+    {
+        return true;
+    }
+    if (cyhal_uart_set_baud(&wire_uart, baud, &actual) != CY_RSLT_SUCCESS)
+    {
+        current_baud = 0;
+        return false;
+    }
+    current_baud = baud;
+    return true;
+}
+
+/******************************************************************************
+ * Function Name: wire_uart_transfer
+ ******************************************************************************
+ * Summary:
+ *  Sends 'len' slot bytes and sleeps until their echo has been received.
+ *
+ * Return:
+ *  bool : false on a HAL error or if the echo did not arrive in time
+ *
+ ******************************************************************************/
+static bool wire_uart_transfer(size_t len)
+{
+    (void) cyhal_uart_clear(&wire_uart);
+    if ((cyhal_uart_read_async(&wire_uart, rx_slots, len) != CY_RSLT_SUCCESS) ||
+        (cyhal_uart_write_async(&wire_uart, tx_slots, len) != CY_RSLT_SUCCESS))
+    {
+        (void) cyhal_uart_read_abort(&wire_uart);
+        return false;
+    }
+
+    if ((wire_wait_slot() & WIRE_EVT_SLOT_DONE) == 0u)
+    {
+        (void) cyhal_uart_write_abort(&wire_uart);
+        (void) cyhal_uart_read_abort(&wire_uart);
+        return false;
+    }
+    return true;
+}
+
+/******************************************************************************
+ * Function Name: wire_uart_init
+ ******************************************************************************
+ * Summary:
+ *  Claims the SCB UART on WIRE_UART_TX/WIRE_UART_RX with DMA transfers and
+ *  switches TX to open drain so devices can pull the line low.
+ *
+ ******************************************************************************/
+void wire_uart_init(void)
+{
+    cy_rslt_t result;
+    const cyhal_uart_cfg_t uart_cfg =
+    {
+        .data_bits = 8,
+        .stop_bits = 1,
+        .parity = CYHAL_UART_PARITY_NONE,
+        .rx_buffer = NULL,
+        .rx_buffer_size = 0
+    };
+
+    result = cyhal_uart_init(&wire_uart, WIRE_UART_TX, WIRE_UART_RX, NC, NC, NULL, &uart_cfg);
+    if (result == CY_RSLT_SUCCESS)
+    {
+        result = cyhal_uart_set_async_mode(&wire_uart, CYHAL_ASYNC_DMA, CYHAL_DMA_PRIORITY_DEFAULT);
+    }
+    if (result != CY_RSLT_SUCCESS)
+    {
+        printf("1-Wire UART initialization failed. Error: %ld\n", (long unsigned int)result);
+        CY_ASSERT(0);
+    }
+
+    Cy_GPIO_SetDrivemode(CYHAL_GET_PORTADDR(WIRE_UART_TX), CYHAL_GET_PIN(WIRE_UART_TX), CY_GPIO_DM_OD_DRIVESLOW);
+
+    cyhal_uart_register_callback(&wire_uart, wire_uart_event, NULL);
+    cyhal_uart_enable_event(&wire_uart, CYHAL_UART_IRQ_RX_DONE, WIRE_UART_IRQ_PRIORITY, true);
+}
+
+/******************************************************************************
+ * Function Name: wire_bus_reset
+ ******************************************************************************
+ * Summary:
+ *  Reset pulse and presence window at WIRE_UART_RESET_BAUD.
+ *
+ * Return:
+ *  uint32_t : WIRE_EVT_SLOT_DONE, with WIRE_EVT_PRESENCE if a device
+ *  answered. 0 if the echo did not arrive.
+ *
+ ******************************************************************************/
+uint32_t wire_bus_reset(void)
+{
+    if (!wire_uart_baud(WIRE_UART_RESET_BAUD))
+    {
+        return 0;
+    }
+
+    tx_slots[0] = WIRE_UART_RESET_BYTE;
+    if (!wire_uart_transfer(1u))
+    {
+        return 0;
+    }
+    return (rx_slots[0] != WIRE_UART_RESET_BYTE) ? (WIRE_EVT_SLOT_DONE | WIRE_EVT_PRESENCE) : WIRE_EVT_SLOT_DONE;
+}
+
+bool wire_bus_write_bit(uint8_t value)
+{
+    if (!wire_uart_baud(WIRE_UART_SLOT_BAUD))
+    {
+        return false;
+    }
+
+    tx_slots[0] = (value & 0x01u) ? WIRE_UART_SLOT_ONE : WIRE_UART_SLOT_ZERO;
+    return wire_uart_transfer(1u);
+}
+
+/******************************************************************************
+ * Function Name: wire_bus_read_bit
+ ******************************************************************************
+ * Return:
+ *  int : the bit read, or -1 on timeout
+ *
+ ******************************************************************************/
+int wire_bus_read_bit(void)
+{
+    if (!wire_bus_write_bit(1u))
+    {
+        return -1;
+    }
+    return (rx_slots[0] == WIRE_UART_SLOT_ONE) ? 1 : 0;
+}
+
+/******************************************************************************
+ * Function Name: wire_bus_write
+ ******************************************************************************
+ * Summary:
+ *  Writes 'len' bytes LSB first, WIRE_UART_MAX_BYTES per DMA transfer.
+ *
+ ******************************************************************************/
+bool wire_bus_write(const uint8_t *data, uint8_t len)
+{
+    if (!wire_uart_baud(WIRE_UART_SLOT_BAUD))
+    {
+        return false;
+    }
+
+    while (len > 0u)
+    {
+        uint8_t block = (len > WIRE_UART_MAX_BYTES) ? WIRE_UART_MAX_BYTES : len;
+
+        for (uint32_t i = 0; i < (block * 8u); i++)
+        {
+            tx_slots[i] = ((data[i / 8u] >> (i % 8u)) & 0x01u) ? WIRE_UART_SLOT_ONE : WIRE_UART_SLOT_ZERO;
+        }
+        if (!wire_uart_transfer(block * 8u))
+        {
+            return false;
+        }
+        data += block;
+        len -= block;
+    }
+    return true;
+}
+
+/******************************************************************************
+ * Function Name: wire_bus_read
+ ******************************************************************************
+ * Summary:
+ *  Reads 'len' bytes LSB first, WIRE_UART_MAX_BYTES per DMA transfer.
+ *
+ ******************************************************************************/
+bool wire_bus_read(uint8_t *data, uint8_t len)
+{
+    if (!wire_uart_baud(WIRE_UART_SLOT_BAUD))
+    {
+        return false;
+    }
+
+    while (len > 0u)
+    {
+        uint8_t block = (len > WIRE_UART_MAX_BYTES) ? WIRE_UART_MAX_BYTES : len;
+
+        memset(tx_slots, WIRE_UART_SLOT_ONE, block * 8u);
+        if (!wire_uart_transfer(block * 8u))
+        {
+            return false;
+        }
+        memset(data, 0, block);
+        for (uint32_t i = 0; i < (block * 8u); i++)
+        {
+            if (rx_slots[i] == WIRE_UART_SLOT_ONE)
+            {
+                data[i / 8u] |= (uint8_t)(1u << (i % 8u));
+            }
+        }
+        data += block;
+        len -= block;
+    }
+    return true;
+}
+
+#endif /* WIRE_BUS_UART */
+
+/* [] END OF FILE */
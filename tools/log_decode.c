@@ -0,0 +1,247 @@
+/******************************************************************************
+* File Name:   log_decode.c
+*
+* Description: Host decoder for the deferred log frames written by
+*              source/dlog.c. Reads the debug UART capture (or a payload of
+*              the "hydro/<id>/log" topic) and prints each record with its
+*              format string from source/dlog_messages.h. Bytes outside a
+*              frame, such as the remaining printf output, are passed through.
+*
+*   gcc -std=c11 -Wall -o log_decode tools/log_decode.c
+*   ./log_decode < capture.bin
+*   ./log_decode /dev/ttyACM0
+*   mosquitto_sub -t 'hydro/+/log' | ./log_decode
+*
+* Related Document: See README.md
+*
+*******************************************************************************/
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+
+#include "../source/dlog_messages.h"
+
+/*******************************************************************************
+* Macros
+********************************************************************************/
+/* Must match dlog.h, which is not included because it pulls in FreeRTOS */
+#define DLOG_FRAME_SYNC                 (0xA5u)
+#define DLOG_FRAME_HEADER_LEN           (7u)
+#define DLOG_MAX_ARGS                   (4u)
+#define DLOG_FRAME_MAX_LEN              (DLOG_FRAME_HEADER_LEN + (DLOG_MAX_ARGS * 4u) + 1u)
+
+#define DLOG_MESSAGE_FORMAT(id, format) format,
+
+/*******************************************************************************
+* Global Variables
+********************************************************************************/
+static const char *const formats[DLOG_MSG_COUNT] =
+{
+    DLOG_MESSAGES(DLOG_MESSAGE_FORMAT)
+};
+
+/* Frame being collected, frame[0] is the sync byte */
+static uint8_t frame[DLOG_FRAME_MAX_LEN];
+static size_t frame_len = 0;
+
+static void decode_byte(uint8_t byte);
+
+static uint32_t get_u32(const uint8_t *in)
+{
+    return (uint32_t)in[0] | ((uint32_t)in[1] << 8) | ((uint32_t)in[2] << 16) | ((uint32_t)in[3] << 24);
+}
+
+/* Bytes of the frame once its header is in, 0 while it is still unknown */
+static size_t frame_expected(void)
+{
+    if (frame_len < DLOG_FRAME_HEADER_LEN)
+    {
+        return 0;
+    }
+    return DLOG_FRAME_HEADER_LEN + ((size_t)frame[2] * 4u) + 1u;
+}
+
+/******************************************************************************
+ * Function Name: print_record
+ ******************************************************************************
+ * Summary:
+ *  Prints one record. Each conversion of the format string is rebuilt
+ *  without length modifiers and given one 32-bit argument.
+ *
+ ******************************************************************************/
+static void print_record(uint8_t id, uint32_t timestamp_ms, uint32_t nargs, const uint32_t *args)
+{
+    const char *p = formats[id];
+    uint32_t next = 0;
+
+    printf("[%10lu ms] ", (unsigned long)timestamp_ms);
+    while (*p != '\0')
+    {
+        char spec[16];
+        size_t len = 0;
+
+        if (*p != '%')
+        {
+            putchar(*p++);
+            continue;
+        }
+        if (p[1] == '%')
+        {
+            putchar('%');
+            p += 2;
+            continue;
+        }
+
+        spec[len++] = *p++;
+        while ((*p != '\0') && (strchr("-+ #0123456789", *p) != NULL) && (len < (sizeof(spec) - 2u)))
+        {
+            spec[len++] = *p++;
+        }
+        while ((*p == 'l') || (*p == 'h'))
+        {
+            p++;
+        }
+        if (*p == '\0')
+        {
+            break;
+        }
+        spec[len++] = *p++;
+        spec[len] = '\0';
+
+        uint32_t value = (next < nargs) ? args[next] : 0u;
+        next++;
+        switch (spec[len - 1u])
+        {
+            case 'd':
+            case 'i':
+                printf(spec, (int)(int32_t)value);
+                break;
+            case 'u':
+            case 'x':
+            case 'X':
+            case 'c':
+                printf(spec, (unsigned int)value);
+                break;
+            default:
+                printf("<%s?>", spec);
+                break;
+        }
+    }
+    fflush(stdout);
+}
+
+/******************************************************************************
+ * Function Name: frame_done
+ ******************************************************************************
+ * Summary:
+ *  Prints a complete frame, or when its checksum is wrong passes the sync
+ *  byte through as text and scans the rest again for the next frame.
+ *
+ ******************************************************************************/
+static void frame_done(void)
+{
+    uint8_t sum = 0;
+    uint8_t copy[DLOG_FRAME_MAX_LEN];
+    size_t copy_len = frame_len;
+
+    for (size_t i = 1; i < frame_len; i++)
+    {
+        sum += frame[i];
+    }
+
+    frame_len = 0;
+    if (sum == 0u)
+    {
+        uint32_t args[DLOG_MAX_ARGS];
+
+        for (uint32_t i = 0; i < frame[2]; i++)
+        {
+            args[i] = get_u32(&frame[DLOG_FRAME_HEADER_LEN + (i * 4u)]);
+        }
+        print_record(frame[1], get_u32(&frame[3]), frame[2], args);
+        return;
+    }
+
+    memcpy(copy, frame, copy_len);
+    putchar(copy[0]);
+    for (size_t i = 1; i < copy_len; i++)
+    {
+        decode_byte(copy[i]);
+    }
+}
+
+static void decode_byte(uint8_t byte)
+{
+    if (frame_len == 0u)
+    {
+        if (byte == DLOG_FRAME_SYNC)
+        {
+            frame[frame_len++] = byte;
+        }
+        else
+        {
+            putchar(byte);
+        }
+        return;
+    }
+
+    frame[frame_len++] = byte;
+
+    /* An unknown ID or too many arguments: not a frame after all */
+    if (((frame_len == 2u) && (byte >= DLOG_MSG_COUNT)) ||
+        ((frame_len == 3u) && (byte > DLOG_MAX_ARGS)))
+    {
+        uint8_t copy[3];
+        size_t copy_len = frame_len;
+
+        memcpy(copy, frame, copy_len);
+        frame_len = 0;
+        putchar(copy[0]);
+        for (size_t i = 1; i < copy_len; i++)
+        {
+            decode_byte(copy[i]);
+        }
+        return;
+    }
+
+    if ((frame_expected() != 0u) && (frame_len == frame_expected()))
+    {
+        frame_done();
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    FILE *in = stdin;
+    int c;
+
+    if (argc > 2)
+    {
+        fprintf(stderr, "usage: %s [capture file or tty]\n", argv[0]);
+        return 2;
+    }
+    if (argc == 2)
+    {
+        in = fopen(argv[1], "rb");
+        if (in == NULL)
+        {
+            perror(argv[1]);
+            return 1;
+        }
+    }
+
+    while ((c = fgetc(in)) != EOF)
+    {
+        decode_byte((uint8_t)c);
+    }
+
+    if (in != stdin)
+    {
+        fclose(in);
+    }
+    return 0;
+}
+
+/* [] END OF FILE */
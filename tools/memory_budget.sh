@@ -0,0 +1,69 @@
+#!/bin/bash
+################################################################################
+# \file memory_budget.sh
+# \version 1.0
+#
+# \brief
+# Link-time RAM report, run as the POSTBUILD step of the application
+# Makefile. Prints the RAM sections of the linked image, the application's
+# statically placed task stacks, TCBs, queues and buffers (see
+# source/app_alloc.h), and the largest remaining RAM objects. Fails the
+# build when .data + .bss exceed the optional budget.
+#
+#   tools/memory_budget.sh <elf> [toolchain prefix] [budget bytes]
+#   tools/memory_budget.sh build/APP_CY8CPROTO-062-4343W/Debug/app.elf arm-none-eabi- 262144
+#
+################################################################################
+
+ELF="$1"
+PREFIX="${2-arm-none-eabi-}"
+BUDGET="$3"
+
+# Largest other RAM objects listed
+TOP_COUNT=10
+
+if [ ! -f "$ELF" ]; then
+    echo "memory_budget: $ELF not found" >&2
+    exit 1
+fi
+
+if ! command -v "${PREFIX}nm" > /dev/null; then
+    echo "memory_budget: ${PREFIX}nm not found" >&2
+    exit 1
+fi
+
+echo "==================== RAM budget ===================="
+
+# Section totals, as placed by the linker script
+SECTIONS=$("${PREFIX}size" -A "$ELF")
+echo "$SECTIONS" | awk '
+    $1 ~ /^\.(data|bss|heap|stack|ram_vectors|noinit)$/ {
+        printf("  %-40s %8d bytes\n", $1, $2)
+    }'
+STATIC_TOTAL=$(echo "$SECTIONS" | awk '$1 == ".data" || $1 == ".bss" { total += $2 } END { print total + 0 }')
+printf "  %-40s %8d bytes\n" ".data + .bss" "$STATIC_TOTAL"
+
+# Storage placed by APP_TASK_DEFINE / APP_QUEUE_DEFINE and the MQTT buffer
+echo "---------------- static allocations ----------------"
+"${PREFIX}nm" -S --size-sort -t d "$ELF" | awk '
+    $3 ~ /^[bBdD]$/ && $4 ~ /(_stack|_tcb|_storage|_queue)$/ {
+        printf("  %-40s %8d bytes\n", $4, $2)
+        total += $2
+    }
+    END { printf("  %-40s %8d bytes\n", "total", total) }'
+
+echo "--------------- largest other objects --------------"
+"${PREFIX}nm" -S --size-sort -r -t d "$ELF" | awk -v top="$TOP_COUNT" '
+    $3 ~ /^[bBdD]$/ && $4 !~ /(_stack|_tcb|_storage|_queue)$/ && shown < top {
+        printf("  %-40s %8d bytes\n", $4, $2 + 0)
+        shown++
+    }'
+
+echo "===================================================="
+
+if [ -n "$BUDGET" ] && [ "$STATIC_TOTAL" -gt "$BUDGET" ]; then
+    echo "memory_budget: .data + .bss is $STATIC_TOTAL bytes, budget is $BUDGET bytes" >&2
+    exit 1
+fi
+
+exit 0